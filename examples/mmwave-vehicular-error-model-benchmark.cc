@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-error-model.h"
+#include "ns3/core-module.h"
+#include <chrono>
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularErrorModelBenchmark");
+
+using namespace ns3;
+using namespace millicar;
+
+/*
+ * This program compares the error model based on lookup tables with the
+ * MIESM error model of the mmwave module. A set of transport blocks with
+ * random MCS, size and frequency selective SINR is decoded with both models,
+ * and the time per transport block and the difference between the error
+ * rates are reported. The time needed to fill the tables, which is spent
+ * once per MCS and size class, is reported separately.
+ */
+
+/**
+ * Returns the time needed to decode all the transport blocks with a model
+ * \param model the error model
+ * \param sinrs the SINR of each transport block
+ * \param rbBitmap the resource blocks used by the transport blocks
+ * \param sizes the size of each transport block
+ * \param mcss the MCS of each transport block
+ * \param tblers filled with the error rate of each transport block
+ * \return the elapsed time in seconds
+ */
+static double
+DecodeAll (Ptr<MmWaveVehicularErrorModel> model,
+           const std::vector<SpectrumValue> &sinrs,
+           const std::vector<int> &rbBitmap,
+           const std::vector<uint32_t> &sizes,
+           const std::vector<uint8_t> &mcss,
+           std::vector<double> &tblers)
+{
+  tblers.resize (sinrs.size ());
+  auto start = std::chrono::steady_clock::now ();
+  for (uint32_t i = 0; i < sinrs.size (); ++i)
+    {
+      tblers[i] = model->GetTbler (sinrs[i], rbBitmap, sizes[i], mcss[i]);
+    }
+  auto end = std::chrono::steady_clock::now ();
+  return std::chrono::duration<double> (end - start).count ();
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t numTb = 10000; // number of transport blocks
+  uint32_t numRb = 72; // number of resource blocks of each transport block
+  double minSinr = -5; // lowest average SINR in dB
+  double maxSinr = 25; // highest average SINR in dB
+  double sinrStep = 0.25; // step of the SINR grid of the tables in dB
+
+  CommandLine cmd;
+  cmd.AddValue ("numTb", "number of transport blocks", numTb);
+  cmd.AddValue ("numRb", "number of resource blocks of each transport block", numRb);
+  cmd.AddValue ("minSinr", "lowest average SINR in dB", minSinr);
+  cmd.AddValue ("maxSinr", "highest average SINR in dB", maxSinr);
+  cmd.AddValue ("sinrStep", "step of the SINR grid of the tables in dB", sinrStep);
+  cmd.Parse (argc, argv);
+
+  Config::SetDefault ("ns3::MmWaveVehicularLutErrorModel::SinrStep", DoubleValue (sinrStep));
+
+  // generate the transport blocks, with Rayleigh fading on each resource block
+  std::vector<double> frequencies;
+  std::vector<int> rbBitmap;
+  for (uint32_t rb = 0; rb < numRb; ++rb)
+    {
+      frequencies.push_back (28e9 + rb * 1.44e6);
+      rbBitmap.push_back (rb);
+    }
+  Ptr<SpectrumModel> sm = Create<SpectrumModel> (frequencies);
+
+  Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable> ();
+  Ptr<ExponentialRandomVariable> fading = CreateObject<ExponentialRandomVariable> ();
+  fading->SetAttribute ("Mean", DoubleValue (1.0));
+
+  std::vector<SpectrumValue> sinrs;
+  std::vector<uint32_t> sizes;
+  std::vector<uint8_t> mcss;
+  for (uint32_t i = 0; i < numTb; ++i)
+    {
+      double avgSinr = std::pow (10.0, uniform->GetValue (minSinr, maxSinr) / 10);
+      SpectrumValue sinr (sm);
+      for (uint32_t rb = 0; rb < numRb; ++rb)
+        {
+          sinr[rb] = avgSinr * fading->GetValue ();
+        }
+      sinrs.push_back (sinr);
+      sizes.push_back (uniform->GetInteger (100, 10000));
+      mcss.push_back (uniform->GetInteger (0, 28));
+    }
+
+  Ptr<MmWaveVehicularErrorModel> exact = CreateObject<MmWaveVehicularMiErrorModel> ();
+  Ptr<MmWaveVehicularErrorModel> lut = CreateObject<MmWaveVehicularLutErrorModel> ();
+
+  std::vector<double> exactTblers;
+  std::vector<double> lutTblers;
+  double exactElapsed = DecodeAll (exact, sinrs, rbBitmap, sizes, mcss, exactTblers);
+  double fillElapsed = DecodeAll (lut, sinrs, rbBitmap, sizes, mcss, lutTblers); // fills the tables
+  double lutElapsed = DecodeAll (lut, sinrs, rbBitmap, sizes, mcss, lutTblers);
+
+  double meanError = 0;
+  double maxError = 0;
+  uint32_t decisions = 0; // number of transport blocks on opposite sides of the 10% error rate
+  for (uint32_t i = 0; i < numTb; ++i)
+    {
+      double error = std::abs (exactTblers[i] - lutTblers[i]);
+      meanError += error / numTb;
+      maxError = std::max (maxError, error);
+      if ((exactTblers[i] > 0.1) != (lutTblers[i] > 0.1))
+        {
+          decisions++;
+        }
+    }
+
+  std::cout << "transport blocks " << numTb
+            << " exact per TB " << exactElapsed / numTb * 1e6 << " us"
+            << " lut per TB " << lutElapsed / numTb * 1e6 << " us"
+            << " table filling " << fillElapsed - lutElapsed << " s"
+            << " mean TBLER error " << meanError
+            << " max TBLER error " << maxError
+            << " different decisions at 10% " << decisions << std::endl;
+
+  return 0;
+}
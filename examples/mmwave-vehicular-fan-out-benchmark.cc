@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-net-device.h"
+#include "ns3/mmwave-vehicular-helper.h"
+#include "ns3/mmwave-vehicular-spectrum-propagation-loss-model.h"
+#include "ns3/mmwave-spectrum-value-helper.h"
+#include "ns3/mobility-module.h"
+#include "ns3/core-module.h"
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularFanOutBenchmark");
+
+using namespace ns3;
+using namespace millicar;
+
+/*
+ * This program measures the time needed to compute the received PSDs of a
+ * dense platoon, in which every vehicle transmits once per millisecond
+ * towards all the other vehicles. Run it with different values of the
+ * threads parameter to evaluate the scaling of the parallel fan-out. The
+ * printed checksum does not depend on the number of threads.
+ * The number of heap allocations per link is reported as well; run it with
+ * psdPoolSize=0 to disable the reuse of the PSD buffers.
+ */
+
+double g_elapsed = 0; // wall-clock time spent computing the PSDs, in seconds
+double g_checksum = 0; // sum of the received power over all the links
+std::atomic<uint64_t> g_allocations (0); // number of heap allocations
+uint64_t g_psdAllocations = 0; // number of heap allocations while computing the PSDs
+
+void *
+operator new (std::size_t size)
+{
+  g_allocations++;
+  void *p = std::malloc (size);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+static void
+TransmitAll (Ptr<MmWaveVehicularSpectrumPropagationLossModel> splm,
+             NodeContainer nodes,
+             Ptr<const SpectrumValue> txPsd,
+             Ptr<MmWaveVehicularWorkerPool> pool)
+{
+  uint64_t allocations = g_allocations;
+  auto start = std::chrono::steady_clock::now ();
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      Ptr<const MobilityModel> a = nodes.Get (i)->GetObject<MobilityModel> ();
+      std::vector<Ptr<const MobilityModel> > receivers;
+      for (uint32_t j = 0; j < nodes.GetN (); ++j)
+        {
+          if (j != i)
+            {
+              receivers.push_back (nodes.Get (j)->GetObject<MobilityModel> ());
+            }
+        }
+
+      std::vector<Ptr<SpectrumValue> > rxPsds = splm->CalcRxPowerSpectralDensityMulti (txPsd, a, receivers, pool);
+      for (auto psd : rxPsds)
+        {
+          g_checksum += Sum (*psd);
+        }
+    }
+  auto end = std::chrono::steady_clock::now ();
+  g_elapsed += std::chrono::duration<double> (end - start).count ();
+  g_psdAllocations += g_allocations - allocations;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t numVehicles = 32; // number of vehicles in the platoon
+  uint32_t threads = 1; // number of threads used to compute the PSDs
+  uint32_t numTx = 100; // number of transmission rounds, one per millisecond
+  double intraGroupDistance = 5; // distance between two consecutive vehicles
+  double frequency = 28e9; // the carrier frequency
+  uint32_t antennaElements = 16; // number of antenna elements
+  uint32_t psdPoolSize = 1024; // maximum number of reused PSD buffers
+
+  CommandLine cmd;
+  cmd.AddValue ("vehicles", "number of vehicles", numVehicles);
+  cmd.AddValue ("threads", "number of threads used to compute the PSDs", threads);
+  cmd.AddValue ("numTx", "number of transmission rounds", numTx);
+  cmd.AddValue ("intraGroupDistance", "distance between two consecutive vehicles", intraGroupDistance);
+  cmd.AddValue ("antennaElements", "number of antenna elements", antennaElements);
+  cmd.AddValue ("psdPoolSize", "maximum number of reused PSD buffers, 0 to disable the reuse", psdPoolSize);
+  cmd.Parse (argc, argv);
+
+  Config::SetDefault ("ns3::MmWavePhyMacCommon::CenterFreq", DoubleValue (frequency));
+  Config::SetDefault ("ns3::MmWaveVehicularPropagationLossModel::Frequency", DoubleValue (frequency));
+  Config::SetDefault ("ns3::MmWaveVehicularSpectrumPropagationLossModel::Frequency", DoubleValue (frequency));
+  Config::SetDefault ("ns3::MmWaveVehicularSpectrumPropagationLossModel::PsdPoolSize", UintegerValue (psdPoolSize));
+  Config::SetDefault ("ns3::MmWaveVehicularPropagationLossModel::ChannelCondition", StringValue ("a"));
+  Config::SetDefault ("ns3::MmWaveVehicularAntennaArrayModel::AntennaElements", UintegerValue (antennaElements));
+  Config::SetDefault ("ns3::MmWaveVehicularAntennaArrayModel::NumSectors", UintegerValue (2));
+
+  // create the platoon
+  NodeContainer n;
+  n.Create (numVehicles);
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantVelocityMobilityModel");
+  mobility.Install (n);
+  for (uint32_t i = 0; i < numVehicles; ++i)
+    {
+      n.Get (i)->GetObject<MobilityModel> ()->SetPosition (Vector (0, i * intraGroupDistance, 0));
+      n.Get (i)->GetObject<ConstantVelocityMobilityModel> ()->SetVelocity (Vector (0, 20, 0));
+    }
+
+  Ptr<MmWaveVehicularHelper> helper = CreateObject<MmWaveVehicularHelper> ();
+  helper->SetNumerology (3);
+  helper->SetPropagationLossModelType ("ns3::MmWaveVehicularPropagationLossModel");
+  helper->SetSpectrumPropagationLossModelType ("ns3::MmWaveVehicularSpectrumPropagationLossModel");
+  NetDeviceContainer devs = helper->InstallMmWaveVehicularNetDevices (n);
+
+  // retrieve the spectrum propagation loss model from the channel
+  Ptr<MmWaveSidelinkSpectrumPhy> ssp = DynamicCast<MmWaveVehicularNetDevice> (devs.Get (0))->GetPhy ()->GetSpectrumPhy ();
+  Ptr<MmWaveVehicularSpectrumPropagationLossModel> splm = DynamicCast<MmWaveVehicularSpectrumPropagationLossModel> (ssp->GetSpectrumChannel ()->GetSpectrumPropagationLossModel ());
+  NS_ASSERT_MSG (splm, "Unexpected spectrum propagation loss model");
+
+  // each vehicle points its beam towards the next one
+  for (uint32_t i = 0; i < numVehicles; ++i)
+    {
+      Ptr<MmWaveVehicularNetDevice> dev = DynamicCast<MmWaveVehicularNetDevice> (devs.Get (i));
+      Ptr<MmWaveVehicularAntennaArrayModel> antenna = DynamicCast<MmWaveVehicularAntennaArrayModel> (dev->GetPhy ()->GetSpectrumPhy ()->GetRxAntenna ());
+      antenna->SetBeamformingVectorPanelDevices (devs.Get (i), devs.Get ((i + 1) % numVehicles));
+    }
+
+  // create the tx PSD, using all the resource blocks
+  Ptr<mmwave::MmWavePhyMacCommon> conf = helper->GetConfigurationParameters ();
+  std::vector<int> subChannels;
+  for (uint32_t i = 0; i < conf->GetTotalNumChunk (); ++i)
+    {
+      subChannels.push_back (i);
+    }
+  Ptr<const SpectrumValue> txPsd = mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (conf, 30, subChannels);
+
+  Ptr<MmWaveVehicularWorkerPool> pool;
+  if (threads > 1)
+    {
+      pool = Create<MmWaveVehicularWorkerPool> (threads);
+    }
+
+  for (uint32_t t = 0; t < numTx; ++t)
+    {
+      Simulator::Schedule (MilliSeconds (t), &TransmitAll, splm, n, txPsd, pool);
+    }
+
+  Simulator::Stop (MilliSeconds (numTx + 1));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  std::cout << "vehicles " << numVehicles
+            << " threads " << threads
+            << " links per round " << numVehicles * (numVehicles - 1)
+            << " elapsed " << g_elapsed << " s"
+            << " per link " << g_elapsed / (numTx * numVehicles * (numVehicles - 1)) * 1e6 << " us"
+            << " allocations per link " << double (g_psdAllocations) / (numTx * numVehicles * (numVehicles - 1))
+            << " checksum " << g_checksum << std::endl;
+
+  return 0;
+}
@@ -20,9 +20,10 @@
 #include "mmwave-vehicular-helper.h"
 #include "ns3/log.h"
 #include "ns3/double.h"
+#include "ns3/boolean.h"
 #include "ns3/mmwave-vehicular-net-device.h"
 #include "ns3/internet-stack-helper.h"
-#include "ns3/single-model-spectrum-channel.h"
+#include "ns3/mmwave-vehicular-spectrum-channel.h"
 #include "ns3/mmwave-vehicular-antenna-array-model.h"
 #include "ns3/mmwave-vehicular-spectrum-propagation-loss-model.h"
 #include "ns3/pointer.h"
@@ -96,6 +97,21 @@ MmWaveVehicularHelper::GetTypeId ()
                                    &MmWaveVehicularHelper::GetSchedulingPatternOptionType),
                  MakeEnumChecker(DEFAULT, "Default",
                                  OPTIMIZED, "Optimized"))
+  .AddAttribute ("SharedSlotClock",
+                 "If true, all the devices installed on the channel are driven by "
+                 "a single slot clock, which schedules one event per slot boundary "
+                 "instead of one event per device",
+                 BooleanValue (false),
+                 MakeBooleanAccessor (&MmWaveVehicularHelper::m_sharedSlotClock),
+                 MakeBooleanChecker ())
+  .AddAttribute ("RbGroupSize",
+                 "Number of resource blocks in each band of the spectrum model used by the PHYs. "
+                 "The PSDs, the fading, the interference and the error model work on one value "
+                 "per group, trading spectral resolution for speed. It must divide the number "
+                 "of resource blocks",
+                 UintegerValue (1),
+                 MakeUintegerAccessor (&MmWaveVehicularHelper::m_rbGroupSize),
+                 MakeUintegerChecker<uint32_t> (1))
   ;
 
   return tid;
@@ -110,7 +126,7 @@ MmWaveVehicularHelper::DoInitialize ()
   m_rntiCounter = 0;
 
   // create the channel
-  m_channel = CreateObject<SingleModelSpectrumChannel> ();
+  m_channel = CreateObject<MmWaveVehicularSpectrumChannel> ();
   if (!m_propagationLossModelType.empty ())
   {
     ObjectFactory factory (m_propagationLossModelType);
@@ -142,6 +158,8 @@ MmWaveVehicularHelper::SetConfigurationParameters (Ptr<mmwave::MmWavePhyMacCommo
 {
   NS_LOG_FUNCTION (this);
   m_phyMacConfig = conf;
+  m_spectrumConfig = 0;
+  m_spectrumModel = 0;
 }
 
 Ptr<mmwave::MmWavePhyMacCommon>
@@ -163,6 +181,8 @@ MmWaveVehicularHelper::SetNumerology (uint8_t index)
   m_numerologyIndex = index;
 
   m_phyMacConfig = CreateObject<mmwave::MmWavePhyMacCommon> ();
+  m_spectrumConfig = 0;
+  m_spectrumModel = 0;
 
   double subcarrierSpacing = 15 * std::pow (2, m_numerologyIndex) * 1000; // subcarrier spacing based on the numerology. Only 60KHz and 120KHz is supported in NR V2X.
 
@@ -183,6 +203,41 @@ MmWaveVehicularHelper::SetNumerology (uint8_t index)
 
 }
 
+void
+MmWaveVehicularHelper::CreateSpectrumConfiguration ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_phyMacConfig->GetNumRb () % m_rbGroupSize != 0)
+  {
+    NS_FATAL_ERROR ("The RB group size " << m_rbGroupSize << " does not divide the number of RBs " << m_phyMacConfig->GetNumRb ());
+  }
+
+  // all the other parameters are the same, hence the MAC and the PHYs use
+  // the same bandwidth and the same center frequency
+  m_spectrumConfig = CopyObject<mmwave::MmWavePhyMacCommon> (m_phyMacConfig);
+  m_spectrumConfig->SetNumRb (m_phyMacConfig->GetNumRb () / m_rbGroupSize);
+  m_spectrumConfig->SetChunkWidth (m_phyMacConfig->GetChunkWidth () * m_rbGroupSize);
+
+  // the bands are centered around the center frequency, as in the model of
+  // MmWaveSpectrumValueHelper, which can't be used since it caches the models
+  // by center frequency only
+  double chunkWidth = m_spectrumConfig->GetChunkWidth ();
+  uint32_t numChunks = m_spectrumConfig->GetTotalNumChunk ();
+  Bands bands;
+  double f = m_spectrumConfig->GetCenterFrequency () - numChunks * chunkWidth / 2.0;
+  for (uint32_t i = 0; i < numChunks; i++)
+  {
+    BandInfo b;
+    b.fl = f;
+    f += chunkWidth / 2;
+    b.fc = f;
+    f += chunkWidth / 2;
+    b.fh = f;
+    bands.push_back (b);
+  }
+  m_spectrumModel = Create<SpectrumModel> (bands);
+}
+
 NetDeviceContainer
 MmWaveVehicularHelper::InstallMmWaveVehicularNetDevices (NodeContainer nodes)
 {
@@ -234,6 +289,27 @@ MmWaveVehicularHelper::InstallSingleMmWaveVehicularNetDevice (Ptr<Node> node, ui
   // create the phy
   NS_ASSERT_MSG (m_phyMacConfig, "First set the configuration parameters");
   Ptr<MmWaveSidelinkPhy> phy = CreateObject<MmWaveSidelinkPhy> (ssp, m_phyMacConfig);
+  if (m_rbGroupSize > 1)
+  {
+    // the spectrum model is shared by all the PHYs attached to the channel
+    if (!m_spectrumModel)
+    {
+      CreateSpectrumConfiguration ();
+    }
+    phy->SetSpectrumConfiguration (m_spectrumConfig, m_spectrumModel);
+  }
+
+  // use the shared slot clock (if needed)
+  if (m_sharedSlotClock)
+  {
+    // a new clock is needed if the numerology has changed
+    Time slotPeriod = NanoSeconds (m_phyMacConfig->GetSymbolPeriod () * 1e3 * m_phyMacConfig->GetSymbPerSlot ());
+    if (!m_slotClock || m_slotClock->GetSlotPeriod () != slotPeriod)
+    {
+      m_slotClock = CreateObject<MmWaveSidelinkSlotClock> (m_phyMacConfig);
+    }
+    phy->SetSlotClock (m_slotClock);
+  }
 
   // connect the rx callback of the spectrum object to the sink
   ssp->SetPhyRxDataEndOkCallback (MakeCallback (&MmWaveSidelinkPhy::Receive, phy));
@@ -263,10 +339,29 @@ MmWaveVehicularHelper::InstallSingleMmWaveVehicularNetDevice (Ptr<Node> node, ui
   // connect the rx callback of the mac object to the rx method of the NetDevice
   mac->SetForwardUpCallback(MakeCallback(&MmWaveVehicularNetDevice::Receive, device));
 
+  // create the context of the device, shared by the phy and the channel
+  Ptr<MmWaveVehicularDeviceContext> context = Create<MmWaveVehicularDeviceContext> ();
+  context->m_device = device;
+  context->m_rnti = rnti;
+  context->m_antenna = aam;
+  context->m_mobility = node->GetObject<MobilityModel> ();
+  ssp->SetDeviceContext (context);
+
   // initialize the channel (if needed)
   Ptr<MmWaveVehicularSpectrumPropagationLossModel> splm = DynamicCast<MmWaveVehicularSpectrumPropagationLossModel> (m_channel->GetSpectrumPropagationLossModel ());
   if (splm)
-    splm->AddDevice (device, aam);
+    {
+      // the splm allocates the index of the device
+      splm->AddDevice (context);
+
+      // the beam training uses the channels cached by the splm
+      if (!m_beamSweep)
+        {
+          m_beamSweep = CreateObject<MmWaveVehicularBeamSweep> ();
+          m_beamSweep->SetPropagationLossModel (splm);
+        }
+      phy->SetBeamSweep (m_beamSweep);
+    }
 
   return device;
 }
@@ -26,6 +26,8 @@
 #include "ns3/spectrum-channel.h"
 #include "ns3/mmwave-phy-mac-common.h"
 #include "ns3/mmwave-vehicular-traces-helper.h"
+#include "ns3/mmwave-vehicular-beam-sweep.h"
+#include "ns3/mmwave-sidelink-slot-clock.h"
 
 namespace ns3 {
 
@@ -141,6 +143,13 @@ private:
    */
   Ptr<MmWaveVehicularNetDevice> InstallSingleMmWaveVehicularNetDevice (Ptr<Node> n, uint16_t rnti);
 
+  /**
+   * Create the configuration and the spectrum model used by the PHYs to
+   * create the PSDs, in which each chunk spans a group of m_rbGroupSize
+   * resource blocks
+   */
+  void CreateSpectrumConfiguration ();
+
   Ptr<SpectrumChannel> m_channel; //!< the SpectrumChannel
   Ptr<mmwave::MmWavePhyMacCommon> m_phyMacConfig; //!< the configuration parameters
   uint16_t m_rntiCounter; //!< a counter to set the RNTIs
@@ -152,6 +161,12 @@ private:
   SchedulingPatternOption_t m_schedulingOpt; //!< the type of scheduling pattern policy to be adopted
 
   Ptr<MmWaveVehicularTracesHelper> m_phyTraceHelper; //!< Ptr to an helper for the physical layer traces
+  Ptr<MmWaveVehicularBeamSweep> m_beamSweep; //!< the beam training module shared by all the devices
+  bool m_sharedSlotClock; //!< if true, the devices are driven by a shared slot clock
+  Ptr<MmWaveSidelinkSlotClock> m_slotClock; //!< the slot clock shared by the devices on the channel
+  uint32_t m_rbGroupSize; //!< number of resource blocks in each band of the spectrum model
+  Ptr<mmwave::MmWavePhyMacCommon> m_spectrumConfig; //!< the configuration of the spectrum, with one chunk per group of resource blocks
+  Ptr<SpectrumModel> m_spectrumModel; //!< the spectrum model with one band per group of resource blocks
 
 };
 
@@ -50,6 +50,12 @@ MacSidelinkMemberPhySapUser::SlotIndication (mmwave::SfnSf timingInfo)
   m_mac->DoSlotIndication (timingInfo);
 }
 
+uint32_t
+MacSidelinkMemberPhySapUser::GetSlotsUntilNextActivity (mmwave::SfnSf timingInfo) const
+{
+  return m_mac->DoGetSlotsUntilNextActivity (timingInfo);
+}
+
 void
 MacSidelinkMemberPhySapUser::SlSinrReport (const SpectrumValue& sinr, uint16_t rnti, uint8_t numSym, uint32_t tbSize)
 {
@@ -112,6 +118,9 @@ MmWaveSidelinkMac::MmWaveSidelinkMac (Ptr<mmwave::MmWavePhyMacCommon> pmc)
   // initialize the RNTI to 0
   m_rnti = 0;
 
+  // the PHY SAP PROVIDER is set by SetPhySapProvider
+  m_phySapProvider = nullptr;
+
   // create the PHY SAP USER
   m_phySapUser = new MacSidelinkMemberPhySapUser (this);
 
@@ -181,6 +190,28 @@ MmWaveSidelinkMac::DoSlotIndication (mmwave::SfnSf timingInfo)
 
 }
 
+uint32_t
+MmWaveSidelinkMac::DoGetSlotsUntilNextActivity (mmwave::SfnSf timingInfo) const
+{
+  NS_ASSERT_MSG (!m_sfAllocInfo.empty (), "First set the scheduling pattern");
+
+  // the pattern is repeated in every subframe, hence it is enough to check
+  // the slots of a subframe
+  for (uint32_t i = 0; i < m_sfAllocInfo.size (); i++)
+  {
+    uint16_t rnti = m_sfAllocInfo [(timingInfo.m_slotNum + i) % m_sfAllocInfo.size ()];
+    if (rnti == m_rnti && !m_bufferStatusReportMap.empty ())
+    {
+      return i; // transmission opportunity with pending data
+    }
+    else if (rnti != m_rnti && rnti != 0)
+    {
+      return i; // possible reception
+    }
+  }
+  return UINT32_MAX;
+}
+
 std::list<mmwave::SlotAllocInfo>
 MmWaveSidelinkMac::ScheduleResources (mmwave::SfnSf timingInfo)
 {
@@ -380,6 +411,12 @@ MmWaveSidelinkMac::DoReportBufferStatus (LteMacSapProvider::ReportBufferStatusPa
     m_bufferStatusReportMap.insert (std::make_pair (params.lcid, params));
     NS_LOG_DEBUG("Insert buffer status report for LCID " << uint32_t(params.lcid));
   }
+
+  // wake up the PHY, it may be skipping the slots of this device
+  if (m_phySapProvider != nullptr)
+  {
+    m_phySapProvider->NotifyActivity ();
+  }
 }
 
 void
@@ -464,6 +501,12 @@ MmWaveSidelinkMac::SetSfAllocationInfo (std::vector<uint16_t> pattern)
   NS_LOG_FUNCTION (this);
   NS_ASSERT_MSG (pattern.size () == m_phyMacConfig->GetSlotsPerSubframe (), "The number of pattern elements must be equal to the number of slots per subframe");
   m_sfAllocInfo = pattern;
+
+  // the active slots may have changed
+  if (m_phySapProvider != nullptr)
+  {
+    m_phySapProvider->NotifyActivity ();
+  }
 }
 
 void
@@ -84,6 +84,16 @@ public:
   */
   void DoSlotIndication (mmwave::SfnSf timingInfo);
 
+  /**
+  * \brief compute the number of idle slots before the next slot in which the
+  *        device has to transmit (i.e., a slot associated to this device, with
+  *        pending data) or to receive (i.e., a slot associated to another device)
+  * \param timingInfo the structure containing the timing information of the
+  *        first slot to check
+  * \return the number of idle slots, or UINT32_MAX if no slot is active
+  */
+  uint32_t DoGetSlotsUntilNextActivity (mmwave::SfnSf timingInfo) const;
+
   /**
   * \brief Get the PHY SAP user
   * \return a pointer to the SAP user
@@ -229,6 +239,8 @@ public:
 
   void SlotIndication (mmwave::SfnSf timingInfo) override;
 
+  uint32_t GetSlotsUntilNextActivity (mmwave::SfnSf timingInfo) const override;
+
   void SlSinrReport (const SpectrumValue& sinr, uint16_t rnti, uint8_t numSym, uint32_t tbSize) override;
 
 private:
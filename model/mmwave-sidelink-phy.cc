@@ -24,6 +24,7 @@
 #include <ns3/mmwave-mac-pdu-header.h>
 #include <ns3/double.h>
 #include <ns3/pointer.h>
+#include <ns3/boolean.h>
 
 namespace ns3 {
 
@@ -47,6 +48,12 @@ MacSidelinkMemberPhySapProvider::PrepareForReception (uint16_t rnti)
   m_phy->DoPrepareForReceptionFrom (rnti);
 }
 
+void
+MacSidelinkMemberPhySapProvider::NotifyActivity ()
+{
+  m_phy->DoNotifyActivity ();
+}
+
 //-----------------------------------------------------------------------
 
 NS_LOG_COMPONENT_DEFINE ("MmWaveSidelinkPhy");
@@ -60,20 +67,27 @@ MmWaveSidelinkPhy::MmWaveSidelinkPhy ()
 }
 
 MmWaveSidelinkPhy::MmWaveSidelinkPhy (Ptr<MmWaveSidelinkSpectrumPhy> spectrumPhy, Ptr<mmwave::MmWavePhyMacCommon> confParams)
+  : m_skipIdleSlots (false),
+    m_inSlot (false),
+    m_slotClockId (0),
+    m_idleSlots (0),
+    m_txPsdPower (0)
 {
   NS_LOG_FUNCTION (this);
   m_sidelinkSpectrumPhy = spectrumPhy;
   m_phyMacConfig = confParams;
+  m_spectrumConfig = confParams;
+  m_spectrumModel = mmwave::MmWaveSpectrumValueHelper::GetSpectrumModel (m_spectrumConfig);
 
   // create the PHY SAP provider
   m_phySapProvider = new MacSidelinkMemberPhySapProvider (this);
 
   // create the noise PSD
-  Ptr<SpectrumValue> noisePsd = mmwave::MmWaveSpectrumValueHelper::CreateNoisePowerSpectralDensity (m_phyMacConfig, m_noiseFigure);
+  Ptr<SpectrumValue> noisePsd = mmwave::MmWaveSpectrumValueHelper::CreateNoisePowerSpectralDensity (m_noiseFigure, m_spectrumModel);
   m_sidelinkSpectrumPhy->SetNoisePowerSpectralDensity (noisePsd);
 
   // schedule the first slot
-  Simulator::ScheduleNow (&MmWaveSidelinkPhy::StartSlot, this, mmwave::SfnSf (0, 0, 0));
+  m_slotEvent = Simulator::ScheduleNow (&MmWaveSidelinkPhy::StartSlot, this, mmwave::SfnSf (0, 0, 0));
 }
 
 MmWaveSidelinkPhy::~MmWaveSidelinkPhy ()
@@ -104,7 +118,14 @@ MmWaveSidelinkPhy::GetTypeId (void)
                     DoubleValue (5.0),
                     MakeDoubleAccessor (&MmWaveSidelinkPhy::SetNoiseFigure,
                                         &MmWaveSidelinkPhy::GetNoiseFigure),
-                    MakeDoubleChecker<double> ());
+                    MakeDoubleChecker<double> ())
+    .AddAttribute ("SkipIdleSlots",
+                   "If true, the slots in which the device has nothing to transmit and "
+                   "nothing to receive are not processed, and the MAC is not triggered. "
+                   "The PHY is woken up by the activity notifications of the MAC",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MmWaveSidelinkPhy::m_skipIdleSlots),
+                   MakeBooleanChecker ());
   return tid;
 }
 
@@ -119,12 +140,24 @@ MmWaveSidelinkPhy::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
   delete m_phySapProvider;
+  m_beamSweep = 0;
+  m_slotEvent.Cancel ();
+  if (m_slotClockId != 0)
+  {
+    m_slotClock->Unsubscribe (m_slotClockId);
+    m_slotClockId = 0;
+  }
+  m_slotClock = 0;
+  m_txPsd = 0;
 }
 
 void
 MmWaveSidelinkPhy::SetTxPower (double power)
 {
   m_txPower = power;
+
+  // the tx PSD has to be recomputed
+  m_txPsd = 0;
 }
 double
 MmWaveSidelinkPhy::GetTxPower () const
@@ -138,7 +171,7 @@ MmWaveSidelinkPhy::SetNoiseFigure (double nf)
   m_noiseFigure = nf;
 
   // update the noise PSD
-  Ptr<SpectrumValue> noisePsd = mmwave::MmWaveSpectrumValueHelper::CreateNoisePowerSpectralDensity (m_phyMacConfig, m_noiseFigure);
+  Ptr<SpectrumValue> noisePsd = mmwave::MmWaveSpectrumValueHelper::CreateNoisePowerSpectralDensity (m_noiseFigure, m_spectrumModel);
   m_sidelinkSpectrumPhy->SetNoisePowerSpectralDensity (noisePsd);
 }
 
@@ -160,6 +193,23 @@ MmWaveSidelinkPhy::GetConfigurationParameters (void) const
   return m_phyMacConfig;
 }
 
+void
+MmWaveSidelinkPhy::SetSpectrumConfiguration (Ptr<mmwave::MmWavePhyMacCommon> config, Ptr<SpectrumModel> model)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (config->GetCenterFrequency () == m_phyMacConfig->GetCenterFrequency (),
+                 "The spectrum must have the same center frequency of the configuration parameters");
+  NS_ASSERT_MSG (model->GetNumBands () == config->GetTotalNumChunk (),
+                 "The spectrum model must have one band per chunk");
+  m_spectrumConfig = config;
+  m_spectrumModel = model;
+
+  // the noise PSD and the tx PSD have to be recomputed with the new spectrum model
+  Ptr<SpectrumValue> noisePsd = mmwave::MmWaveSpectrumValueHelper::CreateNoisePowerSpectralDensity (m_noiseFigure, m_spectrumModel);
+  m_sidelinkSpectrumPhy->SetNoisePowerSpectralDensity (noisePsd);
+  m_txPsd = 0;
+}
+
 MmWaveSidelinkPhySapProvider*
 MmWaveSidelinkPhy::GetPhySapProvider () const
 {
@@ -182,6 +232,45 @@ MmWaveSidelinkPhy::DoAddTransportBlock (Ptr<PacketBurst> pb, mmwave::SlotAllocIn
 
   // add the new entry to the buffer
   m_phyBuffer.push_back (e);
+
+  // the TB may be added while the PHY is skipping the idle slots
+  DoNotifyActivity ();
+}
+
+void
+MmWaveSidelinkPhy::DoNotifyActivity ()
+{
+  if (!m_skipIdleSlots || m_inSlot)
+  {
+    // the next slot will be scheduled at the end of the current one
+    return;
+  }
+
+  if (m_slotClock)
+  {
+    // process the next tick of the clock
+    m_idleSlots = 0;
+    if (m_slotClockId == 0)
+    {
+      m_slotClockId = m_slotClock->Subscribe (MakeCallback (&MmWaveSidelinkPhy::SlotTick, this));
+    }
+    return;
+  }
+
+  // the first slot which starts after now
+  Time slotPeriod = GetSlotPeriod ();
+  uint64_t nextSlot = (Simulator::Now () - m_lastSlotStart).GetTimeStep () / slotPeriod.GetTimeStep () + 1;
+  Time delay = m_lastSlotStart + slotPeriod * int64_t (nextSlot) - Simulator::Now ();
+
+  if (m_slotEvent.IsRunning () && Simulator::GetDelayLeft (m_slotEvent) <= delay)
+  {
+    NS_LOG_LOGIC ("Already scheduled");
+    return;
+  }
+
+  NS_LOG_LOGIC ("Wake up in " << delay.GetNanoSeconds () << " ns");
+  m_slotEvent.Cancel ();
+  m_slotEvent = Simulator::Schedule (delay, &MmWaveSidelinkPhy::StartSlot, this, AdvanceTimingInfo (m_lastSlot, nextSlot));
 }
 
 void
@@ -189,6 +278,10 @@ MmWaveSidelinkPhy::StartSlot (mmwave::SfnSf timingInfo)
 {
    NS_LOG_FUNCTION (this << " frame " << timingInfo.m_frameNum << " subframe " << timingInfo.m_sfNum << " slot " << timingInfo.m_slotNum);
 
+  m_inSlot = true;
+  m_lastSlot = timingInfo;
+  m_lastSlotStart = Simulator::Now ();
+
   // trigger the MAC
   m_phySapUser->SlotIndication (timingInfo);
 
@@ -225,23 +318,78 @@ MmWaveSidelinkPhy::StartSlot (mmwave::SfnSf timingInfo)
     m_phyBuffer.pop_front ();
   }
 
-  // convert the slot period from seconds to nanoseconds
-  // TODO change GetSlotPeriod to return a TimeValue
-  double slotPeriod = m_phyMacConfig->GetSymbolPeriod () * 1e3 * m_phyMacConfig->GetSymbPerSlot ();
+  m_inSlot = false;
+
+  if (m_slotClock)
+  {
+    // the next slot is triggered by the shared clock
+    if (m_skipIdleSlots)
+    {
+      m_idleSlots = m_phySapUser->GetSlotsUntilNextActivity (UpdateTimingInfo (timingInfo));
+      if (m_idleSlots == UINT32_MAX)
+      {
+        NS_LOG_LOGIC ("Nothing to do, wait for the next activity notification");
+        m_slotClock->Unsubscribe (m_slotClockId);
+        m_slotClockId = 0;
+        m_idleSlots = 0;
+      }
+    }
+    return;
+  }
 
   // update the timing information
   timingInfo = UpdateTimingInfo (timingInfo);
-  Simulator::Schedule (NanoSeconds (slotPeriod), &MmWaveSidelinkPhy::StartSlot, this, timingInfo);
+
+  uint32_t idleSlots = 0;
+  if (m_skipIdleSlots)
+  {
+    idleSlots = m_phySapUser->GetSlotsUntilNextActivity (timingInfo);
+    if (idleSlots == UINT32_MAX)
+    {
+      NS_LOG_LOGIC ("Nothing to do, wait for the next activity notification");
+      return;
+    }
+    timingInfo = AdvanceTimingInfo (timingInfo, idleSlots);
+  }
+  m_slotEvent = Simulator::Schedule (GetSlotPeriod () * int64_t (idleSlots + 1), &MmWaveSidelinkPhy::StartSlot, this, timingInfo);
+}
+
+void
+MmWaveSidelinkPhy::SlotTick (mmwave::SfnSf timingInfo)
+{
+  if (m_idleSlots > 0)
+  {
+    m_idleSlots--;
+    return;
+  }
+  StartSlot (timingInfo);
+}
+
+void
+MmWaveSidelinkPhy::SetSlotClock (Ptr<MmWaveSidelinkSlotClock> clock)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (clock->GetSlotPeriod () == GetSlotPeriod (), "The slot clock uses a different frame structure");
+
+  // stop the event loop of this device
+  m_slotEvent.Cancel ();
+  if (m_slotClockId != 0)
+  {
+    m_slotClock->Unsubscribe (m_slotClockId);
+  }
+
+  m_slotClock = clock;
+  m_idleSlots = 0;
+  m_slotClockId = m_slotClock->Subscribe (MakeCallback (&MmWaveSidelinkPhy::SlotTick, this));
 }
 
 uint8_t
-MmWaveSidelinkPhy::SlData (Ptr<PacketBurst> pb, mmwave::SlotAllocInfo info)
+MmWaveSidelinkPhy::SlData (Ptr<PacketBurst> pb, const mmwave::SlotAllocInfo &info)
 {
   NS_LOG_FUNCTION (this);
 
-  // create the tx PSD
-  //TODO do we need to create a new psd at each TTI?
-  std::vector<int> subChannelsForTx = SetSubChannelsForTransmission ();
+  // set the tx PSD
+  Ptr<const MmWaveSidelinkRbBitmap> subChannelsForTx = SetSubChannelsForTransmission ();
 
   // compute the tx start time (IndexOfTheFirstSymbol * SymbolDuration)
   Time startTime = NanoSeconds (info.m_dci.m_symStart * m_phyMacConfig->GetSymbolPeriod () * 1e3);
@@ -265,8 +413,8 @@ MmWaveSidelinkPhy::SlData (Ptr<PacketBurst> pb, mmwave::SlotAllocInfo info)
 void
 MmWaveSidelinkPhy::SendDataChannels (Ptr<PacketBurst> pb,
   Time duration,
-  mmwave::SlotAllocInfo info,
-  std::vector<int> rbBitmap)
+  const mmwave::SlotAllocInfo &info,
+  Ptr<const MmWaveSidelinkRbBitmap> rbBitmap)
 {
   // retrieve the RNTI of the device we want to communicate with and properly
   // configure the beamforming
@@ -277,23 +425,45 @@ MmWaveSidelinkPhy::SendDataChannels (Ptr<PacketBurst> pb,
   m_sidelinkSpectrumPhy->StartTxDataFrames (pb, duration, info.m_slotIdx, info.m_dci.m_mcs, info.m_dci.m_tbSize, info.m_dci.m_numSym, info.m_dci.m_rnti, info.m_rnti, rbBitmap);
 }
 
-std::vector<int>
+Ptr<const MmWaveSidelinkRbBitmap>
 MmWaveSidelinkPhy::SetSubChannelsForTransmission ()
   {
-    // create the transmission mask, use all the available subchannels
-    std::vector<int> subChannelsForTx (m_phyMacConfig->GetTotalNumChunk ());
-    for (uint32_t i = 0; i < subChannelsForTx.size (); i++)
+    // create the transmission mask, use all the available subchannels. The
+    // mask is immutable, hence it is shared by the transmissions and a new
+    // one is created when it changes
+    if (!m_subChannelsForTx || m_subChannelsForTx->Get ().size () != m_spectrumConfig->GetTotalNumChunk ())
     {
-      subChannelsForTx.at(i) = i;
+      std::vector<int> subChannels (m_spectrumConfig->GetTotalNumChunk ());
+      for (uint32_t i = 0; i < subChannels.size (); i++)
+      {
+        subChannels.at(i) = i;
+      }
+      m_subChannelsForTx = Create<MmWaveSidelinkRbBitmap> (subChannels);
     }
 
-    // create the tx PSD
-    Ptr<SpectrumValue> txPsd = mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (m_phyMacConfig, m_txPower, subChannelsForTx);
+    // create the tx PSD, if the power or the mask changed. The PSD is
+    // shared with the transmitted signals, which copy it when needed, hence
+    // a new one is created instead of modifying it
+    if (!m_txPsd || m_txPsdPower != m_txPower || m_txPsdSubChannels != m_subChannelsForTx)
+    {
+      NS_LOG_LOGIC ("Create the tx PSD");
+      // the power is spread over the bandwidth covered by the chunks, as done
+      // by MmWaveSpectrumValueHelper, but on the bands of m_spectrumModel
+      double bandwidth = m_spectrumConfig->GetTotalNumChunk () * m_spectrumConfig->GetChunkWidth ();
+      double txPowerDensity = std::pow (10., (m_txPower - 30) / 10) / bandwidth;
+      m_txPsd = Create<SpectrumValue> (m_spectrumModel);
+      for (int rbId : m_subChannelsForTx->Get ())
+      {
+        (*m_txPsd)[rbId] = txPowerDensity;
+      }
+      m_txPsdPower = m_txPower;
+      m_txPsdSubChannels = m_subChannelsForTx;
+    }
 
     // set the tx PSD in the spectrum phy
-    m_sidelinkSpectrumPhy->SetTxPowerSpectralDensity (txPsd);
+    m_sidelinkSpectrumPhy->SetTxPowerSpectralDensity (m_txPsd);
 
-    return subChannelsForTx;
+    return m_subChannelsForTx;
   }
 
 mmwave::SfnSf
@@ -325,12 +495,41 @@ MmWaveSidelinkPhy::UpdateTimingInfo (mmwave::SfnSf info) const
   return info;
 }
 
+mmwave::SfnSf
+MmWaveSidelinkPhy::AdvanceTimingInfo (mmwave::SfnSf info, uint64_t numSlots) const
+{
+  uint64_t slotsPerSf = m_phyMacConfig->GetSlotsPerSubframe ();
+  uint64_t sfPerFrame = m_phyMacConfig->GetSubframesPerFrame ();
+
+  // absolute index of the slot
+  uint64_t slot = (uint64_t (info.m_frameNum) * sfPerFrame + info.m_sfNum) * slotsPerSf + info.m_slotNum + numSlots;
+
+  info.m_slotNum = slot % slotsPerSf;
+  info.m_sfNum = (slot / slotsPerSf) % sfPerFrame;
+  info.m_frameNum = slot / slotsPerSf / sfPerFrame;
+
+  return info;
+}
+
+Time
+MmWaveSidelinkPhy::GetSlotPeriod () const
+{
+  // convert the slot period from seconds to nanoseconds
+  // TODO change GetSlotPeriod to return a TimeValue
+  double slotPeriod = m_phyMacConfig->GetSymbolPeriod () * 1e3 * m_phyMacConfig->GetSymbPerSlot ();
+  return NanoSeconds (slotPeriod);
+}
+
 void
 MmWaveSidelinkPhy::DoPrepareForReceptionFrom (uint16_t rnti)
 {
   NS_LOG_FUNCTION (this);
   NS_ASSERT_MSG (m_deviceMap.find (rnti) != m_deviceMap.end (), "Cannot find device with rnti " << rnti);
   m_sidelinkSpectrumPhy->ConfigureBeamforming (m_deviceMap.at (rnti));
+
+  // the interference has to be tracked from now on, the transmission of the
+  // other device starts in this slot
+  m_sidelinkSpectrumPhy->ExpectReception (GetSlotPeriod ());
 }
 
 void
@@ -369,5 +568,25 @@ MmWaveSidelinkPhy::GenerateSinrReport (const SpectrumValue& sinr, uint16_t rnti,
   m_phySapUser->SlSinrReport (sinr, rnti, numSym, tbSize);
 }
 
+void
+MmWaveSidelinkPhy::SetBeamSweep (Ptr<MmWaveVehicularBeamSweep> beamSweep)
+{
+  m_beamSweep = beamSweep;
+}
+
+bool
+MmWaveSidelinkPhy::PerformBeamSweep (uint16_t rnti, MmWaveVehicularBeamSweep::Result &result) const
+{
+  NS_LOG_FUNCTION (this << rnti);
+  NS_ASSERT_MSG (m_beamSweep, "The beam sweep module has not been set");
+
+  auto it = m_deviceMap.find (rnti);
+  NS_ASSERT_MSG (it != m_deviceMap.end (), "Device not found");
+
+  Time symbolPeriod = NanoSeconds (m_phyMacConfig->GetSymbolPeriod () * 1e3);
+  return m_beamSweep->Sweep (m_sidelinkSpectrumPhy->GetDevice (), it->second,
+                             m_sidelinkSpectrumPhy->GetRxSpectrumModel (), symbolPeriod, result);
+}
+
 } // namespace millicar
 } // namespace ns3
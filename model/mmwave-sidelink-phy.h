@@ -23,6 +23,8 @@
 
 #include "mmwave-sidelink-spectrum-phy.h"
 #include "mmwave-sidelink-sap.h"
+#include "mmwave-vehicular-beam-sweep.h"
+#include "mmwave-sidelink-slot-clock.h"
 
 namespace ns3 {
 
@@ -89,6 +91,19 @@ public:
    */
   Ptr<mmwave::MmWavePhyMacCommon> GetConfigurationParameters (void) const;
 
+  /**
+   * Set the configuration and the spectrum model used to create the noise and
+   * the tx PSDs. The chunks of the configuration may span a group of resource
+   * blocks, in which case the transmission masks and the SINR have one entry
+   * per group. The model must have one band per chunk, and the same model
+   * must be used by all the PHYs attached to a channel. By default, the
+   * configuration parameters and the model of MmWaveSpectrumValueHelper are
+   * used.
+   * \param config the configuration of the spectrum
+   * \param model the spectrum model
+   */
+  void SetSpectrumConfiguration (Ptr<mmwave::MmWavePhyMacCommon> config, Ptr<SpectrumModel> model);
+
   /**
    * Returns the SpectrumPhy instance associated with this phy
    * \return the SpectrumPhy instance
@@ -131,6 +146,12 @@ public:
    */
   void DoPrepareForReceptionFrom (uint16_t rnti);
 
+  /**
+   * Notify that the upper layers have new work to do. If the idle slots
+   * are skipped, the slot processing is resumed from the next slot.
+   */
+  void DoNotifyActivity ();
+
   /**
   * Receive the packet from SpectrumPhy and forward it up to the MAC
   * \param p received packet
@@ -150,6 +171,32 @@ public:
   */
   void GenerateSinrReport (const SpectrumValue& sinr, uint16_t rnti, uint8_t numSym, uint32_t tbSize, uint8_t mcs);
 
+  /**
+   * Set the module used to perform the beam training
+   * \param beamSweep the beam sweep module
+   */
+  void SetBeamSweep (Ptr<MmWaveVehicularBeamSweep> beamSweep);
+
+  /**
+   * Perform an exhaustive beam training towards another device, using the
+   * channel realization of the link cached by the propagation loss model.
+   * The training latency is the time needed to measure all the beam pairs
+   * with the numerology of this device.
+   * \param rnti the RNTI of the other device
+   * \param result filled with the best beam pair, its gain and the training
+   *        latency
+   * \return false if the link has not been used yet, i.e., its channel is
+   *         not available
+   */
+  bool PerformBeamSweep (uint16_t rnti, MmWaveVehicularBeamSweep::Result &result) const;
+
+  /**
+   * Use a slot clock shared with other devices instead of scheduling an
+   * event for each slot. The timing of the slots is given by the clock.
+   * \param clock the slot clock
+   */
+  void SetSlotClock (Ptr<MmWaveSidelinkSlotClock> clock);
+
 private:
 
   /**
@@ -158,20 +205,28 @@ private:
    */
   void StartSlot (mmwave::SfnSf timingInfo);
 
+  /**
+   * Called by the shared slot clock at the start of each slot
+   * \param timingInfo the structure containing the timing information
+   */
+  void SlotTick (mmwave::SfnSf timingInfo);
+
   /**
    * Transmit a transport block
    * \param pb the packet burst containing the packets to be sent
    * \param info the mmwave::SlotAllocInfo instance containg the transmission information
    * \return the number of symbols used to send this TB
    */
-  uint8_t SlData (Ptr<PacketBurst> pb, mmwave::SlotAllocInfo info);
+  uint8_t SlData (Ptr<PacketBurst> pb, const mmwave::SlotAllocInfo &info);
 
   /**
-   * Set the transmission mask and creates the power spectral density for the
-   * transmission
-   * \return mask indicating the suchannels used for the transmission
+   * Set the transmission mask and the power spectral density for the
+   * transmission. The PSD is created only when the tx power or the mask
+   * change, otherwise the cached one is used.
+   * \return mask indicating the suchannels used for the transmission, shared
+   *         by all the transmissions until it changes
    */
-  std::vector<int> SetSubChannelsForTransmission ();
+  Ptr<const MmWaveSidelinkRbBitmap> SetSubChannelsForTransmission ();
 
   /**
    * Send the packet burts
@@ -181,7 +236,7 @@ private:
    * \param rbBitmap the mask indicating the suchannels to be used for the
             transmission
    */
-  void SendDataChannels (Ptr<PacketBurst> pb, Time duration, mmwave::SlotAllocInfo info, std::vector<int> rbBitmap);
+  void SendDataChannels (Ptr<PacketBurst> pb, Time duration, const mmwave::SlotAllocInfo &info, Ptr<const MmWaveSidelinkRbBitmap> rbBitmap);
 
   /**
    * TODO: this can be done by overloading the operator ++ of the mmwave::SfnSf struct
@@ -195,15 +250,44 @@ private:
    */
   mmwave::SfnSf UpdateTimingInfo (mmwave::SfnSf info) const;
 
+  /**
+   * Update the mmwave::SfnSf structure to point to a following slot
+   * \param info the mmwave::SfnSf structure containg frame, subframe and slot indeces
+   * \param numSlots the number of slots to advance
+   * \return the updated SnfSn structure
+   */
+  mmwave::SfnSf AdvanceTimingInfo (mmwave::SfnSf info, uint64_t numSlots) const;
+
+  /**
+   * Returns the duration of a slot
+   * \return the slot period
+   */
+  Time GetSlotPeriod () const;
+
   MmWaveSidelinkPhySapUser* m_phySapUser; //!< Sidelink PHY SAP user
   MmWaveSidelinkPhySapProvider* m_phySapProvider; //!< Sidelink PHY SAP provider
   double m_txPower; //!< the transmission power in dBm
   double m_noiseFigure; //!< the noise figure in dB
   Ptr<MmWaveSidelinkSpectrumPhy> m_sidelinkSpectrumPhy; //!< the SpectrumPhy instance associated with this PHY
   Ptr<mmwave::MmWavePhyMacCommon> m_phyMacConfig; //!< the configuration parameters
+  Ptr<mmwave::MmWavePhyMacCommon> m_spectrumConfig; //!< the configuration used to create the PSDs
+  Ptr<SpectrumModel> m_spectrumModel; //!< the spectrum model of the PSDs, with one band per chunk of m_spectrumConfig
   typedef std::pair<Ptr<PacketBurst>, mmwave::SlotAllocInfo> PhyBufferEntry; //!< type of the phy buffer entries
   std::list<PhyBufferEntry> m_phyBuffer; //!< buffer of transport blocks to send in the current slot
   std::map<uint64_t, Ptr<NetDevice>> m_deviceMap; //!< map containing the <rnti, device> pairs of the nodes we want to communicate with
+  Ptr<MmWaveVehicularBeamSweep> m_beamSweep; //!< the beam training module
+  bool m_skipIdleSlots; //!< if true, the slots in which the device has nothing to do are not processed
+  EventId m_slotEvent; //!< the event which starts the next processed slot
+  bool m_inSlot; //!< true while a slot is being processed
+  mmwave::SfnSf m_lastSlot; //!< timing information of the last processed slot
+  Time m_lastSlotStart; //!< start time of the last processed slot
+  Ptr<MmWaveSidelinkSlotClock> m_slotClock; //!< the shared slot clock, if any
+  uint32_t m_slotClockId; //!< the subscription id to the slot clock, 0 if not subscribed
+  uint32_t m_idleSlots; //!< number of ticks of the slot clock to skip
+  Ptr<const MmWaveSidelinkRbBitmap> m_subChannelsForTx; //!< the mask used for the transmissions
+  Ptr<SpectrumValue> m_txPsd; //!< the tx PSD for m_txPsdPower and m_txPsdSubChannels, shared with the SpectrumPhy and never modified
+  double m_txPsdPower; //!< the tx power used to create m_txPsd
+  Ptr<const MmWaveSidelinkRbBitmap> m_txPsdSubChannels; //!< the mask used to create m_txPsd
 };
 
 class MacSidelinkMemberPhySapProvider : public MmWaveSidelinkPhySapProvider
@@ -216,6 +300,8 @@ public:
 
   void PrepareForReception (uint16_t rnti) override;
 
+  void NotifyActivity () override;
+
 private:
   Ptr<MmWaveSidelinkPhy> m_phy;
 
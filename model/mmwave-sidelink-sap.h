@@ -51,6 +51,13 @@ public:
    */
   virtual void PrepareForReception (uint16_t rnti) = 0;
 
+  /**
+   * \brief Called by the upper layers to notify that there is new work to
+   *        do, e.g., after a buffer status report. If the PHY is skipping
+   *        the idle slots, it resumes the slot processing from the next slot.
+   */
+  virtual void NotifyActivity () = 0;
+
 };
 
 class MmWaveSidelinkPhySapUser
@@ -72,6 +79,17 @@ public:
    */
   virtual void SlotIndication (mmwave::SfnSf timingInfo) = 0;
 
+  /**
+   * \brief Returns the number of slots, starting from a given one, in which
+   *        the upper layers have nothing to do
+   * \param timingInfo the structure containing the timing information of the
+   *        first slot to check
+   * \return the number of idle slots before the next active one, i.e., 0 if
+   *         the given slot is active, or UINT32_MAX if there is no activity
+   *         until the next call to NotifyActivity
+   */
+  virtual uint32_t GetSlotsUntilNextActivity (mmwave::SfnSf timingInfo) const = 0;
+
   /**
    * \brief Reports the SINR meausured with a certain device
    * \param sinr the SINR
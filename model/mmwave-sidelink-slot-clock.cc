@@ -0,0 +1,188 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "mmwave-sidelink-slot-clock.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveSidelinkSlotClock");
+
+NS_OBJECT_ENSURE_REGISTERED (MmWaveSidelinkSlotClock);
+
+MmWaveSidelinkSlotClock::MmWaveSidelinkSlotClock ()
+{
+  NS_LOG_FUNCTION (this);
+  NS_FATAL_ERROR ("This constructor should not be called");
+}
+
+MmWaveSidelinkSlotClock::MmWaveSidelinkSlotClock (Ptr<mmwave::MmWavePhyMacCommon> confParams)
+  : m_phyMacConfig (confParams),
+    m_origin (Simulator::Now ()),
+    m_slot (0),
+    m_numSubscribers (0),
+    m_lastId (0),
+    m_removed (false)
+{
+  NS_LOG_FUNCTION (this);
+
+  // convert the slot period from seconds to nanoseconds, as done by the PHY
+  double slotPeriod = m_phyMacConfig->GetSymbolPeriod () * 1e3 * m_phyMacConfig->GetSymbPerSlot ();
+  m_slotPeriod = NanoSeconds (slotPeriod);
+}
+
+MmWaveSidelinkSlotClock::~MmWaveSidelinkSlotClock ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+MmWaveSidelinkSlotClock::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MmWaveSidelinkSlotClock")
+    .SetParent<Object> ()
+    .AddConstructor<MmWaveSidelinkSlotClock> ()
+  ;
+  return tid;
+}
+
+void
+MmWaveSidelinkSlotClock::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  m_tickEvent.Cancel ();
+  m_subscribers.clear ();
+  m_phyMacConfig = 0;
+  Object::DoDispose ();
+}
+
+uint32_t
+MmWaveSidelinkSlotClock::Subscribe (SlotCallback cb)
+{
+  NS_LOG_FUNCTION (this);
+
+  Subscriber s;
+  s.m_id = ++m_lastId;
+  s.m_callback = cb;
+  m_subscribers.push_back (s);
+  m_numSubscribers++;
+
+  if (!m_tickEvent.IsRunning ())
+  {
+    Start ();
+  }
+  return s.m_id;
+}
+
+void
+MmWaveSidelinkSlotClock::Unsubscribe (uint32_t id)
+{
+  NS_LOG_FUNCTION (this << id);
+
+  // the entry is removed at the end of the current tick, since the
+  // subscribers may be iterated
+  for (Subscriber &s : m_subscribers)
+  {
+    if (s.m_id == id)
+    {
+      s.m_id = 0;
+      s.m_callback = MakeNullCallback<void, mmwave::SfnSf> ();
+      m_removed = true;
+      m_numSubscribers--;
+      break;
+    }
+  }
+
+  if (m_numSubscribers == 0)
+  {
+    NS_LOG_LOGIC ("No subscribers, stop the clock");
+    m_tickEvent.Cancel ();
+  }
+}
+
+Time
+MmWaveSidelinkSlotClock::GetSlotPeriod () const
+{
+  return m_slotPeriod;
+}
+
+void
+MmWaveSidelinkSlotClock::Start ()
+{
+  NS_LOG_FUNCTION (this);
+
+  // first slot boundary at or after now
+  int64_t elapsed = (Simulator::Now () - m_origin).GetTimeStep ();
+  int64_t period = m_slotPeriod.GetTimeStep ();
+  // the slots already triggered are not repeated
+  m_slot = std::max<uint64_t> (m_slot, (elapsed + period - 1) / period);
+
+  Time delay = m_origin + m_slotPeriod * int64_t (m_slot) - Simulator::Now ();
+  m_tickEvent = Simulator::Schedule (delay, &MmWaveSidelinkSlotClock::Tick, this);
+}
+
+void
+MmWaveSidelinkSlotClock::Tick ()
+{
+  NS_LOG_FUNCTION (this << m_slot);
+
+  // schedule the next slot first, the subscribers may stop the clock
+  mmwave::SfnSf timingInfo = GetTimingInfo (m_slot++);
+  m_tickEvent = Simulator::Schedule (m_slotPeriod, &MmWaveSidelinkSlotClock::Tick, this);
+
+  // the subscriptions made during the iteration start from the next slot
+  size_t numEntries = m_subscribers.size ();
+  for (size_t i = 0; i < numEntries; i++)
+  {
+    if (m_subscribers[i].m_id != 0)
+    {
+      // copy the callback, the vector may be reallocated by a subscription
+      SlotCallback cb = m_subscribers[i].m_callback;
+      cb (timingInfo);
+    }
+  }
+
+  if (m_removed)
+  {
+    m_subscribers.erase (std::remove_if (m_subscribers.begin (), m_subscribers.end (),
+                                         [] (const Subscriber &s) { return s.m_id == 0; }),
+                         m_subscribers.end ());
+    m_removed = false;
+  }
+}
+
+mmwave::SfnSf
+MmWaveSidelinkSlotClock::GetTimingInfo (uint64_t slot) const
+{
+  uint64_t slotsPerSf = m_phyMacConfig->GetSlotsPerSubframe ();
+  uint64_t sfPerFrame = m_phyMacConfig->GetSubframesPerFrame ();
+
+  mmwave::SfnSf info;
+  info.m_slotNum = slot % slotsPerSf;
+  info.m_sfNum = (slot / slotsPerSf) % sfPerFrame;
+  info.m_frameNum = slot / slotsPerSf / sfPerFrame;
+  return info;
+}
+
+} // namespace millicar
+} // namespace ns3
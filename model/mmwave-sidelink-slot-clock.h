@@ -0,0 +1,134 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MMWAVE_SIDELINK_SLOT_CLOCK_H
+#define MMWAVE_SIDELINK_SLOT_CLOCK_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include "ns3/mmwave-phy-mac-common.h"
+#include <vector>
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * \ingroup millicar
+ * Slot clock shared by the sidelink devices which use the same channel and
+ * the same frame structure. A single event is scheduled for each slot
+ * boundary, and the subscribed devices are triggered one after the other,
+ * in the order of subscription. The clock runs only if there is at least
+ * one subscriber, and it is aligned with the time at which it was created.
+ */
+class MmWaveSidelinkSlotClock : public Object
+{
+public:
+  /**
+   * Callback invoked at the start of each slot, with the timing information
+   * of the slot
+   */
+  typedef Callback<void, mmwave::SfnSf> SlotCallback;
+
+  /**
+   * Dummy constructor, it is not used
+   */
+  MmWaveSidelinkSlotClock ();
+
+  /**
+   * Constructor
+   * \param confParams instance of mmwave::MmWavePhyMacCommon containing the
+   *        configuration parameters
+   */
+  MmWaveSidelinkSlotClock (Ptr<mmwave::MmWavePhyMacCommon> confParams);
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveSidelinkSlotClock ();
+
+  // inherited from Object
+  static TypeId GetTypeId (void);
+  void DoDispose ();
+
+  /**
+   * Subscribe to the clock. The callback is triggered starting from the
+   * next slot boundary, or from the current one if the clock is idle and
+   * the current time is a slot boundary.
+   * \param cb the callback
+   * \return the subscription id, to be used to unsubscribe
+   */
+  uint32_t Subscribe (SlotCallback cb);
+
+  /**
+   * Unsubscribe from the clock. It can be called by the callbacks as well.
+   * \param id the subscription id
+   */
+  void Unsubscribe (uint32_t id);
+
+  /**
+   * Returns the duration of a slot
+   * \return the slot period
+   */
+  Time GetSlotPeriod () const;
+
+private:
+  /**
+   * Subscription to the clock
+   */
+  struct Subscriber
+  {
+    uint32_t m_id; //!< the subscription id, 0 if the entry has been removed
+    SlotCallback m_callback; //!< the callback
+  };
+
+  /**
+   * Trigger the subscribers at the start of a slot and schedule the next one
+   */
+  void Tick ();
+
+  /**
+   * Schedule the next tick at the slot boundary at or after the current time
+   */
+  void Start ();
+
+  /**
+   * Returns the timing information of a slot
+   * \param slot the absolute index of the slot
+   * \return the mmwave::SfnSf structure containg frame, subframe and slot indeces
+   */
+  mmwave::SfnSf GetTimingInfo (uint64_t slot) const;
+
+  Ptr<mmwave::MmWavePhyMacCommon> m_phyMacConfig; //!< the configuration parameters
+  Time m_slotPeriod; //!< the duration of a slot
+  Time m_origin; //!< start time of the slot with index 0
+  uint64_t m_slot; //!< absolute index of the next slot
+  EventId m_tickEvent; //!< the event of the next slot boundary
+  std::vector<Subscriber> m_subscribers; //!< the subscribers, in order of subscription
+  uint32_t m_numSubscribers; //!< number of active subscriptions
+  uint32_t m_lastId; //!< last subscription id
+  bool m_removed; //!< true if some entries of m_subscribers have to be removed
+};
+
+} // namespace millicar
+} // namespace ns3
+
+#endif /* MMWAVE_SIDELINK_SLOT_CLOCK_H */
@@ -25,13 +25,15 @@
 #include <ns3/ptr.h>
 #include <ns3/boolean.h>
 #include <cmath>
+#include <algorithm>
 #include <ns3/simulator.h>
 #include <ns3/antenna-model.h>
 #include "mmwave-sidelink-spectrum-phy.h"
 #include "mmwave-sidelink-spectrum-signal-parameters.h"
 #include <stdio.h>
 #include <ns3/double.h>
-#include <ns3/mmwave-mi-error-model.h>
+#include <ns3/enum.h>
+#include <ns3/string.h>
 #include <ns3/mmwave-vehicular-net-device.h>
 #include <ns3/mmwave-vehicular-antenna-array-model.h>
 
@@ -77,7 +79,18 @@ static const double EffectiveCodingRate[29] = {
 
 MmWaveSidelinkSpectrumPhy::MmWaveSidelinkSpectrumPhy ()
   : m_state (IDLE),
-    m_componentCarrierId (0)
+    m_componentCarrierId (0),
+    m_interferencePruning (PRUNING_DISABLED),
+    m_interferenceFloor (-20),
+    m_numInterferenceSignals (0),
+    m_numPrunedSignals (0),
+    m_scalarAbstraction (false),
+    m_noiseMean (0),
+    m_interferencePower (0),
+    m_numInterferers (0),
+    m_interferenceEnergy (0),
+    m_filterUnexpectedSignals (false),
+    m_numFilteredSignals (0)
 {
   m_interferenceData = CreateObject<mmwave::mmWaveInterference> ();
   m_random = CreateObject<UniformRandomVariable> ();
@@ -102,6 +115,46 @@ MmWaveSidelinkSpectrumPhy::GetTypeId (void)
                    BooleanValue (true),
                    MakeBooleanAccessor (&MmWaveSidelinkSpectrumPhy::m_dataErrorModelEnabled),
                    MakeBooleanChecker ())
+    .AddAttribute ("ErrorModelType",
+                   "Type of the error model of data, e.g., ns3::MmWaveVehicularMiErrorModel for the "
+                   "MIESM model of the mmwave module or ns3::MmWaveVehicularLutErrorModel for its "
+                   "approximation based on lookup tables",
+                   StringValue ("ns3::MmWaveVehicularMiErrorModel"),
+                   MakeStringAccessor (&MmWaveSidelinkSpectrumPhy::m_errorModelType),
+                   MakeStringChecker ())
+    .AddAttribute ("InterferencePruning",
+                   "Treatment of the interfering signals which are below the interference floor in all the bands. "
+                   "Disabled: all the signals are added to the interference; "
+                   "Ignore: the weak signals are discarded; "
+                   "Aggregate: the weak signals with the same start time and duration are added as a single signal",
+                   EnumValue (PRUNING_DISABLED),
+                   MakeEnumAccessor (&MmWaveSidelinkSpectrumPhy::m_interferencePruning),
+                   MakeEnumChecker (PRUNING_DISABLED, "Disabled",
+                                    PRUNING_IGNORE, "Ignore",
+                                    PRUNING_AGGREGATE, "Aggregate"))
+    .AddAttribute ("InterferenceFloor",
+                   "Power of an interfering signal, in dB relative to the noise, below which "
+                   "the signal is pruned",
+                   DoubleValue (-20),
+                   MakeDoubleAccessor (&MmWaveSidelinkSpectrumPhy::m_interferenceFloor),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("ScalarAbstraction",
+                   "If true, each signal is reduced to its mean PSD, the interference is summed as a scalar "
+                   "and the transport blocks are decoded with the AWGN error rate at the wideband SINR. "
+                   "The interference pruning is not applied. Meant to be used with the WidebandGain of "
+                   "the MmWaveVehicularSpectrumPropagationLossModel",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MmWaveSidelinkSpectrumPhy::m_scalarAbstraction),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FilterUnexpectedSignals",
+                   "If true, the interfering signals received while the device is idle are discarded, "
+                   "unless a reception has been announced with ExpectReception, i.e., when the MAC "
+                   "prepares for the reception in the current slot. The discarded signals which are "
+                   "still on air when a reception is announced or starts are then added to the "
+                   "interference, hence the SINR does not change",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MmWaveSidelinkSpectrumPhy::m_filterUnexpectedSignals),
+                   MakeBooleanChecker ())
   ;
 
   return tid;
@@ -109,7 +162,10 @@ MmWaveSidelinkSpectrumPhy::GetTypeId (void)
 void
 MmWaveSidelinkSpectrumPhy::DoDispose ()
 {
-
+  m_background.clear ();
+  m_errorModel = 0;
+  m_deviceContext = 0;
+  m_filteredSignals.clear ();
 }
 
 void
@@ -144,6 +200,19 @@ MmWaveSidelinkSpectrumPhy::GetDevice () const
   return m_device;
 }
 
+void
+MmWaveSidelinkSpectrumPhy::SetDeviceContext (Ptr<const MmWaveVehicularDeviceContext> context)
+{
+  NS_ASSERT_MSG (context->m_device == m_device, "The context belongs to another device");
+  m_deviceContext = context;
+}
+
+Ptr<const MmWaveVehicularDeviceContext>
+MmWaveSidelinkSpectrumPhy::GetDeviceContext () const
+{
+  return m_deviceContext;
+}
+
 void
 MmWaveSidelinkSpectrumPhy::SetMobility (Ptr<MobilityModel> m)
 {
@@ -193,6 +262,8 @@ MmWaveSidelinkSpectrumPhy::SetNoisePowerSpectralDensity (Ptr<const SpectrumValue
   NS_LOG_FUNCTION (this << noisePsd);
   NS_ASSERT (noisePsd);
   m_rxSpectrumModel = noisePsd->GetSpectrumModel ();
+  m_noisePsd = noisePsd;
+  m_noiseMean = Sum (*noisePsd) / m_rxSpectrumModel->GetNumBands ();
   m_interferenceData->SetNoisePowerSpectralDensity (noisePsd);
 }
 
@@ -251,7 +322,161 @@ MmWaveSidelinkSpectrumPhy::StartRx (Ptr<SpectrumSignalParameters> params)
     else
     {
       // other type of signal that needs to be counted as interference
-      m_interferenceData->AddSignal (params->psd, params->duration);
+      AddInterferenceSignal (params->psd, params->duration);
+    }
+}
+
+void
+MmWaveSidelinkSpectrumPhy::AddInterferenceSignal (Ptr<const SpectrumValue> psd, Time duration)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_filterUnexpectedSignals && m_state == IDLE && Simulator::Now () >= m_expectedRxEnd)
+    {
+      // the signal is kept until it ends, since a reception may be announced
+      // while it is still on air
+      NS_LOG_LOGIC (this << " no reception pending or expected, discard the signal");
+      Time now = Simulator::Now ();
+      while (!m_filteredSignals.empty () && m_filteredSignals.front ().first <= now)
+        {
+          m_filteredSignals.pop_front ();
+        }
+      m_filteredSignals.push_back (std::make_pair (now + duration, psd));
+      m_numFilteredSignals++;
+      return;
+    }
+
+  m_numInterferenceSignals++;
+
+  if (m_scalarAbstraction)
+    {
+      AddScalarInterference (Sum (*psd) / psd->GetSpectrumModel ()->GetNumBands (), duration);
+      return;
+    }
+
+  if (m_interferencePruning == PRUNING_DISABLED || !IsBelowInterferenceFloor (*psd))
+    {
+      m_interferenceData->AddSignal (psd, duration);
+      return;
+    }
+
+  m_numPrunedSignals++;
+  if (m_interferencePruning == PRUNING_IGNORE)
+    {
+      NS_LOG_LOGIC (this << " ignore a signal below the interference floor");
+      return;
+    }
+
+  // the signals with the same start time and duration are interchangeable
+  // in the interference computation, hence they are summed and added once
+  if (m_background.empty ())
+    {
+      Simulator::ScheduleNow (&MmWaveSidelinkSpectrumPhy::AddBackgroundSignals, this);
+    }
+  auto it = m_background.find (duration);
+  if (it == m_background.end ())
+    {
+      m_background.insert (std::make_pair (duration, Copy (psd)));
+    }
+  else
+    {
+      *(it->second) += *psd;
+    }
+}
+
+void
+MmWaveSidelinkSpectrumPhy::AddBackgroundSignals ()
+{
+  NS_LOG_FUNCTION (this << m_background.size ());
+  for (auto &entry : m_background)
+    {
+      m_interferenceData->AddSignal (entry.second, entry.first);
+    }
+  m_background.clear ();
+}
+
+bool
+MmWaveSidelinkSpectrumPhy::IsBelowInterferenceFloor (const SpectrumValue &psd) const
+{
+  NS_ASSERT_MSG (m_noisePsd, "First set the noise PSD");
+  double floor = std::pow (10.0, m_interferenceFloor / 10.0);
+  Values::const_iterator nit = m_noisePsd->ConstValuesBegin ();
+  for (Values::const_iterator vit = psd.ConstValuesBegin (); vit != psd.ConstValuesEnd (); ++vit, ++nit)
+    {
+      if (*vit >= floor * (*nit))
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+void
+MmWaveSidelinkSpectrumPhy::AddScalarInterference (double power, Time duration)
+{
+  NS_LOG_FUNCTION (this << power << duration);
+  UpdateInterferenceEnergy ();
+  m_interferencePower += power;
+  m_numInterferers++;
+  Simulator::Schedule (duration, &MmWaveSidelinkSpectrumPhy::RemoveScalarInterference, this, power);
+}
+
+void
+MmWaveSidelinkSpectrumPhy::RemoveScalarInterference (double power)
+{
+  NS_LOG_FUNCTION (this << power);
+  UpdateInterferenceEnergy ();
+  NS_ASSERT (m_numInterferers > 0);
+  m_numInterferers--;
+  // reset the sum when no signal is on air, so that the rounding errors
+  // do not accumulate
+  m_interferencePower = (m_numInterferers > 0) ? std::max (m_interferencePower - power, 0.0) : 0.0;
+}
+
+void
+MmWaveSidelinkSpectrumPhy::UpdateInterferenceEnergy ()
+{
+  Time now = Simulator::Now ();
+  m_interferenceEnergy += m_interferencePower * (now - m_lastInterferenceUpdate).GetSeconds ();
+  m_lastInterferenceUpdate = now;
+}
+
+uint64_t
+MmWaveSidelinkSpectrumPhy::GetNumInterferenceSignals () const
+{
+  return m_numInterferenceSignals;
+}
+
+uint64_t
+MmWaveSidelinkSpectrumPhy::GetNumPrunedSignals () const
+{
+  return m_numPrunedSignals;
+}
+
+uint64_t
+MmWaveSidelinkSpectrumPhy::GetNumFilteredSignals () const
+{
+  return m_numFilteredSignals;
+}
+
+void
+MmWaveSidelinkSpectrumPhy::ExpectReception (Time duration)
+{
+  NS_LOG_FUNCTION (this << duration);
+  Time now = Simulator::Now ();
+  m_expectedRxEnd = std::max (m_expectedRxEnd, now + duration);
+
+  // the discarded signals which are still on air interfere with the
+  // reception, for the rest of their duration
+  std::list<std::pair<Time, Ptr<const SpectrumValue> > > filteredSignals;
+  filteredSignals.swap (m_filteredSignals);
+  for (auto &signal : filteredSignals)
+    {
+      if (signal.first > now)
+        {
+          m_numFilteredSignals--;
+          AddInterferenceSignal (signal.second, signal.first - now);
+        }
     }
 }
 
@@ -275,19 +500,28 @@ MmWaveSidelinkSpectrumPhy::StartRxData (Ptr<MmWaveSidelinkSpectrumSignalParamete
       // triggered, it means that multiple concurrent signals are being received.
       // In this case, we assume that the device will synchronize with the first
       // received signal, while the other will act as interferers
-      m_interferenceData->AddSignal (params->psd, params->duration);
+      AddInterferenceSignal (params->psd, params->duration);
       break;
     case IDLE:
       {
         // check if the packet is for this device, otherwise
         // consider it only for the interference
-        m_interferenceData->AddSignal (params->psd, params->duration);
-        uint16_t thisDeviceRnti =
+        uint16_t thisDeviceRnti = m_deviceContext ? m_deviceContext->m_rnti :
           DynamicCast<MmWaveVehicularNetDevice>(m_device)->GetMac()->GetRnti();
         if(thisDeviceRnti == params->destinationRnti)
         {
-          // this is a useful signal
-          m_interferenceData->StartRx (params->psd);
+          // this is a useful signal. If the reception was not announced, the
+          // discarded signals still on air are added to the interference
+          if (m_filterUnexpectedSignals && Simulator::Now () >= m_expectedRxEnd)
+            {
+              ExpectReception (params->duration);
+            }
+
+          if (!m_scalarAbstraction)
+            {
+              m_interferenceData->AddSignal (params->psd, params->duration);
+              m_interferenceData->StartRx (params->psd);
+            }
 
           if (m_rxTransportBlock.empty ())
             {
@@ -297,6 +531,13 @@ MmWaveSidelinkSpectrumPhy::StartRxData (Ptr<MmWaveSidelinkSpectrumSignalParamete
               m_firstRxDuration = params->duration;
               NS_LOG_LOGIC (this << " scheduling EndRx with delay " << params->duration.GetSeconds () << "s");
 
+              if (m_scalarAbstraction)
+                {
+                  // average the interference from the start of the reception
+                  UpdateInterferenceEnergy ();
+                  m_interferenceEnergy = 0;
+                }
+
               m_endRxDataEvent = Simulator::Schedule (params->duration, &MmWaveSidelinkSpectrumPhy::EndRxData, this);
             }
           else
@@ -310,9 +551,20 @@ MmWaveSidelinkSpectrumPhy::StartRxData (Ptr<MmWaveSidelinkSpectrumSignalParamete
             }
 
           ChangeState (RX_DATA);
-          if (params->packetBurst && !params->packetBurst->GetPackets ().empty ())
+          if (params->packetBurst && params->packetBurst->GetNPackets () > 0)
             {
-              TbInfo_t tbInfo = {params->packetBurst, params->size, params->mcs, params->numSym, params->senderRnti, params->rbBitmap};
+              // the burst is shared by all the receivers of the signal, hence
+              // the destination gets its own copy of the packets
+              TbInfo_t tbInfo = {params->packetBurst->Copy (), params->size, params->mcs, params->numSym, params->senderRnti, params->rbBitmap, 0.0};
+              const std::vector<int> &rbBitmap = params->rbBitmap->Get ();
+              if (m_scalarAbstraction && !rbBitmap.empty ())
+                {
+                  for (int rb : rbBitmap)
+                    {
+                      tbInfo.signal += (*params->psd)[rb];
+                    }
+                  tbInfo.signal /= rbBitmap.size ();
+                }
               m_rxTransportBlock.push_back (tbInfo);
             }
         }
@@ -321,6 +573,7 @@ MmWaveSidelinkSpectrumPhy::StartRxData (Ptr<MmWaveSidelinkSpectrumSignalParamete
           NS_LOG_LOGIC (this << " not in sync with this signal (rnti="
               << params->destinationRnti  << ", rnti of the device="
               << thisDeviceRnti << ")");
+          AddInterferenceSignal (params->psd, params->duration);
         }
         //m_rxControlMessageList.insert (m_rxControlMessageList.end (), params->ctrlMsgList.begin (), params->ctrlMsgList.end ());
       }
@@ -371,23 +624,55 @@ void
 MmWaveSidelinkSpectrumPhy::EndRxData ()
 {
   NS_LOG_FUNCTION (this);
-  m_interferenceData->EndRx ();
 
-  double sinrAvg = Sum (m_sinrPerceived) / (m_sinrPerceived.GetSpectrumModel ()->GetNumBands ());
+  double interference = 0;
+  if (m_scalarAbstraction)
+  {
+    UpdateInterferenceEnergy ();
+    interference = m_interferenceEnergy / m_firstRxDuration.GetSeconds ();
+  }
+  else
+  {
+    m_interferenceData->EndRx ();
+  }
 
   NS_ASSERT (m_state = RX_DATA);
 
   if ((m_dataErrorModelEnabled)&&(m_rxTransportBlock.size () > 0))
   {
+    if (!m_errorModel)
+    {
+      ObjectFactory errorModelFactory;
+      errorModelFactory.SetTypeId (m_errorModelType);
+      m_errorModel = errorModelFactory.Create<MmWaveVehicularErrorModel> ();
+    }
+
     for (std::list<TbInfo_t>::const_iterator i = m_rxTransportBlock.begin ();
          i != m_rxTransportBlock.end (); ++i)
      {
-       // Here we need to initialize an empty harqInfoList since it is mandatory input
-       // for the method. Since the vector is empty, no harq procedures are triggeres (as we want)
-       std::vector <mmwave::MmWaveHarqProcessInfoElement_t> harqInfoList;
+       double tbler;
+       if (m_scalarAbstraction)
+       {
+         double sinr = (*i).signal / (m_noiseMean + interference);
+         tbler = m_errorModel->GetTbler (sinr, (*i).size, (*i).mcs);
 
-       NS_LOG_DEBUG ("average sinr " << 10*log10 (sinrAvg) << " MCS " <<  (uint16_t)(*i).mcs);
-       mmwave::MmWaveTbStats_t tbStats = mmwave::MmWaveMiErrorModel::GetTbDecodificationStats (m_sinrPerceived, (*i).rbBitmap, (*i).size, (*i).mcs, harqInfoList);
+         // the reports carry the wideband SINR in all the bands
+         if (!m_slSinrReportCallback.empty ())
+         {
+           if (m_sinrPerceived.GetSpectrumModel () != m_rxSpectrumModel)
+           {
+             m_sinrPerceived = SpectrumValue (m_rxSpectrumModel);
+           }
+           m_sinrPerceived = sinr;
+         }
+         NS_LOG_DEBUG ("wideband sinr " << 10*log10 (sinr) << " MCS " <<  (uint16_t)(*i).mcs);
+       }
+       else
+       {
+         NS_LOG_DEBUG ("average sinr " << 10*log10 (Sum (m_sinrPerceived) / m_sinrPerceived.GetSpectrumModel ()->GetNumBands ())
+                                       << " MCS " <<  (uint16_t)(*i).mcs);
+         tbler = m_errorModel->GetTbler (m_sinrPerceived, (*i).rbBitmap->Get (), (*i).size, (*i).mcs);
+       }
 
        // trigger callbacks
        for (auto& it : m_slSinrReportCallback)
@@ -395,7 +680,7 @@ MmWaveSidelinkSpectrumPhy::EndRxData ()
           it(m_sinrPerceived, (*i).rnti, (*i).numSym, (*i).size, (*i).mcs); // TODO also export corrupt and tbler)
         }
 
-       bool corrupt = m_random->GetValue () > tbStats.tbler ? false : true;
+       bool corrupt = m_random->GetValue () > tbler ? false : true;
        if(!corrupt)
        {
          Ptr<PacketBurst> burst = (*i).packetBurst;
@@ -458,7 +743,7 @@ MmWaveSidelinkSpectrumPhy::StartTxDataFrames (Ptr<PacketBurst> pb,
   uint8_t numSym,
   uint16_t senderRnti,
   uint16_t destinationRnti,
-  std::vector<int> rbBitmap)
+  Ptr<const MmWaveSidelinkRbBitmap> rbBitmap)
 {
   NS_LOG_FUNCTION (this);
 
@@ -505,6 +790,21 @@ MmWaveSidelinkSpectrumPhy::StartTxDataFrames (Ptr<PacketBurst> pb,
   return true;
 }
 
+bool
+MmWaveSidelinkSpectrumPhy::StartTxDataFrames (Ptr<PacketBurst> pb,
+  Time duration,
+  uint8_t slotInd,
+  uint8_t mcs,
+  uint32_t size,
+  uint8_t numSym,
+  uint16_t senderRnti,
+  uint16_t destinationRnti,
+  const std::vector<int> &rbBitmap)
+{
+  return StartTxDataFrames (pb, duration, slotInd, mcs, size, numSym, senderRnti, destinationRnti,
+                            Create<MmWaveSidelinkRbBitmap> (rbBitmap));
+}
+
 // bool
 // MmWaveSidelinkSpectrumPhy::StartTxControlFrames (std::list<Ptr<MmWaveControlMessage> > ctrlMsgList, Time duration)
 // {
@@ -592,8 +892,8 @@ MmWaveSidelinkSpectrumPhy::ConfigureBeamforming (Ptr<NetDevice> dev)
   Ptr<MmWaveVehicularAntennaArrayModel> antennaArray = DynamicCast<MmWaveVehicularAntennaArrayModel> (m_antenna);
   if (antennaArray)
   {
-    //TODO consider to update this in order to not recompute the beamforming
-    // vectors each time
+    // the antenna keeps the previous beamforming vector if the geometry
+    // barely changed, see the attribute BeamUpdateThreshold
     antennaArray->SetBeamformingVectorPanelDevices (m_device, dev);
   }
 }
@@ -36,7 +36,11 @@
 #include <ns3/data-rate.h>
 #include <ns3/generic-phy.h>
 #include <ns3/packet-burst.h>
+#include <map>
+#include <list>
 #include "mmwave-sidelink-spectrum-signal-parameters.h"
+#include "mmwave-vehicular-error-model.h"
+#include "mmwave-vehicular-device-context.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/mmwave-beamforming.h"
 #include "ns3/mmwave-interference.h"
@@ -53,7 +57,8 @@ struct TbInfo_t
   uint8_t mcs; ///< MCS
   uint8_t numSym; ///< number of symbols used to transmit this TB
   uint16_t rnti; ///< RNTI of the device which is sending the packet
-  std::vector<int> rbBitmap; ///< Resource block bitmap
+  Ptr<const MmWaveSidelinkRbBitmap> rbBitmap; ///< Resource block bitmap
+  double signal; ///< mean PSD of the signal over its resource blocks, used with the scalar abstraction
 };
 
 /**
@@ -102,6 +107,16 @@ public:
     RX_CTRL
   };
 
+  /**
+   * Treatment of the interfering signals below the interference floor
+   */
+  enum InterferencePruning
+  {
+    PRUNING_DISABLED = 0, ///< all the signals are added to the interference
+    PRUNING_IGNORE, ///< the weak signals are discarded
+    PRUNING_AGGREGATE ///< the weak signals with the same start time and duration are added as a single signal
+  };
+
   /**
    * \brief Get the type ID.
    * \return the object TypeId
@@ -127,6 +142,21 @@ public:
    */
   Ptr<NetDevice> GetDevice () const;
 
+  /**
+   * Set the context of the associated device. If set, the RNTI of the
+   * device is read from the context instead of from the MAC.
+   *
+   * @param context the device context
+   */
+  void SetDeviceContext (Ptr<const MmWaveVehicularDeviceContext> context);
+
+  /**
+   * Returns the context of the associated device
+   *
+   * @return the device context, or 0 if it has not been set
+   */
+  Ptr<const MmWaveVehicularDeviceContext> GetDeviceContext () const;
+
   /**
    * Set the mobility model associated with this device.
    *
@@ -206,7 +236,18 @@ public:
   * @return true if an error occurred and the transmission was not
   * started, false otherwise.
   */
-  bool StartTxDataFrames (Ptr<PacketBurst> pb, Time duration, uint8_t slotInd, uint8_t mcs, uint32_t size, uint8_t numSym, uint16_t senderRnti, uint16_t destinationRnti, std::vector<int> rbBitmap);
+  bool StartTxDataFrames (Ptr<PacketBurst> pb, Time duration, uint8_t slotInd, uint8_t mcs, uint32_t size, uint8_t numSym, uint16_t senderRnti, uint16_t destinationRnti, Ptr<const MmWaveSidelinkRbBitmap> rbBitmap);
+
+  /**
+  * Start a transmission of data frame in sidelink, with a resource block
+  * bitmap which is not shared yet
+  *
+  * @param rbBitmap resource block bitmap
+  *
+  * @return true if an error occurred and the transmission was not
+  * started, false otherwise.
+  */
+  bool StartTxDataFrames (Ptr<PacketBurst> pb, Time duration, uint8_t slotInd, uint8_t mcs, uint32_t size, uint8_t numSym, uint16_t senderRnti, uint16_t destinationRnti, const std::vector<int> &rbBitmap);
 
   //bool StartTxControlFrames (std::list<Ptr<MmWaveControlMessage> > ctrlMsgList, Time duration);       // control frames from enb to ue
 
@@ -254,6 +295,37 @@ public:
   */
   void ConfigureBeamforming (Ptr<NetDevice> dev);
 
+  /**
+  * Notify that a reception is expected in the following interval, so that
+  * the interfering signals are accounted even if the device is idle. The
+  * discarded signals which are still on air are added to the interference
+  * \param duration the duration of the interval
+  */
+  void ExpectReception (Time duration);
+
+  /**
+  * Get the number of interfering signals received so far
+  *
+  * @return the number of interfering signals
+  */
+  uint64_t GetNumInterferenceSignals () const;
+
+  /**
+  * Get the number of interfering signals below the interference floor,
+  * which have been discarded or aggregated
+  *
+  * @return the number of pruned signals
+  */
+  uint64_t GetNumPrunedSignals () const;
+
+  /**
+  * Get the number of interfering signals discarded because they were
+  * received while no reception was pending or expected
+  *
+  * @return the number of filtered signals
+  */
+  uint64_t GetNumFilteredSignals () const;
+
 private:
   /**
   * \brief Change state function
@@ -265,11 +337,54 @@ private:
   void EndTx ();
   /// End receive data function
   void EndRxData ();
+
+  /**
+  * Add an interfering signal, unless it is below the interference floor
+  *
+  * @param psd the PSD of the signal
+  * @param duration the duration of the signal
+  */
+  void AddInterferenceSignal (Ptr<const SpectrumValue> psd, Time duration);
+
+  /**
+  * Add the aggregated weak signals received at the current time
+  */
+  void AddBackgroundSignals ();
+
+  /**
+  * Check if a signal is below the interference floor in all the bands
+  *
+  * @param psd the PSD of the signal
+  * @return true if the signal is below the interference floor
+  */
+  bool IsBelowInterferenceFloor (const SpectrumValue &psd) const;
+
+  /**
+  * Add an interfering signal to the scalar interference
+  *
+  * @param power the mean PSD of the signal over all the bands
+  * @param duration the duration of the signal
+  */
+  void AddScalarInterference (double power, Time duration);
+
+  /**
+  * Remove an interfering signal from the scalar interference, at its end
+  *
+  * @param power the mean PSD of the signal over all the bands
+  */
+  void RemoveScalarInterference (double power);
+
+  /**
+  * Accumulate the scalar interference since the last update, to compute
+  * its average over the reception
+  */
+  void UpdateInterferenceEnergy ();
   //void EndRxCtrl ();
 
   Ptr<mmwave::mmWaveInterference> m_interferenceData; ///< the data interference
   Ptr<MobilityModel> m_mobility; ///< the modility model
   Ptr<NetDevice> m_device; ///< the device
+  Ptr<const MmWaveVehicularDeviceContext> m_deviceContext; ///< the device context, if any
   Ptr<SpectrumChannel> m_channel; ///< the channel
   Ptr<const SpectrumModel> m_rxSpectrumModel; ///< the spectrum model
   Ptr<SpectrumValue> m_txPsd; ///< the transmit PSD
@@ -302,6 +417,25 @@ private:
 
   EventId m_endTxEvent; ///< end transmit event
   EventId m_endRxDataEvent; ///< end receive data event
+
+  Ptr<const SpectrumValue> m_noisePsd; ///< the noise PSD
+  InterferencePruning m_interferencePruning; ///< treatment of the signals below the interference floor
+  double m_interferenceFloor; ///< the interference floor in dB, relative to the noise
+  std::map<Time, Ptr<SpectrumValue> > m_background; ///< weak signals received at the current time, aggregated by duration
+  uint64_t m_numInterferenceSignals; ///< number of interfering signals
+  uint64_t m_numPrunedSignals; ///< number of interfering signals below the interference floor
+  std::string m_errorModelType; ///< the type of the error model of the data
+  Ptr<MmWaveVehicularErrorModel> m_errorModel; ///< the error model of the data, created at the first reception
+  bool m_scalarAbstraction; ///< if true, the signals are reduced to their mean PSD and the SINR is wideband
+  double m_noiseMean; ///< mean PSD of the noise over all the bands
+  double m_interferencePower; ///< sum of the mean PSDs of the interfering signals on air
+  uint32_t m_numInterferers; ///< number of interfering signals on air, used with the scalar abstraction
+  double m_interferenceEnergy; ///< integral over time of m_interferencePower since the start of the reception
+  Time m_lastInterferenceUpdate; ///< time of the last update of m_interferenceEnergy
+  bool m_filterUnexpectedSignals; ///< if true, the interfering signals are discarded while no reception is pending or expected
+  Time m_expectedRxEnd; ///< end of the interval in which a reception is expected
+  uint64_t m_numFilteredSignals; ///< number of interfering signals discarded because no reception was pending or expected
+  std::list<std::pair<Time, Ptr<const SpectrumValue> > > m_filteredSignals; ///< the discarded signals which may still be on air, with their end time
   //EventId m_endRxCtrlEvent;
 
 };
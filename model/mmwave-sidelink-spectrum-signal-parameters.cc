@@ -31,6 +31,17 @@ NS_LOG_COMPONENT_DEFINE ("MmWaveSidelinkSpectrumSignalParameters");
 
 namespace millicar {
 
+MmWaveSidelinkRbBitmap::MmWaveSidelinkRbBitmap (const std::vector<int> &rbs)
+  : m_rbs (rbs)
+{
+}
+
+const std::vector<int> &
+MmWaveSidelinkRbBitmap::Get () const
+{
+  return m_rbs;
+}
+
 MmWaveSidelinkSpectrumSignalParameters::MmWaveSidelinkSpectrumSignalParameters ()
 {
   NS_LOG_FUNCTION (this);
@@ -40,10 +51,10 @@ MmWaveSidelinkSpectrumSignalParameters::MmWaveSidelinkSpectrumSignalParameters (
   : SpectrumSignalParameters (p)
 {
   NS_LOG_FUNCTION (this << &p);
-  if (p.packetBurst)
-    {
-      packetBurst = p.packetBurst->Copy ();
-    }
+  // the channel creates a copy for each receiver, but only the destination
+  // needs its own packets, hence the burst is shared and the destination
+  // copies it
+  packetBurst = p.packetBurst;
   //ctrlMsgList = p.ctrlMsgList;
   slotInd = p.slotInd;
   mcs = p.mcs;
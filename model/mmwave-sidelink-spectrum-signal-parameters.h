@@ -24,6 +24,8 @@
 #define MMWAVE_SIDELINK_SPECTRUM_SIGNAL_PARAMETERS_H
 
 #include <ns3/spectrum-signal-parameters.h>
+#include <ns3/simple-ref-count.h>
+#include <vector>
 
 namespace ns3 {
 
@@ -33,6 +35,30 @@ namespace millicar {
 
 class MmWaveSidelinkControlMessage;
 
+/**
+* Immutable list of the resource blocks used by a transport block. It is
+* shared by the PHY, the transmitted signal and all the copies of the signal
+* delivered to the receivers, hence it is never copied.
+*/
+class MmWaveSidelinkRbBitmap : public SimpleRefCount<MmWaveSidelinkRbBitmap>
+{
+public:
+  /**
+  * constructor
+  * \param rbs the indices of the resource blocks
+  */
+  MmWaveSidelinkRbBitmap (const std::vector<int> &rbs);
+
+  /**
+  * Returns the indices of the resource blocks
+  * \return the indices of the resource blocks
+  */
+  const std::vector<int> & Get () const;
+
+private:
+  const std::vector<int> m_rbs; ///< the indices of the resource blocks
+};
+
 struct MmWaveSidelinkSpectrumSignalParameters : public SpectrumSignalParameters
 {
 
@@ -49,7 +75,7 @@ struct MmWaveSidelinkSpectrumSignalParameters : public SpectrumSignalParameters
   */
   MmWaveSidelinkSpectrumSignalParameters (const MmWaveSidelinkSpectrumSignalParameters& p);
 
-  Ptr<PacketBurst> packetBurst;
+  Ptr<PacketBurst> packetBurst; ///< the transport block, shared by the copies of the parameters
 
   //std::list<Ptr<MmWaveSidelinkControlMessage>> ctrlMsgList;
 
@@ -65,7 +91,7 @@ struct MmWaveSidelinkSpectrumSignalParameters : public SpectrumSignalParameters
 
   uint32_t size; ///< the size of the corresponding transport block
 
-  std::vector<int> rbBitmap; ///< the resource blocks bitmap associated to the transport block
+  Ptr<const MmWaveSidelinkRbBitmap> rbBitmap; ///< the resource blocks bitmap associated to the transport block
 
   bool pss;
 
@@ -42,12 +42,18 @@ NS_OBJECT_ENSURE_REGISTERED (MmWaveVehicularAntennaArrayModel);
 
 MmWaveVehicularAntennaArrayModel::MmWaveVehicularAntennaArrayModel () :
 m_omniTx {false},
+m_beamformingVectorId {0},
 m_currentPanelId {0},
 m_noPlane {0},
 m_isUe {false},
 m_totNoArrayElements {0},
 m_hpbw {0},       //HPBW value of each antenna element
-m_gMax {0}       //directivity value expressed in dBi and valid only for TRP (see table A.1.6-3 in 38.802)
+m_gMax {0},       //directivity value expressed in dBi and valid only for TRP (see table A.1.6-3 in 38.802)
+m_beamResolution {0},
+m_beamUpdateThreshold {0},
+m_lastBeamId {0},
+m_elementLocationsDisH {0},
+m_elementLocationsDisV {0}
 // :m_minAngle (0),m_maxAngle(2*M_PI)
 {
   m_lastUpdateMap.clear ();
@@ -56,7 +62,18 @@ m_gMax {0}       //directivity value expressed in dBi and valid only for TRP (se
 
 MmWaveVehicularAntennaArrayModel::~MmWaveVehicularAntennaArrayModel ()
 {
+  MmWaveVehicularBeamCodebook::Release (m_codebook);
+}
 
+void
+MmWaveVehicularAntennaArrayModel::DoDispose ()
+{
+  MmWaveVehicularBeamCodebook::Release (m_codebook);
+  m_beamformingVectorPanelMap.clear ();
+  m_currentBeam = BeamEntry ();
+  m_beamformingVector.clear ();
+  m_currentDev = 0;
+  AntennaModel::DoDispose ();
 }
 
 TypeId
@@ -96,6 +113,21 @@ MmWaveVehicularAntennaArrayModel::GetTypeId ()
                    UintegerValue (2),
                    MakeUintegerAccessor (&MmWaveVehicularAntennaArrayModel::SetPlanesNumber),
                    MakeUintegerChecker<uint8_t> ())
+    .AddAttribute ("BeamResolution",
+                   "Resolution of the steering angles, in degrees. If greater than 0, the beamforming vectors are "
+                   "taken from a codebook shared by all the antennas with the same configuration, and only the "
+                   "beam index is stored for each peer device. If 0, the exact beamforming vectors are computed",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&MmWaveVehicularAntennaArrayModel::SetBeamResolution,
+                                       &MmWaveVehicularAntennaArrayModel::GetBeamResolution),
+                   MakeDoubleChecker<double> (0, 180))
+    .AddAttribute ("BeamUpdateThreshold",
+                   "Minimum change of the steering angles towards a peer device, in degrees, which triggers the "
+                   "computation of a new beamforming vector. If the change is smaller and the panel is the same, "
+                   "the previous beamforming vector is kept. If 0, the vector is recomputed every time",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&MmWaveVehicularAntennaArrayModel::m_beamUpdateThreshold),
+                   MakeDoubleChecker<double> (0, 180))
   ;
   return tid;
 }
@@ -172,12 +204,24 @@ MmWaveVehicularAntennaArrayModel::GetOffset ()
   return m_currentPanelId * 2 * M_PI / m_noPlane;
 }
 
+uint8_t
+MmWaveVehicularAntennaArrayModel::GetNumPanels () const
+{
+  return m_noPlane;
+}
+
+double
+MmWaveVehicularAntennaArrayModel::GetPanelOffset (uint8_t panelId) const
+{
+  NS_ASSERT_MSG (panelId < m_noPlane, "Panel " << (uint16_t) panelId << " not available");
+  return panelId * 2 * M_PI / m_noPlane;
+}
+
 void
 MmWaveVehicularAntennaArrayModel::SetBeamformingVectorPanelDevices (Ptr<NetDevice> thisDevice, Ptr<NetDevice> otherDevice)
 {
   NS_LOG_FUNCTION (this << otherDevice << Simulator::Now ());
   m_omniTx = false;
-  complexVector_t antennaWeights;
   int panelId = 0;       // initialize all the variables
   if (thisDevice != 0 && otherDevice != 0)
     {
@@ -209,36 +253,68 @@ MmWaveVehicularAntennaArrayModel::SetBeamformingVectorPanelDevices (Ptr<NetDevic
 
       double hAngleRadian = fmod ((phiAngle + (M_PI / m_noPlane)),2 * M_PI / m_noPlane) - (M_PI / m_noPlane);
       double vAngleRadian = completeAngle.theta;
-      double power = 1 / sqrt (m_totNoArrayElements);
-      uint16_t antennaNum [2];
-      antennaNum[0] = sqrt (m_totNoArrayElements);
-      antennaNum[1] = sqrt (m_totNoArrayElements);
       NS_LOG_INFO ("hAngleRadian: " << hAngleRadian);
 
-      for (uint64_t ind = 0; ind < m_totNoArrayElements; ind++)
+      std::map< Ptr<NetDevice>, BeamEntry>::iterator iter = m_beamformingVectorPanelMap.find (otherDevice);
+      if (m_beamUpdateThreshold > 0 && iter != m_beamformingVectorPanelMap.end ()
+          && !iter->second.m_weights && iter->second.m_panelId == panelId
+          && std::abs (iter->second.m_hAngle - hAngleRadian) * 180 / M_PI < m_beamUpdateThreshold
+          && std::abs (iter->second.m_vAngle - vAngleRadian) * 180 / M_PI < m_beamUpdateThreshold)
+        {
+          // the geometry barely changed, keep the previous beamforming vector
+          NS_LOG_LOGIC ("Keep the beamforming vector towards " << otherDevice);
+          m_currentBeam = iter->second;
+          m_currentPanelId = panelId;
+          m_currentDev = otherDevice;
+          return;
+        }
+
+      BeamEntry entry;
+      entry.m_panelId = panelId;
+      entry.m_hAngle = hAngleRadian;
+      entry.m_vAngle = vAngleRadian;
+      if (m_beamResolution > 0)
+        {
+          // take the closest beam from the codebook, the vector is stored
+          // only by the codebook
+          if (m_codebook == 0)
+            {
+              m_codebook = GetBeamCodebook (m_beamResolution * M_PI / 180);
+            }
+          entry.m_codebookBeam = true;
+          entry.m_beamIndex = m_codebook->GetBeamIndex (hAngleRadian, vAngleRadian);
+        }
+      // otherwise the steering vector is computed from the separable
+      // factors of the angles when needed
+      if (entry.m_codebookBeam && iter != m_beamformingVectorPanelMap.end ()
+          && iter->second.m_codebookBeam && iter->second.m_beamIndex == entry.m_beamIndex)
+        {
+          // same beam of the codebook, the vector is unchanged
+          entry.m_beamId = iter->second.m_beamId;
+        }
+      else
         {
-          Vector loc = GetAntennaLocation (ind, antennaNum);
-          double phase = -2 * M_PI * (sin (vAngleRadian) * cos (hAngleRadian) * loc.x
-                                      + sin (vAngleRadian) * sin (hAngleRadian) * loc.y
-                                      + cos (vAngleRadian) * loc.z);
-          antennaWeights.push_back (exp (std::complex<double> (0, phase)) * power);
+          entry.m_beamId = NewBeamId ();
         }
 
-      std::map< Ptr<NetDevice>, std::pair<complexVector_t,int> >::iterator iter = m_beamformingVectorPanelMap.find (otherDevice);
       if (iter != m_beamformingVectorPanelMap.end ())
         {
-          (*iter).second = std::make_pair (antennaWeights, panelId);
+          (*iter).second = entry;
           m_lastUpdatePairMap[otherDevice] = Simulator::Now ();
         }
       else
         {
-          m_beamformingVectorPanelMap.insert (std::make_pair (otherDevice, std::make_pair (antennaWeights, panelId) ));
+          iter = m_beamformingVectorPanelMap.insert (std::make_pair (otherDevice, entry)).first;
           m_lastUpdatePairMap.insert (std::make_pair (otherDevice, Simulator::Now ()));
 
           NS_LOG_INFO ("m_lastUpdatePairMap.size " << m_lastUpdatePairMap.size ());
         }
+      m_currentBeam = iter->second;
+    }
+  else
+    {
+      m_currentBeam = BeamEntry ();
     }
-  m_beamformingVector = antennaWeights;
   m_currentPanelId = panelId;
   m_currentDev = otherDevice;
   NS_LOG_INFO ("panelId: " << panelId);
@@ -253,15 +329,18 @@ MmWaveVehicularAntennaArrayModel::SetBeamformingVectorPanel (complexVector_t ant
   m_omniTx = false;
   if (device != 0)
     {
+      BeamEntry entry;
+      entry.m_weights = std::make_shared<const complexVector_t> (std::move (antennaWeights));
+      entry.m_beamId = NewBeamId ();
       auto iter = m_beamformingVectorPanelMap.find (device);
       if (iter != m_beamformingVectorPanelMap.end ())
         {
-          (*iter).second = std::make_pair (antennaWeights, 0);
+          (*iter).second = entry;
           m_lastUpdatePairMap[device] = Simulator::Now ();
         }
       else
         {
-          m_beamformingVectorPanelMap.insert (std::make_pair (device, std::make_pair (antennaWeights, 0)) );
+          m_beamformingVectorPanelMap.insert (std::make_pair (device, entry));
           m_lastUpdatePairMap.insert (std::make_pair (device, Simulator::Now ()));
 
           NS_LOG_INFO ("m_lastUpdatePairMap.size " << m_lastUpdatePairMap.size ());
@@ -277,11 +356,11 @@ MmWaveVehicularAntennaArrayModel::ChangeBeamformingVectorPanel (Ptr<NetDevice> d
 {
   NS_LOG_FUNCTION (this << device << Simulator::Now ());
   m_omniTx = false;
-  std::map< Ptr<NetDevice>, std::pair<complexVector_t,int> >::iterator it = m_beamformingVectorPanelMap.find (device);
+  std::map< Ptr<NetDevice>, BeamEntry>::iterator it = m_beamformingVectorPanelMap.find (device);
   NS_ASSERT_MSG (it != m_beamformingVectorPanelMap.end (), "could not find");
-  NS_LOG_DEBUG ("ChangeBeamformingVectorPanel towards dev " << device << " prev panel " << m_currentPanelId << " updated to " << it->second.second);
-  m_beamformingVector = it->second.first;
-  m_currentPanelId = it->second.second;
+  NS_LOG_DEBUG ("ChangeBeamformingVectorPanel towards dev " << device << " prev panel " << m_currentPanelId << " updated to " << it->second.m_panelId);
+  m_currentBeam = it->second;
+  m_currentPanelId = it->second.m_panelId;
   m_currentDev = device;
 }
 
@@ -293,6 +372,16 @@ MmWaveVehicularAntennaArrayModel::GetBeamformingVectorPanel ()
     {
       NS_FATAL_ERROR ("Omni transmission do not need beamforming vector");
     }
+  if (m_currentBeam.m_codebookBeam || m_currentBeam.m_weights)
+    {
+      return GetWeights (m_currentBeam);
+    }
+  if (m_beamformingVectorId != m_currentBeam.m_beamId)
+    {
+      // compute the steering vector once per beam
+      m_beamformingVector = GetWeights (m_currentBeam);
+      m_beamformingVectorId = m_currentBeam.m_beamId;
+    }
   return m_beamformingVector;
 }
 
@@ -312,19 +401,164 @@ complexVector_t
 MmWaveVehicularAntennaArrayModel::GetBeamformingVectorPanel (Ptr<NetDevice> device)
 {
   NS_LOG_FUNCTION (this << device << Simulator::Now ());
-  complexVector_t weights;
-  std::map< Ptr<NetDevice>, std::pair<complexVector_t,int> >::iterator it = m_beamformingVectorPanelMap.find (device);
+  std::map< Ptr<NetDevice>, BeamEntry>::iterator it = m_beamformingVectorPanelMap.find (device);
   if (it != m_beamformingVectorPanelMap.end ())
     {
-      weights = it->second.first;
+      return GetWeights (it->second);
     }
-  else
+  return GetWeights (m_currentBeam);
+}
+
+uint64_t
+MmWaveVehicularAntennaArrayModel::GetBeamId () const
+{
+  return m_currentBeam.m_beamId;
+}
+
+uint64_t
+MmWaveVehicularAntennaArrayModel::NewBeamId ()
+{
+  return ++m_lastBeamId;
+}
+
+bool
+MmWaveVehicularAntennaArrayModel::GetBeamformingVectorFactors (complexVector_t &hWeights, complexVector_t &vWeights) const
+{
+  return GetFactors (m_currentBeam, hWeights, vWeights);
+}
+
+void
+MmWaveVehicularAntennaArrayModel::GetSteeringFactors (uint16_t numH, uint16_t numV, double disH, double disV,
+                                                      double hAngleRadian, double vAngleRadian,
+                                                      complexVector_t &hWeights, complexVector_t &vWeights)
+{
+  // the element (h, v) is in (0, disH * h, disV * v), see GetAntennaLocation,
+  // hence its phase is the sum of a term which depends only on h and a term
+  // which depends only on v
+  double hPhase = -2 * M_PI * sin (vAngleRadian) * sin (hAngleRadian) * disH;
+  double vPhase = -2 * M_PI * cos (vAngleRadian) * disV;
+
+  hWeights.resize (numH);
+  double hPower = 1 / sqrt (numH);
+  for (uint16_t h = 0; h < numH; h++)
+    {
+      hWeights[h] = exp (std::complex<double> (0, hPhase * h)) * hPower;
+    }
+
+  vWeights.resize (numV);
+  double vPower = 1 / sqrt (numV);
+  for (uint16_t v = 0; v < numV; v++)
     {
-      weights = m_beamformingVector;
+      vWeights[v] = exp (std::complex<double> (0, vPhase * v)) * vPower;
+    }
+}
+
+complexVector_t
+MmWaveVehicularAntennaArrayModel::KroneckerProduct (const complexVector_t &hWeights, const complexVector_t &vWeights)
+{
+  complexVector_t weights;
+  weights.reserve (hWeights.size () * vWeights.size ());
+  for (const std::complex<double> &vWeight : vWeights)
+    {
+      for (const std::complex<double> &hWeight : hWeights)
+        {
+          weights.push_back (vWeight * hWeight);
+        }
     }
   return weights;
 }
 
+Ptr<MmWaveVehicularBeamCodebook>
+MmWaveVehicularAntennaArrayModel::GetBeamCodebook (double resolution) const
+{
+  return MmWaveVehicularBeamCodebook::Get (m_totNoArrayElements, m_disH, m_disV, m_noPlane, resolution);
+}
+
+complexVector_t
+MmWaveVehicularAntennaArrayModel::GetWeights (const BeamEntry &entry) const
+{
+  if (entry.m_codebookBeam)
+    {
+      return m_codebook->GetBeam (entry.m_beamIndex);
+    }
+  if (entry.m_weights)
+    {
+      return *entry.m_weights;
+    }
+  complexVector_t hWeights;
+  complexVector_t vWeights;
+  if (!GetFactors (entry, hWeights, vWeights))
+    {
+      return complexVector_t ();
+    }
+  return KroneckerProduct (hWeights, vWeights);
+}
+
+bool
+MmWaveVehicularAntennaArrayModel::GetFactors (const BeamEntry &entry, complexVector_t &hWeights, complexVector_t &vWeights) const
+{
+  if (entry.m_beamId == 0 || entry.m_weights)
+    {
+      return false;
+    }
+  if (entry.m_codebookBeam)
+    {
+      m_codebook->GetBeamFactors (entry.m_beamIndex, hWeights, vWeights);
+      return true;
+    }
+  uint16_t antennaNum = sqrt (m_totNoArrayElements);
+  GetSteeringFactors (antennaNum, antennaNum, m_disH, m_disV, entry.m_hAngle, entry.m_vAngle,
+                      hWeights, vWeights);
+  return true;
+}
+
+void
+MmWaveVehicularAntennaArrayModel::SetBeamResolution (double resolution)
+{
+  NS_LOG_FUNCTION (this << resolution);
+  if (resolution == m_beamResolution)
+    {
+      return;
+    }
+  m_beamResolution = resolution;
+  // the codebook of the previous resolution is no longer used
+  MmWaveVehicularBeamCodebook::Release (m_codebook);
+  for (auto &it : m_beamformingVectorPanelMap)
+    {
+      UpdateCodebookBeam (it.second);
+    }
+  UpdateCodebookBeam (m_currentBeam);
+}
+
+double
+MmWaveVehicularAntennaArrayModel::GetBeamResolution () const
+{
+  return m_beamResolution;
+}
+
+void
+MmWaveVehicularAntennaArrayModel::UpdateCodebookBeam (BeamEntry &entry)
+{
+  if (!entry.m_codebookBeam)
+    {
+      return;
+    }
+  if (m_beamResolution > 0)
+    {
+      if (m_codebook == 0)
+        {
+          m_codebook = GetBeamCodebook (m_beamResolution * M_PI / 180);
+        }
+      entry.m_beamIndex = m_codebook->GetBeamIndex (entry.m_hAngle, entry.m_vAngle);
+    }
+  else
+    {
+      entry.m_codebookBeam = false;
+      entry.m_beamIndex = 0;
+    }
+  entry.m_beamId = NewBeamId ();
+}
+
 Ptr<NetDevice>
 MmWaveVehicularAntennaArrayModel::GetCurrentDevice ()
 {
@@ -391,23 +625,58 @@ MmWaveVehicularAntennaArrayModel::GetAntennaLocation (uint16_t index, uint16_t*
   return loc;
 }
 
+const std::vector<Vector> &
+MmWaveVehicularAntennaArrayModel::GetElementLocations () const
+{
+  if (m_elementLocations.size () != m_totNoArrayElements
+      || m_elementLocationsDisH != m_disH
+      || m_elementLocationsDisV != m_disV)
+    {
+      NS_LOG_LOGIC ("Compute the location of " << m_totNoArrayElements << " antenna elements");
+      uint16_t antennaNum = sqrt (m_totNoArrayElements);
+      m_elementLocations.resize (m_totNoArrayElements);
+      for (uint64_t ind = 0; ind < m_totNoArrayElements; ind++)
+        {
+          //assume the left bottom corner is (0,0,0), and the rectangular antenna array is on the y-z plane.
+          m_elementLocations[ind] = Vector (0, m_disH * (ind % antennaNum), m_disV * floor (ind / antennaNum));
+        }
+      m_elementLocationsDisH = m_disH;
+      m_elementLocationsDisV = m_disV;
+    }
+  return m_elementLocations;
+}
+
+void
+MmWaveVehicularAntennaArrayModel::GetElementPhaseTerms (double vAngleRadian, double hAngleRadian, complexVector_t &terms) const
+{
+  const std::vector<Vector> &locations = GetElementLocations ();
+
+  // the direction of the wave is the same for all the elements
+  double rx = sin (vAngleRadian) * cos (hAngleRadian);
+  double ry = sin (vAngleRadian) * sin (hAngleRadian);
+  double rz = cos (vAngleRadian);
+
+  terms.resize (locations.size ());
+  for (uint64_t ind = 0; ind < locations.size (); ind++)
+    {
+      const Vector &loc = locations[ind];
+      terms[ind] = exp (std::complex<double> (0, 2 * M_PI * (rx * loc.x + ry * loc.y + rz * loc.z)));
+    }
+}
+
 void
 MmWaveVehicularAntennaArrayModel::SetSector (uint8_t sector, uint16_t *antennaNum, double elevation)
 {
-  complexVector_t tempVector;
   double hAngle_radian = M_PI * (double)sector / (double)antennaNum[1] - 0.5 * M_PI;
   double vAngle_radian = elevation * M_PI / 180;
-  uint64_t size = antennaNum[0] * antennaNum[1];
-  double power = 1 / sqrt (size);
-  for (uint64_t ind = 0; ind < size; ind++)
-    {
-      Vector loc = GetAntennaLocation (ind, antennaNum);
-      double phase = -2 * M_PI * (sin (vAngle_radian) * cos (hAngle_radian) * loc.x
-                                  + sin (vAngle_radian) * sin (hAngle_radian) * loc.y
-                                  + cos (vAngle_radian) * loc.z);
-      tempVector.push_back (exp (std::complex<double> (0, phase)) * power);
-    }
-  m_beamformingVector = tempVector;
+  complexVector_t hWeights;
+  complexVector_t vWeights;
+  GetSteeringFactors (antennaNum[0], antennaNum[1], m_disH, m_disV, hAngle_radian, vAngle_radian,
+                      hWeights, vWeights);
+  // the layout may differ from the one of the array, store the vector
+  m_currentBeam = BeamEntry ();
+  m_currentBeam.m_weights = std::make_shared<const complexVector_t> (KroneckerProduct (hWeights, vWeights));
+  m_currentBeam.m_beamId = NewBeamId ();
 }
 
 Time
@@ -26,9 +26,11 @@
 #include <complex>
 #include <ns3/net-device.h>
 #include <map>
+#include <memory>
 #include <ns3/nstime.h>
 #include <ns3/node.h>
 #include <ns3/mobility-model.h>
+#include <ns3/mmwave-vehicular-beam-codebook.h>
 
 namespace ns3 {
 
@@ -57,6 +59,24 @@ public:
   bool IsOmniTx ();
   double GetRadiationPattern (double vangle, double hangle = 0);
   Vector GetAntennaLocation (uint16_t index, uint16_t* antennaNum);
+
+  /**
+   * Returns the location of each antenna element, in multiples of lambda,
+   * with the same layout used by GetAntennaLocation. The locations are
+   * computed only when the configuration of the array changes.
+   * \return the locations, one for each antenna element
+   */
+  const std::vector<Vector> & GetElementLocations () const;
+
+  /**
+   * Computes the phase term exp (j 2 pi r . loc) of each antenna element for a
+   * plane wave with direction r, given by the zenith and azimuth angles
+   * \param vAngleRadian the zenith angle
+   * \param hAngleRadian the azimuth angle
+   * \param terms filled with the phase terms, one for each antenna element
+   */
+  void GetElementPhaseTerms (double vAngleRadian, double hAngleRadian, complexVector_t &terms) const;
+
   void SetSector (uint8_t sector, uint16_t *antennaNum, double elevation = 90);
 
   void SetPlanesNumber (uint8_t planesNumber);
@@ -66,17 +86,150 @@ public:
   uint64_t GetTotNoArrayElements () const;
   double GetOffset ();
 
+  /**
+   * Returns the number of panels of the array
+   * \return the number of panels
+   */
+  uint8_t GetNumPanels () const;
+
+  /**
+   * Returns the azimuth offset of a panel, i.e., the rotation of its local
+   * coordinate system
+   * \param panelId the id of the panel
+   * \return the offset in radians
+   */
+  double GetPanelOffset (uint8_t panelId) const;
+
+  /**
+   * Returns the identifier of the current beamforming vector. The identifier
+   * changes every time the beamforming vector is recomputed, hence two
+   * vectors of this antenna with the same identifier are equal.
+   * \return the identifier, 0 if no beamforming vector has been set
+   */
+  uint64_t GetBeamId () const;
+
+  /**
+   * Returns the current beamforming vector in separable form. The element
+   * with index ind = v * numH + h has weight hWeights[h] * vWeights[v],
+   * i.e., the beamforming vector is the Kronecker product of the vertical
+   * and the horizontal factors.
+   * \param hWeights filled with the horizontal factor
+   * \param vWeights filled with the vertical factor
+   * \return false if the current beamforming vector is not separable, e.g.,
+   *         if it has been set with SetBeamformingVectorPanel
+   */
+  bool GetBeamformingVectorFactors (complexVector_t &hWeights, complexVector_t &vWeights) const;
+
+  /**
+   * Computes the horizontal and vertical factors of the steering vector of
+   * a uniform planar array on the y-z plane, with numH * numV elements.
+   * Only numH + numV complex exponentials are computed.
+   * \param numH the number of elements along the horizontal axis
+   * \param numV the number of elements along the vertical axis
+   * \param disH the horizontal spacing in multiples of lambda
+   * \param disV the vertical spacing in multiples of lambda
+   * \param hAngleRadian the horizontal steering angle
+   * \param vAngleRadian the vertical steering angle
+   * \param hWeights filled with the horizontal factor
+   * \param vWeights filled with the vertical factor
+   */
+  static void GetSteeringFactors (uint16_t numH, uint16_t numV, double disH, double disV,
+                                  double hAngleRadian, double vAngleRadian,
+                                  complexVector_t &hWeights, complexVector_t &vWeights);
+
+  /**
+   * Builds the dense beamforming vector from its separable factors
+   * \param hWeights the horizontal factor
+   * \param vWeights the vertical factor
+   * \return the beamforming vector, with hWeights.size () * vWeights.size () elements
+   */
+  static complexVector_t KroneckerProduct (const complexVector_t &hWeights, const complexVector_t &vWeights);
+
+  /**
+   * Returns the shared codebook for the configuration of this antenna. The
+   * codebook must be released with MmWaveVehicularBeamCodebook::Release
+   * \param resolution the angular resolution in radians
+   * \return the codebook
+   */
+  Ptr<MmWaveVehicularBeamCodebook> GetBeamCodebook (double resolution) const;
+
+  /**
+   * Sets the resolution of the steering angles. The beams taken from the
+   * codebook for the peer devices are moved to the codebook with the new
+   * resolution, or to the exact beams if it is 0.
+   * \param resolution the resolution in degrees, 0 to compute the exact beams
+   */
+  void SetBeamResolution (double resolution);
+
+  /**
+   * Returns the resolution of the steering angles
+   * \return the resolution in degrees
+   */
+  double GetBeamResolution () const;
+
   Ptr<NetDevice> GetCurrentDevice ();
   Time GetLastUpdate (Ptr<NetDevice> device);
 
+protected:
+  virtual void DoDispose ();
+
 private:
+  /**
+   * Beamforming configuration towards a peer device. Only the codebook
+   * index, or the steering angles, are stored: the beamforming vector is
+   * resolved when it is used.
+   */
+  struct BeamEntry
+  {
+    bool m_codebookBeam {false}; //!< true if the beam is taken from the codebook
+    uint32_t m_beamIndex {0}; //!< the index of the beam in the codebook
+    int m_panelId {0}; //!< the id of the panel
+    double m_hAngle {0}; //!< the horizontal steering angle in radians
+    double m_vAngle {0}; //!< the vertical steering angle in radians
+    uint64_t m_beamId {0}; //!< the identifier of the beamforming vector, 0 if no beam has been set
+    std::shared_ptr<const complexVector_t> m_weights; //!< the vector set with SetBeamformingVectorPanel or SetSector, null for the steering and the codebook beams
+  };
+
+  /**
+   * Returns a new beam identifier, unique among the beams of this antenna
+   * \return the identifier
+   */
+  uint64_t NewBeamId ();
+
+  /**
+   * Resolves the beamforming vector of an entry
+   * \param entry the entry
+   * \return the beamforming vector, empty if no beam has been set
+   */
+  complexVector_t GetWeights (const BeamEntry &entry) const;
+
+  /**
+   * Resolves the beamforming vector of an entry in separable form
+   * \param entry the entry
+   * \param hWeights filled with the horizontal factor
+   * \param vWeights filled with the vertical factor
+   * \return false if the beamforming vector is not separable
+   */
+  bool GetFactors (const BeamEntry &entry, complexVector_t &hWeights, complexVector_t &vWeights) const;
+
+  /**
+   * Takes the beam of an entry from the codebook of the current resolution,
+   * or computes the exact beam if the resolution is 0, and gives it a new
+   * beam identifier. Only the entries already taken from a codebook are
+   * changed.
+   * \param entry the entry
+   */
+  void UpdateCodebookBeam (BeamEntry &entry);
+
   bool m_omniTx;
   // double m_minAngle;
   // double m_maxAngle;
-  complexVector_t m_beamformingVector;
+  BeamEntry m_currentBeam; // the current beam
+  complexVector_t m_beamformingVector; // the dense vector of the current steering beam, computed when needed
+  uint64_t m_beamformingVectorId; // identifier of the beam stored in m_beamformingVector
   int m_currentPanelId;
   // std::map<Ptr<NetDevice>, complexVector_t> m_beamformingVectorMap;
-  std::map<Ptr<NetDevice>, std::pair<complexVector_t,int> > m_beamformingVectorPanelMap;
+  std::map<Ptr<NetDevice>, BeamEntry> m_beamformingVectorPanelMap;
 
   double m_disV;       //antenna spacing in the vertical direction in terms of wave length.
   double m_disH;       //antenna spacing in the horizontal direction in terms of wave length.
@@ -95,6 +248,14 @@ private:
   bool m_isotropicElement;
 
   std::string m_antennaElementPattern; // configuration of antenna parameters based on different 3GPP technical reports (38.901, 37.885)
+
+  double m_beamResolution; // resolution of the steering angles in degrees, 0 to compute the exact beams
+  double m_beamUpdateThreshold; // minimum change of the steering angles, in degrees, which triggers a beam update
+  uint64_t m_lastBeamId; // last identifier given to a beamforming vector of this antenna
+  Ptr<MmWaveVehicularBeamCodebook> m_codebook; // the shared codebook, used if m_beamResolution > 0
+  mutable std::vector<Vector> m_elementLocations; // location of each antenna element, in multiples of lambda
+  mutable double m_elementLocationsDisH; // horizontal spacing used to compute m_elementLocations
+  mutable double m_elementLocationsDisV; // vertical spacing used to compute m_elementLocations
 };
 
 } /* namespace millicar */
@@ -0,0 +1,150 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "mmwave-vehicular-beam-codebook.h"
+#include "mmwave-vehicular-antenna-array-model.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularBeamCodebook");
+
+Ptr<MmWaveVehicularBeamCodebook>
+MmWaveVehicularBeamCodebook::Get (uint64_t numElements, double disH, double disV,
+                                  uint8_t numSectors, double resolution)
+{
+  std::map<Key_t, Registration> &codebooks = GetCodebooks ();
+
+  Key_t key = std::make_tuple (numElements, disH, disV, numSectors, resolution);
+  auto it = codebooks.find (key);
+  if (it == codebooks.end ())
+    {
+      NS_LOG_INFO ("New codebook for " << numElements << " elements, " << (uint16_t) numSectors << " sectors");
+      Registration registration;
+      registration.m_codebook = Create<MmWaveVehicularBeamCodebook> (numElements, disH, disV, numSectors, resolution);
+      registration.m_users = 0;
+      it = codebooks.insert (std::make_pair (key, registration)).first;
+    }
+  it->second.m_users++;
+  return it->second.m_codebook;
+}
+
+void
+MmWaveVehicularBeamCodebook::Release (Ptr<MmWaveVehicularBeamCodebook> &codebook)
+{
+  if (codebook == 0)
+    {
+      return;
+    }
+  std::map<Key_t, Registration> &codebooks = GetCodebooks ();
+  auto it = codebooks.find (codebook->m_key);
+  NS_ASSERT_MSG (it != codebooks.end () && it->second.m_codebook == codebook && it->second.m_users > 0,
+                 "The codebook has not been obtained with Get");
+  if (--it->second.m_users == 0)
+    {
+      NS_LOG_INFO ("Release the codebook for " << codebook->m_numElements << " elements");
+      codebooks.erase (it);
+    }
+  codebook = 0;
+}
+
+uint32_t
+MmWaveVehicularBeamCodebook::GetNumCodebooks ()
+{
+  return GetCodebooks ().size ();
+}
+
+std::map<MmWaveVehicularBeamCodebook::Key_t, MmWaveVehicularBeamCodebook::Registration> &
+MmWaveVehicularBeamCodebook::GetCodebooks ()
+{
+  static std::map<Key_t, Registration> codebooks;
+  return codebooks;
+}
+
+MmWaveVehicularBeamCodebook::MmWaveVehicularBeamCodebook (uint64_t numElements, double disH, double disV,
+                                                          uint8_t numSectors, double resolution)
+  : m_key (std::make_tuple (numElements, disH, disV, numSectors, resolution)),
+    m_numElements (numElements),
+    m_antennaNum (sqrt (numElements)),
+    m_disH (disH),
+    m_disV (disV),
+    m_minHAngle (-M_PI / numSectors),
+    m_resolution (resolution)
+{
+  NS_LOG_FUNCTION (this << numElements << disH << disV << (uint16_t) numSectors << resolution);
+  NS_ASSERT_MSG (resolution > 0, "The resolution must be positive");
+  NS_ASSERT_MSG (numSectors > 0, "The number of sectors must be positive");
+
+  m_numH = floor (2 * M_PI / numSectors / resolution) + 1;
+  m_numV = floor (M_PI / resolution) + 1;
+  m_beams.resize (m_numH * m_numV);
+}
+
+uint32_t
+MmWaveVehicularBeamCodebook::GetBeamIndex (double hAngle, double vAngle) const
+{
+  int64_t hIndex = std::lround ((hAngle - m_minHAngle) / m_resolution);
+  int64_t vIndex = std::lround (vAngle / m_resolution);
+  hIndex = std::min<int64_t> (std::max<int64_t> (hIndex, 0), m_numH - 1);
+  vIndex = std::min<int64_t> (std::max<int64_t> (vIndex, 0), m_numV - 1);
+  return vIndex * m_numH + hIndex;
+}
+
+const std::vector<std::complex<double> > &
+MmWaveVehicularBeamCodebook::GetBeam (uint32_t index) const
+{
+  NS_ASSERT_MSG (index < m_beams.size (), "Invalid beam index " << index);
+
+  std::vector<std::complex<double> > &beam = m_beams.at (index);
+  if (beam.empty ())
+    {
+      std::vector<std::complex<double> > hWeights;
+      std::vector<std::complex<double> > vWeights;
+      GetBeamFactors (index, hWeights, vWeights);
+      beam = MmWaveVehicularAntennaArrayModel::KroneckerProduct (hWeights, vWeights);
+    }
+  return beam;
+}
+
+void
+MmWaveVehicularBeamCodebook::GetBeamFactors (uint32_t index, std::vector<std::complex<double> > &hWeights,
+                                             std::vector<std::complex<double> > &vWeights) const
+{
+  NS_ASSERT_MSG (index < m_beams.size (), "Invalid beam index " << index);
+
+  // same steering vector computed by MmWaveVehicularAntennaArrayModel
+  double hAngleRadian = m_minHAngle + (index % m_numH) * m_resolution;
+  double vAngleRadian = (index / m_numH) * m_resolution;
+  MmWaveVehicularAntennaArrayModel::GetSteeringFactors (m_antennaNum, m_antennaNum, m_disH, m_disV,
+                                                        hAngleRadian, vAngleRadian, hWeights, vWeights);
+}
+
+uint32_t
+MmWaveVehicularBeamCodebook::GetNumBeams () const
+{
+  return m_beams.size ();
+}
+
+} // namespace millicar
+} // namespace ns3
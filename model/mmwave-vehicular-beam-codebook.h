@@ -0,0 +1,152 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MMWAVE_VEHICULAR_BEAM_CODEBOOK_H
+#define MMWAVE_VEHICULAR_BEAM_CODEBOOK_H
+
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+#include <complex>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * \ingroup millicar
+ * Codebook of beamforming vectors for a squared antenna panel. The steering
+ * angles are quantized with a fixed resolution: the horizontal angle spans
+ * the sector covered by the panel, i.e., [-pi/numSectors, pi/numSectors],
+ * and the vertical angle spans [0, pi].
+ * The codebooks are shared by all the antennas with the same configuration,
+ * which release them with Release, and each beamforming vector is computed
+ * the first time it is used.
+ */
+class MmWaveVehicularBeamCodebook : public SimpleRefCount<MmWaveVehicularBeamCodebook>
+{
+public:
+  /**
+   * Returns the codebook for the given configuration, creating it if needed.
+   * Each call must be paired with a call to Release
+   * \param numElements the number of antenna elements of the panel
+   * \param disH the horizontal spacing in multiples of lambda
+   * \param disV the vertical spacing in multiples of lambda
+   * \param numSectors the number of panels of the antenna
+   * \param resolution the angular resolution in radians
+   * \return the codebook
+   */
+  static Ptr<MmWaveVehicularBeamCodebook> Get (uint64_t numElements, double disH, double disV,
+                                               uint8_t numSectors, double resolution);
+
+  /**
+   * Releases a codebook obtained with Get. The codebook is removed from the
+   * shared ones when every Get has been paired with a Release, hence the
+   * codebooks do not outlive the antennas which use them. Other references
+   * to the codebook keep it alive, but do not keep it shared.
+   * \param codebook the codebook, set to 0
+   */
+  static void Release (Ptr<MmWaveVehicularBeamCodebook> &codebook);
+
+  /**
+   * Returns the number of codebooks in use
+   * \return the number of codebooks
+   */
+  static uint32_t GetNumCodebooks ();
+
+  /**
+   * Constructor
+   * \param numElements the number of antenna elements of the panel
+   * \param disH the horizontal spacing in multiples of lambda
+   * \param disV the vertical spacing in multiples of lambda
+   * \param numSectors the number of panels of the antenna
+   * \param resolution the angular resolution in radians
+   */
+  MmWaveVehicularBeamCodebook (uint64_t numElements, double disH, double disV,
+                               uint8_t numSectors, double resolution);
+
+  /**
+   * Returns the index of the beam closest to the given direction
+   * \param hAngle the horizontal angle in radians, with respect to the
+   *        boresight of the panel
+   * \param vAngle the vertical angle in radians
+   * \return the beam index
+   */
+  uint32_t GetBeamIndex (double hAngle, double vAngle) const;
+
+  /**
+   * Returns the beamforming vector of a beam
+   * \param index the beam index
+   * \return the beamforming vector
+   */
+  const std::vector<std::complex<double> > & GetBeam (uint32_t index) const;
+
+  /**
+   * Returns the beamforming vector of a beam in separable form, see
+   * MmWaveVehicularAntennaArrayModel::GetSteeringFactors
+   * \param index the beam index
+   * \param hWeights filled with the horizontal factor
+   * \param vWeights filled with the vertical factor
+   */
+  void GetBeamFactors (uint32_t index, std::vector<std::complex<double> > &hWeights,
+                       std::vector<std::complex<double> > &vWeights) const;
+
+  /**
+   * Returns the number of beams of the codebook
+   * \return the number of beams
+   */
+  uint32_t GetNumBeams () const;
+
+private:
+  typedef std::tuple<uint64_t, double, double, uint8_t, double> Key_t; //!< (elements, disH, disV, sectors, resolution)
+
+  /**
+   * A shared codebook and the number of its users
+   */
+  struct Registration
+  {
+    Ptr<MmWaveVehicularBeamCodebook> m_codebook; //!< the codebook
+    uint32_t m_users; //!< the number of calls to Get not yet paired with a call to Release
+  };
+
+  /**
+   * Returns the codebooks in use, indexed by configuration
+   * \return the codebooks
+   */
+  static std::map<Key_t, Registration> & GetCodebooks ();
+
+  Key_t m_key; //!< the configuration of the codebook
+
+  uint64_t m_numElements; //!< number of antenna elements
+  uint16_t m_antennaNum; //!< number of antenna elements per side
+  double m_disH; //!< horizontal spacing in multiples of lambda
+  double m_disV; //!< vertical spacing in multiples of lambda
+  double m_minHAngle; //!< smallest horizontal angle
+  double m_resolution; //!< angular resolution in radians
+  uint32_t m_numH; //!< number of horizontal angles
+  uint32_t m_numV; //!< number of vertical angles
+  mutable std::vector<std::vector<std::complex<double> > > m_beams; //!< the beams, empty until first used
+};
+
+} // namespace millicar
+} // namespace ns3
+
+#endif /* MMWAVE_VEHICULAR_BEAM_CODEBOOK_H */
@@ -0,0 +1,233 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "mmwave-vehicular-beam-sweep.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include <algorithm>
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularBeamSweep");
+
+NS_OBJECT_ENSURE_REGISTERED (MmWaveVehicularBeamSweep);
+
+MmWaveVehicularBeamSweep::MmWaveVehicularBeamSweep ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+MmWaveVehicularBeamSweep::~MmWaveVehicularBeamSweep ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+MmWaveVehicularBeamSweep::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MmWaveVehicularBeamSweep")
+    .SetParent<Object> ()
+    .AddConstructor<MmWaveVehicularBeamSweep> ()
+    .AddAttribute ("BeamResolution",
+                   "Angular resolution of the codebooks used for the training, in degrees. Each codebook "
+                   "has (floor (360 / (NumSectors * BeamResolution)) + 1) * (floor (180 / BeamResolution) + 1) "
+                   "beams, e.g., 49 for two sectors and 30 degrees, and every pair of beams is measured",
+                   DoubleValue (30),
+                   MakeDoubleAccessor (&MmWaveVehicularBeamSweep::m_beamResolution),
+                   MakeDoubleChecker<double> (0.1, 180))
+    .AddAttribute ("WidebandOnly",
+                   "If true, the gain of a beam pair is the sum of the power of the clusters, "
+                   "otherwise it is averaged over the bands taking into account the cluster delays",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MmWaveVehicularBeamSweep::m_widebandOnly),
+                   MakeBooleanChecker ())
+    .AddAttribute ("SymbolsPerBeamPair",
+                   "Number of OFDM symbols needed to measure a beam pair, e.g., 4 for an NR SSB",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&MmWaveVehicularBeamSweep::m_symbolsPerBeamPair),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+void
+MmWaveVehicularBeamSweep::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  m_splm = 0;
+  Object::DoDispose ();
+}
+
+void
+MmWaveVehicularBeamSweep::SetPropagationLossModel (Ptr<MmWaveVehicularSpectrumPropagationLossModel> splm)
+{
+  m_splm = splm;
+}
+
+bool
+MmWaveVehicularBeamSweep::Sweep (Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, Ptr<const SpectrumModel> sm,
+                                 Time symbolPeriod, Result &result) const
+{
+  NS_LOG_FUNCTION (this << txDevice << rxDevice);
+  NS_ASSERT_MSG (m_splm, "First set the spectrum propagation loss model");
+
+  bool reverse;
+  Ptr<const Params3gpp> params = m_splm->GetCachedChannel (txDevice, rxDevice, reverse);
+  if (params == 0)
+    {
+      NS_LOG_LOGIC ("The channel between " << txDevice << " and " << rxDevice << " is not available");
+      return false;
+    }
+
+  Ptr<MmWaveVehicularAntennaArrayModel> txAntenna = m_splm->GetAntenna (txDevice);
+  Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna = m_splm->GetAntenna (rxDevice);
+  NS_ASSERT_MSG (txAntenna && rxAntenna, "Antenna not found");
+  Ptr<MmWaveVehicularBeamCodebook> txCodebook = txAntenna->GetBeamCodebook (m_beamResolution * M_PI / 180);
+  Ptr<MmWaveVehicularBeamCodebook> rxCodebook = rxAntenna->GetBeamCodebook (m_beamResolution * M_PI / 180);
+
+  std::vector<double> gains;
+  uint32_t best;
+  if (!reverse)
+    {
+      ComputeGains (*params, *txCodebook, *rxCodebook, m_widebandOnly ? 0 : sm, gains);
+      best = std::max_element (gains.begin (), gains.end ()) - gains.begin ();
+      result.m_txBeam = best % txCodebook->GetNumBeams ();
+      result.m_rxBeam = best / txCodebook->GetNumBeams ();
+    }
+  else
+    {
+      // the realization has been generated for the reverse link, hence the
+      // rows of the matrix are the elements of the tx panel; the gain of a
+      // pair of beams is the same in the two directions
+      ComputeGains (*params, *rxCodebook, *txCodebook, m_widebandOnly ? 0 : sm, gains);
+      best = std::max_element (gains.begin (), gains.end ()) - gains.begin ();
+      result.m_txBeam = best / rxCodebook->GetNumBeams ();
+      result.m_rxBeam = best % rxCodebook->GetNumBeams ();
+    }
+  result.m_gain = gains.at (best);
+  result.m_numPairs = gains.size ();
+  result.m_latency = symbolPeriod * (result.m_numPairs * m_symbolsPerBeamPair);
+
+  NS_LOG_DEBUG ("Best pair tx " << result.m_txBeam << " rx " << result.m_rxBeam
+                                << " gain " << 10 * log10 (result.m_gain) << " dB out of "
+                                << result.m_numPairs << " pairs, latency " << result.m_latency.GetSeconds ());
+
+  // the codebooks are kept only if they are used by the antennas
+  MmWaveVehicularBeamCodebook::Release (txCodebook);
+  MmWaveVehicularBeamCodebook::Release (rxCodebook);
+  return true;
+}
+
+void
+MmWaveVehicularBeamSweep::ComputeGains (const Params3gpp &params,
+                                        const MmWaveVehicularBeamCodebook &txCodebook,
+                                        const MmWaveVehicularBeamCodebook &rxCodebook,
+                                        Ptr<const SpectrumModel> sm,
+                                        std::vector<double> &gains)
+{
+  //channel[rx][tx][cluster]
+  uint8_t numCluster = params.m_numCluster;
+  uint32_t numTxBeams = txCodebook.GetNumBeams ();
+  uint32_t numRxBeams = rxCodebook.GetNumBeams ();
+  uint16_t rxElements = params.m_channel.size ();
+  uint16_t txElements = params.m_channel.at (0).size ();
+  NS_ASSERT_MSG (txCodebook.GetBeam (0).size () == txElements, "The tx codebook does not match the channel");
+  NS_ASSERT_MSG (rxCodebook.GetBeam (0).size () == rxElements, "The rx codebook does not match the channel");
+
+  // first product, partial[n][u * numTxBeams + t] = sum_s H[u][s][n] * wTx[t][s]
+  complex2DVector_t partial (numCluster, complexVector_t (rxElements * numTxBeams));
+  for (uint32_t t = 0; t < numTxBeams; t++)
+    {
+      const complexVector_t &txBeam = txCodebook.GetBeam (t);
+      for (uint16_t u = 0; u < rxElements; u++)
+        {
+          const complex2DVector_t &row = params.m_channel[u];
+          for (uint16_t s = 0; s < txElements; s++)
+            {
+              const complexVector_t &clusters = row[s];
+              for (uint8_t n = 0; n < numCluster; n++)
+                {
+                  partial[n][u * numTxBeams + t] += clusters[n] * txBeam[s];
+                }
+            }
+        }
+    }
+
+  // second product, pairGain[n][r * numTxBeams + t] = sum_u wRx[r][u] * partial[n][u * numTxBeams + t]
+  complex2DVector_t pairGain (numCluster, complexVector_t (numRxBeams * numTxBeams));
+  for (uint32_t r = 0; r < numRxBeams; r++)
+    {
+      const complexVector_t &rxBeam = rxCodebook.GetBeam (r);
+      for (uint8_t n = 0; n < numCluster; n++)
+        {
+          std::complex<double> *out = &pairGain[n][r * numTxBeams];
+          for (uint16_t u = 0; u < rxElements; u++)
+            {
+              const std::complex<double> *in = &partial[n][u * numTxBeams];
+              for (uint32_t t = 0; t < numTxBeams; t++)
+                {
+                  out[t] += rxBeam[u] * in[t];
+                }
+            }
+        }
+    }
+
+  gains.assign (numRxBeams * numTxBeams, 0.0);
+  if (sm == 0)
+    {
+      // the cross terms among the clusters average out over a wide band
+      for (uint8_t n = 0; n < numCluster; n++)
+        {
+          for (uint32_t i = 0; i < gains.size (); i++)
+            {
+              gains[i] += norm (pairGain[n][i]);
+            }
+        }
+      return;
+    }
+
+  complexVector_t delays (numCluster);
+  for (Bands::const_iterator sbit = sm->Begin (); sbit != sm->End (); sbit++)
+    {
+      for (uint8_t n = 0; n < numCluster; n++)
+        {
+          delays[n] = exp (std::complex<double> (0, -2 * M_PI * (*sbit).fc * params.m_delay.at (n)));
+        }
+      for (uint32_t i = 0; i < gains.size (); i++)
+        {
+          std::complex<double> subbandGain (0.0, 0.0);
+          for (uint8_t n = 0; n < numCluster; n++)
+            {
+              subbandGain += pairGain[n][i] * delays[n];
+            }
+          gains[i] += norm (subbandGain);
+        }
+    }
+  for (double &gain : gains)
+    {
+      gain /= sm->GetNumBands ();
+    }
+}
+
+} // namespace millicar
+} // namespace ns3
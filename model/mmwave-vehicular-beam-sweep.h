@@ -0,0 +1,129 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MMWAVE_VEHICULAR_BEAM_SWEEP_H
+#define MMWAVE_VEHICULAR_BEAM_SWEEP_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/spectrum-model.h"
+#include "ns3/mmwave-vehicular-spectrum-propagation-loss-model.h"
+#include <vector>
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * \ingroup millicar
+ * Exhaustive beam training between two devices, as done with the SSB bursts
+ * of NR: every pair of beams of the tx and rx codebooks is evaluated and the
+ * pair with the highest gain is selected.
+ * Instead of configuring each pair in the antennas and computing the rx PSD,
+ * the gains of all the pairs are obtained from the channel realization
+ * cached by the MmWaveVehicularSpectrumPropagationLossModel with two matrix
+ * products per cluster, i.e., G_n = W_rx^T H_n W_tx, where the columns of
+ * W_tx and W_rx are the beams of the codebooks.
+ * The Doppler terms and the oxygen absorption are neglected, since the
+ * training is assumed to be shorter than the coherence time of the channel.
+ * The codebooks span the panels used by the last transmission on the link,
+ * since the cached channel matrix is projected on those panels. With the
+ * default resolution of 30 degrees, each codebook of an antenna with two
+ * sectors has 7 x 7 beams.
+ */
+class MmWaveVehicularBeamSweep : public Object
+{
+public:
+  /**
+   * Outcome of a beam sweep
+   */
+  struct Result
+  {
+    uint32_t m_txBeam; //!< index of the best beam in the tx codebook
+    uint32_t m_rxBeam; //!< index of the best beam in the rx codebook
+    double m_gain; //!< beamforming gain of the best pair (linear scale)
+    uint32_t m_numPairs; //!< number of evaluated beam pairs
+    Time m_latency; //!< duration of the training procedure
+  };
+
+  /**
+   * Constructor
+   */
+  MmWaveVehicularBeamSweep ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularBeamSweep ();
+
+  // inherited from Object
+  static TypeId GetTypeId (void);
+  void DoDispose ();
+
+  /**
+   * Set the spectrum propagation loss model which provides the channel
+   * realizations and the antenna arrays of the devices
+   * \param splm the spectrum propagation loss model
+   */
+  void SetPropagationLossModel (Ptr<MmWaveVehicularSpectrumPropagationLossModel> splm);
+
+  /**
+   * Evaluate all the beam pairs of the link between two devices. The link
+   * must have been used at least once, so that its channel realization is
+   * available.
+   * \param txDevice the tx device
+   * \param rxDevice the rx device
+   * \param sm the spectrum model over which the gain is averaged, not used
+   *        if WidebandOnly is true
+   * \param symbolPeriod the duration of an OFDM symbol
+   * \param result filled with the outcome of the sweep
+   * \return false if the channel of the link is not available
+   */
+  bool Sweep (Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, Ptr<const SpectrumModel> sm,
+              Time symbolPeriod, Result &result) const;
+
+  /**
+   * Compute the gain of all the beam pairs for a channel realization.
+   * If sm is 0, the wideband gain sum_n |G_n|^2 is returned, otherwise the
+   * gain is averaged over the bands of sm, taking into account the cluster
+   * delays as in CalBeamformingGain.
+   * \param params the channel realization
+   * \param txCodebook the codebook of the tx panel
+   * \param rxCodebook the codebook of the rx panel
+   * \param sm the spectrum model, or 0 for the wideband gain
+   * \param gains filled with the gains (linear scale); the gain of the tx
+   *        beam t and the rx beam r is in gains[r * numTxBeams + t]
+   */
+  static void ComputeGains (const Params3gpp &params,
+                            const MmWaveVehicularBeamCodebook &txCodebook,
+                            const MmWaveVehicularBeamCodebook &rxCodebook,
+                            Ptr<const SpectrumModel> sm,
+                            std::vector<double> &gains);
+
+private:
+  Ptr<MmWaveVehicularSpectrumPropagationLossModel> m_splm; //!< provides the channels and the antennas
+  double m_beamResolution; //!< angular resolution of the codebooks in degrees
+  bool m_widebandOnly; //!< if true, the frequency selectivity is neglected
+  uint32_t m_symbolsPerBeamPair; //!< number of OFDM symbols needed to measure a beam pair
+};
+
+} // namespace millicar
+} // namespace ns3
+
+#endif /* MMWAVE_VEHICULAR_BEAM_SWEEP_H */
@@ -0,0 +1,424 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "mmwave-vehicular-channel-trace.h"
+#include "ns3/log.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularChannelTrace");
+
+static const char g_traceMagic[4] = {'M', 'C', 'H', 'T'}; //!< magic number of the header
+static const char g_indexMagic[4] = {'M', 'C', 'H', 'I'}; //!< magic number of the trailer
+static const uint32_t g_traceVersion = 1; //!< version of the format
+static const uint64_t g_headerSize = 16; //!< size of the header in bytes
+static const uint64_t g_trailerSize = 24; //!< size of the trailer in bytes
+static const uint64_t g_indexEntrySize = 24; //!< size of an index entry in bytes
+static const uint64_t g_recordHeaderSize = 68; //!< size of the fixed part of a record in bytes
+
+/**
+ * Write a value in binary form
+ * \param file the output stream
+ * \param value the value
+ * \return the number of written bytes
+ */
+template <class T>
+static uint64_t
+WriteValue (std::ofstream &file, T value)
+{
+  file.write (reinterpret_cast<const char *> (&value), sizeof (T));
+  return sizeof (T);
+}
+
+/**
+ * Read a value in binary form
+ * \param data pointer to the data, advanced past the value
+ * \return the value
+ */
+template <class T>
+static T
+ReadValue (const uint8_t *&data)
+{
+  T value;
+  std::memcpy (&value, data, sizeof (T));
+  data += sizeof (T);
+  return value;
+}
+
+MmWaveVehicularChannelTraceWriter::MmWaveVehicularChannelTraceWriter (std::string fileName)
+  : m_offset (0)
+{
+  NS_LOG_FUNCTION (this << fileName);
+
+  m_file.open (fileName.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!m_file.is_open ())
+    {
+      NS_FATAL_ERROR ("Can't open the channel trace " << fileName);
+    }
+
+  m_file.write (g_traceMagic, 4);
+  m_offset += 4;
+  m_offset += WriteValue<uint32_t> (m_file, g_traceVersion);
+  m_offset += WriteValue<uint64_t> (m_file, 0);
+  NS_ASSERT (m_offset == g_headerSize);
+}
+
+MmWaveVehicularChannelTraceWriter::~MmWaveVehicularChannelTraceWriter ()
+{
+  NS_LOG_FUNCTION (this);
+
+  uint64_t indexOffset = m_offset;
+  for (auto &entry : m_index)
+    {
+      WriteValue<uint32_t> (m_file, entry.m_txId);
+      WriteValue<uint32_t> (m_file, entry.m_rxId);
+      WriteValue<int64_t> (m_file, entry.m_time);
+      WriteValue<uint64_t> (m_file, entry.m_offset);
+    }
+
+  m_file.write (g_indexMagic, 4);
+  WriteValue<uint32_t> (m_file, 0);
+  WriteValue<uint64_t> (m_file, indexOffset);
+  WriteValue<uint64_t> (m_file, m_index.size ());
+  m_file.close ();
+}
+
+void
+MmWaveVehicularChannelTraceWriter::Write (uint32_t txId, uint32_t rxId, Time time, const Params3gpp &params)
+{
+  NS_LOG_FUNCTION (this << txId << rxId << time);
+
+  IndexEntry entry;
+  entry.m_txId = txId;
+  entry.m_rxId = rxId;
+  entry.m_time = time.GetNanoSeconds ();
+  entry.m_offset = m_offset;
+  m_index.push_back (entry);
+
+  uint32_t uSize = params.m_channel.size ();
+  uint32_t sSize = uSize > 0 ? params.m_channel.at (0).size () : 0;
+  uint32_t nSize = sSize > 0 ? params.m_channel.at (0).at (0).size () : 0;
+
+  m_offset += WriteValue<uint32_t> (m_file, txId);
+  m_offset += WriteValue<uint32_t> (m_file, rxId);
+  m_offset += WriteValue<int64_t> (m_file, entry.m_time);
+  m_offset += WriteValue<uint8_t> (m_file, params.m_condition);
+  m_offset += WriteValue<uint8_t> (m_file, params.m_numCluster);
+  m_offset += WriteValue<uint16_t> (m_file, 0);
+  m_offset += WriteValue<uint32_t> (m_file, uSize);
+  m_offset += WriteValue<uint32_t> (m_file, sSize);
+  m_offset += WriteValue<uint32_t> (m_file, nSize);
+  m_offset += WriteValue<uint32_t> (m_file, params.m_delay.size ());
+  for (uint8_t i = 0; i < 4; i++)
+    {
+      m_offset += WriteValue<uint32_t> (m_file, i < params.m_angle.size () ? params.m_angle.at (i).size () : 0);
+    }
+  m_offset += WriteValue<double> (m_file, params.m_tauDelta);
+  m_offset += WriteValue<double> (m_file, params.m_dis3D);
+
+  for (auto delay : params.m_delay)
+    {
+      m_offset += WriteValue<double> (m_file, delay);
+    }
+  for (auto &angles : params.m_angle)
+    {
+      for (auto angle : angles)
+        {
+          m_offset += WriteValue<double> (m_file, angle);
+        }
+    }
+  for (auto &h_u : params.m_channel)
+    {
+      for (auto &h_us : h_u)
+        {
+          NS_ASSERT_MSG (h_us.size () == nSize, "Unexpected channel size");
+          for (auto h : h_us)
+            {
+              m_offset += WriteValue<double> (m_file, h.real ());
+              m_offset += WriteValue<double> (m_file, h.imag ());
+            }
+        }
+    }
+}
+
+MmWaveVehicularChannelTraceReader::MmWaveVehicularChannelTraceReader (std::string fileName)
+  : m_data (0),
+    m_size (0)
+{
+  NS_LOG_FUNCTION (this << fileName);
+
+  int fd = open (fileName.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      NS_FATAL_ERROR ("Can't open the channel trace " << fileName);
+    }
+
+  struct stat st;
+  if (fstat (fd, &st) != 0 || uint64_t (st.st_size) < g_headerSize)
+    {
+      close (fd);
+      NS_FATAL_ERROR ("Invalid channel trace " << fileName);
+    }
+  m_size = st.st_size;
+
+  void *data = mmap (0, m_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd); // the mapping is still valid after closing the descriptor
+  if (data == MAP_FAILED)
+    {
+      NS_FATAL_ERROR ("Can't map the channel trace " << fileName);
+    }
+  m_data = static_cast<const uint8_t *> (data);
+
+  const uint8_t *p = m_data;
+  if (std::memcmp (p, g_traceMagic, 4) != 0)
+    {
+      NS_FATAL_ERROR (fileName << " is not a channel trace");
+    }
+  p += 4;
+  uint32_t version = ReadValue<uint32_t> (p);
+  if (version != g_traceVersion)
+    {
+      NS_FATAL_ERROR ("Unsupported channel trace version " << version);
+    }
+
+  // load the index, if present
+  bool indexFound = false;
+  if (m_size >= g_headerSize + g_trailerSize)
+    {
+      const uint8_t *trailer = m_data + m_size - g_trailerSize;
+      if (std::memcmp (trailer, g_indexMagic, 4) == 0)
+        {
+          trailer += 8;
+          uint64_t indexOffset = ReadValue<uint64_t> (trailer);
+          uint64_t numEntries = ReadValue<uint64_t> (trailer);
+          uint64_t indexEnd = m_size - g_trailerSize;
+          if (indexOffset < g_headerSize || indexOffset > indexEnd
+              || (indexEnd - indexOffset) % g_indexEntrySize != 0
+              || (indexEnd - indexOffset) / g_indexEntrySize != numEntries)
+            {
+              NS_FATAL_ERROR ("Invalid index in channel trace " << fileName);
+            }
+
+          const uint8_t *entry = m_data + indexOffset;
+          for (uint64_t i = 0; i < numEntries; ++i)
+            {
+              uint32_t txId = ReadValue<uint32_t> (entry);
+              uint32_t rxId = ReadValue<uint32_t> (entry);
+              int64_t time = ReadValue<int64_t> (entry);
+              uint64_t offset = ReadValue<uint64_t> (entry);
+
+              // the record has to be stored before the index and match the entry
+              uint64_t size;
+              if (offset < g_headerSize || !GetRecordSize (offset, indexOffset, size))
+                {
+                  NS_FATAL_ERROR ("Invalid offset of index entry " << i << " in channel trace " << fileName);
+                }
+              const uint8_t *record = m_data + offset;
+              if (ReadValue<uint32_t> (record) != txId
+                  || ReadValue<uint32_t> (record) != rxId
+                  || ReadValue<int64_t> (record) != time)
+                {
+                  NS_FATAL_ERROR ("Index entry " << i << " does not match its record in channel trace " << fileName);
+                }
+              m_index[std::make_pair (txId, rxId)].push_back (std::make_pair (time, offset));
+            }
+          indexFound = true;
+        }
+    }
+
+  if (!indexFound)
+    {
+      NS_LOG_WARN ("Index not found in " << fileName << ", scanning the records");
+      ScanRecords (m_size);
+    }
+
+  // the records of each link are sorted by generation time
+  for (auto &link : m_index)
+    {
+      std::stable_sort (link.second.begin (), link.second.end (),
+                        [] (const std::pair<int64_t, uint64_t> &l, const std::pair<int64_t, uint64_t> &r)
+                        {
+                          return l.first < r.first;
+                        });
+    }
+}
+
+MmWaveVehicularChannelTraceReader::~MmWaveVehicularChannelTraceReader ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_data)
+    {
+      munmap (const_cast<uint8_t *> (m_data), m_size);
+    }
+}
+
+void
+MmWaveVehicularChannelTraceReader::ScanRecords (uint64_t end)
+{
+  NS_LOG_FUNCTION (this << end);
+
+  uint64_t offset = g_headerSize;
+  while (offset < end)
+    {
+      uint64_t size;
+      if (!GetRecordSize (offset, end, size))
+        {
+          NS_LOG_WARN ("Truncated record at offset " << offset);
+          break;
+        }
+
+      const uint8_t *p = m_data + offset;
+      uint32_t txId = ReadValue<uint32_t> (p);
+      uint32_t rxId = ReadValue<uint32_t> (p);
+      int64_t time = ReadValue<int64_t> (p);
+      m_index[std::make_pair (txId, rxId)].push_back (std::make_pair (time, offset));
+      offset += size;
+    }
+}
+
+bool
+MmWaveVehicularChannelTraceReader::GetRecordSize (uint64_t offset, uint64_t end, uint64_t &size) const
+{
+  if (offset > end || end - offset < g_recordHeaderSize)
+    {
+      return false;
+    }
+
+  const uint8_t *p = m_data + offset + 20; // skip to the sizes
+  uint32_t uSize = ReadValue<uint32_t> (p);
+  uint32_t sSize = ReadValue<uint32_t> (p);
+  uint32_t nSize = ReadValue<uint32_t> (p);
+  uint64_t numValues = ReadValue<uint32_t> (p);
+  for (uint8_t i = 0; i < 4; i++)
+    {
+      numValues += ReadValue<uint32_t> (p);
+    }
+
+  // the sizes are checked against the available space before computing
+  // the size of the channel matrix, which may overflow
+  uint64_t maxValues = (end - offset - g_recordHeaderSize) / sizeof (double);
+  if (numValues > maxValues)
+    {
+      return false;
+    }
+  uint64_t usSize = uint64_t (uSize) * sSize;
+  if (usSize > 0 && nSize > 0 && usSize > (maxValues - numValues) / 2 / nSize)
+    {
+      return false;
+    }
+  numValues += 2 * usSize * nSize;
+  size = g_recordHeaderSize + sizeof (double) * numValues;
+  return true;
+}
+
+Ptr<Params3gpp>
+MmWaveVehicularChannelTraceReader::Decode (uint64_t offset) const
+{
+  const uint8_t *p = m_data + offset;
+  p += 16; // skip the node IDs and the generation time
+  Ptr<Params3gpp> params = Create<Params3gpp> ();
+  params->m_condition = ReadValue<uint8_t> (p);
+  params->m_numCluster = ReadValue<uint8_t> (p);
+  p += 2;
+  uint32_t uSize = ReadValue<uint32_t> (p);
+  uint32_t sSize = ReadValue<uint32_t> (p);
+  uint32_t nSize = ReadValue<uint32_t> (p);
+  uint32_t numDelays = ReadValue<uint32_t> (p);
+  uint32_t numAngles[4];
+  for (uint8_t i = 0; i < 4; i++)
+    {
+      numAngles[i] = ReadValue<uint32_t> (p);
+    }
+  params->m_tauDelta = ReadValue<double> (p);
+  params->m_dis3D = ReadValue<double> (p);
+
+  params->m_delay.resize (numDelays);
+  for (auto &delay : params->m_delay)
+    {
+      delay = ReadValue<double> (p);
+    }
+  params->m_angle.resize (4);
+  for (uint8_t i = 0; i < 4; i++)
+    {
+      params->m_angle.at (i).resize (numAngles[i]);
+      for (auto &angle : params->m_angle.at (i))
+        {
+          angle = ReadValue<double> (p);
+        }
+    }
+  params->m_channel.resize (uSize, complex2DVector_t (sSize, complexVector_t (nSize)));
+  for (auto &h_u : params->m_channel)
+    {
+      for (auto &h_us : h_u)
+        {
+          for (auto &h : h_us)
+            {
+              double re = ReadValue<double> (p);
+              double im = ReadValue<double> (p);
+              h = std::complex<double> (re, im);
+            }
+        }
+    }
+  return params;
+}
+
+Ptr<Params3gpp>
+MmWaveVehicularChannelTraceReader::Read (uint32_t txId, uint32_t rxId, Time time, bool &reverse) const
+{
+  NS_LOG_FUNCTION (this << txId << rxId << time);
+
+  reverse = false;
+  auto it = m_index.find (std::make_pair (txId, rxId));
+  if (it == m_index.end ())
+    {
+      reverse = true;
+      it = m_index.find (std::make_pair (rxId, txId));
+      if (it == m_index.end ())
+        {
+          return 0;
+        }
+    }
+
+  // find the latest realization not more recent than time
+  const RecordList_t &records = it->second;
+  auto rec = std::upper_bound (records.begin (), records.end (), time.GetNanoSeconds (),
+                               [] (int64_t t, const std::pair<int64_t, uint64_t> &r)
+                               {
+                                 return t < r.first;
+                               });
+  if (rec != records.begin ())
+    {
+      --rec;
+    }
+
+  Ptr<Params3gpp> params = Decode (rec->second);
+  params->m_generatedTime = time;
+  return params;
+}
+
+} // namespace millicar
+} // namespace ns3
@@ -0,0 +1,168 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MMWAVE_VEHICULAR_CHANNEL_TRACE_H
+#define MMWAVE_VEHICULAR_CHANNEL_TRACE_H
+
+#include "ns3/mmwave-vehicular-spectrum-propagation-loss-model.h"
+#include "ns3/nstime.h"
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+namespace millicar {
+
+/*
+ * A channel trace is a binary file (native byte order) with the following
+ * structure:
+ * - a header, containing the magic number "MCHT" and the format version;
+ * - a sequence of records, each one storing a channel realization;
+ * - an index, with an entry for each record;
+ * - a trailer, containing the magic number "MCHI", the offset of the index
+ *   and the number of entries.
+ * Records are only appended, and the index is written when the writer is
+ * destroyed. If the index is missing (e.g., the recording was interrupted),
+ * the reader rebuilds it by scanning the records.
+ *
+ * Each record contains:
+ * uint32 txId, uint32 rxId, int64 time (ns), uint8 condition,
+ * uint8 numCluster, uint16 reserved, uint32 U, uint32 S, uint32 N,
+ * uint32 numDelays, uint32 numAngles[4], double tauDelta, double dis3D,
+ * double delay[numDelays], double angle[4][numAngles[i]],
+ * double channel[U][S][N][2] (real and imaginary parts)
+ */
+
+/**
+ * \ingroup millicar
+ * Appends the channel realizations generated by the
+ * MmWaveVehicularSpectrumPropagationLossModel to a channel trace
+ */
+class MmWaveVehicularChannelTraceWriter : public SimpleRefCount<MmWaveVehicularChannelTraceWriter>
+{
+public:
+  /**
+   * Constructor, creates the file
+   * \param fileName the name of the trace file
+   */
+  MmWaveVehicularChannelTraceWriter (std::string fileName);
+
+  /**
+   * Destructor, writes the index and closes the file
+   */
+  ~MmWaveVehicularChannelTraceWriter ();
+
+  /**
+   * Append a channel realization
+   * \param txId the ID of the tx node
+   * \param rxId the ID of the rx node
+   * \param time the time at which the realization has been generated
+   * \param params the channel realization
+   */
+  void Write (uint32_t txId, uint32_t rxId, Time time, const Params3gpp &params);
+
+private:
+  /**
+   * Entry of the index
+   */
+  struct IndexEntry
+  {
+    uint32_t m_txId; //!< ID of the tx node
+    uint32_t m_rxId; //!< ID of the rx node
+    int64_t m_time; //!< generation time in ns
+    uint64_t m_offset; //!< offset of the record in the file
+  };
+
+  std::ofstream m_file; //!< the trace file
+  uint64_t m_offset; //!< current offset in the file
+  std::vector<IndexEntry> m_index; //!< the index of the records
+};
+
+/**
+ * \ingroup millicar
+ * Reads the channel realizations from a channel trace. The file is mapped in
+ * memory in read only mode, hence the same trace can be shared by multiple
+ * processes and only the records which are actually used are read from disk.
+ */
+class MmWaveVehicularChannelTraceReader : public SimpleRefCount<MmWaveVehicularChannelTraceReader>
+{
+public:
+  /**
+   * Constructor, maps the file in memory and loads the index
+   * \param fileName the name of the trace file
+   */
+  MmWaveVehicularChannelTraceReader (std::string fileName);
+
+  /**
+   * Destructor, unmaps the file
+   */
+  ~MmWaveVehicularChannelTraceReader ();
+
+  /**
+   * Returns the realization of the link (txId, rxId) with the latest
+   * generation time not greater than time. If all the realizations of the
+   * link are more recent, the oldest one is returned. If the link is not in
+   * the trace, the realization of the reverse link (rxId, txId) is returned
+   * as it was recorded, i.e., with rxId as transmitter.
+   * \param txId the ID of the tx node
+   * \param rxId the ID of the rx node
+   * \param time the current time
+   * \param reverse set to true if the realization of the reverse link is returned
+   * \return the channel realization, or 0 if the link is not in the trace
+   */
+  Ptr<Params3gpp> Read (uint32_t txId, uint32_t rxId, Time time, bool &reverse) const;
+
+private:
+  /**
+   * Build the index by scanning the records
+   * \param end offset of the end of the records
+   */
+  void ScanRecords (uint64_t end);
+
+  /**
+   * Computes the size of the record at the given offset
+   * \param offset offset of the record
+   * \param end offset of the end of the records
+   * \param size the size of the record in bytes
+   * \return false if the record does not fit before end
+   */
+  bool GetRecordSize (uint64_t offset, uint64_t end, uint64_t &size) const;
+
+  /**
+   * Decode the record at the given offset, which has been validated when
+   * the index was loaded
+   * \param offset offset of the record
+   * \return the channel realization
+   */
+  Ptr<Params3gpp> Decode (uint64_t offset) const;
+
+  typedef std::pair<uint32_t, uint32_t> LinkId_t; //!< (tx node ID, rx node ID)
+  typedef std::vector<std::pair<int64_t, uint64_t> > RecordList_t; //!< (generation time, offset) sorted by time
+
+  const uint8_t *m_data; //!< the mapped file
+  uint64_t m_size; //!< the size of the mapped file
+  std::map<LinkId_t, RecordList_t> m_index; //!< the records of each link
+};
+
+} // namespace millicar
+} // namespace ns3
+
+#endif /* MMWAVE_VEHICULAR_CHANNEL_TRACE_H */
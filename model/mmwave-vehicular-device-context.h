@@ -0,0 +1,51 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MMWAVE_VEHICULAR_DEVICE_CONTEXT_H
+#define MMWAVE_VEHICULAR_DEVICE_CONTEXT_H
+
+#include "ns3/simple-ref-count.h"
+#include "ns3/net-device.h"
+#include "ns3/mobility-model.h"
+#include "ns3/mmwave-vehicular-antenna-array-model.h"
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * \ingroup millicar
+ * Per-device quantities which do not change during the simulation. The
+ * context is created once when the device is installed, and it is used by
+ * the PHY and by the propagation models to avoid the lookup of the RNTI,
+ * of the antenna and of the mobility model for every signal.
+ */
+struct MmWaveVehicularDeviceContext : public SimpleRefCount<MmWaveVehicularDeviceContext>
+{
+  Ptr<NetDevice> m_device; //!< the device
+  uint16_t m_rnti {0}; //!< the RNTI of the device
+  uint32_t m_index {0}; //!< dense index of the device, allocated by the MmWaveVehicularSpectrumPropagationLossModel in order of registration
+  Ptr<MmWaveVehicularAntennaArrayModel> m_antenna; //!< the antenna array of the device
+  Ptr<MobilityModel> m_mobility; //!< the mobility model of the node
+};
+
+} // namespace millicar
+} // namespace ns3
+
+#endif /* MMWAVE_VEHICULAR_DEVICE_CONTEXT_H */
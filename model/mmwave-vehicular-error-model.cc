@@ -0,0 +1,299 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "mmwave-vehicular-error-model.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/mmwave-mi-error-model.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularErrorModel");
+
+NS_OBJECT_ENSURE_REGISTERED (MmWaveVehicularErrorModel);
+NS_OBJECT_ENSURE_REGISTERED (MmWaveVehicularMiErrorModel);
+NS_OBJECT_ENSURE_REGISTERED (MmWaveVehicularLutErrorModel);
+
+static const uint8_t MAX_MCS = 28; //!< highest MCS supported by the mmwave error model
+
+MmWaveVehicularErrorModel::MmWaveVehicularErrorModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+MmWaveVehicularErrorModel::~MmWaveVehicularErrorModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+MmWaveVehicularErrorModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MmWaveVehicularErrorModel")
+    .SetParent<Object> ()
+  ;
+  return tid;
+}
+
+double
+MmWaveVehicularErrorModel::GetTbler (double sinr, uint32_t size, uint8_t mcs)
+{
+  static Ptr<SpectrumModel> sm = Create<SpectrumModel> (std::vector<double> (1, 0.0));
+  SpectrumValue flat (sm);
+  flat[0] = sinr;
+  return GetTbler (flat, std::vector<int> (1, 0), size, mcs);
+}
+
+MmWaveVehicularMiErrorModel::MmWaveVehicularMiErrorModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+MmWaveVehicularMiErrorModel::~MmWaveVehicularMiErrorModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+MmWaveVehicularMiErrorModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MmWaveVehicularMiErrorModel")
+    .SetParent<MmWaveVehicularErrorModel> ()
+    .AddConstructor<MmWaveVehicularMiErrorModel> ()
+  ;
+  return tid;
+}
+
+double
+MmWaveVehicularMiErrorModel::GetTbler (const SpectrumValue &sinr, const std::vector<int> &rbBitmap,
+                                       uint32_t size, uint8_t mcs)
+{
+  // Here we need to initialize an empty harqInfoList since it is mandatory input
+  // for the method. Since the vector is empty, no harq procedures are triggeres (as we want)
+  std::vector <mmwave::MmWaveHarqProcessInfoElement_t> harqInfoList;
+  mmwave::MmWaveTbStats_t tbStats = mmwave::MmWaveMiErrorModel::GetTbDecodificationStats (sinr, rbBitmap, size, mcs, harqInfoList);
+  return tbStats.tbler;
+}
+
+MmWaveVehicularLutErrorModel::MmWaveVehicularLutErrorModel ()
+  : m_gridSize (0),
+    m_tables (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+MmWaveVehicularLutErrorModel::~MmWaveVehicularLutErrorModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+MmWaveVehicularLutErrorModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MmWaveVehicularLutErrorModel")
+    .SetParent<MmWaveVehicularErrorModel> ()
+    .AddConstructor<MmWaveVehicularLutErrorModel> ()
+    .AddAttribute ("MinSinr",
+                   "Lowest SINR of the tables in dB, below which the error rate is the one of the lowest SINR",
+                   DoubleValue (-10),
+                   MakeDoubleAccessor (&MmWaveVehicularLutErrorModel::m_minSinr),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("MaxSinr",
+                   "Highest SINR of the tables in dB, above which the error rate is the one of the highest SINR",
+                   DoubleValue (30),
+                   MakeDoubleAccessor (&MmWaveVehicularLutErrorModel::m_maxSinr),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("SinrStep",
+                   "Step of the SINR grid of the tables in dB",
+                   DoubleValue (0.25),
+                   MakeDoubleAccessor (&MmWaveVehicularLutErrorModel::m_sinrStep),
+                   MakeDoubleChecker<double> (0.01))
+  ;
+  return tid;
+}
+
+void
+MmWaveVehicularLutErrorModel::InitializeTables ()
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_maxSinr > m_minSinr, "The highest SINR must be greater than the lowest one");
+
+  // the tables are filled with the mmwave error model and do not depend on
+  // the instance, hence they are shared by all the instances with the same grid
+  static std::map<Grid_t, std::vector<McsTables> > tables;
+
+  m_gridSize = std::ceil ((m_maxSinr - m_minSinr) / m_sinrStep) + 1;
+  Grid_t grid = std::make_tuple (m_minSinr, m_maxSinr, m_sinrStep);
+  auto it = tables.find (grid);
+  if (it == tables.end ())
+    {
+      it = tables.insert (std::make_pair (grid, std::vector<McsTables> (MAX_MCS + 1))).first;
+    }
+  m_tables = &it->second;
+}
+
+MmWaveVehicularLutErrorModel::McsTables &
+MmWaveVehicularLutErrorModel::GetTables (uint8_t mcs)
+{
+  NS_ASSERT_MSG (mcs <= MAX_MCS, "Unsupported MCS " << (uint16_t) mcs);
+  if (m_tables == 0)
+    {
+      InitializeTables ();
+    }
+
+  McsTables &tables = m_tables->at (mcs);
+  if (tables.m_mib.empty ())
+    {
+      NS_LOG_LOGIC ("Fill the mutual information table of MCS " << (uint16_t) mcs);
+      Ptr<SpectrumModel> sm = Create<SpectrumModel> (std::vector<double> (1, 0.0));
+      SpectrumValue flat (sm);
+      std::vector<int> map (1, 0);
+      tables.m_mib.resize (m_gridSize);
+      for (uint32_t k = 0; k < m_gridSize; k++)
+        {
+          flat[0] = std::pow (10.0, (m_minSinr + k * m_sinrStep) / 10);
+          tables.m_mib[k] = mmwave::MmWaveMiErrorModel::Mib (flat, map, mcs);
+          if (k > 0)
+            {
+              // guard the search against numerical noise
+              tables.m_mib[k] = std::max (tables.m_mib[k], tables.m_mib[k - 1]);
+            }
+        }
+    }
+  return tables;
+}
+
+const std::vector<double> &
+MmWaveVehicularLutErrorModel::GetTblerTable (McsTables &tables, uint8_t mcs, uint8_t sizeClass)
+{
+  auto it = tables.m_tbler.find (sizeClass);
+  if (it != tables.m_tbler.end ())
+    {
+      return it->second;
+    }
+
+  // the class is represented by the size halfway between its two powers of two
+  uint32_t size = std::ldexp (1.5, sizeClass);
+  NS_LOG_LOGIC ("Fill the error rate table of MCS " << (uint16_t) mcs << " size " << size);
+
+  Ptr<SpectrumModel> sm = Create<SpectrumModel> (std::vector<double> (1, 0.0));
+  SpectrumValue flat (sm);
+  std::vector<int> map (1, 0);
+  std::vector <mmwave::MmWaveHarqProcessInfoElement_t> harqInfoList;
+  std::vector<double> &tbler = tables.m_tbler[sizeClass];
+  tbler.resize (m_gridSize);
+  for (uint32_t k = 0; k < m_gridSize; k++)
+    {
+      flat[0] = std::pow (10.0, (m_minSinr + k * m_sinrStep) / 10);
+      tbler[k] = mmwave::MmWaveMiErrorModel::GetTbDecodificationStats (flat, map, size, mcs, harqInfoList).tbler;
+    }
+  return tbler;
+}
+
+double
+MmWaveVehicularLutErrorModel::GetGridPosition (double sinrDb) const
+{
+  double position = (sinrDb - m_minSinr) / m_sinrStep;
+  return std::min (std::max (position, 0.0), double (m_gridSize - 1));
+}
+
+double
+MmWaveVehicularLutErrorModel::FindMib (const std::vector<double> &mib, double value) const
+{
+  auto it = std::lower_bound (mib.begin (), mib.end (), value);
+  if (it == mib.begin ())
+    {
+      return 0;
+    }
+  if (it == mib.end ())
+    {
+      return mib.size () - 1;
+    }
+  uint32_t k = it - mib.begin ();
+  double delta = mib[k] - mib[k - 1];
+  return delta > 0 ? k - 1 + (value - mib[k - 1]) / delta : k;
+}
+
+double
+MmWaveVehicularLutErrorModel::Interpolate (const std::vector<double> &table, double position)
+{
+  uint32_t k = position;
+  if (k + 1 >= table.size ())
+    {
+      return table.back ();
+    }
+  double frac = position - k;
+  return table[k] + frac * (table[k + 1] - table[k]);
+}
+
+double
+MmWaveVehicularLutErrorModel::GetEffectivePosition (const McsTables &tables, const SpectrumValue &sinr,
+                                                    const std::vector<int> &rbBitmap) const
+{
+  NS_ASSERT_MSG (!rbBitmap.empty (), "The transport block does not use any resource block");
+
+  // the tabulated mutual information is averaged over the resource blocks
+  // and mapped back to the position of the effective SINR on the grid
+  double mib = 0;
+  for (int rb : rbBitmap)
+    {
+      mib += Interpolate (tables.m_mib, GetGridPosition (10 * std::log10 (sinr[rb])));
+    }
+  mib /= rbBitmap.size ();
+  return FindMib (tables.m_mib, mib);
+}
+
+double
+MmWaveVehicularLutErrorModel::GetEffectiveSinrDb (const SpectrumValue &sinr, const std::vector<int> &rbBitmap, uint8_t mcs)
+{
+  return m_minSinr + GetEffectivePosition (GetTables (mcs), sinr, rbBitmap) * m_sinrStep;
+}
+
+double
+MmWaveVehicularLutErrorModel::GetTbler (const SpectrumValue &sinr, const std::vector<int> &rbBitmap,
+                                        uint32_t size, uint8_t mcs)
+{
+  NS_LOG_FUNCTION (this << size << (uint16_t) mcs);
+  NS_ASSERT_MSG (size > 0, "Empty transport block");
+  McsTables &tables = GetTables (mcs);
+  double position = GetEffectivePosition (tables, sinr, rbBitmap);
+
+  uint8_t sizeClass = std::ilogb (size);
+  double tbler = Interpolate (GetTblerTable (tables, mcs, sizeClass), position);
+  NS_LOG_DEBUG ("Effective SINR " << m_minSinr + position * m_sinrStep << " dB MCS " << (uint16_t) mcs
+                                  << " size " << size << " TBLER " << tbler);
+  return tbler;
+}
+
+double
+MmWaveVehicularLutErrorModel::GetTbler (double sinr, uint32_t size, uint8_t mcs)
+{
+  NS_LOG_FUNCTION (this << sinr << size << (uint16_t) mcs);
+  NS_ASSERT_MSG (size > 0, "Empty transport block");
+  McsTables &tables = GetTables (mcs);
+  uint8_t sizeClass = std::ilogb (size);
+  return Interpolate (GetTblerTable (tables, mcs, sizeClass), GetGridPosition (10 * std::log10 (sinr)));
+}
+
+} // namespace millicar
+} // namespace ns3
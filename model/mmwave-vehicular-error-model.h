@@ -0,0 +1,228 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MMWAVE_VEHICULAR_ERROR_MODEL_H
+#define MMWAVE_VEHICULAR_ERROR_MODEL_H
+
+#include "ns3/object.h"
+#include "ns3/spectrum-value.h"
+#include <vector>
+#include <map>
+#include <tuple>
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * \ingroup millicar
+ * Computes the error probability of the transport blocks received by the
+ * sidelink devices
+ */
+class MmWaveVehicularErrorModel : public Object
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularErrorModel ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularErrorModel ();
+
+  // inherited from Object
+  static TypeId GetTypeId (void);
+
+  /**
+   * Returns the error probability of a transport block
+   * \param sinr the SINR perceived in each resource block
+   * \param rbBitmap the resource blocks used by the transport block
+   * \param size the size of the transport block in bytes
+   * \param mcs the MCS of the transport block
+   * \return the transport block error rate
+   */
+  virtual double GetTbler (const SpectrumValue &sinr, const std::vector<int> &rbBitmap,
+                           uint32_t size, uint8_t mcs) = 0;
+
+  /**
+   * Returns the error probability of a transport block received with the
+   * same SINR in all its resource blocks, i.e., over an AWGN channel
+   * \param sinr the SINR (linear scale)
+   * \param size the size of the transport block in bytes
+   * \param mcs the MCS of the transport block
+   * \return the transport block error rate
+   */
+  virtual double GetTbler (double sinr, uint32_t size, uint8_t mcs);
+};
+
+/**
+ * \ingroup millicar
+ * Wrapper of the MIESM error model of the mmwave module, which maps the SINR
+ * of each resource block to the mutual information and computes the error
+ * rate of each code block
+ */
+class MmWaveVehicularMiErrorModel : public MmWaveVehicularErrorModel
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularMiErrorModel ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularMiErrorModel ();
+
+  // inherited from Object
+  static TypeId GetTypeId (void);
+
+  // inherited from MmWaveVehicularErrorModel
+  using MmWaveVehicularErrorModel::GetTbler;
+  double GetTbler (const SpectrumValue &sinr, const std::vector<int> &rbBitmap,
+                   uint32_t size, uint8_t mcs) override;
+};
+
+/**
+ * \ingroup millicar
+ * Approximation of the MmWaveVehicularMiErrorModel based on lookup tables.
+ * For each MCS, the mutual information per bit and the error rate are
+ * tabulated over a uniform grid of SINR values, the latter for each class of
+ * transport block sizes (the sizes between two consecutive powers of two).
+ * The tables are filled the first time an MCS or a size class is used, with
+ * the values returned by the mmwave error model for a flat SINR.
+ * A transport block is then decoded by averaging the tabulated mutual
+ * information over its resource blocks, by mapping the average back to the
+ * effective SINR and by interpolating the error rate at the effective SINR.
+ * The tables are shared by all the instances with the same grid.
+ */
+class MmWaveVehicularLutErrorModel : public MmWaveVehicularErrorModel
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularLutErrorModel ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularLutErrorModel ();
+
+  // inherited from Object
+  static TypeId GetTypeId (void);
+
+  // inherited from MmWaveVehicularErrorModel
+  double GetTbler (const SpectrumValue &sinr, const std::vector<int> &rbBitmap,
+                   uint32_t size, uint8_t mcs) override;
+  double GetTbler (double sinr, uint32_t size, uint8_t mcs) override;
+
+  /**
+   * Returns the effective SINR of a transport block, i.e., the flat SINR
+   * with the same average mutual information
+   * \param sinr the SINR perceived in each resource block
+   * \param rbBitmap the resource blocks used by the transport block
+   * \param mcs the MCS of the transport block
+   * \return the effective SINR in dB
+   */
+  double GetEffectiveSinrDb (const SpectrumValue &sinr, const std::vector<int> &rbBitmap, uint8_t mcs);
+
+private:
+  /**
+   * Tables of a MCS
+   */
+  struct McsTables
+  {
+    std::vector<double> m_mib; //!< mutual information per bit for each SINR of the grid, non decreasing
+    std::map<uint8_t, std::vector<double> > m_tbler; //!< error rate for each SINR of the grid, for each size class
+  };
+
+  typedef std::tuple<double, double, double> Grid_t; //!< minimum, maximum and step of the SINR grid, in dB
+
+  /**
+   * Look up the tables shared by the instances with the same grid
+   */
+  void InitializeTables ();
+
+  /**
+   * Returns the tables of a MCS, filling the mutual information table if
+   * needed
+   * \param mcs the MCS
+   * \return the tables
+   */
+  McsTables & GetTables (uint8_t mcs);
+
+  /**
+   * Returns the error rate table of a MCS and a size class, filling it if
+   * needed
+   * \param tables the tables of the MCS
+   * \param mcs the MCS
+   * \param sizeClass the size class, i.e., floor (log2 (size))
+   * \return the error rate table
+   */
+  const std::vector<double> & GetTblerTable (McsTables &tables, uint8_t mcs, uint8_t sizeClass);
+
+  /**
+   * Returns the position on the SINR grid of the effective SINR of a
+   * transport block
+   * \param tables the tables of the MCS
+   * \param sinr the SINR perceived in each resource block
+   * \param rbBitmap the resource blocks used by the transport block
+   * \return the fractional index of the grid
+   */
+  double GetEffectivePosition (const McsTables &tables, const SpectrumValue &sinr,
+                               const std::vector<int> &rbBitmap) const;
+
+  /**
+   * Returns the position on the SINR grid of a value of the mutual
+   * information
+   * \param mib the mutual information table
+   * \param value the mutual information per bit
+   * \return the fractional index of the grid
+   */
+  double FindMib (const std::vector<double> &mib, double value) const;
+
+  /**
+   * Returns the fractional index of the grid corresponding to a SINR
+   * \param sinrDb the SINR in dB
+   * \return the fractional index, clamped to the grid
+   */
+  double GetGridPosition (double sinrDb) const;
+
+  /**
+   * Linear interpolation of a table
+   * \param table the table
+   * \param position the fractional index of the grid
+   * \return the interpolated value
+   */
+  static double Interpolate (const std::vector<double> &table, double position);
+
+  double m_minSinr; //!< lowest SINR of the grid in dB
+  double m_maxSinr; //!< highest SINR of the grid in dB
+  double m_sinrStep; //!< step of the grid in dB
+  uint32_t m_gridSize; //!< number of points of the grid
+  std::vector<McsTables> *m_tables; //!< the tables for this grid, indexed by MCS
+};
+
+} // namespace millicar
+} // namespace ns3
+
+#endif /* MMWAVE_VEHICULAR_ERROR_MODEL_H */
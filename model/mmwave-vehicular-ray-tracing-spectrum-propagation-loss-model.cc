@@ -0,0 +1,474 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "mmwave-vehicular-ray-tracing-spectrum-propagation-loss-model.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/boolean.h"
+#include "ns3/nstime.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularRayTracingSpectrumPropagationLossModel");
+
+NS_OBJECT_ENSURE_REGISTERED (MmWaveVehicularRayTracingSpectrumPropagationLossModel);
+
+static const char g_rayTracingMagic[4] = {'M', 'R', 'T', 'X'}; //!< magic number of the header
+static const uint32_t g_rayTracingVersion = 1; //!< version of the format
+static const uint64_t g_headerSize = 16; //!< size of the header in bytes
+static const uint64_t g_linkEntrySize = 24; //!< size of an entry of the link table in bytes
+static const uint64_t g_stepEntrySize = 24; //!< size of an entry of the step table in bytes
+static const uint64_t g_pathSize = 7 * sizeof (double); //!< size of a path in bytes
+
+/**
+ * Read a value in binary form
+ * \param data pointer to the data, advanced past the value
+ * \return the value
+ */
+template <class T>
+static T
+ReadValue (const uint8_t *&data)
+{
+  T value;
+  std::memcpy (&value, data, sizeof (T));
+  data += sizeof (T);
+  return value;
+}
+
+/**
+ * Interpolate two angles along the shortest arc
+ * \param a the first angle
+ * \param b the second angle
+ * \param w the weight of the second angle
+ * \param period the period of the angles
+ * \return the interpolated angle
+ */
+static double
+InterpolateAngle (double a, double b, double w, double period)
+{
+  double diff = std::fmod (b - a, period);
+  if (diff > period / 2)
+    {
+      diff -= period;
+    }
+  else if (diff < -period / 2)
+    {
+      diff += period;
+    }
+  return a + w * diff;
+}
+
+MmWaveVehicularRayTracingData::MmWaveVehicularRayTracingData (std::string fileName)
+  : m_data (0),
+    m_size (0)
+{
+  NS_LOG_FUNCTION (this << fileName);
+
+  int fd = open (fileName.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      NS_FATAL_ERROR ("Can't open the ray tracing file " << fileName);
+    }
+
+  struct stat st;
+  if (fstat (fd, &st) != 0 || uint64_t (st.st_size) < g_headerSize)
+    {
+      close (fd);
+      NS_FATAL_ERROR ("Invalid ray tracing file " << fileName);
+    }
+  m_size = st.st_size;
+
+  void *data = mmap (0, m_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd); // the mapping is still valid after closing the descriptor
+  if (data == MAP_FAILED)
+    {
+      NS_FATAL_ERROR ("Can't map the ray tracing file " << fileName);
+    }
+  m_data = static_cast<const uint8_t *> (data);
+
+  const uint8_t *p = m_data;
+  if (std::memcmp (p, g_rayTracingMagic, 4) != 0)
+    {
+      NS_FATAL_ERROR (fileName << " is not a ray tracing file");
+    }
+  p += 4;
+  uint32_t version = ReadValue<uint32_t> (p);
+  if (version != g_rayTracingVersion)
+    {
+      NS_FATAL_ERROR ("Unsupported ray tracing file version " << version);
+    }
+  uint32_t numLinks = ReadValue<uint32_t> (p);
+  p += 4;
+
+  if (g_headerSize + numLinks * g_linkEntrySize > m_size)
+    {
+      NS_FATAL_ERROR ("Truncated link table in " << fileName);
+    }
+  for (uint32_t i = 0; i < numLinks; ++i)
+    {
+      uint32_t txId = ReadValue<uint32_t> (p);
+      uint32_t rxId = ReadValue<uint32_t> (p);
+      LinkEntry link;
+      link.m_numSteps = ReadValue<uint32_t> (p);
+      p += 4;
+      link.m_stepOffset = ReadValue<uint64_t> (p);
+      if (link.m_numSteps == 0 || link.m_stepOffset + link.m_numSteps * g_stepEntrySize > m_size)
+        {
+          NS_FATAL_ERROR ("Invalid step table for the link between node " << txId << " and node " << rxId);
+        }
+      m_links[std::make_pair (txId, rxId)] = link;
+    }
+  NS_LOG_INFO ("Loaded " << numLinks << " links from " << fileName);
+}
+
+MmWaveVehicularRayTracingData::~MmWaveVehicularRayTracingData ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_data)
+    {
+      munmap (const_cast<uint8_t *> (m_data), m_size);
+    }
+}
+
+int64_t
+MmWaveVehicularRayTracingData::GetStepTime (const LinkEntry &link, uint32_t step) const
+{
+  const uint8_t *p = m_data + link.m_stepOffset + step * g_stepEntrySize;
+  return ReadValue<int64_t> (p);
+}
+
+void
+MmWaveVehicularRayTracingData::ReadStep (const LinkEntry &link, uint32_t step, std::vector<MmWaveVehicularRayPath> &paths) const
+{
+  const uint8_t *p = m_data + link.m_stepOffset + step * g_stepEntrySize + 8;
+  uint32_t numPaths = ReadValue<uint32_t> (p);
+  p += 4;
+  uint64_t pathOffset = ReadValue<uint64_t> (p);
+  NS_ABORT_MSG_IF (pathOffset + numPaths * g_pathSize > m_size, "Truncated step at offset " << pathOffset);
+
+  paths.resize (numPaths);
+  p = m_data + pathOffset;
+  for (auto &path : paths)
+    {
+      path.m_delay = ReadValue<double> (p);
+      path.m_power = ReadValue<double> (p);
+      path.m_phase = ReadValue<double> (p);
+      path.m_aoa = ReadValue<double> (p);
+      path.m_zoa = ReadValue<double> (p);
+      path.m_aod = ReadValue<double> (p);
+      path.m_zod = ReadValue<double> (p);
+    }
+}
+
+bool
+MmWaveVehicularRayTracingData::GetPaths (uint32_t txId, uint32_t rxId, Time time,
+                                         std::vector<MmWaveVehicularRayPath> &paths, Time &stepTime) const
+{
+  NS_LOG_FUNCTION (this << txId << rxId << time);
+
+  bool reverse = false;
+  auto it = m_links.find (std::make_pair (txId, rxId));
+  if (it == m_links.end ())
+    {
+      it = m_links.find (std::make_pair (rxId, txId));
+      if (it == m_links.end ())
+        {
+          return false;
+        }
+      reverse = true;
+    }
+  const LinkEntry &link = it->second;
+
+  // find the last step not more recent than time
+  int64_t t = time.GetNanoSeconds ();
+  uint32_t low = 0;
+  uint32_t high = link.m_numSteps;
+  while (low < high)
+    {
+      uint32_t mid = low + (high - low) / 2;
+      if (GetStepTime (link, mid) <= t)
+        {
+          low = mid + 1;
+        }
+      else
+        {
+          high = mid;
+        }
+    }
+  uint32_t step = low > 0 ? low - 1 : 0;
+
+  int64_t t0 = GetStepTime (link, step);
+  ReadStep (link, step, paths);
+  stepTime = NanoSeconds (t0);
+
+  if (t > t0 && step + 1 < link.m_numSteps)
+    {
+      std::vector<MmWaveVehicularRayPath> next;
+      ReadStep (link, step + 1, next);
+      if (next.size () == paths.size ())
+        {
+          double w = double (t - t0) / (GetStepTime (link, step + 1) - t0);
+          for (uint32_t i = 0; i < paths.size (); ++i)
+            {
+              MmWaveVehicularRayPath &path = paths.at (i);
+              path.m_delay += w * (next.at (i).m_delay - path.m_delay);
+              path.m_power += w * (next.at (i).m_power - path.m_power);
+              path.m_aoa = InterpolateAngle (path.m_aoa, next.at (i).m_aoa, w, 360);
+              path.m_zoa += w * (next.at (i).m_zoa - path.m_zoa);
+              path.m_aod = InterpolateAngle (path.m_aod, next.at (i).m_aod, w, 360);
+              path.m_zod += w * (next.at (i).m_zod - path.m_zod);
+            }
+        }
+    }
+
+  if (reverse)
+    {
+      for (auto &path : paths)
+        {
+          std::swap (path.m_aoa, path.m_aod);
+          std::swap (path.m_zoa, path.m_zod);
+        }
+    }
+
+  return true;
+}
+
+MmWaveVehicularRayTracingSpectrumPropagationLossModel::MmWaveVehicularRayTracingSpectrumPropagationLossModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+MmWaveVehicularRayTracingSpectrumPropagationLossModel::~MmWaveVehicularRayTracingSpectrumPropagationLossModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+MmWaveVehicularRayTracingSpectrumPropagationLossModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MmWaveVehicularRayTracingSpectrumPropagationLossModel")
+    .SetParent<MmWaveVehicularSpectrumPropagationLossModel> ()
+    .SetGroupName ("millicar")
+    .AddConstructor<MmWaveVehicularRayTracingSpectrumPropagationLossModel> ()
+    .AddAttribute ("RayTracingFile",
+                   "The name of the file containing the output of the ray tracer",
+                   StringValue ("ray-tracing.bin"),
+                   MakeStringAccessor (&MmWaveVehicularRayTracingSpectrumPropagationLossModel::m_fileName),
+                   MakeStringChecker ())
+    .AddAttribute ("NormalizePower",
+                   "If true, the path gains are normalized to unit total power and the large scale fading is "
+                   "given by the propagation loss model, otherwise the path gains are used as they are",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&MmWaveVehicularRayTracingSpectrumPropagationLossModel::m_normalizePower),
+                   MakeBooleanChecker ())
+    .AddAttribute ("CoherenceTime",
+                   "The channel matrix of a link is rebuilt from the paths only after this time; in between, "
+                   "the phase of the paths is updated by the Doppler term",
+                   TimeValue (MilliSeconds (1)),
+                   MakeTimeAccessor (&MmWaveVehicularRayTracingSpectrumPropagationLossModel::m_coherenceTime),
+                   MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+void
+MmWaveVehicularRayTracingSpectrumPropagationLossModel::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  m_rayTracingData = 0;
+  m_cache.clear ();
+  MmWaveVehicularSpectrumPropagationLossModel::DoDispose ();
+}
+
+Ptr<const Params3gpp>
+MmWaveVehicularRayTracingSpectrumPropagationLossModel::GetCachedChannel (Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, bool &reverse) const
+{
+  reverse = false;
+  auto it = m_cache.find (std::make_pair (txDevice, rxDevice));
+  if (it == m_cache.end ())
+    {
+      return 0;
+    }
+  return it->second.m_params;
+}
+
+Ptr<Params3gpp>
+MmWaveVehicularRayTracingSpectrumPropagationLossModel::GetChannel (const TxInfo &txInfo,
+                                                                   Ptr<MmWaveVehicularAntennaArrayModel> rxAntennaArray,
+                                                                   Ptr<const MobilityModel> a,
+                                                                   Ptr<const MobilityModel> b) const
+{
+  NS_LOG_FUNCTION (this);
+
+  Ptr<NetDevice> rxDevice = GetDeviceContext (b)->m_device;
+  double txOffset = txInfo.m_antenna->GetOffset ();
+  double rxOffset = rxAntennaArray->GetOffset ();
+
+  // reuse the last realization if it is still valid
+  key_t key = std::make_pair (txInfo.m_device, rxDevice);
+  auto it = m_cache.find (key);
+  if (it != m_cache.end ()
+      && Simulator::Now () - it->second.m_buildTime < m_coherenceTime
+      && it->second.m_txOffset == txOffset
+      && it->second.m_rxOffset == rxOffset)
+    {
+      NS_LOG_DEBUG ("No need to update the channel");
+      return it->second.m_params;
+    }
+
+  if (m_rayTracingData == 0)
+    {
+      m_rayTracingData = Create<MmWaveVehicularRayTracingData> (m_fileName);
+    }
+
+  uint32_t txId = txInfo.m_device->GetNode ()->GetId ();
+  uint32_t rxId = rxDevice->GetNode ()->GetId ();
+
+  std::vector<MmWaveVehicularRayPath> paths;
+  Time stepTime;
+  if (!m_rayTracingData->GetPaths (txId, rxId, Simulator::Now (), paths, stepTime))
+    {
+      NS_FATAL_ERROR ("No paths for the link between node " << txId << " and node " << rxId
+                      << " in the ray tracing file " << m_fileName);
+    }
+  NS_ABORT_MSG_IF (paths.empty (), "No paths for the link between node " << txId << " and node " << rxId);
+
+  // the number of clusters is stored in a uint8_t, keep the strongest paths
+  if (paths.size () > UINT8_MAX)
+    {
+      NS_LOG_WARN ("Keeping the " << UINT8_MAX << " strongest paths out of " << paths.size ());
+      std::sort (paths.begin (), paths.end (),
+                 [] (const MmWaveVehicularRayPath &l, const MmWaveVehicularRayPath &r)
+                 {
+                   return l.m_power > r.m_power;
+                 });
+      paths.resize (UINT8_MAX);
+    }
+
+  // the delays are relative to the first path, the propagation delay is
+  // applied by the channel
+  double minDelay = paths.at (0).m_delay;
+  double totPower = 0;
+  for (auto &path : paths)
+    {
+      minDelay = std::min (minDelay, path.m_delay);
+      totPower += std::pow (10, path.m_power / 10);
+    }
+
+  Ptr<Params3gpp> params = Create<Params3gpp> ();
+  params->m_numCluster = paths.size ();
+  params->m_generatedTime = stepTime;
+  params->m_dis3D = a->GetDistanceFrom (b);
+  params->m_dis2D = std::sqrt (std::pow (a->GetPosition ().x - b->GetPosition ().x, 2)
+                               + std::pow (a->GetPosition ().y - b->GetPosition ().y, 2));
+  params->m_locUT = b->GetPosition ();
+  params->m_preLocUT = params->m_locUT;
+  params->m_tauDelta = 0;
+  // the link is considered in LOS if the first path is the direct one
+  params->m_condition = std::abs (minDelay - params->m_dis3D / 3e8) < 1e-9 ? 'l' : 'n';
+  params->m_angle.resize (4);
+
+  complexVector_t rxPhaseTerms;
+  complexVector_t txPhaseTerms;
+  uint64_t uSize = rxAntennaArray->GetTotNoArrayElements ();
+  uint64_t sSize = txInfo.m_antenna->GetTotNoArrayElements ();
+
+  params->m_channel.resize (uSize, complex2DVector_t (sSize, complexVector_t (paths.size ())));
+
+  for (uint8_t nIndex = 0; nIndex < paths.size (); nIndex++)
+    {
+      const MmWaveVehicularRayPath &path = paths.at (nIndex);
+      params->m_delay.push_back (path.m_delay - minDelay);
+      params->m_angle.at (AOA_INDEX).push_back (path.m_aoa);
+      params->m_angle.at (ZOA_INDEX).push_back (path.m_zoa);
+      params->m_angle.at (AOD_INDEX).push_back (path.m_aod);
+      params->m_angle.at (ZOD_INDEX).push_back (path.m_zod);
+
+      double power = std::pow (10, path.m_power / 10);
+      if (m_normalizePower)
+        {
+          power /= totPower;
+        }
+
+      // angles in the local coordinate system of the panels, as in the 3GPP model
+      double aoa = path.m_aoa * M_PI / 180 - rxOffset;
+      double zoa = path.m_zoa * M_PI / 180;
+      double aod = path.m_aod * M_PI / 180 - txOffset;
+      double zod = path.m_zod * M_PI / 180;
+
+      std::complex<double> pathGain = std::sqrt (power) * std::exp (std::complex<double> (0, path.m_phase))
+        * (rxAntennaArray->GetRadiationPattern (zoa, aoa) * txInfo.m_antenna->GetRadiationPattern (zod, aod));
+
+      //lambda_0 is accounted in the antenna spacing of the element locations.
+      rxAntennaArray->GetElementPhaseTerms (zoa, aoa, rxPhaseTerms);
+      txInfo.m_antenna->GetElementPhaseTerms (zod, aod, txPhaseTerms);
+      for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
+        {
+          std::complex<double> rxTerm = pathGain * rxPhaseTerms[uIndex];
+          for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
+            {
+              params->m_channel[uIndex][sIndex][nIndex] = rxTerm * txPhaseTerms[sIndex];
+            }
+        }
+    }
+
+  CachedChannel &entry = m_cache[key];
+  entry.m_params = params;
+  entry.m_buildTime = Simulator::Now ();
+  entry.m_txOffset = txOffset;
+  entry.m_rxOffset = rxOffset;
+
+  return params;
+}
+
+complexVector_t
+MmWaveVehicularRayTracingSpectrumPropagationLossModel::CalDoppler (Ptr<Params3gpp> params, Vector rxSpeed, Vector txSpeed) const
+{
+  NS_LOG_FUNCTION (this);
+
+  // the phases of the paths refer to the time step of the ray tracer
+  double elapsed = (Simulator::Now () - params->m_generatedTime).GetSeconds ();
+  complexVector_t doppler;
+  for (uint8_t cIndex = 0; cIndex < params->m_numCluster; cIndex++)
+    {
+      double zoa = params->m_angle.at (ZOA_INDEX).at (cIndex) * M_PI / 180;
+      double aoa = params->m_angle.at (AOA_INDEX).at (cIndex) * M_PI / 180;
+      double zod = params->m_angle.at (ZOD_INDEX).at (cIndex) * M_PI / 180;
+      double aod = params->m_angle.at (AOD_INDEX).at (cIndex) * M_PI / 180;
+      double tempDoppler = 2 * M_PI * ((sin (zoa) * cos (aoa) * rxSpeed.x + sin (zoa) * sin (aoa) * rxSpeed.y + cos (zoa) * rxSpeed.z)
+                                       + (sin (zod) * cos (aod) * txSpeed.x + sin (zod) * sin (aod) * txSpeed.y + cos (zod) * txSpeed.z))
+        * elapsed * m_frequency / 3e8;
+      doppler.push_back (exp (std::complex<double> (0, tempDoppler)));
+    }
+  return doppler;
+}
+
+} // namespace millicar
+} // namespace ns3
@@ -0,0 +1,225 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MMWAVE_VEHICULAR_RAY_TRACING_SPECTRUM_PROPAGATION_LOSS_MODEL_H
+#define MMWAVE_VEHICULAR_RAY_TRACING_SPECTRUM_PROPAGATION_LOSS_MODEL_H
+
+#include "ns3/mmwave-vehicular-spectrum-propagation-loss-model.h"
+#include "ns3/nstime.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+namespace millicar {
+
+/*
+ * A ray tracing file is a binary file (native byte order) with the following
+ * structure:
+ * - a header: char magic[4] = "MRTX", uint32 version, uint32 numLinks,
+ *   uint32 reserved;
+ * - the link table, with numLinks entries: uint32 txId, uint32 rxId,
+ *   uint32 numSteps, uint32 reserved, uint64 offset of the step table;
+ * - for each link, the step table, with numSteps entries sorted by time:
+ *   int64 time (ns), uint32 numPaths, uint32 reserved, uint64 offset of
+ *   the paths;
+ * - for each step, numPaths paths: double delay (s), double power (dB),
+ *   double phase (rad), double aoa, zoa, aod, zod (degrees, global
+ *   coordinate system).
+ * The IDs are the node IDs. All offsets are from the beginning of the file.
+ */
+
+/**
+ * A propagation path obtained by the ray tracer
+ */
+struct MmWaveVehicularRayPath
+{
+  double m_delay; //!< propagation delay in s
+  double m_power; //!< path gain in dB
+  double m_phase; //!< phase in rad
+  double m_aoa; //!< azimuth angle of arrival in degrees
+  double m_zoa; //!< zenith angle of arrival in degrees
+  double m_aod; //!< azimuth angle of departure in degrees
+  double m_zod; //!< zenith angle of departure in degrees
+};
+
+/**
+ * \ingroup millicar
+ * Reads the propagation paths from a ray tracing file. The file is mapped in
+ * memory in read only mode, hence only the time steps which are actually
+ * used are read from disk, and the same dataset can be shared by multiple
+ * processes.
+ */
+class MmWaveVehicularRayTracingData : public SimpleRefCount<MmWaveVehicularRayTracingData>
+{
+public:
+  /**
+   * Constructor, maps the file in memory and loads the link table
+   * \param fileName the name of the ray tracing file
+   */
+  MmWaveVehicularRayTracingData (std::string fileName);
+
+  /**
+   * Destructor, unmaps the file
+   */
+  ~MmWaveVehicularRayTracingData ();
+
+  /**
+   * Returns the paths of the link (txId, rxId) at the given time. If the
+   * two closest time steps have the same number of paths, the delay, the
+   * power and the angles of the paths are linearly interpolated, otherwise
+   * the paths of the previous step are used. The phase is always the one of
+   * the previous step, since it rotates many times between two steps.
+   * Before the first and after the last step, the paths of the first and
+   * last step are used. If the link is not in the file, the reverse link is
+   * used and the angles of arrival and departure are swapped.
+   * \param txId the ID of the tx node
+   * \param rxId the ID of the rx node
+   * \param time the current time
+   * \param paths vector filled with the paths
+   * \param stepTime set to the time of the step which provided the phases
+   * \return false if the link is not in the file
+   */
+  bool GetPaths (uint32_t txId, uint32_t rxId, Time time,
+                 std::vector<MmWaveVehicularRayPath> &paths, Time &stepTime) const;
+
+private:
+  /**
+   * Entry of the link table
+   */
+  struct LinkEntry
+  {
+    uint32_t m_numSteps; //!< number of time steps
+    uint64_t m_stepOffset; //!< offset of the step table
+  };
+
+  /**
+   * Returns the generation time of a step
+   * \param link the link
+   * \param step the index of the step
+   * \return the time in ns
+   */
+  int64_t GetStepTime (const LinkEntry &link, uint32_t step) const;
+
+  /**
+   * Read the paths of a step
+   * \param link the link
+   * \param step the index of the step
+   * \param paths vector filled with the paths
+   */
+  void ReadStep (const LinkEntry &link, uint32_t step, std::vector<MmWaveVehicularRayPath> &paths) const;
+
+  typedef std::pair<uint32_t, uint32_t> LinkId_t; //!< (tx node ID, rx node ID)
+
+  const uint8_t *m_data; //!< the mapped file
+  uint64_t m_size; //!< the size of the mapped file
+  std::map<LinkId_t, LinkEntry> m_links; //!< the link table
+};
+
+/**
+ * \ingroup millicar
+ * Spectrum propagation loss model based on the output of a ray tracer.
+ * The channel matrix of each link is built from the propagation paths
+ * stored in a MmWaveVehicularRayTracingData file, and the beamforming gain
+ * is then computed as in the MmWaveVehicularSpectrumPropagationLossModel.
+ * Each path is treated as a cluster with a single ray.
+ * By default, the path gains are normalized so that the large scale fading
+ * is still given by the propagation loss model of the channel; if
+ * NormalizePower is false, the path gains are used as they are, and the
+ * propagation loss model of the channel should be removed.
+ */
+class MmWaveVehicularRayTracingSpectrumPropagationLossModel : public MmWaveVehicularSpectrumPropagationLossModel
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularRayTracingSpectrumPropagationLossModel ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularRayTracingSpectrumPropagationLossModel ();
+
+  // inherited from Object
+  static TypeId GetTypeId (void);
+  void DoDispose ();
+
+  /**
+   * Returns the last channel realization built for a link. The realizations
+   * are built for each direction, hence reverse is always false.
+   * @params the tx device
+   * @params the rx device
+   * @params set to false
+   * @returns the channel realization, or 0 if the link has not been used yet
+   */
+  virtual Ptr<const Params3gpp> GetCachedChannel (Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, bool &reverse) const;
+
+protected:
+  /**
+   * Build the channel realization from the paths of the ray tracer
+   * @params the transmitter information
+   * @params the antenna array of the receiver
+   * @params the mobility model of the transmitter
+   * @params the mobility model of the receiver
+   * @returns the channel realization in a Params3gpp object
+   */
+  virtual Ptr<Params3gpp> GetChannel (const TxInfo &txInfo,
+                                      Ptr<MmWaveVehicularAntennaArrayModel> rxAntennaArray,
+                                      Ptr<const MobilityModel> a,
+                                      Ptr<const MobilityModel> b) const;
+
+  /**
+   * Compute the Doppler term of each path, i.e., the phase rotation since
+   * the time step of the ray tracer. Differently from the 3GPP model, the
+   * Doppler shift of each path is deterministic.
+   * @params the channel realizationin as a Params3gpp object
+   * @params the speed of the receiver
+   * @params the speed of the transmitter
+   * @returns the Doppler terms
+   */
+  virtual complexVector_t CalDoppler (Ptr<Params3gpp> params,
+                                      Vector rxSpeed,
+                                      Vector txSpeed) const;
+
+private:
+  /**
+   * Channel realization of a link, with the quantities needed to decide if
+   * it is still valid
+   */
+  struct CachedChannel
+  {
+    Ptr<Params3gpp> m_params; //!< the channel realization
+    Time m_buildTime; //!< the time at which the realization has been built
+    double m_txOffset; //!< the offset of the tx panel
+    double m_rxOffset; //!< the offset of the rx panel
+  };
+
+  std::string m_fileName; // name of the ray tracing file
+  bool m_normalizePower; // if true, the path gains are normalized to unit total power
+  Time m_coherenceTime; // time after which the channel matrix of a link is rebuilt
+  mutable Ptr<MmWaveVehicularRayTracingData> m_rayTracingData; // the ray tracing data, loaded when needed
+  mutable std::map<key_t, CachedChannel> m_cache; // the last channel realization of each link
+};
+
+} // namespace millicar
+} // namespace ns3
+
+#endif /* MMWAVE_VEHICULAR_RAY_TRACING_SPECTRUM_PROPAGATION_LOSS_MODEL_H */
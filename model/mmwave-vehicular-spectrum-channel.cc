@@ -0,0 +1,742 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "mmwave-vehicular-spectrum-channel.h"
+#include "mmwave-vehicular-spectrum-propagation-loss-model.h"
+#include "mmwave-sidelink-spectrum-signal-parameters.h"
+#include "mmwave-sidelink-spectrum-phy.h"
+#include "mmwave-vehicular-net-device.h"
+#include "mmwave-vehicular-antenna-array-model.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/net-device.h"
+#include "ns3/spectrum-phy.h"
+#include "ns3/antenna-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/nstime.h"
+#include "ns3/mobility-model.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularSpectrumChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (MmWaveVehicularSpectrumChannel);
+
+MmWaveVehicularSpectrumChannel::MmWaveVehicularSpectrumChannel ()
+  : m_workerThreads (1),
+    m_maxInterferenceRange (0),
+    m_gridValid (false),
+    m_maxSpeed (0),
+    m_numCachedLinkGains (0),
+    m_numFarFieldSignals (0),
+    m_numFarFieldAggregates (0),
+    m_farFieldApproxPower (0),
+    m_farFieldExactPower (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+MmWaveVehicularSpectrumChannel::~MmWaveVehicularSpectrumChannel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+MmWaveVehicularSpectrumChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MmWaveVehicularSpectrumChannel")
+    .SetParent<SpectrumChannel> ()
+    .SetGroupName ("millicar")
+    .AddConstructor<MmWaveVehicularSpectrumChannel> ()
+    .AddAttribute ("WorkerThreads",
+                   "Number of threads used to compute the PSDs of the receivers of a transmission. "
+                   "With 1, everything is computed in the simulation thread",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&MmWaveVehicularSpectrumChannel::m_workerThreads),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxInterferenceRange",
+                   "Maximum distance in meters between a transmitter and the receivers of its "
+                   "signals. Set to 0 to deliver the signals to all the receivers",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&MmWaveVehicularSpectrumChannel::m_maxInterferenceRange),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("GridUpdatePeriod",
+                   "Minimum time between two updates of the positions of the receivers in the grid "
+                   "used with MaxInterferenceRange",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&MmWaveVehicularSpectrumChannel::m_gridUpdatePeriod),
+                   MakeTimeChecker ())
+    .AddAttribute ("CoherenceTime",
+                   "Duration of the intervals in which the gains of the links are assumed "
+                   "constant, so that they are computed once and reused by the following "
+                   "transmissions with the same beams. Within an interval, the evolution of "
+                   "the Doppler terms and the updates of the channel realizations are frozen, "
+                   "the gain traces are not fired, and the range and far-field decisions taken "
+                   "for the first signal hold for the following ones. Set to 0 to compute every signal",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&MmWaveVehicularSpectrumChannel::m_coherenceTime),
+                   MakeTimeChecker ())
+    .AddAttribute ("FarFieldRadius",
+                   "Distance in meters beyond which the interfering signals are approximated "
+                   "with the pathloss and the fixed gain FarFieldFixedBeamGain, and aggregated "
+                   "by spatial cell. Set to 0 to disable the approximation",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&MmWaveVehicularSpectrumChannel::m_farFieldRadius),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("FarFieldCellSize",
+                   "Side in meters of the square cells used to aggregate the far-field signals",
+                   DoubleValue (100),
+                   MakeDoubleAccessor (&MmWaveVehicularSpectrumChannel::m_farFieldCellSize),
+                   MakeDoubleChecker<double> (1))
+    .AddAttribute ("FarFieldFixedBeamGain",
+                   "Beamforming gain in dB applied to all the far-field signals, in place of the "
+                   "gain of the actual beams, which is not computed",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&MmWaveVehicularSpectrumChannel::m_farFieldFixedBeamGainDb),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("FarFieldValidation",
+                   "If true, the far-field signals are computed also with the spectrum "
+                   "propagation loss model, to evaluate the error of the approximation",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MmWaveVehicularSpectrumChannel::m_farFieldValidation),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+void
+MmWaveVehicularSpectrumChannel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_phyList.clear ();
+  m_spectrumModel = 0;
+  m_workerPool = 0;
+  m_farFieldAggregates.clear ();
+  m_grid.clear ();
+  m_phyIndex.clear ();
+  m_linkGains.clear ();
+  SpectrumChannel::DoDispose ();
+}
+
+void
+MmWaveVehicularSpectrumChannel::AddRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  m_phyList.push_back (phy);
+  m_phyIndex[phy] = m_phyList.size () - 1;
+  m_gridValid = false;
+}
+
+void
+MmWaveVehicularSpectrumChannel::RemoveRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  PhyList::iterator it = std::find (m_phyList.begin (), m_phyList.end (), phy);
+  if (it != m_phyList.end ())
+    {
+      m_phyList.erase (it);
+      m_gridValid = false;
+
+      // the indices changed
+      m_phyIndex.clear ();
+      for (std::size_t i = 0; i < m_phyList.size (); ++i)
+        {
+          m_phyIndex[m_phyList[i]] = i;
+        }
+      m_linkGains.clear ();
+    }
+}
+
+void
+MmWaveVehicularSpectrumChannel::StartTx (Ptr<SpectrumSignalParameters> txParams)
+{
+  NS_LOG_FUNCTION (this << txParams->psd << txParams->duration << txParams->txPhy);
+  NS_ASSERT_MSG (txParams->psd, "NULL txPsd");
+  NS_ASSERT_MSG (txParams->txPhy, "NULL txPhy");
+
+  Ptr<SpectrumSignalParameters> txParamsTrace = txParams->Copy (); // copy it since traced value cannot be const
+  m_txSigParamsTrace (txParamsTrace);
+
+  // all the attached SpectrumPhy instances must use the same SpectrumModel
+  if (m_spectrumModel == 0)
+    {
+      m_spectrumModel = txParams->psd->GetSpectrumModel ();
+    }
+  else
+    {
+      NS_ASSERT (*(txParams->psd->GetSpectrumModel ()) == *m_spectrumModel);
+    }
+
+  Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility ();
+
+  // if possible, the spectrum propagation loss is computed at once for all the receivers
+  Ptr<MmWaveVehicularSpectrumPropagationLossModel> vehicularSplm = DynamicCast<MmWaveVehicularSpectrumPropagationLossModel> (m_spectrumPropagationLoss);
+
+  // first, evaluate the pathloss and discard the receivers which are beyond range
+  std::vector<Ptr<SpectrumPhy> > receivers;
+  std::vector<Ptr<SpectrumSignalParameters> > rxParamsList;
+  std::vector<Ptr<const MobilityModel> > receiverMobilities;
+  std::vector<double> pathGains;
+  std::vector<std::size_t> receiverIndices;
+  std::vector<uint64_t> rxBeamIds;
+  std::vector<bool> cachedGains;
+  std::vector<Time> cachedDelays;
+
+  // the gains of the links can be cached only if the transmitter is attached
+  // to the channel
+  bool useLinkGains = m_coherenceTime.IsStrictlyPositive () && senderMobility
+    && m_phyIndex.find (txParams->txPhy) != m_phyIndex.end ();
+  std::size_t txIndex = useLinkGains ? m_phyIndex.at (txParams->txPhy) : 0;
+  uint64_t txBeamId = useLinkGains ? GetBeamId (txParams->txAntenna) : 0;
+
+  double farFieldBeamGain = std::pow (10.0, m_farFieldFixedBeamGainDb / 10.0);
+  std::vector<std::size_t> candidates;
+  GetCandidateReceivers (senderMobility, candidates);
+  for (std::size_t rxIndex : candidates)
+    {
+      Ptr<SpectrumPhy> rxPhy = m_phyList[rxIndex];
+      if (rxPhy == txParams->txPhy)
+        {
+          continue;
+        }
+
+      Ptr<MobilityModel> receiverMobility = rxPhy->GetMobility ();
+      double distance = 0;
+      if (senderMobility && receiverMobility)
+        {
+          distance = senderMobility->GetDistanceFrom (receiverMobility);
+          if (m_maxInterferenceRange > 0 && distance > m_maxInterferenceRange)
+            {
+              continue;
+            }
+        }
+
+      NS_LOG_LOGIC ("copying signal parameters " << txParams);
+      Ptr<SpectrumSignalParameters> rxParams = txParams->Copy ();
+
+      uint64_t rxBeamId = 0;
+      if (useLinkGains && receiverMobility)
+        {
+          rxBeamId = GetBeamId (rxPhy->GetRxAntenna ());
+          Time delay;
+          if (ApplyLinkGain (txIndex, rxIndex, txBeamId, rxBeamId, *(rxParams->psd), delay))
+            {
+              // the propagation models are not needed
+              receivers.push_back (rxPhy);
+              rxParamsList.push_back (rxParams);
+              receiverMobilities.push_back (0);
+              pathGains.push_back (1.0);
+              receiverIndices.push_back (rxIndex);
+              rxBeamIds.push_back (rxBeamId);
+              cachedGains.push_back (true);
+              cachedDelays.push_back (delay);
+              continue;
+            }
+        }
+
+      if (senderMobility && receiverMobility)
+        {
+          double txAntennaGain = 0;
+          double rxAntennaGain = 0;
+          double propagationGainDb = 0;
+          double pathLossDb = 0;
+          if (rxParams->txAntenna != 0)
+            {
+              Angles txAngles (receiverMobility->GetPosition (), senderMobility->GetPosition ());
+              txAntennaGain = rxParams->txAntenna->GetGainDb (txAngles);
+              NS_LOG_LOGIC ("txAntennaGain = " << txAntennaGain << " dB");
+              pathLossDb -= txAntennaGain;
+            }
+          Ptr<AntennaModel> rxAntenna = rxPhy->GetRxAntenna ();
+          if (rxAntenna != 0)
+            {
+              Angles rxAngles (senderMobility->GetPosition (), receiverMobility->GetPosition ());
+              rxAntennaGain = rxAntenna->GetGainDb (rxAngles);
+              NS_LOG_LOGIC ("rxAntennaGain = " << rxAntennaGain << " dB");
+              pathLossDb -= rxAntennaGain;
+            }
+          if (m_propagationLoss)
+            {
+              propagationGainDb = m_propagationLoss->CalcRxPower (0, senderMobility, receiverMobility);
+              NS_LOG_LOGIC ("propagationGainDb = " << propagationGainDb << " dB");
+              pathLossDb -= propagationGainDb;
+            }
+          NS_LOG_LOGIC ("total pathLoss = " << pathLossDb << " dB");
+          m_gainTrace (senderMobility, receiverMobility, txAntennaGain, rxAntennaGain, propagationGainDb, pathLossDb);
+          m_pathLossTrace (txParams->txPhy, rxPhy, pathLossDb);
+          if (pathLossDb > m_maxLossDb)
+            {
+              // beyond range
+              continue;
+            }
+
+          if (IsFarField (txParams, rxPhy, distance))
+            {
+              // the fading is neglected, only the pathloss and the fixed gain are applied
+              double pathGain = std::pow (10.0, (-pathLossDb) / 10.0);
+              *(rxParams->psd) *= pathGain * farFieldBeamGain;
+
+              if (m_farFieldValidation && m_spectrumPropagationLoss)
+                {
+                  Ptr<SpectrumValue> exact = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (txParams->psd, senderMobility, receiverMobility);
+                  m_farFieldExactPower += Sum (*exact) * pathGain;
+                  m_farFieldApproxPower += Sum (*(rxParams->psd));
+                }
+
+              Time delay = MicroSeconds (0);
+              if (m_propagationDelay)
+                {
+                  delay = m_propagationDelay->GetDelay (senderMobility, receiverMobility);
+                }
+              AddFarFieldSignal (rxIndex, senderMobility->GetPosition (), rxParams, delay);
+              continue;
+            }
+
+          receiverMobilities.push_back (receiverMobility);
+          pathGains.push_back (std::pow (10.0, (-pathLossDb) / 10.0));
+        }
+      else
+        {
+          // no mobility, the signal is delivered as it is
+          receiverMobilities.push_back (0);
+          pathGains.push_back (1.0);
+        }
+
+      receivers.push_back (rxPhy);
+      rxParamsList.push_back (rxParams);
+      receiverIndices.push_back (rxIndex);
+      rxBeamIds.push_back (rxBeamId);
+      cachedGains.push_back (false);
+      cachedDelays.push_back (Seconds (0));
+    }
+
+  // then, compute the spectrum propagation loss
+  std::vector<Ptr<SpectrumValue> > rxPsds (receivers.size ());
+  if (vehicularSplm && senderMobility)
+    {
+      std::vector<Ptr<const MobilityModel> > withMobility;
+      for (auto mm : receiverMobilities)
+        {
+          if (mm != 0)
+            {
+              withMobility.push_back (mm);
+            }
+        }
+
+      if (m_workerThreads > 1 && !m_workerPool)
+        {
+          m_workerPool = Create<MmWaveVehicularWorkerPool> (m_workerThreads);
+        }
+
+      std::vector<Ptr<SpectrumValue> > psds = vehicularSplm->CalcRxPowerSpectralDensityMulti (txParams->psd, senderMobility, withMobility, m_workerPool);
+
+      std::vector<Ptr<SpectrumValue> >::iterator psdIt = psds.begin ();
+      for (std::size_t i = 0; i < receivers.size (); ++i)
+        {
+          if (receiverMobilities.at (i) != 0)
+            {
+              rxPsds.at (i) = *psdIt;
+              ++psdIt;
+            }
+        }
+    }
+  else if (m_spectrumPropagationLoss && senderMobility)
+    {
+      for (std::size_t i = 0; i < receivers.size (); ++i)
+        {
+          if (receiverMobilities.at (i) != 0)
+            {
+              rxPsds.at (i) = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (txParams->psd, senderMobility, receiverMobilities.at (i));
+            }
+        }
+    }
+
+  // finally, apply the pathloss and schedule the receptions
+  for (std::size_t i = 0; i < receivers.size (); ++i)
+    {
+      Ptr<SpectrumSignalParameters> rxParams = rxParamsList.at (i);
+      if (cachedGains.at (i))
+        {
+          ScheduleRx (rxParams, receivers.at (i), cachedDelays.at (i));
+          continue;
+        }
+
+      if (rxPsds.at (i) != 0)
+        {
+          // the spectrum propagation loss is linear in the input PSD, hence the
+          // pathloss can be applied after it
+          rxParams->psd = rxPsds.at (i);
+        }
+      *(rxParams->psd) *= pathGains.at (i);
+
+      Time delay = MicroSeconds (0);
+      if (m_propagationDelay && senderMobility && receiverMobilities.at (i))
+        {
+          delay = m_propagationDelay->GetDelay (senderMobility, receiverMobilities.at (i));
+        }
+
+      if (useLinkGains && receiverMobilities.at (i))
+        {
+          StoreLinkGain (txIndex, receiverIndices.at (i), txBeamId, rxBeamIds.at (i), *(txParams->psd), *(rxParams->psd), delay);
+        }
+
+      ScheduleRx (rxParams, receivers.at (i), delay);
+    }
+}
+
+void
+MmWaveVehicularSpectrumChannel::ScheduleRx (Ptr<SpectrumSignalParameters> rxParams, Ptr<SpectrumPhy> receiver, Time delay)
+{
+  Ptr<NetDevice> netDev = receiver->GetDevice ();
+  if (netDev)
+    {
+      // the receiver has a NetDevice, so we expect that it is attached to a Node
+      uint32_t dstNode =  netDev->GetNode ()->GetId ();
+      Simulator::ScheduleWithContext (dstNode, delay, &MmWaveVehicularSpectrumChannel::StartRx, this,
+                                      rxParams, receiver);
+    }
+  else
+    {
+      // the receiver is not attached to a NetDevice, so we cannot assume that it is attached to a node
+      Simulator::Schedule (delay, &MmWaveVehicularSpectrumChannel::StartRx, this,
+                           rxParams, receiver);
+    }
+}
+
+void
+MmWaveVehicularSpectrumChannel::StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+{
+  NS_LOG_FUNCTION (this << params);
+  receiver->StartRx (params);
+}
+
+uint64_t
+MmWaveVehicularSpectrumChannel::GetBeamId (Ptr<const AntennaModel> antenna)
+{
+  Ptr<const MmWaveVehicularAntennaArrayModel> array = DynamicCast<const MmWaveVehicularAntennaArrayModel> (antenna);
+  return array ? array->GetBeamId () : 0;
+}
+
+int64_t
+MmWaveVehicularSpectrumChannel::GetCoherenceInterval () const
+{
+  return Simulator::Now ().GetTimeStep () / m_coherenceTime.GetTimeStep ();
+}
+
+bool
+MmWaveVehicularSpectrumChannel::ApplyLinkGain (std::size_t txIndex, std::size_t rxIndex, uint64_t txBeamId, uint64_t rxBeamId,
+                                               SpectrumValue &rxPsd, Time &delay)
+{
+  auto it = m_linkGains.find (std::make_pair (txIndex, rxIndex));
+  if (it == m_linkGains.end ()
+      || it->second.m_interval != GetCoherenceInterval ()
+      || it->second.m_txBeamId != txBeamId
+      || it->second.m_rxBeamId != rxBeamId)
+    {
+      return false;
+    }
+
+  // the gain of the bands which were not used when the gains were computed
+  // is unknown
+  const std::vector<double> &gains = it->second.m_gains;
+  Values::const_iterator vit = rxPsd.ConstValuesBegin ();
+  for (std::size_t b = 0; b < gains.size (); ++b, ++vit)
+    {
+      if (*vit != 0 && gains[b] < 0)
+        {
+          return false;
+        }
+    }
+
+  Values::iterator rit = rxPsd.ValuesBegin ();
+  for (std::size_t b = 0; b < gains.size (); ++b, ++rit)
+    {
+      *rit *= std::max (gains[b], 0.0);
+    }
+  delay = it->second.m_delay;
+  m_numCachedLinkGains++;
+  return true;
+}
+
+void
+MmWaveVehicularSpectrumChannel::StoreLinkGain (std::size_t txIndex, std::size_t rxIndex, uint64_t txBeamId, uint64_t rxBeamId,
+                                               const SpectrumValue &txPsd, const SpectrumValue &rxPsd, Time delay)
+{
+  LinkGain &entry = m_linkGains[std::make_pair (txIndex, rxIndex)];
+  entry.m_gains.resize (txPsd.GetSpectrumModel ()->GetNumBands ());
+  Values::const_iterator tit = txPsd.ConstValuesBegin ();
+  Values::const_iterator rit = rxPsd.ConstValuesBegin ();
+  for (std::size_t b = 0; b < entry.m_gains.size (); ++b, ++tit, ++rit)
+    {
+      entry.m_gains[b] = (*tit != 0) ? (*rit) / (*tit) : -1.0;
+    }
+  entry.m_txBeamId = txBeamId;
+  entry.m_rxBeamId = rxBeamId;
+  entry.m_interval = GetCoherenceInterval ();
+  entry.m_delay = delay;
+}
+
+uint64_t
+MmWaveVehicularSpectrumChannel::GetNumCachedLinkGains () const
+{
+  return m_numCachedLinkGains;
+}
+
+std::pair<int64_t, int64_t>
+MmWaveVehicularSpectrumChannel::GetCell (Vector position) const
+{
+  return std::make_pair (int64_t (std::floor (position.x / m_maxInterferenceRange)),
+                         int64_t (std::floor (position.y / m_maxInterferenceRange)));
+}
+
+void
+MmWaveVehicularSpectrumChannel::RebuildGrid ()
+{
+  NS_LOG_FUNCTION (this);
+  m_grid.clear ();
+  m_noMobility.clear ();
+  m_phyCell.assign (m_phyList.size (), std::make_pair (0, 0));
+  m_maxSpeed = 0;
+  for (std::size_t i = 0; i < m_phyList.size (); ++i)
+    {
+      Ptr<MobilityModel> mobility = m_phyList[i]->GetMobility ();
+      if (mobility == 0)
+        {
+          m_noMobility.push_back (i);
+          continue;
+        }
+      m_phyCell[i] = GetCell (mobility->GetPosition ());
+      m_grid[m_phyCell[i]].push_back (i);
+      m_maxSpeed = std::max (m_maxSpeed, CalculateDistance (mobility->GetVelocity (), Vector (0, 0, 0)));
+    }
+  m_gridValid = true;
+  m_lastGridUpdate = Simulator::Now ();
+}
+
+void
+MmWaveVehicularSpectrumChannel::UpdateGrid ()
+{
+  NS_LOG_FUNCTION (this);
+  m_maxSpeed = 0;
+  for (std::size_t i = 0; i < m_phyList.size (); ++i)
+    {
+      Ptr<MobilityModel> mobility = m_phyList[i]->GetMobility ();
+      bool inGrid = !std::binary_search (m_noMobility.begin (), m_noMobility.end (), i);
+      if ((mobility != 0) != inGrid)
+        {
+          // the mobility model has been set or removed after the grid was
+          // built, hence the receiver has to be moved to or from m_noMobility
+          RebuildGrid ();
+          return;
+        }
+      if (mobility == 0)
+        {
+          continue;
+        }
+      m_maxSpeed = std::max (m_maxSpeed, CalculateDistance (mobility->GetVelocity (), Vector (0, 0, 0)));
+
+      std::pair<int64_t, int64_t> cell = GetCell (mobility->GetPosition ());
+      if (cell == m_phyCell[i])
+        {
+          continue;
+        }
+
+      // move the receiver to the new cell, keeping the indices sorted
+      std::vector<std::size_t> &oldCell = m_grid[m_phyCell[i]];
+      std::vector<std::size_t>::iterator it = std::lower_bound (oldCell.begin (), oldCell.end (), i);
+      if (it == oldCell.end () || *it != i)
+        {
+          NS_LOG_WARN ("Receiver " << i << " not found in its cell, rebuilding the grid");
+          RebuildGrid ();
+          return;
+        }
+      oldCell.erase (it);
+      if (oldCell.empty ())
+        {
+          m_grid.erase (m_phyCell[i]);
+        }
+      std::vector<std::size_t> &newCell = m_grid[cell];
+      newCell.insert (std::lower_bound (newCell.begin (), newCell.end (), i), i);
+      m_phyCell[i] = cell;
+    }
+  m_lastGridUpdate = Simulator::Now ();
+}
+
+void
+MmWaveVehicularSpectrumChannel::GetCandidateReceivers (Ptr<MobilityModel> senderMobility, std::vector<std::size_t> &candidates)
+{
+  candidates.clear ();
+  if (m_maxInterferenceRange <= 0 || senderMobility == 0)
+    {
+      for (std::size_t i = 0; i < m_phyList.size (); ++i)
+        {
+          candidates.push_back (i);
+        }
+      return;
+    }
+
+  if (!m_gridValid)
+    {
+      RebuildGrid ();
+    }
+  else if (Simulator::Now () - m_lastGridUpdate >= m_gridUpdatePeriod)
+    {
+      UpdateGrid ();
+    }
+
+  // the receivers may have moved since the last update
+  double radius = m_maxInterferenceRange + m_maxSpeed * (Simulator::Now () - m_lastGridUpdate).GetSeconds ();
+  Vector position = senderMobility->GetPosition ();
+  std::pair<int64_t, int64_t> minCell = GetCell (Vector (position.x - radius, position.y - radius, 0));
+  std::pair<int64_t, int64_t> maxCell = GetCell (Vector (position.x + radius, position.y + radius, 0));
+  for (int64_t x = minCell.first; x <= maxCell.first; ++x)
+    {
+      for (int64_t y = minCell.second; y <= maxCell.second; ++y)
+        {
+          auto it = m_grid.find (std::make_pair (x, y));
+          if (it != m_grid.end ())
+            {
+              candidates.insert (candidates.end (), it->second.begin (), it->second.end ());
+            }
+        }
+    }
+  candidates.insert (candidates.end (), m_noMobility.begin (), m_noMobility.end ());
+
+  // same order as the scan of all the receivers
+  std::sort (candidates.begin (), candidates.end ());
+}
+
+bool
+MmWaveVehicularSpectrumChannel::IsFarField (Ptr<const SpectrumSignalParameters> txParams, Ptr<SpectrumPhy> receiver, double distance) const
+{
+  if (m_farFieldRadius <= 0 || distance <= m_farFieldRadius)
+    {
+      return false;
+    }
+
+  // the signals intended for the receiver are always computed exactly
+  Ptr<const MmWaveSidelinkSpectrumSignalParameters> sidelinkParams = DynamicCast<const MmWaveSidelinkSpectrumSignalParameters> (txParams);
+  if (sidelinkParams == 0)
+    {
+      return true;
+    }
+
+  // the RNTI is read from the device context, if available
+  Ptr<MmWaveSidelinkSpectrumPhy> rxPhy = DynamicCast<MmWaveSidelinkSpectrumPhy> (receiver);
+  Ptr<const MmWaveVehicularDeviceContext> context = rxPhy ? rxPhy->GetDeviceContext () : 0;
+  if (context)
+    {
+      return context->m_rnti != sidelinkParams->destinationRnti;
+    }
+  Ptr<MmWaveVehicularNetDevice> rxDevice = DynamicCast<MmWaveVehicularNetDevice> (receiver->GetDevice ());
+  return !rxDevice || rxDevice->GetMac ()->GetRnti () != sidelinkParams->destinationRnti;
+}
+
+void
+MmWaveVehicularSpectrumChannel::AddFarFieldSignal (std::size_t rxIndex, Vector txPosition, Ptr<SpectrumSignalParameters> rxParams, Time delay)
+{
+  NS_LOG_FUNCTION (this << rxIndex << txPosition);
+  m_numFarFieldSignals++;
+
+  if (m_farFieldAggregates.empty ())
+    {
+      Simulator::ScheduleNow (&MmWaveVehicularSpectrumChannel::ScheduleFarFieldSignals, this);
+    }
+
+  FarFieldKey key (rxIndex,
+                   int64_t (std::floor (txPosition.x / m_farFieldCellSize)),
+                   int64_t (std::floor (txPosition.y / m_farFieldCellSize)),
+                   rxParams->duration);
+  auto it = m_farFieldAggregates.find (key);
+  if (it == m_farFieldAggregates.end ())
+    {
+      // the aggregate is a generic signal, hence the receivers consider it
+      // only as interference
+      FarFieldAggregate aggregate;
+      aggregate.m_params = Create<SpectrumSignalParameters> ();
+      // the following signals are summed to the PSD, hence it must not be
+      // shared with the first signal
+      aggregate.m_params->psd = Copy (rxParams->psd);
+      aggregate.m_params->duration = rxParams->duration;
+      aggregate.m_params->txPhy = rxParams->txPhy;
+      aggregate.m_delay = delay;
+      m_farFieldAggregates.insert (std::make_pair (key, aggregate));
+    }
+  else
+    {
+      *(it->second.m_params->psd) += *(rxParams->psd);
+    }
+}
+
+void
+MmWaveVehicularSpectrumChannel::ScheduleFarFieldSignals ()
+{
+  NS_LOG_FUNCTION (this << m_farFieldAggregates.size ());
+  for (auto &entry : m_farFieldAggregates)
+    {
+      ScheduleRx (entry.second.m_params, m_phyList.at (std::get<0> (entry.first)), entry.second.m_delay);
+      m_numFarFieldAggregates++;
+    }
+  m_farFieldAggregates.clear ();
+}
+
+uint64_t
+MmWaveVehicularSpectrumChannel::GetNumFarFieldSignals () const
+{
+  return m_numFarFieldSignals;
+}
+
+uint64_t
+MmWaveVehicularSpectrumChannel::GetNumFarFieldAggregates () const
+{
+  return m_numFarFieldAggregates;
+}
+
+double
+MmWaveVehicularSpectrumChannel::GetFarFieldErrorDb () const
+{
+  NS_ASSERT_MSG (m_farFieldExactPower > 0, "No far-field signal has been validated");
+  return 10 * std::log10 (m_farFieldApproxPower / m_farFieldExactPower);
+}
+
+std::size_t
+MmWaveVehicularSpectrumChannel::GetNDevices (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_phyList.size ();
+}
+
+Ptr<NetDevice>
+MmWaveVehicularSpectrumChannel::GetDevice (std::size_t i) const
+{
+  NS_LOG_FUNCTION (this << i);
+  return m_phyList.at (i)->GetDevice ()->GetObject<NetDevice> ();
+}
+
+} // namespace millicar
+} // namespace ns3
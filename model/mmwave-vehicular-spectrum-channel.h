@@ -0,0 +1,295 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MMWAVE_VEHICULAR_SPECTRUM_CHANNEL_H
+#define MMWAVE_VEHICULAR_SPECTRUM_CHANNEL_H
+
+#include "ns3/spectrum-channel.h"
+#include "ns3/spectrum-model.h"
+#include "ns3/vector.h"
+#include "ns3/antenna-model.h"
+#include "ns3/mmwave-vehicular-worker-pool.h"
+#include <vector>
+#include <map>
+#include <tuple>
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * \ingroup millicar
+ * SpectrumChannel for the vehicular devices. It behaves like the
+ * SingleModelSpectrumChannel, but when the spectrum propagation loss model is a
+ * MmWaveVehicularSpectrumPropagationLossModel the PSDs of all the receivers of
+ * a transmission are computed with a single call, so that the quantities
+ * which only depend on the transmitter are evaluated once.
+ * If the attribute WorkerThreads is greater than one, the beamforming gain of
+ * the receivers is computed in parallel; the receptions are then scheduled in
+ * the same order as in the sequential case.
+ * If the attribute FarFieldRadius is positive, the signals received from
+ * the transmitters farther than this radius are only considered as
+ * interference and their fading is not computed: the rx PSD is obtained with
+ * the pathloss of the link and a fixed beamforming gain, set with the
+ * attribute FarFieldFixedBeamGain, which does not depend on the beams and on
+ * the positions of the devices. The signals coming from the same spatial
+ * cell and received at the same time by a device are summed and delivered as
+ * a single signal. The signals intended for a receiver
+ * always go through the spectrum propagation loss model.
+ * If the attribute MaxInterferenceRange is positive, a transmission is
+ * delivered only to the receivers within this range. The receivers are kept
+ * in a uniform grid of square cells, with side equal to the range, so that
+ * only the cells around the transmitter are visited. The grid is updated
+ * incrementally, moving only the receivers which changed cell, at most once
+ * every GridUpdatePeriod; in between, the search area is extended by the
+ * distance the receivers may have traveled. The receivers are always visited
+ * in the order in which they were added to the channel.
+ * If the attribute CoherenceTime is positive, the gain of each band of the
+ * links which go through the full propagation path (pathloss, antenna gains
+ * and spectrum propagation loss) is stored in a sparse matrix, and reused
+ * for the following transmissions on the same link with the same beams in
+ * the same coherence interval: the rx PSD is then obtained by scaling the tx
+ * PSD, without calling the propagation models. Hence, within an interval the
+ * Doppler terms keep the value they had when the gains were stored, and the
+ * gain traces are fired only for the first signal of each link.
+ */
+class MmWaveVehicularSpectrumChannel : public SpectrumChannel
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularSpectrumChannel ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularSpectrumChannel ();
+
+  // inherited from Object
+  static TypeId GetTypeId (void);
+
+  // inherited from SpectrumChannel
+  virtual void AddRx (Ptr<SpectrumPhy> phy);
+  virtual void RemoveRx (Ptr<SpectrumPhy> phy);
+  virtual void StartTx (Ptr<SpectrumSignalParameters> params);
+
+  // inherited from Channel
+  virtual std::size_t GetNDevices (void) const;
+  virtual Ptr<NetDevice> GetDevice (std::size_t i) const;
+
+  /**
+   * Returns the number of signals which have been approximated as far-field
+   * interference
+   * \return the number of far-field signals
+   */
+  uint64_t GetNumFarFieldSignals () const;
+
+  /**
+   * Returns the number of signals whose rx PSD has been obtained from the
+   * gains cached in the current coherence interval
+   * \return the number of signals
+   */
+  uint64_t GetNumCachedLinkGains () const;
+
+  /**
+   * Returns the number of aggregated signals delivered to the receivers in
+   * place of the far-field signals
+   * \return the number of aggregated signals
+   */
+  uint64_t GetNumFarFieldAggregates () const;
+
+  /**
+   * Returns the error of the far-field approximation, i.e., the ratio
+   * between the total power of the approximated far-field signals and the
+   * total power obtained with the spectrum propagation loss model. It is
+   * available only if FarFieldValidation is true.
+   * \return the error in dB
+   */
+  double GetFarFieldErrorDb () const;
+
+protected:
+  // inherited from Object
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * Deliver the signal to a receiver
+   * \param params the signal parameters
+   * \param receiver the receiver SpectrumPhy
+   */
+  void StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver);
+
+  /**
+   * Schedule the reception of the signal at the receiver
+   * \param rxParams the signal parameters seen by the receiver
+   * \param receiver the receiver SpectrumPhy
+   * \param delay the propagation delay
+   */
+  void ScheduleRx (Ptr<SpectrumSignalParameters> rxParams, Ptr<SpectrumPhy> receiver, Time delay);
+
+  /**
+   * Update the cells of the receivers which moved since the last update.
+   * The grid is rebuilt if a receiver got or lost its mobility model
+   */
+  void UpdateGrid ();
+
+  /**
+   * Rebuild the grid from scratch
+   */
+  void RebuildGrid ();
+
+  /**
+   * Returns the cell of a position
+   * \param position the position
+   * \return the coordinates of the cell
+   */
+  std::pair<int64_t, int64_t> GetCell (Vector position) const;
+
+  /**
+   * Collect the receivers which may be within the maximum interference
+   * range of a transmitter, in the order of m_phyList
+   * \param senderMobility the mobility model of the transmitter, or 0
+   * \param candidates filled with the indices of the receivers in m_phyList
+   */
+  void GetCandidateReceivers (Ptr<MobilityModel> senderMobility, std::vector<std::size_t> &candidates);
+
+  /**
+   * Check if a receiver has to be treated with the far-field approximation
+   * \param txParams the transmitted signal
+   * \param receiver the receiver SpectrumPhy
+   * \param distance the distance between the transmitter and the receiver
+   * \return true if the receiver is in the far field and it is not the
+   *         destination of the signal
+   */
+  bool IsFarField (Ptr<const SpectrumSignalParameters> txParams, Ptr<SpectrumPhy> receiver, double distance) const;
+
+  /**
+   * Add a far-field signal to the aggregate of its spatial cell
+   * \param rxIndex the index of the receiver in m_phyList
+   * \param txPosition the position of the transmitter
+   * \param rxParams the signal seen by the receiver
+   * \param delay the propagation delay
+   */
+  void AddFarFieldSignal (std::size_t rxIndex, Vector txPosition, Ptr<SpectrumSignalParameters> rxParams, Time delay);
+
+  /**
+   * Deliver the aggregated far-field signals of the current time step
+   */
+  void ScheduleFarFieldSignals ();
+
+  /**
+   * Gain of a link in a coherence interval
+   */
+  struct LinkGain
+  {
+    std::vector<double> m_gains; //!< gain of each band, negative if unknown
+    uint64_t m_txBeamId; //!< identifier of the tx beam
+    uint64_t m_rxBeamId; //!< identifier of the rx beam
+    int64_t m_interval; //!< index of the coherence interval
+    Time m_delay; //!< the propagation delay
+  };
+
+  /**
+   * Returns the identifier of the current beam of an antenna
+   * \param antenna the antenna
+   * \return the beam identifier, 0 if the antenna does not support beamforming
+   */
+  static uint64_t GetBeamId (Ptr<const AntennaModel> antenna);
+
+  /**
+   * Returns the index of the current coherence interval
+   * \return the index
+   */
+  int64_t GetCoherenceInterval () const;
+
+  /**
+   * Compute the rx PSD of a link from the cached gains, if available
+   * \param txIndex the index of the transmitter in m_phyList
+   * \param rxIndex the index of the receiver in m_phyList
+   * \param txBeamId the identifier of the tx beam
+   * \param rxBeamId the identifier of the rx beam
+   * \param rxPsd a copy of the tx PSD, scaled by the gains if available
+   * \param delay set to the propagation delay if the gains are available
+   * \return true if the gains are available
+   */
+  bool ApplyLinkGain (std::size_t txIndex, std::size_t rxIndex, uint64_t txBeamId, uint64_t rxBeamId,
+                      SpectrumValue &rxPsd, Time &delay);
+
+  /**
+   * Store the gains of a link for the current coherence interval
+   * \param txIndex the index of the transmitter in m_phyList
+   * \param rxIndex the index of the receiver in m_phyList
+   * \param txBeamId the identifier of the tx beam
+   * \param rxBeamId the identifier of the rx beam
+   * \param txPsd the tx PSD
+   * \param rxPsd the rx PSD
+   * \param delay the propagation delay
+   */
+  void StoreLinkGain (std::size_t txIndex, std::size_t rxIndex, uint64_t txBeamId, uint64_t rxBeamId,
+                      const SpectrumValue &txPsd, const SpectrumValue &rxPsd, Time delay);
+
+  /**
+   * Aggregate of the far-field signals from a spatial cell
+   */
+  struct FarFieldAggregate
+  {
+    Ptr<SpectrumSignalParameters> m_params; //!< the aggregated signal
+    Time m_delay; //!< the propagation delay of the first signal
+  };
+
+  /**
+   * Key of the aggregates: index of the receiver, coordinates of the cell
+   * and duration of the signals
+   */
+  typedef std::tuple<std::size_t, int64_t, int64_t, Time> FarFieldKey;
+
+  typedef std::vector<Ptr<SpectrumPhy> > PhyList; //!< list of SpectrumPhy instances
+
+  PhyList m_phyList; //!< list of the SpectrumPhy instances attached to the channel
+  Ptr<const SpectrumModel> m_spectrumModel; //!< the SpectrumModel used by all the attached instances
+  uint32_t m_workerThreads; //!< number of threads used to compute the rx PSDs
+  Ptr<MmWaveVehicularWorkerPool> m_workerPool; //!< the worker pool, created on the first transmission
+  double m_maxInterferenceRange; //!< maximum distance of the receivers of a transmission, 0 for no limit
+  Time m_gridUpdatePeriod; //!< minimum time between two updates of the grid
+  Time m_lastGridUpdate; //!< time of the last update of the grid
+  bool m_gridValid; //!< false if the grid has to be rebuilt
+  double m_maxSpeed; //!< maximum speed of the receivers at the last update of the grid
+  std::map<std::pair<int64_t, int64_t>, std::vector<std::size_t> > m_grid; //!< indices of the receivers in each cell, in increasing order
+  std::vector<std::pair<int64_t, int64_t> > m_phyCell; //!< cell of each receiver
+  std::vector<std::size_t> m_noMobility; //!< indices of the receivers without mobility model
+  Time m_coherenceTime; //!< duration of the coherence interval of the cached gains, 0 to disable the cache
+  std::map<Ptr<SpectrumPhy>, std::size_t> m_phyIndex; //!< index of each SpectrumPhy in m_phyList
+  std::map<std::pair<std::size_t, std::size_t>, LinkGain> m_linkGains; //!< gains of the links used in the current coherence interval
+  uint64_t m_numCachedLinkGains; //!< number of signals computed with the cached gains
+  double m_farFieldRadius; //!< distance beyond which the far-field approximation is used, 0 to disable it
+  double m_farFieldCellSize; //!< side of the spatial cells used to aggregate the far-field signals
+  double m_farFieldFixedBeamGainDb; //!< fixed beamforming gain of the far-field signals in dB
+  bool m_farFieldValidation; //!< if true, the exact PSD of the far-field signals is computed to evaluate the error
+  std::map<FarFieldKey, FarFieldAggregate> m_farFieldAggregates; //!< the far-field signals of the current time step
+  uint64_t m_numFarFieldSignals; //!< number of far-field signals
+  uint64_t m_numFarFieldAggregates; //!< number of delivered aggregates
+  double m_farFieldApproxPower; //!< total power of the validated far-field signals, approximated
+  double m_farFieldExactPower; //!< total power of the validated far-field signals, exact
+};
+
+} // namespace millicar
+} // namespace ns3
+
+#endif /* MMWAVE_VEHICULAR_SPECTRUM_CHANNEL_H */
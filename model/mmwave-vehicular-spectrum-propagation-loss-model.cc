@@ -21,6 +21,7 @@
 */
 
 #include "mmwave-vehicular-spectrum-propagation-loss-model.h"
+#include "mmwave-vehicular-channel-trace.h"
 #include <ns3/log.h>
 #include <ns3/math.h>
 #include <ns3/simulator.h>
@@ -30,6 +31,9 @@
 #include <random>       // std::default_random_engine
 #include <ns3/boolean.h>
 #include <ns3/integer.h>
+#include <ns3/uinteger.h>
+#include <ns3/enum.h>
+#include <ns3/string.h>
 
 namespace ns3 {
 
@@ -93,6 +97,8 @@ static const double oxygen_loss[17][2] = {
 };
 
 MmWaveVehicularSpectrumPropagationLossModel::MmWaveVehicularSpectrumPropagationLossModel ()
+  : m_psdPoolNext (0),
+    m_nextDeviceIndex (0)
 {
   m_uniformRv = CreateObject<UniformRandomVariable> ();
   m_uniformRvBlockage = CreateObject<UniformRandomVariable> ();
@@ -151,6 +157,32 @@ MmWaveVehicularSpectrumPropagationLossModel::GetTypeId (void)
                    BooleanValue (false),
                    MakeBooleanAccessor (&MmWaveVehicularSpectrumPropagationLossModel::m_o2i),
                    MakeBooleanChecker ())
+    .AddAttribute ("ChannelTraceMode",
+                   "Record the channel realizations in the channel trace file, or replay them from it",
+                   EnumValue (TRACE_DISABLED),
+                   MakeEnumAccessor (&MmWaveVehicularSpectrumPropagationLossModel::m_channelTraceMode),
+                   MakeEnumChecker (TRACE_DISABLED, "Disabled",
+                                    TRACE_RECORD, "Record",
+                                    TRACE_REPLAY, "Replay"))
+    .AddAttribute ("ChannelTraceFile",
+                   "The name of the channel trace file",
+                   StringValue ("channel-trace.bin"),
+                   MakeStringAccessor (&MmWaveVehicularSpectrumPropagationLossModel::m_channelTraceFile),
+                   MakeStringChecker ())
+    .AddAttribute ("PsdPoolSize",
+                   "Maximum number of buffers kept to store the received PSDs, "
+                   "which are reused once the receivers release them. Set to 0 "
+                   "to allocate a new PSD for each received signal",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&MmWaveVehicularSpectrumPropagationLossModel::m_psdPoolSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("WidebandGain",
+                   "If true, a single BF gain, given by the sum of the power of the clusters, "
+                   "is applied to all the bands, neglecting the frequency selectivity. "
+                   "Meant to be used with the ScalarAbstraction of the MmWaveSidelinkSpectrumPhy",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MmWaveVehicularSpectrumPropagationLossModel::m_widebandGain),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
@@ -164,6 +196,20 @@ void
 MmWaveVehicularSpectrumPropagationLossModel::DoDispose ()
 {
   NS_LOG_FUNCTION (this);
+  m_chainedNext = 0;
+  // the index of the channel trace is written when the writer is destroyed
+  m_traceWriter = 0;
+  m_traceReader = 0;
+  m_psdPool.clear ();
+  m_mobilityContextMap.clear ();
+}
+
+void
+MmWaveVehicularSpectrumPropagationLossModel::SetNext (Ptr<SpectrumPropagationLossModel> next)
+{
+  NS_LOG_FUNCTION (this << next);
+  m_chainedNext = next;
+  SpectrumPropagationLossModel::SetNext (next);
 }
 
 void
@@ -173,6 +219,65 @@ MmWaveVehicularSpectrumPropagationLossModel::AddDevice (Ptr<NetDevice> dev, Ptr<
   m_deviceAntennaMap.insert (std::pair <Ptr<NetDevice>, Ptr<MmWaveVehicularAntennaArrayModel>> (dev, antenna));
 }
 
+void
+MmWaveVehicularSpectrumPropagationLossModel::AddDevice (Ptr<MmWaveVehicularDeviceContext> context)
+{
+  NS_ASSERT_MSG (m_mobilityContextMap.find (context->m_mobility) == m_mobilityContextMap.end (), "The context of the mobility model is already present in the map");
+  AddDevice (context->m_device, context->m_antenna);
+  context->m_index = m_nextDeviceIndex++;
+  m_mobilityContextMap[context->m_mobility] = context;
+}
+
+Ptr<const MmWaveVehicularDeviceContext>
+MmWaveVehicularSpectrumPropagationLossModel::GetDeviceContext (Ptr<const MobilityModel> mobility) const
+{
+  auto it = m_mobilityContextMap.find (mobility);
+  if (it != m_mobilityContextMap.end ())
+    {
+      return it->second;
+    }
+
+  // the device was added without its context
+  Ptr<MmWaveVehicularDeviceContext> context = Create<MmWaveVehicularDeviceContext> ();
+  context->m_device = mobility->GetObject<Node> ()->GetDevice (0);
+  NS_ASSERT_MSG (m_deviceAntennaMap.find (context->m_device) != m_deviceAntennaMap.end (), "Antenna not found for device " << context->m_device);
+  context->m_antenna = m_deviceAntennaMap.at (context->m_device);
+  context->m_mobility = mobility->GetObject<MobilityModel> ();
+  context->m_rnti = 0; // unknown
+  context->m_index = m_nextDeviceIndex++;
+  m_mobilityContextMap[mobility] = context;
+  return context;
+}
+
+Ptr<MmWaveVehicularAntennaArrayModel>
+MmWaveVehicularSpectrumPropagationLossModel::GetAntenna (Ptr<NetDevice> device) const
+{
+  auto it = m_deviceAntennaMap.find (device);
+  if (it == m_deviceAntennaMap.end ())
+    {
+      return 0;
+    }
+  return it->second;
+}
+
+Ptr<const Params3gpp>
+MmWaveVehicularSpectrumPropagationLossModel::GetCachedChannel (Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, bool &reverse) const
+{
+  // as in GetChannel, the two directions of a link share the same realization
+  reverse = false;
+  auto it = m_channelMap.find (std::make_pair (txDevice, rxDevice));
+  if (it == m_channelMap.end ())
+    {
+      it = m_channelMap.find (std::make_pair (rxDevice, txDevice));
+      reverse = true;
+    }
+  if (it == m_channelMap.end () || it->second->m_channel.size () == 0)
+    {
+      return 0;
+    }
+  return it->second;
+}
+
 Ptr<SpectrumValue>
 MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<const SpectrumValue> txPsd,
                                                  Ptr<const MobilityModel> a,
@@ -183,46 +288,282 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
   // check if the frequency is correctly set
   NS_ASSERT_MSG (m_frequency != 0.0, "Set the operating frequency first!");
 
-  Ptr<SpectrumValue> rxPsd = Copy (txPsd);
+  TxInfo txInfo = GetTxInfo (a);
+  LinkInfo link = PrepareLink (txPsd, txInfo, a, b);
+  ComputeLink (link);
+  LogBeamformingGain (txPsd, txInfo, link, a, b);
+  return link.m_rxPsd;
+}
 
-  Ptr<NetDevice> txDevice = a->GetObject<Node> ()->GetDevice (0);
-  Ptr<NetDevice> rxDevice = b->GetObject<Node> ()->GetDevice (0);
+std::vector<Ptr<SpectrumValue> >
+MmWaveVehicularSpectrumPropagationLossModel::CalcRxPowerSpectralDensityMulti (Ptr<const SpectrumValue> txPsd,
+                                                                              Ptr<const MobilityModel> a,
+                                                                              const std::vector<Ptr<const MobilityModel> > &receivers,
+                                                                              Ptr<MmWaveVehicularWorkerPool> pool) const
+{
+  NS_LOG_FUNCTION (this << receivers.size ());
 
-  Vector locUT = b->GetPosition (); // TODO change this
+  // check if the frequency is correctly set
+  NS_ASSERT_MSG (m_frequency != 0.0, "Set the operating frequency first!");
 
-  // retrieve the antenna of the tx device
-  NS_ASSERT_MSG (m_deviceAntennaMap.find (txDevice) != m_deviceAntennaMap.end (), "Antenna not found for device " << txDevice);
-  Ptr<MmWaveVehicularAntennaArrayModel> txAntennaArray = m_deviceAntennaMap.at (txDevice);
-  NS_LOG_DEBUG ("tx dev " << txDevice << " antenna " << txAntennaArray);
+  // the tx side is resolved only once for all the receivers
+  TxInfo txInfo = GetTxInfo (a);
 
-  // retrieve the antenna of the rx device
-  NS_ASSERT_MSG (m_deviceAntennaMap.find (txDevice) != m_deviceAntennaMap.end (), "Antenna not found for device " << rxDevice);
-  Ptr<MmWaveVehicularAntennaArrayModel> rxAntennaArray = m_deviceAntennaMap.at (rxDevice);
-  NS_LOG_DEBUG ("rx dev " << rxDevice << " antenna " << rxAntennaArray);
+  // the channel map and the random variables are only accessed in this
+  // loop, always in the same order, so that the results do not depend on
+  // the number of threads
+  std::vector<LinkInfo> links;
+  links.reserve (receivers.size ());
+  for (auto b : receivers)
+    {
+      links.push_back (PrepareLink (txPsd, txInfo, a, b));
+    }
+
+  if (pool)
+    {
+      pool->ParallelFor (links.size (), [this, &links] (uint32_t i)
+                         {
+                           ComputeLink (links[i]);
+                         });
+    }
+  else
+    {
+      for (auto &link : links)
+        {
+          ComputeLink (link);
+        }
+    }
+
+  std::vector<Ptr<SpectrumValue> > rxPsds;
+  rxPsds.reserve (receivers.size ());
+  for (std::size_t i = 0; i < links.size (); ++i)
+    {
+      LogBeamformingGain (txPsd, txInfo, links.at (i), a, receivers.at (i));
+      rxPsds.push_back (links.at (i).m_rxPsd);
+    }
+
+  // the chained models are applied as in CalcRxPowerSpectralDensity
+  if (m_chainedNext)
+    {
+      for (std::size_t i = 0; i < receivers.size (); ++i)
+        {
+          rxPsds[i] = m_chainedNext->CalcRxPowerSpectralDensity (rxPsds[i], a, receivers[i]);
+        }
+    }
+  return rxPsds;
+}
+
+void
+MmWaveVehicularSpectrumPropagationLossModel::ComputeGainMatrix (Ptr<const SpectrumModel> sm,
+                                                                const std::vector<Ptr<const MobilityModel> > &nodes,
+                                                                double *gains,
+                                                                Ptr<MmWaveVehicularWorkerPool> pool) const
+{
+  NS_LOG_FUNCTION (this << nodes.size ());
+
+  Ptr<SpectrumValue> ones = Create<SpectrumValue> (sm);
+  (*ones) = 1.0;
+
+  for (uint32_t i = 0; i < nodes.size (); ++i)
+    {
+      ComputeGainRow (ones, i, nodes, gains + i * nodes.size (), pool);
+    }
+}
+
+void
+MmWaveVehicularSpectrumPropagationLossModel::ComputeStrongestNeighbors (Ptr<const SpectrumModel> sm,
+                                                                        const std::vector<Ptr<const MobilityModel> > &nodes,
+                                                                        uint32_t k,
+                                                                        uint32_t *indices,
+                                                                        double *gains,
+                                                                        Ptr<MmWaveVehicularWorkerPool> pool) const
+{
+  NS_LOG_FUNCTION (this << nodes.size () << k);
+
+  Ptr<SpectrumValue> ones = Create<SpectrumValue> (sm);
+  (*ones) = 1.0;
+
+  std::vector<double> row (nodes.size ());
+  std::vector<uint32_t> order;
+  order.reserve (nodes.size ());
+  for (uint32_t i = 0; i < nodes.size (); ++i)
+    {
+      ComputeGainRow (ones, i, nodes, row.data (), pool);
+
+      order.clear ();
+      for (uint32_t j = 0; j < nodes.size (); ++j)
+        {
+          if (j != i)
+            {
+              order.push_back (j);
+            }
+        }
+      uint32_t numNeighbors = std::min<std::size_t> (k, order.size ());
+      std::partial_sort (order.begin (), order.begin () + numNeighbors, order.end (),
+                         [&row] (uint32_t l, uint32_t r)
+                         {
+                           return row[l] > row[r];
+                         });
+
+      for (uint32_t n = 0; n < k; ++n)
+        {
+          indices[i * k + n] = n < numNeighbors ? order[n] : UINT32_MAX;
+          gains[i * k + n] = n < numNeighbors ? row[order[n]] : 0.0;
+        }
+    }
+}
+
+void
+MmWaveVehicularSpectrumPropagationLossModel::ComputeGainRow (Ptr<const SpectrumValue> ones,
+                                                             uint32_t tx,
+                                                             const std::vector<Ptr<const MobilityModel> > &nodes,
+                                                             double *row,
+                                                             Ptr<MmWaveVehicularWorkerPool> pool) const
+{
+  // check if the frequency is correctly set
+  NS_ASSERT_MSG (m_frequency != 0.0, "Set the operating frequency first!");
+
+  // the links with the same transmitter use different channel realizations,
+  // hence they can be computed in parallel, while the links in the opposite
+  // direction share the realization and are computed in another row
+  Ptr<const MobilityModel> a = nodes.at (tx);
+  TxInfo txInfo = GetTxInfo (a);
+  std::vector<LinkInfo> links (nodes.size ());
+  for (uint32_t j = 0; j < nodes.size (); ++j)
+    {
+      if (j != tx)
+        {
+          links[j] = PrepareLink (ones, txInfo, a, nodes.at (j));
+        }
+    }
+
+  double numBands = ones->GetSpectrumModel ()->GetNumBands ();
+  auto computeGain = [this, &links, row, tx, numBands] (uint32_t j)
+    {
+      if (j == tx)
+        {
+          row[j] = 0.0;
+          return;
+        }
+      ComputeLink (links[j]);
+      row[j] = Sum (*links[j].m_rxPsd) / numBands;
+    };
+
+  if (pool)
+    {
+      pool->ParallelFor (links.size (), computeGain);
+    }
+  else
+    {
+      for (uint32_t j = 0; j < links.size (); ++j)
+        {
+          computeGain (j);
+        }
+    }
+}
+
+MmWaveVehicularSpectrumPropagationLossModel::TxInfo
+MmWaveVehicularSpectrumPropagationLossModel::GetTxInfo (Ptr<const MobilityModel> a) const
+{
+  TxInfo txInfo;
+  Ptr<const MmWaveVehicularDeviceContext> context = GetDeviceContext (a);
+  txInfo.m_device = context->m_device;
+  txInfo.m_antenna = context->m_antenna;
+  txInfo.m_mobility = context->m_mobility;
+  NS_LOG_DEBUG ("tx dev " << txInfo.m_device << " antenna " << txInfo.m_antenna);
 
   /* txAntennaNum[0]-number of vertical antenna elements
    * txAntennaNum[1]-number of horizontal antenna elements*/
   // NOTE: only squared antenna arrays are currently supported
-  uint16_t txAntennaNum[2];
-  txAntennaNum[0] = sqrt (txAntennaArray->GetTotNoArrayElements ());
-  txAntennaNum[1] = txAntennaNum[0];
-  NS_LOG_DEBUG ("number of tx antenna elements " << txAntennaNum[0] << " x " << txAntennaNum[1]);
+  txInfo.m_antennaNum[0] = sqrt (txInfo.m_antenna->GetTotNoArrayElements ());
+  txInfo.m_antennaNum[1] = txInfo.m_antennaNum[0];
+  NS_LOG_DEBUG ("number of tx antenna elements " << txInfo.m_antennaNum[0] << " x " << txInfo.m_antennaNum[1]);
+
+  txInfo.m_bfVector = txInfo.m_antenna->GetBeamformingVectorPanel ();
+  txInfo.m_beamId = txInfo.m_antenna->GetBeamId ();
+  txInfo.m_speed = a->GetVelocity ();
+  return txInfo;
+}
 
-  uint16_t rxAntennaNum[2];
-  rxAntennaNum[0] = sqrt (rxAntennaArray->GetTotNoArrayElements ());
-  rxAntennaNum[1] = rxAntennaNum[0];
-  NS_LOG_DEBUG ("number of rx antenna elements " << rxAntennaNum[0] << " x " << rxAntennaNum[1]);
+MmWaveVehicularSpectrumPropagationLossModel::LinkInfo
+MmWaveVehicularSpectrumPropagationLossModel::PrepareLink (Ptr<const SpectrumValue> txPsd,
+                                                          const TxInfo &txInfo,
+                                                          Ptr<const MobilityModel> a,
+                                                          Ptr<const MobilityModel> b) const
+{
+  NS_LOG_FUNCTION (this);
+
+  LinkInfo link;
+  link.m_rxPsd = GetPsdBuffer (txPsd);
+
+  Ptr<const MmWaveVehicularDeviceContext> rxContext = GetDeviceContext (b);
+  Ptr<NetDevice> rxDevice = rxContext->m_device;
+  Ptr<MmWaveVehicularAntennaArrayModel> txAntennaArray = txInfo.m_antenna;
+  Ptr<MmWaveVehicularAntennaArrayModel> rxAntennaArray = rxContext->m_antenna;
+  NS_LOG_DEBUG ("rx dev " << rxDevice << " antenna " << rxAntennaArray);
+  link.m_rxAntenna = rxAntennaArray;
 
   if (txAntennaArray->IsOmniTx () || rxAntennaArray->IsOmniTx () )
     {
       NS_LOG_LOGIC ("Omni transmission, do nothing.");
-      return rxPsd;
+      return link;
     }
 
   NS_ASSERT_MSG (a->GetDistanceFrom (b) != 0, "The position of tx and rx devices cannot be the same");
 
   Vector rxSpeed = b->GetVelocity ();
-  Vector txSpeed = a->GetVelocity ();
+  Vector txSpeed = txInfo.m_speed;
+
+  Ptr<Params3gpp> channelParams = GetChannel (txInfo, rxAntennaArray, a, b);
+
+  // the long term component is still valid if the channel and the BF
+  // vectors did not change, otherwise it is recomputed by ComputeLink
+  uint64_t rxBeamId = rxAntennaArray->GetBeamId ();
+  if (txInfo.m_beamId == 0 || rxBeamId == 0
+      || channelParams->m_longTermTxBeamId != txInfo.m_beamId
+      || channelParams->m_longTermRxBeamId != rxBeamId)
+    {
+      // for now, store these BF vectors so that CalLongTerm can use them
+      channelParams->m_txW = txInfo.m_bfVector;
+      channelParams->m_rxW = rxAntennaArray->GetBeamformingVectorPanel ();
+      channelParams->m_longTerm.clear ();
+      channelParams->m_longTermTxBeamId = txInfo.m_beamId;
+      channelParams->m_longTermRxBeamId = rxBeamId;
+    }
+
+  // the Doppler terms use the random variables, hence they are computed here
+  link.m_doppler = CalDoppler (channelParams, rxSpeed, txSpeed);
+  link.m_params = channelParams;
+  return link;
+}
+
+Ptr<Params3gpp>
+MmWaveVehicularSpectrumPropagationLossModel::GetChannel (const TxInfo &txInfo,
+                                                         Ptr<MmWaveVehicularAntennaArrayModel> rxAntennaArray,
+                                                         Ptr<const MobilityModel> a,
+                                                         Ptr<const MobilityModel> b) const
+{
+  NS_LOG_FUNCTION (this);
+
+  Ptr<const MmWaveVehicularDeviceContext> rxContext = GetDeviceContext (b);
+  Ptr<NetDevice> txDevice = txInfo.m_device;
+  Ptr<NetDevice> rxDevice = rxContext->m_device;
+
+  Vector locUT = b->GetPosition (); // TODO change this
+
+  Ptr<MmWaveVehicularAntennaArrayModel> txAntennaArray = txInfo.m_antenna;
+
+  uint16_t txAntennaNum[2];
+  txAntennaNum[0] = txInfo.m_antennaNum[0];
+  txAntennaNum[1] = txInfo.m_antennaNum[1];
+
+  uint16_t rxAntennaNum[2];
+  rxAntennaNum[0] = sqrt (rxAntennaArray->GetTotNoArrayElements ());
+  rxAntennaNum[1] = rxAntennaNum[0];
+  NS_LOG_DEBUG ("number of rx antenna elements " << rxAntennaNum[0] << " x " << rxAntennaNum[1]);
+
+  Vector rxSpeed = b->GetVelocity ();
+  Vector txSpeed = txInfo.m_speed;
   Vector relativeSpeed (rxSpeed.x - txSpeed.x,rxSpeed.y - txSpeed.y,rxSpeed.z - txSpeed.z);
 
   key_t key = std::make_pair (txDevice,rxDevice);
@@ -236,10 +577,9 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
   //Step 2: Assign propagation condition (LOS/NLOS).
 
   char condition;
-  if (DynamicCast<MmWaveVehicularPropagationLossModel> (m_3gppPathloss) != 0)
+  if (m_vehicularPathloss != 0)
     {
-      condition = m_3gppPathloss->GetObject<MmWaveVehicularPropagationLossModel> ()
-        ->GetChannelCondition (a->GetObject<MobilityModel> (),b->GetObject<MobilityModel> ());
+      condition = m_vehicularPathloss->GetChannelCondition (txInfo.m_mobility, rxContext->m_mobility);
     }
   // else if (DynamicCast<MmWave3gppBuildingsPropagationLossModel> (m_3gppPathloss) != 0)
   //   {
@@ -297,9 +637,26 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
       //Draw parameters from table 7.5-6 and 7.5-7 to 7.5-10.
       Ptr<ParamsTable> table3gpp = Get3gppTable (condition, o2i, hTx, hRx, distance2D);
 
+      // the realization read from the trace may be the one of the reverse link
+      bool reverse = false;
+      if (m_channelTraceMode == TRACE_REPLAY)
+        {
+          channelParams = ReadChannelFromTrace (txDevice, rxDevice, reverse);
+        }
+
       // Step 4-11 are performed in function GetNewChannel()
-      if ((it == m_channelMap.end () && itReverse == m_channelMap.end ())
-          || (it != m_channelMap.end () && it->second->m_channel.size () == 0))
+      if (reverse)
+        {
+          if (m_updatePeriod.GetMilliSeconds () > 0
+              && (itReverse == m_channelMap.end () || itReverse->second->m_channel.size () == 0))
+            {
+              NS_LOG_INFO ("Time " << Simulator::Now ().GetSeconds () << " schedule delete for a " << b->GetPosition () << " b " << a->GetPosition ()
+                                   << " m_updatePeriod " << m_updatePeriod.GetSeconds ());
+              Simulator::Schedule (m_updatePeriod, &MmWaveVehicularSpectrumPropagationLossModel::DeleteChannel,this,b,a);
+            }
+        }
+      else if ((it == m_channelMap.end () && itReverse == m_channelMap.end ())
+               || (it != m_channelMap.end () && it->second->m_channel.size () == 0))
         {
           //delete the channel parameter to cause the channel to be updated again.
           //The m_updatePeriod can be configured to be relatively large in order to disable updates.
@@ -314,7 +671,26 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
       double distance3D = a->GetDistanceFrom (b);
 
       bool channelUpdate = false;
-      if (it != m_channelMap.end () && it->second->m_channel.size () == 0)
+      if (m_channelTraceMode == TRACE_REPLAY)
+        {
+          // nothing is generated, the realization has been read from the trace
+          channelParams->m_o2i = o2i;
+          channelParams->m_dis2D = distance2D;
+          if (reverse)
+            {
+              // the realization has been recorded with the roles of the
+              // devices swapped
+              channelParams->m_locUT = a->GetPosition ();
+              channelParams->m_speed = Vector (-relativeSpeed.x, -relativeSpeed.y, -relativeSpeed.z);
+            }
+          else
+            {
+              channelParams->m_locUT = locUT;
+              channelParams->m_speed = relativeSpeed;
+            }
+          channelParams->m_preLocUT = channelParams->m_locUT;
+        }
+      else if (it != m_channelMap.end () && it->second->m_channel.size () == 0)
         {
           //if the channel map is not empty, we only update the channel.
           NS_LOG_DEBUG ("Update forward channel consistently between MobilityModel " << a << " " << b);
@@ -340,6 +716,24 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
 
       NS_LOG_DEBUG (" --- UPDATE BF VECTOR and LONGTERM vectors --- for new or update? " << channelUpdate);
 
+      if (m_channelTraceMode == TRACE_RECORD)
+        {
+          WriteChannelToTrace (txDevice, rxDevice, channelParams);
+        }
+
+      // the channel matrix changed, the long term component has to be recomputed
+      channelParams->m_longTerm.clear ();
+
+      if (reverse)
+        {
+          // the realization is stored as the one of the reverse link, as if it
+          // had been generated when the roles of the devices were swapped
+          m_channelMap.erase (key);
+          m_channelMap[keyReverse] = channelParams;
+          SelectPanelChannel (*channelParams, rxAntennaArray, txAntennaArray);
+          return channelParams;
+        }
+
       // insert the channelParams in the map
       m_channelMap[key] = channelParams;
     }
@@ -353,52 +747,106 @@ MmWaveVehicularSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<c
       channelParams = (*itReverse).second;
 
       NS_LOG_DEBUG ("No need to update the channel");
+
+      // the realization of the reverse link is shared, the roles of the devices are swapped
+      SelectPanelChannel (*channelParams, rxAntennaArray, txAntennaArray);
+      return channelParams;
+    }
+
+  SelectPanelChannel (*channelParams, txAntennaArray, rxAntennaArray);
+  return channelParams;
+}
+
+void
+MmWaveVehicularSpectrumPropagationLossModel::ComputeLink (LinkInfo &link) const
+{
+  if (link.m_params == 0)
+    {
+      // omni transmission, nothing to do
+      return;
     }
 
-  // for now, store these BF vectors so that CalLongTerm can use them
-  channelParams->m_txW = txAntennaArray->GetBeamformingVectorPanel ();
-  channelParams->m_rxW = rxAntennaArray->GetBeamformingVectorPanel ();
+  // NOTE: this method may run on a worker thread, thus it must not copy the
+  // Ptr members of link, since the reference counting is not thread safe
+  Params3gpp &params = *link.m_params;
 
   // call CalLongTerm, and get the longTerm params
-  auto longTerm = CalLongTerm (channelParams);
+  if (params.m_longTerm.empty ())
+    {
+      params.m_longTerm = CalLongTerm (params);
+    }
 
-  channelParams->m_longTerm = longTerm;
+  if (m_widebandGain)
+    {
+      CalWidebandBeamformingGain (*link.m_rxPsd, params, params.m_longTerm);
+      return;
+    }
+  CalBeamformingGain (*link.m_rxPsd, params, params.m_longTerm, link.m_doppler);
+}
 
-  Ptr<SpectrumValue> bfPsd = CalBeamformingGain (rxPsd, channelParams, longTerm, rxSpeed, txSpeed);
+void
+MmWaveVehicularSpectrumPropagationLossModel::LogBeamformingGain (Ptr<const SpectrumValue> txPsd,
+                                                                 const TxInfo &txInfo,
+                                                                 const LinkInfo &link,
+                                                                 Ptr<const MobilityModel> a,
+                                                                 Ptr<const MobilityModel> b) const
+{
+  if (link.m_params == 0 || !g_log.IsEnabled (LOG_DEBUG))
+    {
+      return;
+    }
 
-  SpectrumValue bfGain = (*bfPsd) / (*rxPsd);
+  SpectrumValue bfGain = (*link.m_rxPsd) / (*txPsd);
   uint8_t nbands = bfGain.GetSpectrumModel ()->GetNumBands ();
 
-  NS_LOG_DEBUG ("****** BF gain == " << Sum (bfGain) / nbands << " RX PSD " << Sum (*rxPsd) / nbands
+  NS_LOG_DEBUG ("****** BF gain == " << Sum (bfGain) / nbands << " RX PSD " << Sum (*txPsd) / nbands
                                         << " a pos " << a->GetPosition ()
-                                        << " a antenna ID " << txAntennaArray->GetPlanesId ()
+                                        << " a antenna ID " << txInfo.m_antenna->GetPlanesId ()
                                         << " b pos " << b->GetPosition ()
-                                        << " b antenna ID " << rxAntennaArray->GetPlanesId ());
-  return bfPsd;
+                                        << " b antenna ID " << link.m_rxAntenna->GetPlanesId ());
 }
 
 Ptr<SpectrumValue>
-MmWaveVehicularSpectrumPropagationLossModel::CalBeamformingGain (Ptr<const SpectrumValue> txPsd, Ptr<Params3gpp> params,
-                                       complexVector_t longTerm, Vector rxSpeed, Vector txSpeed) const
+MmWaveVehicularSpectrumPropagationLossModel::GetPsdBuffer (Ptr<const SpectrumValue> txPsd) const
 {
-  NS_LOG_FUNCTION (this);
+  if (m_psdPool.size () > m_psdPoolSize)
+    {
+      // the size of the pool has been reduced
+      m_psdPool.resize (m_psdPoolSize);
+      m_psdPoolNext = 0;
+    }
 
-  Ptr<SpectrumValue> tempPsd = Copy<SpectrumValue> (txPsd);
+  // look for a buffer which is no longer used, starting from the one
+  // following the last returned buffer
+  for (std::size_t n = 0; n < m_psdPool.size (); ++n)
+    {
+      Ptr<SpectrumValue> &buffer = m_psdPool[m_psdPoolNext];
+      m_psdPoolNext = (m_psdPoolNext + 1) % m_psdPool.size ();
+      if (buffer->GetReferenceCount () == 1
+          && buffer->GetSpectrumModelUid () == txPsd->GetSpectrumModelUid ())
+        {
+          // same number of bands, hence the values are copied without allocations
+          *buffer = *txPsd;
+          return buffer;
+        }
+    }
+
+  Ptr<SpectrumValue> buffer = Copy (txPsd);
+  if (m_psdPool.size () < m_psdPoolSize)
+    {
+      m_psdPool.push_back (buffer);
+    }
+  return buffer;
+}
 
-  //NS_ASSERT_MSG (params->m_delay.size()==params->m_channel.at(0).at(0).size(), "the cluster number of channel and delay spread should be the same");
-  //NS_ASSERT_MSG (params->m_txW.size()==params->m_channel.at(0).size(), "the tx antenna size of channel and antenna weights should be the same");
-  //NS_ASSERT_MSG (params->m_rxW.size()==params->m_channel.size(), "the rx antenna size of channel and antenna weights should be the same");
-  //NS_ASSERT_MSG (params->m_angle.at(0).size()==params->m_channel.at(0).at(0).size(), "the cluster number of channel and AOA should be the same");
-  //NS_ASSERT_MSG (params->m_angle.at(1).size()==params->m_channel.at(0).at(0).size(), "the cluster number of channel and ZOA should be the same");
+complexVector_t
+MmWaveVehicularSpectrumPropagationLossModel::CalDoppler (Ptr<Params3gpp> params, Vector rxSpeed, Vector txSpeed) const
+{
+  NS_LOG_FUNCTION (this);
 
   //channel[rx][tx][cluster]
   uint8_t numCluster = params->m_numCluster;
-  //uint8_t txAntenna = params->m_txW.size();
-  //uint8_t rxAntenna = params->m_rxW.size();
   //the update of Doppler is simplified by only taking the center angle of each cluster in to consideration.
-  Values::iterator vit = tempPsd->ValuesBegin ();
-  Bands::const_iterator sbit = tempPsd->ConstBandsBegin(); // sub band iterator
-
   double slotTime = Simulator::Now ().GetSeconds ();
   complexVector_t doppler;
   for (uint8_t cIndex = 0; cIndex < numCluster; cIndex++)
@@ -433,8 +881,25 @@ MmWaveVehicularSpectrumPropagationLossModel::CalBeamformingGain (Ptr<const Spect
       doppler.push_back (exp (std::complex<double> (0, temp_doppler)));
 
     }
+  return doppler;
+}
 
-  while (vit != tempPsd->ValuesEnd ())
+void
+MmWaveVehicularSpectrumPropagationLossModel::CalBeamformingGain (SpectrumValue &psd, const Params3gpp &params,
+                                       const complexVector_t &longTerm, const complexVector_t &doppler) const
+{
+  //NS_ASSERT_MSG (params.m_delay.size()==params.m_channel.at(0).at(0).size(), "the cluster number of channel and delay spread should be the same");
+  //NS_ASSERT_MSG (params.m_txW.size()==params.m_channel.at(0).size(), "the tx antenna size of channel and antenna weights should be the same");
+  //NS_ASSERT_MSG (params.m_rxW.size()==params.m_channel.size(), "the rx antenna size of channel and antenna weights should be the same");
+  //NS_ASSERT_MSG (params.m_angle.at(0).size()==params.m_channel.at(0).at(0).size(), "the cluster number of channel and AOA should be the same");
+  //NS_ASSERT_MSG (params.m_angle.at(1).size()==params.m_channel.at(0).at(0).size(), "the cluster number of channel and ZOA should be the same");
+
+  //channel[rx][tx][cluster]
+  uint8_t numCluster = params.m_numCluster;
+  Values::iterator vit = psd.ValuesBegin ();
+  Bands::const_iterator sbit = psd.ConstBandsBegin(); // sub band iterator
+
+  while (vit != psd.ValuesEnd ())
     {
       std::complex<double> subsbandGain (0.0,0.0);
       if ((*vit) != 0.00)
@@ -442,12 +907,12 @@ MmWaveVehicularSpectrumPropagationLossModel::CalBeamformingGain (Ptr<const Spect
           double fsb = (*sbit).fc;
           for (uint8_t cIndex = 0; cIndex < numCluster; cIndex++)
             {
-              double delay = -2 * M_PI * fsb * (params->m_delay.at (cIndex));
+              double delay = -2 * M_PI * fsb * (params.m_delay.at (cIndex));
               double tauDelta = 0.0;
 
               if(cIndex != 0)
               {
-                tauDelta = params->m_tauDelta; // when in LOS condition, tau_{\Delta} is equal to zero.
+                tauDelta = params.m_tauDelta; // when in LOS condition, tau_{\Delta} is equal to zero.
               }
 
               if(!m_oxygenAbsorption)
@@ -456,7 +921,7 @@ MmWaveVehicularSpectrumPropagationLossModel::CalBeamformingGain (Ptr<const Spect
               }
               else
               {
-                subsbandGain = subsbandGain + longTerm.at (cIndex) * doppler.at (cIndex) * exp (std::complex<double> (0, delay)) / GetOxygenLoss(fsb, params->m_dis3D, params->m_delay.at (cIndex), tauDelta);
+                subsbandGain = subsbandGain + longTerm.at (cIndex) * doppler.at (cIndex) * exp (std::complex<double> (0, delay)) / GetOxygenLoss(fsb, params.m_dis3D, params.m_delay.at (cIndex), tauDelta);
               }
 
             }
@@ -465,14 +930,33 @@ MmWaveVehicularSpectrumPropagationLossModel::CalBeamformingGain (Ptr<const Spect
       vit++;
       sbit++;
     }
-  return tempPsd;
 }
 
+void
+MmWaveVehicularSpectrumPropagationLossModel::CalWidebandBeamformingGain (SpectrumValue &psd, const Params3gpp &params,
+                                                                         const complexVector_t &longTerm) const
+{
+  // the Doppler terms have unit modulus, hence they do not change the power
+  // of the clusters
+  double gain = 0.0;
+  for (uint8_t cIndex = 0; cIndex < params.m_numCluster; cIndex++)
+    {
+      double clusterGain = norm (longTerm.at (cIndex));
+      if (m_oxygenAbsorption)
+        {
+          // as in CalBeamformingGain, evaluated at the carrier frequency
+          double tauDelta = (cIndex != 0) ? params.m_tauDelta : 0.0;
+          double loss = GetOxygenLoss (m_frequency, params.m_dis3D, params.m_delay.at (cIndex), tauDelta);
+          clusterGain /= loss * loss;
+        }
+      gain += clusterGain;
+    }
+  psd *= gain;
+}
 
 double
 MmWaveVehicularSpectrumPropagationLossModel::GetOxygenLoss (double f, double dist3D, double tau, double tauDelta) const
 {
-  NS_LOG_FUNCTION (this << f << dist3D << tau << tauDelta);
   double alpha = 0.0, loss = 0.0;
 
   if(f > oxygen_loss[0][0] && f < oxygen_loss[16][0])
@@ -484,7 +968,6 @@ MmWaveVehicularSpectrumPropagationLossModel::GetOxygenLoss (double f, double dis
         // interpolation of the oxygen_loss table
         alpha = (oxygen_loss[idx][1] - oxygen_loss[idx-1][1])/(oxygen_loss[idx][0] - oxygen_loss[idx-1][0])*(f - oxygen_loss[idx-1][0]) + oxygen_loss[idx-1][1];
         loss = alpha / 1e3 * (dist3D + 3e8 * (tau + tauDelta));
-        NS_LOG_DEBUG ("f (subband) " << f << " alpha " << alpha << " dB/km loss " << loss << " dB");
       }
     }
   }
@@ -497,9 +980,10 @@ void
 MmWaveVehicularSpectrumPropagationLossModel::SetPathlossModel (Ptr<PropagationLossModel> pathloss)
 {
   m_3gppPathloss = pathloss;
-  if (DynamicCast<MmWaveVehicularPropagationLossModel> (m_3gppPathloss) != 0)
+  m_vehicularPathloss = DynamicCast<MmWaveVehicularPropagationLossModel> (m_3gppPathloss);
+  if (m_vehicularPathloss != 0)
     {
-      m_scenario = m_3gppPathloss->GetObject<MmWaveVehicularPropagationLossModel> ()->GetScenario ();
+      m_scenario = m_vehicularPathloss->GetScenario ();
     }
   // else if (DynamicCast<MmWave3gppBuildingsPropagationLossModel> (m_3gppPathloss) != 0)
   //   {
@@ -513,16 +997,15 @@ MmWaveVehicularSpectrumPropagationLossModel::SetPathlossModel (Ptr<PropagationLo
 
 
 complexVector_t
-MmWaveVehicularSpectrumPropagationLossModel::CalLongTerm (Ptr<Params3gpp> params) const
+MmWaveVehicularSpectrumPropagationLossModel::CalLongTerm (const Params3gpp &params) const
 {
-  uint16_t txAntenna = params->m_txW.size ();
-  uint16_t rxAntenna = params->m_rxW.size ();
+  uint16_t txAntenna = params.m_txW.size ();
+  uint16_t rxAntenna = params.m_rxW.size ();
 
-  NS_LOG_DEBUG ("CalLongTerm with txAntenna " << (uint16_t)txAntenna << " rxAntenna " << (uint16_t)rxAntenna);
   //store the long term part to reduce computation load
   //only the small scale fading is need to be updated if the large scale parameters and antenna weights remain unchanged.
   complexVector_t longTerm;
-  uint8_t numCluster = params->m_numCluster;
+  uint8_t numCluster = params.m_numCluster;
 
   for (uint8_t cIndex = 0; cIndex < numCluster; cIndex++)
     {
@@ -532,9 +1015,9 @@ MmWaveVehicularSpectrumPropagationLossModel::CalLongTerm (Ptr<Params3gpp> params
           std::complex<double> rxSum (0,0);
           for (uint16_t rxIndex = 0; rxIndex < rxAntenna; rxIndex++)
             {
-              rxSum = rxSum + params->m_rxW.at (rxIndex) * params->m_channel.at (rxIndex).at (txIndex).at (cIndex);
+              rxSum = rxSum + params.m_rxW.at (rxIndex) * params.m_channel.at (rxIndex).at (txIndex).at (cIndex);
             }
-          txSum = txSum + params->m_txW.at (txIndex) * rxSum;
+          txSum = txSum + params.m_txW.at (txIndex) * rxSum;
         }
       longTerm.push_back (txSum);
     }
@@ -775,14 +1258,15 @@ void
 MmWaveVehicularSpectrumPropagationLossModel::DeleteChannel (Ptr<const MobilityModel> a, Ptr<const MobilityModel> b) const
 {
   NS_LOG_FUNCTION (this);
-  Ptr<NetDevice> dev1 = a->GetObject<Node> ()->GetDevice (0);
-  Ptr<NetDevice> dev2 = b->GetObject<Node> ()->GetDevice (0);
+  Ptr<NetDevice> dev1 = GetDeviceContext (a)->m_device;
+  Ptr<NetDevice> dev2 = GetDeviceContext (b)->m_device;
   NS_LOG_INFO ("a position " << a->GetPosition () << " b " << b->GetPosition ());
   Ptr<Params3gpp> params = m_channelMap.find (std::make_pair (dev1,dev2))->second;
   NS_LOG_INFO ("params " << params);
   NS_LOG_INFO ("params m_channel size" << params->m_channel.size ());
   NS_ASSERT_MSG (m_channelMap.find (std::make_pair (dev1,dev2)) != m_channelMap.end (), "Channel not found");
   params->m_channel.clear ();
+  params->m_panelChannel.clear ();
   m_channelMap[std::make_pair (dev1,dev2)] = params;
 }
 
@@ -1354,11 +1838,6 @@ MmWaveVehicularSpectrumPropagationLossModel::GetNewChannel (Ptr<ParamsTable>  ta
 
   //Step 11: Generate channel coefficients for each cluster n and each receiver and transmitter element pair u,s.
 
-  complex3DVector_t H_NLOS;       // channel coefficients H_NLOS [u][s][n],
-  // where u and s are receive and transmit antenna element, n is cluster index.
-  uint64_t uSize = rxAntennaNum[0] * rxAntennaNum[1];
-  uint64_t sSize = txAntennaNum[0] * txAntennaNum[1];
-
   uint8_t cluster1st = 0, cluster2nd = 0;       // first and second strongest cluster;
   double maxPower = 0;
   for (uint8_t cIndex = 0; cIndex < numReducedCluster; cIndex++)
@@ -1381,170 +1860,33 @@ MmWaveVehicularSpectrumPropagationLossModel::GetNewChannel (Ptr<ParamsTable>  ta
 
   NS_LOG_INFO ("1st strongest cluster:" << (int)cluster1st << ", 2nd strongest cluster:" << (int)cluster2nd);
 
-  complex3DVector_t H_usn;       //channel coffecient H_usn[u][s][n];
-  //Since each of the strongest 2 clusters are divided into 3 sub-clusters, the total cluster will be numReducedCLuster + 4.
-
-  H_usn.resize (uSize);
-  for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
+  // store the rays, so that the channel can be projected on the other panels
+  channelParams->m_rayAoa.assign (numReducedCluster, doubleVector_t (raysPerCluster));
+  channelParams->m_rayZoa.assign (numReducedCluster, doubleVector_t (raysPerCluster));
+  channelParams->m_rayAod.assign (numReducedCluster, doubleVector_t (raysPerCluster));
+  channelParams->m_rayZod.assign (numReducedCluster, doubleVector_t (raysPerCluster));
+  for (uint8_t nIndex = 0; nIndex < numReducedCluster; nIndex++)
     {
-      H_usn.at (uIndex).resize (sSize);
-      for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
+      for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
         {
-          H_usn.at (uIndex).at (sIndex).resize (numReducedCluster);
+          channelParams->m_rayAoa[nIndex][mIndex] = rayAoa_radian[nIndex][mIndex];
+          channelParams->m_rayZoa[nIndex][mIndex] = rayZoa_radian[nIndex][mIndex];
+          channelParams->m_rayAod[nIndex][mIndex] = rayAod_radian[nIndex][mIndex];
+          channelParams->m_rayZod[nIndex][mIndex] = rayZod_radian[nIndex][mIndex];
         }
     }
-  //double slotTime = Simulator::Now ().GetSeconds ();
-  // The following for loops computes the channel coefficients
-  for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
-    {
-      Vector uLoc = rxAntenna->GetAntennaLocation (uIndex,rxAntennaNum);
-
-      for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
-        {
-
-          Vector sLoc = txAntenna->GetAntennaLocation (sIndex,txAntennaNum);
-
-          for (uint8_t nIndex = 0; nIndex < numReducedCluster; nIndex++)
-            {
-              //Compute the N-2 weakest cluster, only vertical polarization. (7.5-22)
-              if (nIndex != cluster1st && nIndex != cluster2nd)
-                {
-                  std::complex<double> rays (0,0);
-                  for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
-                    {
-                      double initialPhase = clusterPhase.at (nIndex).at (mIndex);
-                      //lambda_0 is accounted in the antenna spacing uLoc and sLoc.
-                      double rxPhaseDiff = 2 * M_PI * (sin (rayZoa_radian[nIndex][mIndex]) * cos (rayAoa_radian[nIndex][mIndex]) * uLoc.x
-                                                       + sin (rayZoa_radian[nIndex][mIndex]) * sin (rayAoa_radian[nIndex][mIndex]) * uLoc.y
-                                                       + cos (rayZoa_radian[nIndex][mIndex]) * uLoc.z);
-
-                      double txPhaseDiff = 2 * M_PI * (sin (rayZod_radian[nIndex][mIndex]) * cos (rayAod_radian[nIndex][mIndex]) * sLoc.x
-                                                       + sin (rayZod_radian[nIndex][mIndex]) * sin (rayAod_radian[nIndex][mIndex]) * sLoc.y
-                                                       + cos (rayZod_radian[nIndex][mIndex]) * sLoc.z);
-                      //Doppler is computed in the CalBeamformingGain function and is simplified to only account for the center anngle of each cluster.
-                      //double doppler = 2*M_PI*(sin(rayZoa_radian[nIndex][mIndex])*cos(rayAoa_radian[nIndex][mIndex])*relativeSpeed.x
-                      //		+ sin(rayZoa_radian[nIndex][mIndex])*sin(rayAoa_radian[nIndex][mIndex])*relativeSpeed.y
-                      //		+ cos(rayZoa_radian[nIndex][mIndex])*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-                      rays += exp (std::complex<double> (0, initialPhase))
-                        * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                           * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                        * exp (std::complex<double> (0, rxPhaseDiff))
-                        * exp (std::complex<double> (0, txPhaseDiff));
-                      //*exp(std::complex<double>(0, doppler));
-                      //rays += 1;
-                    }
-                  //rays *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  rays *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  H_usn.at (uIndex).at (sIndex).at (nIndex) = rays;
-                }
-              else                   //(7.5-28)
-                {
-                  std::complex<double> raysSub1 (0,0);
-                  std::complex<double> raysSub2 (0,0);
-                  std::complex<double> raysSub3 (0,0);
-
-                  for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
-                    {
-
-                      //ZML:Just remind me that the angle offsets for the 3 subclusters were not generated correctly.
-
-                      double initialPhase = clusterPhase.at (nIndex).at (mIndex);
-                      double rxPhaseDiff = 2 * M_PI * (sin (rayZoa_radian[nIndex][mIndex]) * cos (rayAoa_radian[nIndex][mIndex]) * uLoc.x
-                                                       + sin (rayZoa_radian[nIndex][mIndex]) * sin (rayAoa_radian[nIndex][mIndex]) * uLoc.y
-                                                       + cos (rayZoa_radian[nIndex][mIndex]) * uLoc.z);
-                      double txPhaseDiff = 2 * M_PI * (sin (rayZod_radian[nIndex][mIndex]) * cos (rayAod_radian[nIndex][mIndex]) * sLoc.x
-                                                       + sin (rayZod_radian[nIndex][mIndex]) * sin (rayAod_radian[nIndex][mIndex]) * sLoc.y
-                                                       + cos (rayZod_radian[nIndex][mIndex]) * sLoc.z);
-                      //double doppler = 2*M_PI*(sin(rayZoa_radian[nIndex][mIndex])*cos(rayAoa_radian[nIndex][mIndex])*relativeSpeed.x
-                      //		+ sin(rayZoa_radian[nIndex][mIndex])*sin(rayAoa_radian[nIndex][mIndex])*relativeSpeed.y
-                      //		+ cos(rayZoa_radian[nIndex][mIndex])*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-                      //double delaySpread;
-                      switch (mIndex)
-                        {
-                        case 9:
-                        case 10:
-                        case 11:
-                        case 12:
-                        case 17:
-                        case 18:
-                          //delaySpread= -2*M_PI*(clusterDelay.at(nIndex)+1.28*c_DS)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub2 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub2 +=1;
-                          break;
-                        case 13:
-                        case 14:
-                        case 15:
-                        case 16:
-                          //delaySpread = -2*M_PI*(clusterDelay.at(nIndex)+2.56*c_DS)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub3 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub3 +=1;
-                          break;
-                        default:                        //case 1,2,3,4,5,6,7,8,19,20
-                                                        //delaySpread = -2*M_PI*clusterDelay.at(nIndex)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub1 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub1 +=1;
-                          break;
-                        }
-                    }
-                  //raysSub1 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  //raysSub2 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  //raysSub3 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  raysSub1 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  raysSub2 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  raysSub3 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  H_usn.at (uIndex).at (sIndex).at (nIndex) = raysSub1;
-                  H_usn.at (uIndex).at (sIndex).push_back (raysSub2);
-                  H_usn.at (uIndex).at (sIndex).push_back (raysSub3);
-
-                }
-            }
-          if (condition == 'l')               //(7.5-29) && (7.5-30)
-            {
-              std::complex<double> ray (0,0);
-              double rxPhaseDiff = 2 * M_PI * (sin (rxAngle.theta) * cos (rxAngle.phi) * uLoc.x
-                                               + sin (rxAngle.theta) * sin (rxAngle.phi) * uLoc.y
-                                               + cos (rxAngle.theta) * uLoc.z);
-              double txPhaseDiff = 2 * M_PI * (sin (txAngle.theta) * cos (txAngle.phi) * sLoc.x
-                                               + sin (txAngle.theta) * sin (txAngle.phi) * sLoc.y
-                                               + cos (txAngle.theta) * sLoc.z);
-              //double doppler = 2*M_PI*(sin(rxAngle.theta)*cos(rxAngle.phi)*relativeSpeed.x
-              //		+ sin(rxAngle.theta)*sin(rxAngle.phi)*relativeSpeed.y
-              //		+ cos(rxAngle.theta)*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-
-              ray = exp (std::complex<double> (0, losPhase))
-                * (rxAntenna->GetRadiationPattern (rxAngle.theta,rxAngle.phi)
-                   * txAntenna->GetRadiationPattern (txAngle.theta,rxAngle.phi))
-                * exp (std::complex<double> (0, rxPhaseDiff))
-                * exp (std::complex<double> (0, txPhaseDiff));
-              //*exp(std::complex<double>(0, doppler));
-
-              double K_linear = pow (10,K_factor / 10);
-              // the LOS path should be attenuated if blockage is enabled.
-              H_usn.at (uIndex).at (sIndex).at (0) = sqrt (1 / (K_linear + 1)) * H_usn.at (uIndex).at (sIndex).at (0) + sqrt (K_linear / (1 + K_linear)) * ray / pow (10,attenuation_dB.at (0) / 10);           //(7.5-30) for tau = tau1
-              double tempSize = H_usn.at (uIndex).at (sIndex).size ();
-              for (uint8_t nIndex = 1; nIndex < tempSize; nIndex++)
-                {
-                  H_usn.at (uIndex).at (sIndex).at (nIndex) *= sqrt (1 / (K_linear + 1));                   //(7.5-30) for tau = tau2...taunN
-                }
+  channelParams->m_clusterPower = clusterPower;
+  channelParams->m_cluster1st = cluster1st;
+  channelParams->m_cluster2nd = cluster2nd;
+  channelParams->m_losAttenuation = attenuation_dB.at (0);
+  channelParams->m_losRxAngle = rxAngle;
+  channelParams->m_losTxAngle = txAngle;
+  channelParams->m_rayPanels = std::make_pair (txAntenna->GetPlanesId (), rxAntenna->GetPlanesId ());
+  channelParams->m_channelPanels = channelParams->m_rayPanels;
+  channelParams->m_panelChannel.clear ();
 
-            }
-        }
-    }
+  complex3DVector_t H_usn = CalChannelCoefficients (*channelParams, txAntenna, rxAntenna,
+                                                    channelParams->m_rayPanels.first, channelParams->m_rayPanels.second);
 
   if (cluster1st == cluster2nd)
     {
@@ -2005,17 +2347,11 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
   //This step is skipped, only vertical polarization is considered in this version
 
   //Step 10: Draw initial phases
-  double2DVector_t clusterPhase = params->m_clusterPhase;       //rayAoa_radian[n][m], where n is cluster index, m is ray index
-  double losPhase = params->m_losPhase;
-  // these two should also be generated from previous channel.
+  // the initial phases of the previous channel, params->m_clusterPhase and
+  // params->m_losPhase, are reused
 
   //Step 11: Generate channel coefficients for each cluster n and each receiver and transmitter element pair u,s.
 
-  complex3DVector_t H_NLOS;       // channel coefficients H_NLOS [u][s][n],
-  // where u and s are receive and transmit antenna element, n is cluster index.
-  uint64_t uSize = rxAntennaNum[0] * rxAntennaNum[1];
-  uint64_t sSize = txAntennaNum[0] * txAntennaNum[1];
-
   uint8_t cluster1st = 0, cluster2nd = 0;       // first and second strongest cluster;
   double maxPower = 0;
   for (uint8_t cIndex = 0; cIndex < params->m_numCluster; cIndex++)
@@ -2038,8 +2374,120 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
 
   NS_LOG_INFO ("1st strongest cluster:" << (int)cluster1st << ", 2nd strongest cluster:" << (int)cluster2nd);
 
+  // store the rays, so that the channel can be projected on the other panels
+  params->m_rayAoa.assign (params->m_numCluster, doubleVector_t (raysPerCluster));
+  params->m_rayZoa.assign (params->m_numCluster, doubleVector_t (raysPerCluster));
+  params->m_rayAod.assign (params->m_numCluster, doubleVector_t (raysPerCluster));
+  params->m_rayZod.assign (params->m_numCluster, doubleVector_t (raysPerCluster));
+  for (uint8_t nIndex = 0; nIndex < params->m_numCluster; nIndex++)
+    {
+      for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
+        {
+          params->m_rayAoa[nIndex][mIndex] = rayAoa_radian[nIndex][mIndex];
+          params->m_rayZoa[nIndex][mIndex] = rayZoa_radian[nIndex][mIndex];
+          params->m_rayAod[nIndex][mIndex] = rayAod_radian[nIndex][mIndex];
+          params->m_rayZod[nIndex][mIndex] = rayZod_radian[nIndex][mIndex];
+        }
+    }
+  params->m_clusterPower = clusterPower;
+  params->m_cluster1st = cluster1st;
+  params->m_cluster2nd = cluster2nd;
+  params->m_losAttenuation = attenuation_dB.at (0);
+  params->m_losRxAngle = rxAngle;
+  params->m_losTxAngle = txAngle;
+  params->m_rayPanels = std::make_pair (txAntenna->GetPlanesId (), rxAntenna->GetPlanesId ());
+  params->m_channelPanels = params->m_rayPanels;
+  params->m_panelChannel.clear ();
+
+  complex3DVector_t H_usn = CalChannelCoefficients (*params, txAntenna, rxAntenna,
+                                                    params->m_rayPanels.first, params->m_rayPanels.second);
+
+  if (cluster1st == cluster2nd)
+    {
+      clusterDelay.push_back (clusterDelay.at (cluster2nd) + 1.28 * table3gpp->m_cDS);
+      clusterDelay.push_back (clusterDelay.at (cluster2nd) + 2.56 * table3gpp->m_cDS);
+
+      clusterAoa.push_back (clusterAoa.at (cluster2nd));
+      clusterAoa.push_back (clusterAoa.at (cluster2nd));
+      clusterZoa.push_back (clusterZoa.at (cluster2nd));
+      clusterZoa.push_back (clusterZoa.at (cluster2nd));
+    }
+  else
+    {
+      double min, max;
+      if (cluster1st < cluster2nd)
+        {
+          min = cluster1st;
+          max = cluster2nd;
+        }
+      else
+        {
+          min = cluster2nd;
+          max = cluster1st;
+        }
+      clusterDelay.push_back (clusterDelay.at (min) + 1.28 * table3gpp->m_cDS);
+      clusterDelay.push_back (clusterDelay.at (min) + 2.56 * table3gpp->m_cDS);
+      clusterDelay.push_back (clusterDelay.at (max) + 1.28 * table3gpp->m_cDS);
+      clusterDelay.push_back (clusterDelay.at (max) + 2.56 * table3gpp->m_cDS);
+
+      clusterAoa.push_back (clusterAoa.at (min));
+      clusterAoa.push_back (clusterAoa.at (min));
+      clusterAoa.push_back (clusterAoa.at (max));
+      clusterAoa.push_back (clusterAoa.at (max));
+
+      clusterZoa.push_back (clusterZoa.at (min));
+      clusterZoa.push_back (clusterZoa.at (min));
+      clusterZoa.push_back (clusterZoa.at (max));
+      clusterZoa.push_back (clusterZoa.at (max));
+
+
+    }
+
+  NS_LOG_INFO ("size of coefficient matrix =[" << H_usn.size () << "][" << H_usn.at (0).size () << "][" << H_usn.at (0).at (0).size () << "]");
+
+
+  /*std::cout << "Delay:";
+  for (uint8_t i = 0; i < clusterDelay.size(); i++)
+  {
+          std::cout <<clusterDelay.at(i)<<"s\t";
+  }
+  std::cout << "\n";*/
+
+  params->m_delay = clusterDelay;
+  params->m_channel = H_usn;
+  params->m_angle.clear ();
+  params->m_angle.push_back (clusterAoa);
+  params->m_angle.push_back (clusterZoa);
+  params->m_angle.push_back (clusterAod);
+  params->m_angle.push_back (clusterZod);
+  //update the previous location.
+
+  return params;
+
+}
+
+complex3DVector_t
+MmWaveVehicularSpectrumPropagationLossModel::CalChannelCoefficients (const Params3gpp &params,
+                                                                     Ptr<MmWaveVehicularAntennaArrayModel> txAntenna,
+                                                                     Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna,
+                                                                     uint8_t txPanel, uint8_t rxPanel) const
+{
+  NS_LOG_FUNCTION (this << (uint16_t) txPanel << (uint16_t) rxPanel);
+
+  uint8_t numCluster = params.m_numCluster;
+  uint8_t raysPerCluster = params.m_rayAoa.at (0).size ();
+  uint8_t cluster1st = params.m_cluster1st;
+  uint8_t cluster2nd = params.m_cluster2nd;
+
+  // rotation of the azimuth angles from the panels of the rays to the given ones
+  double txRotation = txAntenna->GetPanelOffset (params.m_rayPanels.first) - txAntenna->GetPanelOffset (txPanel);
+  double rxRotation = rxAntenna->GetPanelOffset (params.m_rayPanels.second) - rxAntenna->GetPanelOffset (rxPanel);
+
   complex3DVector_t H_usn;       //channel coffecient H_usn[u][s][n];
+  // where u and s are receive and transmit antenna element, n is cluster index.
   //Since each of the strongest 2 clusters are divided into 3 sub-clusters, the total cluster will be numReducedCLuster + 4.
+  uint64_t uSize = rxAntenna->GetTotNoArrayElements ();
+  uint64_t sSize = txAntenna->GetTotNoArrayElements ();
 
   H_usn.resize (uSize);
   for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
@@ -2047,21 +2495,51 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
       H_usn.at (uIndex).resize (sSize);
       for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
         {
-          H_usn.at (uIndex).at (sIndex).resize (params->m_numCluster);
+          H_usn.at (uIndex).at (sIndex).resize (numCluster);
         }
     }
-  //double slotTime = Simulator::Now ().GetSeconds ();
+  // the radiation patterns and the phase terms at the antenna elements only
+  // depend on the angles of the rays, hence they are computed once per ray
+  // and not for each pair of tx and rx elements
+  complex2DVector_t rayGain (numCluster, complexVector_t (raysPerCluster));
+  complex3DVector_t rxPhaseTerms (numCluster, complex2DVector_t (raysPerCluster));
+  complex3DVector_t txPhaseTerms (numCluster, complex2DVector_t (raysPerCluster));
+  for (uint8_t nIndex = 0; nIndex < numCluster; nIndex++)
+    {
+      for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
+        {
+          double zoa = params.m_rayZoa[nIndex][mIndex];
+          double aoa = params.m_rayAoa[nIndex][mIndex] + rxRotation;
+          double zod = params.m_rayZod[nIndex][mIndex];
+          double aod = params.m_rayAod[nIndex][mIndex] + txRotation;
+          rayGain[nIndex][mIndex] = exp (std::complex<double> (0, params.m_clusterPhase.at (nIndex).at (mIndex)))
+            * (rxAntenna->GetRadiationPattern (zoa,aoa)
+               * txAntenna->GetRadiationPattern (zod,aod));
+          //lambda_0 is accounted in the antenna spacing of the element locations.
+          rxAntenna->GetElementPhaseTerms (zoa, aoa, rxPhaseTerms[nIndex][mIndex]);
+          txAntenna->GetElementPhaseTerms (zod, aod, txPhaseTerms[nIndex][mIndex]);
+        }
+    }
+  std::complex<double> losGain (0,0);
+  complexVector_t losRxPhaseTerms;
+  complexVector_t losTxPhaseTerms;
+  if (params.m_condition == 'l')
+    {
+      double rxPhi = params.m_losRxAngle.phi + rxRotation;
+      double txPhi = params.m_losTxAngle.phi + txRotation;
+      losGain = exp (std::complex<double> (0, params.m_losPhase))
+        * (rxAntenna->GetRadiationPattern (params.m_losRxAngle.theta,rxPhi)
+           * txAntenna->GetRadiationPattern (params.m_losTxAngle.theta,txPhi));
+      rxAntenna->GetElementPhaseTerms (params.m_losRxAngle.theta, rxPhi, losRxPhaseTerms);
+      txAntenna->GetElementPhaseTerms (params.m_losTxAngle.theta, txPhi, losTxPhaseTerms);
+    }
+
   // The following for loops computes the channel coefficients
   for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
     {
-      Vector uLoc = rxAntenna->GetAntennaLocation (uIndex,rxAntennaNum);
-
       for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
         {
-
-          Vector sLoc = txAntenna->GetAntennaLocation (sIndex,txAntennaNum);
-
-          for (uint8_t nIndex = 0; nIndex < params->m_numCluster; nIndex++)
+          for (uint8_t nIndex = 0; nIndex < numCluster; nIndex++)
             {
               //Compute the N-2 weakest cluster, only vertical polarization. (7.5-22)
               if (nIndex != cluster1st && nIndex != cluster2nd)
@@ -2069,29 +2547,10 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
                   std::complex<double> rays (0,0);
                   for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
                     {
-                      double initialPhase = clusterPhase.at (nIndex).at (mIndex);
-                      //lambda_0 is accounted in the antenna spacing uLoc and sLoc.
-                      double rxPhaseDiff = 2 * M_PI * (sin (rayZoa_radian[nIndex][mIndex]) * cos (rayAoa_radian[nIndex][mIndex]) * uLoc.x
-                                                       + sin (rayZoa_radian[nIndex][mIndex]) * sin (rayAoa_radian[nIndex][mIndex]) * uLoc.y
-                                                       + cos (rayZoa_radian[nIndex][mIndex]) * uLoc.z);
-
-                      double txPhaseDiff = 2 * M_PI * (sin (rayZod_radian[nIndex][mIndex]) * cos (rayAod_radian[nIndex][mIndex]) * sLoc.x
-                                                       + sin (rayZod_radian[nIndex][mIndex]) * sin (rayAod_radian[nIndex][mIndex]) * sLoc.y
-                                                       + cos (rayZod_radian[nIndex][mIndex]) * sLoc.z);
                       //Doppler is computed in the CalBeamformingGain function and is simplified to only account for the center anngle of each cluster.
-                      //double doppler = 2*M_PI*(sin(rayZoa_radian[nIndex][mIndex])*cos(rayAoa_radian[nIndex][mIndex])*relativeSpeed.x
-                      //		+ sin(rayZoa_radian[nIndex][mIndex])*sin(rayAoa_radian[nIndex][mIndex])*relativeSpeed.y
-                      //		+ cos(rayZoa_radian[nIndex][mIndex])*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-                      rays += exp (std::complex<double> (0, initialPhase))
-                        * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                           * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                        * exp (std::complex<double> (0, rxPhaseDiff))
-                        * exp (std::complex<double> (0, txPhaseDiff));
-                      //*exp(std::complex<double>(0, doppler));
-                      //rays += 1;
+                      rays += rayGain[nIndex][mIndex] * rxPhaseTerms[nIndex][mIndex][uIndex] * txPhaseTerms[nIndex][mIndex][sIndex];
                     }
-                  //rays *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  rays *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
+                  rays *= sqrt (params.m_clusterPower.at (nIndex) / raysPerCluster);
                   H_usn.at (uIndex).at (sIndex).at (nIndex) = rays;
                 }
               else                   //(7.5-28)
@@ -2102,17 +2561,6 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
 
                   for (uint8_t mIndex = 0; mIndex < raysPerCluster; mIndex++)
                     {
-                      double initialPhase = clusterPhase.at (nIndex).at (mIndex);
-                      double rxPhaseDiff = 2 * M_PI * (sin (rayZoa_radian[nIndex][mIndex]) * cos (rayAoa_radian[nIndex][mIndex]) * uLoc.x
-                                                       + sin (rayZoa_radian[nIndex][mIndex]) * sin (rayAoa_radian[nIndex][mIndex]) * uLoc.y
-                                                       + cos (rayZoa_radian[nIndex][mIndex]) * uLoc.z);
-                      double txPhaseDiff = 2 * M_PI * (sin (rayZod_radian[nIndex][mIndex]) * cos (rayAod_radian[nIndex][mIndex]) * sLoc.x
-                                                       + sin (rayZod_radian[nIndex][mIndex]) * sin (rayAod_radian[nIndex][mIndex]) * sLoc.y
-                                                       + cos (rayZod_radian[nIndex][mIndex]) * sLoc.z);
-                      //double doppler = 2*M_PI*(sin(rayZoa_radian[nIndex][mIndex])*cos(rayAoa_radian[nIndex][mIndex])*relativeSpeed.x
-                      //		+ sin(rayZoa_radian[nIndex][mIndex])*sin(rayAoa_radian[nIndex][mIndex])*relativeSpeed.y
-                      //		+ cos(rayZoa_radian[nIndex][mIndex])*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-                      //double delaySpread;
                       switch (mIndex)
                         {
                         case 9:
@@ -2121,147 +2569,87 @@ MmWaveVehicularSpectrumPropagationLossModel::UpdateChannel (Ptr<Params3gpp> para
                         case 12:
                         case 17:
                         case 18:
-                          //delaySpread= -2*M_PI*(clusterDelay.at(nIndex)+1.28*c_DS)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub2 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub2 +=1;
+                          raysSub2 += rayGain[nIndex][mIndex] * rxPhaseTerms[nIndex][mIndex][uIndex] * txPhaseTerms[nIndex][mIndex][sIndex];
                           break;
                         case 13:
                         case 14:
                         case 15:
                         case 16:
-                          //delaySpread = -2*M_PI*(clusterDelay.at(nIndex)+2.56*c_DS)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub3 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub3 +=1;
+                          raysSub3 += rayGain[nIndex][mIndex] * rxPhaseTerms[nIndex][mIndex][uIndex] * txPhaseTerms[nIndex][mIndex][sIndex];
                           break;
                         default:                        //case 1,2,3,4,5,6,7,8,19,20
-                                                        //delaySpread = -2*M_PI*clusterDelay.at(nIndex)*m_phyMacConfig->GetCenterFrequency ();
-                          raysSub1 += exp (std::complex<double> (0, initialPhase))
-                            * (rxAntenna->GetRadiationPattern (rayZoa_radian[nIndex][mIndex],rayAoa_radian[nIndex][mIndex])
-                               * txAntenna->GetRadiationPattern (rayZod_radian[nIndex][mIndex],rayAod_radian[nIndex][mIndex]))
-                            * exp (std::complex<double> (0, rxPhaseDiff))
-                            * exp (std::complex<double> (0, txPhaseDiff));
-                          //*exp(std::complex<double>(0, doppler));
-                          //raysSub1 +=1;
+                          raysSub1 += rayGain[nIndex][mIndex] * rxPhaseTerms[nIndex][mIndex][uIndex] * txPhaseTerms[nIndex][mIndex][sIndex];
                           break;
                         }
                     }
-                  //raysSub1 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  //raysSub2 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  //raysSub3 *= sqrt(clusterPower.at(nIndex))/raysPerCluster;
-                  raysSub1 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  raysSub2 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
-                  raysSub3 *= sqrt (clusterPower.at (nIndex) / raysPerCluster);
+                  raysSub1 *= sqrt (params.m_clusterPower.at (nIndex) / raysPerCluster);
+                  raysSub2 *= sqrt (params.m_clusterPower.at (nIndex) / raysPerCluster);
+                  raysSub3 *= sqrt (params.m_clusterPower.at (nIndex) / raysPerCluster);
                   H_usn.at (uIndex).at (sIndex).at (nIndex) = raysSub1;
                   H_usn.at (uIndex).at (sIndex).push_back (raysSub2);
                   H_usn.at (uIndex).at (sIndex).push_back (raysSub3);
-
                 }
             }
-          if (params->m_condition == 'l')               //(7.5-29) && (7.5-30)
+          if (params.m_condition == 'l')               //(7.5-29) && (7.5-30)
             {
-              std::complex<double> ray (0,0);
-              double rxPhaseDiff = 2 * M_PI * (sin (rxAngle.theta) * cos (rxAngle.phi) * uLoc.x
-                                               + sin (rxAngle.theta) * sin (rxAngle.phi) * uLoc.y
-                                               + cos (rxAngle.theta) * uLoc.z);
-              double txPhaseDiff = 2 * M_PI * (sin (txAngle.theta) * cos (txAngle.phi) * sLoc.x
-                                               + sin (txAngle.theta) * sin (txAngle.phi) * sLoc.y
-                                               + cos (txAngle.theta) * sLoc.z);
-              //double doppler = 2*M_PI*(sin(rxAngle.theta)*cos(rxAngle.phi)*relativeSpeed.x
-              //		+ sin(rxAngle.theta)*sin(rxAngle.phi)*relativeSpeed.y
-              //		+ cos(rxAngle.theta)*relativeSpeed.z)*slotTime*m_phyMacConfig->GetCenterFrequency ()/3e8;
-
-              ray = exp (std::complex<double> (0, losPhase))
-                * (rxAntenna->GetRadiationPattern (rxAngle.theta,rxAngle.phi)
-                   * txAntenna->GetRadiationPattern (txAngle.theta,txAngle.phi))
-                * exp (std::complex<double> (0, rxPhaseDiff))
-                * exp (std::complex<double> (0, txPhaseDiff));
-              //*exp(std::complex<double>(0, doppler));
-
-              double K_linear = pow (10,K_factor / 10);
-
-              H_usn.at (uIndex).at (sIndex).at (0) = sqrt (1 / (K_linear + 1)) * H_usn.at (uIndex).at (sIndex).at (0) + sqrt (K_linear / (1 + K_linear)) * ray / pow (10,attenuation_dB.at (0) / 10);           //(7.5-30) for tau = tau1
+              std::complex<double> ray = losGain * losRxPhaseTerms[uIndex] * losTxPhaseTerms[sIndex];
+
+              double K_linear = pow (10,params.m_K / 10);
+              // the LOS path should be attenuated if blockage is enabled.
+              H_usn.at (uIndex).at (sIndex).at (0) = sqrt (1 / (K_linear + 1)) * H_usn.at (uIndex).at (sIndex).at (0) + sqrt (K_linear / (1 + K_linear)) * ray / pow (10,params.m_losAttenuation / 10);           //(7.5-30) for tau = tau1
               double tempSize = H_usn.at (uIndex).at (sIndex).size ();
               for (uint8_t nIndex = 1; nIndex < tempSize; nIndex++)
                 {
                   H_usn.at (uIndex).at (sIndex).at (nIndex) *= sqrt (1 / (K_linear + 1));                   //(7.5-30) for tau = tau2...taunN
                 }
-
             }
         }
     }
 
-  if (cluster1st == cluster2nd)
-    {
-      clusterDelay.push_back (clusterDelay.at (cluster2nd) + 1.28 * table3gpp->m_cDS);
-      clusterDelay.push_back (clusterDelay.at (cluster2nd) + 2.56 * table3gpp->m_cDS);
+  return H_usn;
+}
 
-      clusterAoa.push_back (clusterAoa.at (cluster2nd));
-      clusterAoa.push_back (clusterAoa.at (cluster2nd));
-      clusterZoa.push_back (clusterZoa.at (cluster2nd));
-      clusterZoa.push_back (clusterZoa.at (cluster2nd));
-    }
-  else
+void
+MmWaveVehicularSpectrumPropagationLossModel::SelectPanelChannel (Params3gpp &params,
+                                                                 Ptr<MmWaveVehicularAntennaArrayModel> txAntenna,
+                                                                 Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna) const
+{
+  if (params.m_rayAoa.empty ())
     {
-      double min, max;
-      if (cluster1st < cluster2nd)
-        {
-          min = cluster1st;
-          max = cluster2nd;
-        }
-      else
-        {
-          min = cluster2nd;
-          max = cluster1st;
-        }
-      clusterDelay.push_back (clusterDelay.at (min) + 1.28 * table3gpp->m_cDS);
-      clusterDelay.push_back (clusterDelay.at (min) + 2.56 * table3gpp->m_cDS);
-      clusterDelay.push_back (clusterDelay.at (max) + 1.28 * table3gpp->m_cDS);
-      clusterDelay.push_back (clusterDelay.at (max) + 2.56 * table3gpp->m_cDS);
-
-      clusterAoa.push_back (clusterAoa.at (min));
-      clusterAoa.push_back (clusterAoa.at (min));
-      clusterAoa.push_back (clusterAoa.at (max));
-      clusterAoa.push_back (clusterAoa.at (max));
-
-      clusterZoa.push_back (clusterZoa.at (min));
-      clusterZoa.push_back (clusterZoa.at (min));
-      clusterZoa.push_back (clusterZoa.at (max));
-      clusterZoa.push_back (clusterZoa.at (max));
-
-
+      // e.g., replayed from a trace, only the projection on the panels
+      // used to generate it is available
+      return;
     }
 
-  NS_LOG_INFO ("size of coefficient matrix =[" << H_usn.size () << "][" << H_usn.at (0).size () << "][" << H_usn.at (0).at (0).size () << "]");
-
+  std::pair<uint8_t, uint8_t> panels = std::make_pair (txAntenna->GetPlanesId (), rxAntenna->GetPlanesId ());
+  if (panels == params.m_channelPanels)
+    {
+      return;
+    }
 
-  /*std::cout << "Delay:";
-  for (uint8_t i = 0; i < clusterDelay.size(); i++)
-  {
-          std::cout <<clusterDelay.at(i)<<"s\t";
-  }
-  std::cout << "\n";*/
+  NS_LOG_DEBUG ("Switch the channel projection from panels (" << (uint16_t) params.m_channelPanels.first
+                << ", " << (uint16_t) params.m_channelPanels.second << ") to ("
+                << (uint16_t) panels.first << ", " << (uint16_t) panels.second << ")");
 
-  params->m_delay = clusterDelay;
-  params->m_channel = H_usn;
-  params->m_angle.clear ();
-  params->m_angle.push_back (clusterAoa);
-  params->m_angle.push_back (clusterZoa);
-  params->m_angle.push_back (clusterAod);
-  params->m_angle.push_back (clusterZod);
-  //update the previous location.
+  complex3DVector_t channel;
+  auto it = params.m_panelChannel.find (panels);
+  if (it != params.m_panelChannel.end ())
+    {
+      channel.swap (it->second);
+      params.m_panelChannel.erase (it);
+    }
+  else
+    {
+      channel = CalChannelCoefficients (params, txAntenna, rxAntenna, panels.first, panels.second);
+    }
 
-  return params;
+  // keep the current projection for the next switch
+  params.m_panelChannel[params.m_channelPanels].swap (params.m_channel);
+  params.m_channel.swap (channel);
+  params.m_channelPanels = panels;
 
+  // the long term component refers to the previous projection
+  params.m_longTerm.clear ();
 }
 
 doubleVector_t
@@ -2482,6 +2870,36 @@ MmWaveVehicularSpectrumPropagationLossModel::CalAttenuationOfBlockage (Ptr<Param
 }
 
 
+Ptr<Params3gpp>
+MmWaveVehicularSpectrumPropagationLossModel::ReadChannelFromTrace (Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, bool &reverse) const
+{
+  if (m_traceReader == 0)
+    {
+      m_traceReader = Create<MmWaveVehicularChannelTraceReader> (m_channelTraceFile);
+    }
+
+  uint32_t txId = txDevice->GetNode ()->GetId ();
+  uint32_t rxId = rxDevice->GetNode ()->GetId ();
+  Ptr<Params3gpp> params = m_traceReader->Read (txId, rxId, Simulator::Now (), reverse);
+  if (params == 0)
+    {
+      NS_FATAL_ERROR ("No channel realization for the link between node " << txId << " and node " << rxId
+                      << " in the trace " << m_channelTraceFile);
+    }
+  return params;
+}
+
+void
+MmWaveVehicularSpectrumPropagationLossModel::WriteChannelToTrace (Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, Ptr<Params3gpp> params) const
+{
+  if (m_traceWriter == 0)
+    {
+      m_traceWriter = Create<MmWaveVehicularChannelTraceWriter> (m_channelTraceFile);
+    }
+
+  m_traceWriter->Write (txDevice->GetNode ()->GetId (), rxDevice->GetNode ()->GetId (), Simulator::Now (), *params);
+}
+
 } // namespace millicar
 
 } // namespace ns3
@@ -37,6 +37,8 @@
 #include <ns3/mmwave-phy-mac-common.h>
 #include <ns3/mmwave-vehicular-propagation-loss-model.h>
 #include <ns3/mmwave-vehicular-antenna-array-model.h>
+#include <ns3/mmwave-vehicular-worker-pool.h>
+#include <ns3/mmwave-vehicular-device-context.h>
 // #include <ns3/mmwave-3gpp-buildings-propagation-loss-model.h>
 
 #define AOA_INDEX 0
@@ -77,6 +79,8 @@ struct Params3gpp : public SimpleRefCount<Params3gpp>
   double                          m_tauDelta;       // minimum delay as indicated in 7.6-1 TR 38.901.
   double2DVector_t                m_angle;          // cluster angle angle[direction][n], where direction = 0(aoa), 1(zoa), 2(aod), 3(zod) in degree.
   complexVector_t                 m_longTerm;       // long term component.
+  uint64_t                        m_longTermTxBeamId = 0; // id of the tx beam used to compute m_longTerm.
+  uint64_t                        m_longTermRxBeamId = 0; // id of the rx beam used to compute m_longTerm.
 
   double2DVector_t                m_nonSelfBlocking;       // store the blockages
 
@@ -96,6 +100,21 @@ struct Params3gpp : public SimpleRefCount<Params3gpp>
   double m_dis2D;
   double m_dis3D;
 
+  /*The following parameters are stored to project the channel on the other panels*/
+  double2DVector_t m_rayAoa;       // ray angles in radians rayAoa[n][m], in the local coordinate system of the panels m_rayPanels
+  double2DVector_t m_rayZoa;
+  double2DVector_t m_rayAod;
+  double2DVector_t m_rayZod;
+  doubleVector_t m_clusterPower;       // normalized power of each cluster, including the blockage attenuation
+  uint8_t m_cluster1st = 0;       // strongest cluster
+  uint8_t m_cluster2nd = 0;       // second strongest cluster
+  double m_losAttenuation = 0;       // blockage attenuation of the LOS path in dB
+  Angles m_losRxAngle;       // LOS direction at the rx, in the local coordinate system of the panels m_rayPanels
+  Angles m_losTxAngle;       // LOS direction at the tx, in the local coordinate system of the panels m_rayPanels
+  std::pair<uint8_t, uint8_t> m_rayPanels;       // (tx, rx) panels in which the ray angles are expressed
+  std::pair<uint8_t, uint8_t> m_channelPanels;       // (tx, rx) panels on which m_channel is projected
+  std::map<std::pair<uint8_t, uint8_t>, complex3DVector_t> m_panelChannel;       // projections of the channel on the other (tx, rx) panel pairs
+
   std::map<Ptr<NetDevice>, complexVector_t> m_allLongTermMap;
 };
 
@@ -162,6 +181,9 @@ struct ParamsTable : public Object
 
 };
 
+class MmWaveVehicularChannelTraceWriter;
+class MmWaveVehicularChannelTraceReader;
+
 /**
  * \brief This class implements the fading computation of the 3GPP TR 38.900 channel model and performs the
  * beamforming gain computation. It implements the SpectrumPropagationLossModel interface
@@ -182,6 +204,15 @@ public:
   static TypeId GetTypeId (void);
   void DoDispose ();
 
+  /**
+   * Operating modes of the channel trace. In RECORD mode, every channel
+   * realization is appended to the trace file. In REPLAY mode, the channel
+   * realizations are read from the trace file instead of being generated.
+   */
+  enum ChannelTraceMode_t {TRACE_DISABLED = 0,
+                           TRACE_RECORD = 1,
+                           TRACE_REPLAY = 2};
+
   /**
    * Add a device
    * @param a pointer to the NetDevice
@@ -189,12 +220,172 @@ public:
    */
   void AddDevice (Ptr<NetDevice>, Ptr<MmWaveVehicularAntennaArrayModel>);
 
+  /**
+   * Add a device with its context, so that the device and its antenna are
+   * retrieved from the mobility model without any lookup. The dense index
+   * of the device is allocated here and written in the context, hence the
+   * value set by the caller is ignored
+   * @params the context of the device
+   */
+  void AddDevice (Ptr<MmWaveVehicularDeviceContext> context);
+
+  /**
+   * Returns the context of the device installed on the node of a mobility
+   * model. If the device was added without its context, the context is
+   * created and cached the first time it is requested, and its index is
+   * allocated as in AddDevice.
+   * @params the mobility model
+   * @returns the context of the device
+   */
+  Ptr<const MmWaveVehicularDeviceContext> GetDeviceContext (Ptr<const MobilityModel> mobility) const;
+
   /**
    * Set the pathloss model associated to this class
    * @param a pointer to the pathloss model, which has to implement the PropagationLossModel interface
    */
   void SetPathlossModel (Ptr<PropagationLossModel> pathloss);
 
+  /**
+   * Chain another model to this one, so that it is applied after this model
+   * by CalcRxPowerSpectralDensity and by CalcRxPowerSpectralDensityMulti.
+   * NOTE: SpectrumPropagationLossModel::SetNext is not virtual, hence the
+   * model has to be chained through a pointer to this class
+   * @params the model to chain
+   */
+  void SetNext (Ptr<SpectrumPropagationLossModel> next);
+
+  /**
+   * Compute the PSDs received by a group of devices from a single transmission.
+   * The quantities which only depend on the transmitter (device, antenna
+   * array, beamforming vector, speed) are resolved once and shared among
+   * all the receivers. The models chained with SetNext are applied to each
+   * received PSD, as in CalcRxPowerSpectralDensity.
+   * If a worker pool is provided, the beamforming gain of the different
+   * receivers is computed in parallel. The channel realizations are still
+   * generated sequentially, so that the results do not depend on the number
+   * of threads.
+   * @params the transmitted PSD
+   * @params the mobility model of the transmitter
+   * @params the mobility models of the receivers
+   * @params the worker pool, or 0 to compute everything in the calling thread
+   * @returns the received PSDs, in the same order as the receivers
+   */
+  std::vector<Ptr<SpectrumValue> > CalcRxPowerSpectralDensityMulti (Ptr<const SpectrumValue> txPsd,
+                                                                    Ptr<const MobilityModel> a,
+                                                                    const std::vector<Ptr<const MobilityModel> > &receivers,
+                                                                    Ptr<MmWaveVehicularWorkerPool> pool = 0) const;
+
+  /**
+   * Compute the wideband gain of all the links among a group of devices,
+   * i.e., the average over the bands of the gain applied by this model to
+   * the PSD, with the beamforming vectors currently configured in the
+   * antennas. The large scale fading of the propagation loss model is not
+   * included.
+   * The cached channel realizations are reused, while the missing ones are
+   * generated, as it would happen with a transmission; the gains of the
+   * links with the same transmitter are computed in parallel if a worker
+   * pool is provided.
+   * @params the spectrum model over which the gain is averaged
+   * @params the mobility models of the devices
+   * @params the output buffer, with nodes.size () * nodes.size () elements;
+   *         the gain from the i-th to the j-th device (linear scale) is
+   *         stored in gains[i * nodes.size () + j], the diagonal is set to 0
+   * @params the worker pool, or 0 to compute everything in the calling thread
+   */
+  void ComputeGainMatrix (Ptr<const SpectrumModel> sm,
+                          const std::vector<Ptr<const MobilityModel> > &nodes,
+                          double *gains,
+                          Ptr<MmWaveVehicularWorkerPool> pool = 0) const;
+
+  /**
+   * Compute the k strongest neighbors of each device of a group, according
+   * to the wideband gain defined in ComputeGainMatrix
+   * @params the spectrum model over which the gain is averaged
+   * @params the mobility models of the devices
+   * @params the number of neighbors per device
+   * @params the output buffer for the indices of the neighbors, with
+   *         nodes.size () * k elements; the neighbors of the i-th device
+   *         are stored from position i * k, sorted by decreasing gain. If
+   *         there are less than k neighbors, the remaining entries are set
+   *         to UINT32_MAX
+   * @params the output buffer for the gains (linear scale), with the same
+   *         layout as the indices; the missing entries are set to 0
+   * @params the worker pool, or 0 to compute everything in the calling thread
+   */
+  void ComputeStrongestNeighbors (Ptr<const SpectrumModel> sm,
+                                  const std::vector<Ptr<const MobilityModel> > &nodes,
+                                  uint32_t k,
+                                  uint32_t *indices,
+                                  double *gains,
+                                  Ptr<MmWaveVehicularWorkerPool> pool = 0) const;
+
+  /**
+   * Returns the antenna array of a device
+   * @params the device
+   * @returns the antenna array, or 0 if the device has not been added
+   */
+  Ptr<MmWaveVehicularAntennaArrayModel> GetAntenna (Ptr<NetDevice> device) const;
+
+  /**
+   * Returns the last channel realization of a link, without generating or
+   * updating it. The matrix is indexed as H[u][s][n], where u is an element
+   * of the rx panel and s an element of the tx panel, as in CalLongTerm.
+   * The two directions of a link share the same realization, hence the
+   * returned one may have been generated for the reverse link, i.e., u may
+   * be an element of the panel of txDevice and s of the panel of rxDevice.
+   * @params the tx device
+   * @params the rx device
+   * @params set to true if the realization is the one of the reverse link
+   * @returns the channel realization, or 0 if the link has not been used yet
+   */
+  virtual Ptr<const Params3gpp> GetCachedChannel (Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, bool &reverse) const;
+
+protected:
+  /**
+   * Quantities which only depend on the transmitter, shared by all the
+   * receivers of a transmission
+   */
+  struct TxInfo
+  {
+    Ptr<NetDevice> m_device; //!< the tx device
+    Ptr<MmWaveVehicularAntennaArrayModel> m_antenna; //!< the tx antenna array
+    Ptr<MobilityModel> m_mobility; //!< the tx mobility model
+    uint16_t m_antennaNum[2]; //!< number of antenna elements along each dimension
+    complexVector_t m_bfVector; //!< the tx beamforming vector
+    uint64_t m_beamId; //!< the identifier of the tx beamforming vector
+    Vector m_speed; //!< the tx speed
+  };
+
+  /**
+   * Retrieve or generate the channel realization of a link. Must be called
+   * from the simulation thread. The default implementation generates the
+   * channel with the 3GPP TR 37.885 procedure; subclasses can override it to
+   * obtain the channel from a different source and reuse the beamforming
+   * gain computation.
+   * @params the transmitter information
+   * @params the antenna array of the receiver
+   * @params the mobility model of the transmitter
+   * @params the mobility model of the receiver
+   * @returns the channel realization in a Params3gpp object
+   */
+  virtual Ptr<Params3gpp> GetChannel (const TxInfo &txInfo,
+                                      Ptr<MmWaveVehicularAntennaArrayModel> rxAntennaArray,
+                                      Ptr<const MobilityModel> a,
+                                      Ptr<const MobilityModel> b) const;
+
+  /**
+   * Compute the Doppler term of each cluster
+   * @params the channel realizationin as a Params3gpp object
+   * @params the speed of the receivers
+   * @params the speed of the transmitter (for example in case of vehicular communication)
+   * @returns the Doppler terms
+   */
+  virtual complexVector_t CalDoppler (Ptr<Params3gpp> params,
+                                      Vector rxSpeed,
+                                      Vector txSpeed) const;
+
+  double m_frequency; // operating frequency in Hz
+
 private:
   /**
    * Inherited from SpectrumPropagationLossModel, it returns the PSD at the receiver
@@ -207,6 +398,90 @@ private:
                                                    Ptr<const MobilityModel> a,
                                                    Ptr<const MobilityModel> b) const;
 
+  /**
+   * Collect the quantities which only depend on the transmitter
+   * @params the mobility model of the transmitter
+   * @returns the TxInfo structure
+   */
+  TxInfo GetTxInfo (Ptr<const MobilityModel> a) const;
+
+  /**
+   * Quantities associated to a single receiver of a transmission
+   */
+  struct LinkInfo
+  {
+    Ptr<SpectrumValue> m_rxPsd; //!< the rx PSD, updated in place by ComputeLink
+    Ptr<MmWaveVehicularAntennaArrayModel> m_rxAntenna; //!< the rx antenna array
+    Ptr<Params3gpp> m_params; //!< the channel realization, 0 in case of omni transmission
+    complexVector_t m_doppler; //!< the Doppler term of each cluster
+  };
+
+  /**
+   * Retrieve or generate the channel of a link and compute all the quantities
+   * which need the random variables or modify the channel map. Must be called
+   * from the simulation thread.
+   * @params the transmitted PSD
+   * @params the transmitter information
+   * @params the mobility model of the transmitter
+   * @params the mobility model of the receiver
+   * @returns the LinkInfo structure
+   */
+  LinkInfo PrepareLink (Ptr<const SpectrumValue> txPsd,
+                        const TxInfo &txInfo,
+                        Ptr<const MobilityModel> a,
+                        Ptr<const MobilityModel> b) const;
+
+  /**
+   * Apply the beamforming gain to the rx PSD of a link prepared with
+   * PrepareLink. It only accesses the objects of the link, thus it can be
+   * called for different links at the same time. For the same reason, it
+   * must not log, nor call methods which log, since the logging is not
+   * thread safe.
+   * @params the LinkInfo structure
+   */
+  void ComputeLink (LinkInfo &link) const;
+
+  /**
+   * Compute the wideband gain from a device towards all the other devices
+   * of a group
+   * @params a PSD equal to one in all the bands
+   * @params the index of the transmitter
+   * @params the mobility models of the devices
+   * @params the output buffer, with nodes.size () elements; the element
+   *         of the transmitter is set to 0
+   * @params the worker pool, or 0 to compute everything in the calling thread
+   */
+  void ComputeGainRow (Ptr<const SpectrumValue> ones,
+                       uint32_t tx,
+                       const std::vector<Ptr<const MobilityModel> > &nodes,
+                       double *row,
+                       Ptr<MmWaveVehicularWorkerPool> pool) const;
+
+  /**
+   * Returns a buffer containing a copy of the transmitted PSD. The buffers of
+   * the pool which are no longer referenced by the receivers are reused, so
+   * that no SpectrumValue is allocated in the steady state. Must be called
+   * from the simulation thread.
+   * @params the transmitted PSD
+   * @returns the buffer
+   */
+  Ptr<SpectrumValue> GetPsdBuffer (Ptr<const SpectrumValue> txPsd) const;
+
+  /**
+   * Log the average beamforming gain of a link. The gain is computed only
+   * if the debug logging is enabled.
+   * @params the transmitted PSD
+   * @params the transmitter information
+   * @params the LinkInfo structure
+   * @params the mobility model of the transmitter
+   * @params the mobility model of the receiver
+   */
+  void LogBeamformingGain (Ptr<const SpectrumValue> txPsd,
+                           const TxInfo &txInfo,
+                           const LinkInfo &link,
+                           Ptr<const MobilityModel> a,
+                           Ptr<const MobilityModel> b) const;
+
   /**
    * Get a new realization of the channel
    * @params the ParamsTable for the specific scenario
@@ -246,31 +521,72 @@ private:
                                  Ptr<MmWaveVehicularAntennaArrayModel> txAntenna, Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna,
                                  uint16_t *txAntennaNum, uint16_t *rxAntennaNum, Angles &rxAngle, Angles &txAngle) const;
 
+  /**
+   * Compute the channel coefficients H[u][s][n] of step 11 of the procedure
+   * from the rays of a channel realization, projected on a pair of panels.
+   * The ray angles are rotated by the difference between the offset of the
+   * panels in which they are expressed and the offset of the given panels.
+   * @params the channel realization in a Params3gpp object
+   * @params the ArrayAntennaModel for the txAntenna
+   * @params the ArrayAntennaModel for the rxAntenna
+   * @params the tx panel
+   * @params the rx panel
+   * @returns the channel matrix H[u][s][n]
+   */
+  complex3DVector_t CalChannelCoefficients (const Params3gpp &params,
+                                            Ptr<MmWaveVehicularAntennaArrayModel> txAntenna,
+                                            Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna,
+                                            uint8_t txPanel, uint8_t rxPanel) const;
+
+  /**
+   * Make m_channel the projection of the channel on the panels currently
+   * used by the antennas. The projections are computed once per pair of
+   * panels and cached in the channel realization, thus switching panel does
+   * not require to generate the channel again.
+   * @params the channel realization in a Params3gpp object
+   * @params the ArrayAntennaModel of the tx device of the realization
+   * @params the ArrayAntennaModel of the rx device of the realization
+   */
+  void SelectPanelChannel (Params3gpp &params,
+                           Ptr<MmWaveVehicularAntennaArrayModel> txAntenna,
+                           Ptr<MmWaveVehicularAntennaArrayModel> rxAntenna) const;
+
   /**
    * Compute and return the long term fading params in order to decrease the computational load
    * @params the channel realizationin as a Params3gpp object
    * @return the complexVector_t with the BF applied to the channel
    */
-  complexVector_t CalLongTerm (Ptr<Params3gpp> params) const;
+  complexVector_t CalLongTerm (const Params3gpp &params) const;
 
   /**
    * Compute the BF gain, apply frequency selectivity by phase-shifting with the cluster delays
-   * and scale the txPsd to get the rxPsd
-   * @params the tx PSD
+   * and scale the PSD in place to get the rxPsd
+   * @params the PSD to scale
    * @params the channel realizationin as a Params3gpp object
    * @params the longTerm component (i.e., with the BF vectors already applied)
-   * @params the speed of the receivers
-   * @params the speed of the transmitter (for example in case of vehicular communication)
-   * @returns the rx PSD
+   * @params the Doppler terms computed by CalDoppler
    */
-  Ptr<SpectrumValue> CalBeamformingGain (Ptr<const SpectrumValue> txPsd,
-                                         Ptr<Params3gpp> params,
-                                         complexVector_t longTerm,
-                                         Vector rxSpeed,
-                                         Vector txSpeed) const;
+  void CalBeamformingGain (SpectrumValue &psd,
+                           const Params3gpp &params,
+                           const complexVector_t &longTerm,
+                           const complexVector_t &doppler) const;
 
   /**
-   * Returns the loss associated to the oxygen absorption as described in p. 43 of TR 38.901
+   * Compute the wideband BF gain, i.e., the sum of the power of the clusters,
+   * and scale all the bands of the PSD in place by the same gain. The cross
+   * terms among the clusters, which give the frequency selectivity, are
+   * neglected since they average out over a wide band.
+   * @params the PSD to scale
+   * @params the channel realizationin as a Params3gpp object
+   * @params the longTerm component (i.e., with the BF vectors already applied)
+   */
+  void CalWidebandBeamformingGain (SpectrumValue &psd,
+                                   const Params3gpp &params,
+                                   const complexVector_t &longTerm) const;
+
+  /**
+   * Returns the loss associated to the oxygen absorption as described in p. 43 of TR 38.901.
+   * It is called by ComputeLink, hence it does not log.
    * @returns a double corresponding to the loss associated to the oxygen absorption
    * @params frequency of the subcarrier
    * @params 3D distance between the communicating terminals
@@ -318,9 +634,24 @@ private:
   doubleVector_t CalAttenuationOfBlockage (Ptr<Params3gpp> params,
                                            doubleVector_t clusterAOA, doubleVector_t clusterZOA) const;
 
-  mutable std::map< key_t, Ptr<Params3gpp> > m_channelMap;
+  /**
+   * Read the channel realization of a link from the trace file
+   * @params the tx device
+   * @params the rx device
+   * @params set to true if the realization has been recorded for the reverse link
+   * @returns the channel realization
+   */
+  Ptr<Params3gpp> ReadChannelFromTrace (Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, bool &reverse) const;
 
-  double m_frequency; // operating frequency in Hz
+  /**
+   * Append the channel realization of a link to the trace file
+   * @params the tx device
+   * @params the rx device
+   * @params the channel realization
+   */
+  void WriteChannelToTrace (Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, Ptr<Params3gpp> params) const;
+
+  mutable std::map< key_t, Ptr<Params3gpp> > m_channelMap;
 
   Ptr<UniformRandomVariable> m_uniformRv;
   Ptr<UniformRandomVariable> m_uniformRvBlockage;
@@ -331,6 +662,7 @@ private:
   Ptr<ExponentialRandomVariable> m_expRv;
 
   Ptr<PropagationLossModel> m_3gppPathloss;
+  Ptr<MmWaveVehicularPropagationLossModel> m_vehicularPathloss; // m_3gppPathloss, cast when it is set
   Ptr<ParamsTable> m_table3gpp;
   Time m_updatePeriod;
   bool m_blockage;
@@ -343,6 +675,19 @@ private:
   bool m_o2i; // true if outdoor to indoor propagation
 
   std::map < Ptr<NetDevice>, Ptr<MmWaveVehicularAntennaArrayModel> > m_deviceAntennaMap;
+  mutable std::map < Ptr<const MobilityModel>, Ptr<const MmWaveVehicularDeviceContext> > m_mobilityContextMap; // context of the device of each mobility model
+  mutable uint32_t m_nextDeviceIndex; // the index assigned to the next device context
+
+  Ptr<SpectrumPropagationLossModel> m_chainedNext; // the next model in the chain, also applied by CalcRxPowerSpectralDensityMulti
+  ChannelTraceMode_t m_channelTraceMode; // operating mode of the channel trace
+  std::string m_channelTraceFile; // name of the channel trace file
+  mutable Ptr<MmWaveVehicularChannelTraceWriter> m_traceWriter; // writer of the channel trace, created when needed
+  mutable Ptr<MmWaveVehicularChannelTraceReader> m_traceReader; // reader of the channel trace, created when needed
+
+  uint32_t m_psdPoolSize; // maximum number of buffers in the PSD pool, 0 to disable the pool
+  mutable std::vector<Ptr<SpectrumValue> > m_psdPool; // buffers for the rx PSDs, free if referenced only by the pool
+  mutable std::size_t m_psdPoolNext; // index of the next buffer of the pool to check
+  bool m_widebandGain; // if true, the same BF gain is applied to all the bands
 
 };
 
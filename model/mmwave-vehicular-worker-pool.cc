@@ -0,0 +1,136 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "mmwave-vehicular-worker-pool.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+namespace millicar {
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularWorkerPool");
+
+MmWaveVehicularWorkerPool::MmWaveVehicularWorkerPool (uint32_t numThreads)
+  : m_task (0),
+    m_numTasks (0),
+    m_nextTask (0),
+    m_activeWorkers (0),
+    m_jobId (0),
+    m_stop (false)
+{
+  NS_LOG_FUNCTION (this << numThreads);
+  NS_ASSERT_MSG (numThreads > 0, "At least one thread is needed");
+
+  // the calling thread takes part in the computation
+  for (uint32_t i = 1; i < numThreads; ++i)
+    {
+      m_workers.push_back (std::thread (&MmWaveVehicularWorkerPool::WorkerLoop, this));
+    }
+}
+
+MmWaveVehicularWorkerPool::~MmWaveVehicularWorkerPool ()
+{
+  NS_LOG_FUNCTION (this);
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    m_stop = true;
+  }
+  m_startCv.notify_all ();
+  for (auto &worker : m_workers)
+    {
+      worker.join ();
+    }
+}
+
+uint32_t
+MmWaveVehicularWorkerPool::GetNumThreads () const
+{
+  return m_workers.size () + 1;
+}
+
+void
+MmWaveVehicularWorkerPool::ParallelFor (uint32_t n, const std::function<void (uint32_t)> &task)
+{
+  NS_LOG_FUNCTION (this << n);
+
+  if (m_workers.empty () || n < 2)
+    {
+      for (uint32_t i = 0; i < n; ++i)
+        {
+          task (i);
+        }
+      return;
+    }
+
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    m_task = &task;
+    m_numTasks = n;
+    m_nextTask = 0;
+    m_activeWorkers = m_workers.size ();
+    ++m_jobId;
+  }
+  m_startCv.notify_all ();
+
+  RunTasks ();
+
+  // wait until all the workers are done with this job
+  std::unique_lock<std::mutex> lock (m_mutex);
+  m_doneCv.wait (lock, [this] { return m_activeWorkers == 0; });
+  m_task = 0;
+}
+
+void
+MmWaveVehicularWorkerPool::WorkerLoop ()
+{
+  uint64_t lastJobId = 0;
+  while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock (m_mutex);
+        m_startCv.wait (lock, [this, lastJobId] { return m_stop || m_jobId != lastJobId; });
+        if (m_stop)
+          {
+            return;
+          }
+        lastJobId = m_jobId;
+      }
+
+      RunTasks ();
+
+      std::unique_lock<std::mutex> lock (m_mutex);
+      if (--m_activeWorkers == 0)
+        {
+          m_doneCv.notify_one ();
+        }
+    }
+}
+
+void
+MmWaveVehicularWorkerPool::RunTasks ()
+{
+  uint32_t i;
+  while ((i = m_nextTask.fetch_add (1)) < m_numTasks)
+    {
+      (*m_task) (i);
+    }
+}
+
+} // namespace millicar
+} // namespace ns3
@@ -0,0 +1,97 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MMWAVE_VEHICULAR_WORKER_POOL_H
+#define MMWAVE_VEHICULAR_WORKER_POOL_H
+
+#include "ns3/simple-ref-count.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ns3 {
+
+namespace millicar {
+
+/**
+ * \ingroup millicar
+ * A fixed set of worker threads used to evaluate independent tasks in
+ * parallel, e.g., the PSDs of the receivers of a single transmission.
+ * The tasks must not interact with the simulator nor modify shared state;
+ * in particular they must not copy or release Ptr instances shared among
+ * tasks, since the reference counting is not thread safe.
+ */
+class MmWaveVehicularWorkerPool : public SimpleRefCount<MmWaveVehicularWorkerPool>
+{
+public:
+  /**
+   * Constructor
+   * \param numThreads the total number of threads, including the calling one
+   */
+  MmWaveVehicularWorkerPool (uint32_t numThreads);
+
+  /**
+   * Destructor, stops and joins the worker threads
+   */
+  ~MmWaveVehicularWorkerPool ();
+
+  /**
+   * Returns the total number of threads, including the calling one
+   * \return the number of threads
+   */
+  uint32_t GetNumThreads () const;
+
+  /**
+   * Call task (i) for each i in [0, n) and return when all the calls are
+   * completed. The calling thread takes part in the computation.
+   * \param n the number of tasks
+   * \param task the function to call
+   */
+  void ParallelFor (uint32_t n, const std::function<void (uint32_t)> &task);
+
+private:
+  /**
+   * Main loop of the worker threads
+   */
+  void WorkerLoop ();
+
+  /**
+   * Run the tasks of the current job until none is left
+   */
+  void RunTasks ();
+
+  std::vector<std::thread> m_workers; //!< the worker threads
+  std::mutex m_mutex; //!< protects the job state
+  std::condition_variable m_startCv; //!< signals a new job or the stop request
+  std::condition_variable m_doneCv; //!< signals the end of the current job
+  const std::function<void (uint32_t)> *m_task; //!< the task of the current job
+  uint32_t m_numTasks; //!< number of tasks of the current job
+  std::atomic<uint32_t> m_nextTask; //!< index of the next task to be run
+  uint32_t m_activeWorkers; //!< number of workers still running the current job
+  uint64_t m_jobId; //!< identifier of the current job
+  bool m_stop; //!< true if the workers have to terminate
+};
+
+} // namespace millicar
+} // namespace ns3
+
+#endif /* MMWAVE_VEHICULAR_WORKER_POOL_H */
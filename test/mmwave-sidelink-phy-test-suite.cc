@@ -304,6 +304,368 @@ MmWaveVehicularSpectrumPhyTestCase1::StartTest (TestVector testVector)
   //NS_LOG_UNCOND (distance << " " << average_sinr << " " << double (m_rx) / double (m_tx));
 }
 
+/**
+ * In this test, a packet is sent using the configuration parameters and using
+ * a configuration with one chunk per group of resource blocks. The test checks
+ * that the transmitted PSD has one band per group and that the total tx power
+ * is the same in both cases.
+ */
+class MmWaveSidelinkRbGroupTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveSidelinkRbGroupTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveSidelinkRbGroupTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Transmit a packet, whose PSD is stored in m_txPsds
+   * \param pmc the configuration parameters
+   * \param spectrumConfig the configuration used to create the PSDs
+   * \param spectrumModel the spectrum model of the PSDs, used if spectrumConfig is not pmc
+   */
+  void Transmit (Ptr<mmwave::MmWavePhyMacCommon> pmc, Ptr<mmwave::MmWavePhyMacCommon> spectrumConfig, Ptr<SpectrumModel> spectrumModel);
+
+  /**
+   * This method is a callback sink which is fired when a signal is
+   * transmitted on the channel
+   * \param params the parameters of the signal
+   */
+  void TxSignal (Ptr<SpectrumSignalParameters> params);
+
+  std::vector<Ptr<const SpectrumValue>> m_txPsds; //!< the transmitted PSDs
+};
+
+MmWaveSidelinkRbGroupTestCase::MmWaveSidelinkRbGroupTestCase ()
+  : TestCase ("The PSDs created with groups of resource blocks have one band per group and the same power")
+{
+}
+
+MmWaveSidelinkRbGroupTestCase::~MmWaveSidelinkRbGroupTestCase ()
+{
+}
+
+void
+MmWaveSidelinkRbGroupTestCase::TxSignal (Ptr<SpectrumSignalParameters> params)
+{
+  m_txPsds.push_back (params->psd);
+}
+
+void
+MmWaveSidelinkRbGroupTestCase::Transmit (Ptr<mmwave::MmWavePhyMacCommon> pmc, Ptr<mmwave::MmWavePhyMacCommon> spectrumConfig, Ptr<SpectrumModel> spectrumModel)
+{
+  NodeContainer n;
+  n.Create (2);
+  for (uint32_t i = 0; i < n.GetN (); i++)
+  {
+    Ptr<MobilityModel> mm = CreateObject<ConstantPositionMobilityModel> ();
+    mm->SetPosition (Vector (100.0 * i, 0.0, 0.0));
+    n.Get (i)->AggregateObject (mm);
+  }
+
+  SpectrumChannelHelper sh = SpectrumChannelHelper::Default ();
+  Ptr<SpectrumChannel> sc = sh.Create ();
+  sc->TraceConnectWithoutContext ("TxSigParams", MakeCallback (&MmWaveSidelinkRbGroupTestCase::TxSignal, this));
+
+  // the first slot of each subframe is assigned to the first device, the
+  // second one to the second device
+  std::vector<uint16_t> pattern (pmc->GetSlotsPerSubframe ());
+  pattern.at (0) = 1;
+  pattern.at (1) = 2;
+
+  std::vector<Ptr<MmWaveSidelinkPhy>> phys;
+  std::vector<Ptr<NetDevice>> devs;
+  for (uint32_t i = 0; i < n.GetN (); i++)
+  {
+    Ptr<MmWaveSidelinkSpectrumPhy> ssp = CreateObject<MmWaveSidelinkSpectrumPhy> ();
+    ssp->SetMobility (n.Get (i)->GetObject<MobilityModel> ());
+    ssp->SetAntenna (CreateObject<IsotropicAntennaModel> ());
+    ssp->SetChannel (sc);
+    sc->AddRx (ssp);
+
+    Ptr<MmWaveSidelinkPhy> phy = CreateObject<MmWaveSidelinkPhy> (ssp, pmc);
+    if (spectrumConfig != pmc)
+    {
+      phy->SetSpectrumConfiguration (spectrumConfig, spectrumModel);
+    }
+    NS_TEST_EXPECT_MSG_EQ (ssp->GetRxSpectrumModel ()->GetNumBands (), spectrumConfig->GetTotalNumChunk (), "The noise PSD must have one band per chunk");
+
+    Ptr<MmWaveSidelinkMac> mac = CreateObject<MmWaveSidelinkMac> (pmc);
+    mac->SetRnti (i + 1);
+    mac->SetSfAllocationInfo (pattern);
+    phy->SetPhySapUser (mac->GetPhySapUser ());
+
+    Ptr<NetDevice> dev = CreateObject<MmWaveVehicularNetDevice> (phy, mac);
+    n.Get (i)->AddDevice (dev);
+    dev->SetNode (n.Get (i));
+    ssp->SetDevice (dev);
+
+    phys.push_back (phy);
+    devs.push_back (dev);
+  }
+  phys.at (0)->AddDevice (2, devs.at (1));
+  phys.at (1)->AddDevice (1, devs.at (0));
+
+  // send a TB from the first device to the second one, in the first slot of
+  // the second subframe
+  Ptr<PacketBurst> pb = CreateObject<PacketBurst> ();
+  pb->AddPacket (Create<Packet> (1024));
+  mmwave::DciInfoElementTdma dci;
+  dci.m_mcs = 0;
+  dci.m_tbSize = 1024;
+  dci.m_symStart = 0;
+  dci.m_numSym = 3;
+  dci.m_rnti = 1;
+  mmwave::SlotAllocInfo info;
+  info.m_slotType = mmwave::SlotAllocInfo::DATA;
+  info.m_slotIdx = 0;
+  info.m_dci = dci;
+  info.m_rnti = 2;
+  Time slotPeriod = MicroSeconds (pmc->GetSubframePeriod () / pmc->GetSlotsPerSubframe ());
+  Simulator::Schedule (MilliSeconds (1) - slotPeriod / int64_t (2), &MmWaveSidelinkPhy::DoAddTransportBlock, phys.at (0), pb, info);
+
+  Simulator::Stop (MilliSeconds (2));
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+MmWaveSidelinkRbGroupTestCase::DoRun (void)
+{
+  uint32_t groupSize = 3;
+
+  // create the configuration
+  Ptr<mmwave::MmWavePhyMacCommon> pmc = CreateObject<mmwave::MmWavePhyMacCommon> ();
+  double subcarrierSpacing = 15 * std::pow (2, 2) * 1000;
+  pmc->SetSymbPerSlot (14);
+  pmc->SetSlotPerSubframe (std::pow (2, 2));
+  pmc->SetSubframePeriod (1000);
+  pmc->SetSymbolPeriod (pmc->GetSubframePeriod () / pmc->GetSlotsPerSubframe () / 14.0);
+  double subCarriersPerRB = 12;
+  pmc->SetNumChunkPerRB (1);
+  pmc->SetNumRb (uint32_t (100e6 / (subcarrierSpacing * subCarriersPerRB)));
+  pmc->SetChunkWidth (subCarriersPerRB * subcarrierSpacing);
+
+  // create the configuration of the spectrum, as done by the helper
+  Ptr<mmwave::MmWavePhyMacCommon> groupConfig = CopyObject<mmwave::MmWavePhyMacCommon> (pmc);
+  groupConfig->SetNumRb (pmc->GetNumRb () / groupSize);
+  groupConfig->SetChunkWidth (pmc->GetChunkWidth () * groupSize);
+  NS_TEST_ASSERT_MSG_EQ (pmc->GetNumRb () % groupSize, 0u, "The group size must divide the number of RBs");
+  Bands bands;
+  double f = pmc->GetCenterFrequency () - groupConfig->GetTotalNumChunk () * groupConfig->GetChunkWidth () / 2.0;
+  for (uint32_t i = 0; i < groupConfig->GetTotalNumChunk (); i++)
+  {
+    BandInfo b;
+    b.fl = f;
+    b.fc = f + groupConfig->GetChunkWidth () / 2;
+    b.fh = f + groupConfig->GetChunkWidth ();
+    f = b.fh;
+    bands.push_back (b);
+  }
+  Ptr<SpectrumModel> groupModel = Create<SpectrumModel> (bands);
+
+  Transmit (pmc, pmc, 0);
+  Transmit (pmc, groupConfig, groupModel);
+  NS_TEST_ASSERT_MSG_EQ (m_txPsds.size (), 2u, "The TBs have not been transmitted");
+  Ptr<const SpectrumValue> rbPsd = m_txPsds.at (0);
+  Ptr<const SpectrumValue> groupPsd = m_txPsds.at (1);
+
+  NS_TEST_EXPECT_MSG_EQ (rbPsd->GetSpectrumModel ()->GetNumBands (), pmc->GetNumRb (), "The PSD must have one band per RB");
+  NS_TEST_EXPECT_MSG_EQ (groupPsd->GetSpectrumModel ()->GetNumBands (), pmc->GetNumRb () / groupSize, "The PSD must have one band per group");
+  NS_TEST_EXPECT_MSG_NE (groupPsd->GetSpectrumModel ()->GetUid (), rbPsd->GetSpectrumModel ()->GetUid (), "The spectrum models must be different");
+
+  // the whole bandwidth is used, hence the total power is the tx power
+  double txPower = 1.0; // default tx power of 30 dBm, in W
+  NS_TEST_EXPECT_MSG_EQ_TOL (Integral (*rbPsd), txPower, txPower * 1e-9, "Wrong tx power with one band per RB");
+  NS_TEST_EXPECT_MSG_EQ_TOL (Integral (*groupPsd), Integral (*rbPsd), txPower * 1e-9, "The tx power must not depend on the groups");
+}
+
+/**
+ * In this test, a device sends a TB in four consecutive subframes, and the
+ * tx power is changed between the first and the second TB and between the
+ * second and the third one. The test checks that each transmitted PSD is
+ * equal to the one created for each TB by MmWaveSpectrumValueHelper, i.e.,
+ * that the PSD reused by the PHY is updated when the power changes.
+ */
+class MmWaveSidelinkTxPsdTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveSidelinkTxPsdTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveSidelinkTxPsdTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Add a TB to the buffer of the PHY, to be sent in the first slot of the
+   * next subframe
+   * \param phy the tx PHY
+   */
+  void AddTransportBlock (Ptr<MmWaveSidelinkPhy> phy);
+
+  /**
+   * This method is a callback sink which is fired when a signal is
+   * transmitted on the channel
+   * \param params the parameters of the signal
+   */
+  void TxSignal (Ptr<SpectrumSignalParameters> params);
+
+  std::vector<Ptr<const SpectrumValue>> m_txPsds; //!< the transmitted PSDs
+};
+
+MmWaveSidelinkTxPsdTestCase::MmWaveSidelinkTxPsdTestCase ()
+  : TestCase ("The tx PSD follows the changes of the tx power")
+{
+}
+
+MmWaveSidelinkTxPsdTestCase::~MmWaveSidelinkTxPsdTestCase ()
+{
+}
+
+void
+MmWaveSidelinkTxPsdTestCase::TxSignal (Ptr<SpectrumSignalParameters> params)
+{
+  m_txPsds.push_back (params->psd);
+}
+
+void
+MmWaveSidelinkTxPsdTestCase::AddTransportBlock (Ptr<MmWaveSidelinkPhy> phy)
+{
+  Ptr<PacketBurst> pb = CreateObject<PacketBurst> ();
+  pb->AddPacket (Create<Packet> (1024));
+  mmwave::DciInfoElementTdma dci;
+  dci.m_mcs = 0;
+  dci.m_tbSize = 1024;
+  dci.m_symStart = 0;
+  dci.m_numSym = 3;
+  dci.m_rnti = 1;
+  mmwave::SlotAllocInfo info;
+  info.m_slotType = mmwave::SlotAllocInfo::DATA;
+  info.m_slotIdx = 0;
+  info.m_dci = dci;
+  info.m_rnti = 2;
+  phy->DoAddTransportBlock (pb, info);
+}
+
+void
+MmWaveSidelinkTxPsdTestCase::DoRun (void)
+{
+  // create the configuration
+  Ptr<mmwave::MmWavePhyMacCommon> pmc = CreateObject<mmwave::MmWavePhyMacCommon> ();
+  double subcarrierSpacing = 15 * std::pow (2, 2) * 1000;
+  pmc->SetSymbPerSlot (14);
+  pmc->SetSlotPerSubframe (std::pow (2, 2));
+  pmc->SetSubframePeriod (1000);
+  pmc->SetSymbolPeriod (pmc->GetSubframePeriod () / pmc->GetSlotsPerSubframe () / 14.0);
+  double subCarriersPerRB = 12;
+  pmc->SetNumChunkPerRB (1);
+  pmc->SetNumRb (uint32_t (100e6 / (subcarrierSpacing * subCarriersPerRB)));
+  pmc->SetChunkWidth (subCarriersPerRB * subcarrierSpacing);
+
+  NodeContainer n;
+  n.Create (2);
+  for (uint32_t i = 0; i < n.GetN (); i++)
+  {
+    Ptr<MobilityModel> mm = CreateObject<ConstantPositionMobilityModel> ();
+    mm->SetPosition (Vector (100.0 * i, 0.0, 0.0));
+    n.Get (i)->AggregateObject (mm);
+  }
+
+  SpectrumChannelHelper sh = SpectrumChannelHelper::Default ();
+  Ptr<SpectrumChannel> sc = sh.Create ();
+  sc->TraceConnectWithoutContext ("TxSigParams", MakeCallback (&MmWaveSidelinkTxPsdTestCase::TxSignal, this));
+
+  std::vector<uint16_t> pattern (pmc->GetSlotsPerSubframe ());
+  pattern.at (0) = 1;
+  pattern.at (1) = 2;
+
+  std::vector<Ptr<MmWaveSidelinkPhy>> phys;
+  std::vector<Ptr<NetDevice>> devs;
+  for (uint32_t i = 0; i < n.GetN (); i++)
+  {
+    Ptr<MmWaveSidelinkSpectrumPhy> ssp = CreateObject<MmWaveSidelinkSpectrumPhy> ();
+    ssp->SetMobility (n.Get (i)->GetObject<MobilityModel> ());
+    ssp->SetAntenna (CreateObject<IsotropicAntennaModel> ());
+    ssp->SetChannel (sc);
+    sc->AddRx (ssp);
+
+    Ptr<MmWaveSidelinkPhy> phy = CreateObject<MmWaveSidelinkPhy> (ssp, pmc);
+    Ptr<MmWaveSidelinkMac> mac = CreateObject<MmWaveSidelinkMac> (pmc);
+    mac->SetRnti (i + 1);
+    mac->SetSfAllocationInfo (pattern);
+    phy->SetPhySapUser (mac->GetPhySapUser ());
+
+    Ptr<NetDevice> dev = CreateObject<MmWaveVehicularNetDevice> (phy, mac);
+    n.Get (i)->AddDevice (dev);
+    dev->SetNode (n.Get (i));
+    ssp->SetDevice (dev);
+
+    phys.push_back (phy);
+    devs.push_back (dev);
+  }
+  phys.at (0)->AddDevice (2, devs.at (1));
+  phys.at (1)->AddDevice (1, devs.at (0));
+
+  // send a TB in the first slot of the subframes 1, 2, 3 and 4, and change
+  // the tx power after the first and the second TB
+  std::vector<double> txPowers = {30.0, 20.0, 30.0, 30.0};
+  Time slotPeriod = MicroSeconds (pmc->GetSubframePeriod () / pmc->GetSlotsPerSubframe ());
+  phys.at (0)->SetTxPower (txPowers.at (0));
+  for (uint32_t i = 0; i < txPowers.size (); i++)
+  {
+    Time subframeStart = MilliSeconds (i + 1);
+    if (i > 0 && txPowers.at (i) != txPowers.at (i - 1))
+    {
+      Simulator::Schedule (subframeStart - slotPeriod, &MmWaveSidelinkPhy::SetTxPower, phys.at (0), txPowers.at (i));
+    }
+    Simulator::Schedule (subframeStart - slotPeriod / int64_t (2), &MmWaveSidelinkTxPsdTestCase::AddTransportBlock, this, phys.at (0));
+  }
+
+  Simulator::Stop (MilliSeconds (txPowers.size () + 1));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  // the PSDs created for each TB, using all the subchannels
+  std::vector<int> subChannels (pmc->GetTotalNumChunk ());
+  for (uint32_t i = 0; i < subChannels.size (); i++)
+  {
+    subChannels.at (i) = i;
+  }
+
+  NS_TEST_ASSERT_MSG_EQ (m_txPsds.size (), txPowers.size (), "The TBs have not been transmitted");
+  for (uint32_t i = 0; i < txPowers.size (); i++)
+  {
+    Ptr<SpectrumValue> expected = mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (pmc, txPowers.at (i), subChannels);
+    Ptr<const SpectrumValue> actual = m_txPsds.at (i);
+    NS_TEST_ASSERT_MSG_EQ (actual->GetSpectrumModel ()->GetNumBands (), expected->GetSpectrumModel ()->GetNumBands (), "Wrong number of bands in TB " << i);
+    for (uint32_t k = 0; k < expected->GetSpectrumModel ()->GetNumBands (); k++)
+    {
+      NS_TEST_EXPECT_MSG_EQ_TOL ((*actual)[k], (*expected)[k], (*expected)[k] * 1e-9, "Wrong PSD in band " << k << " of TB " << i);
+    }
+  }
+}
+
 /**
  * Test suite for the class MmWaveSidelinkPhy
  */
@@ -318,6 +680,8 @@ MmWaveVehicularSpectrumPhyTestSuite::MmWaveVehicularSpectrumPhyTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new MmWaveVehicularSpectrumPhyTestCase1, TestCase::QUICK);
+  AddTestCase (new MmWaveSidelinkRbGroupTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveSidelinkTxPsdTestCase, TestCase::QUICK);
 }
 
 static MmWaveVehicularSpectrumPhyTestSuite MmWaveVehicularSpectrumPhyTestSuite;
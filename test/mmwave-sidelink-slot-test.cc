@@ -0,0 +1,467 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-sidelink-mac.h"
+#include "ns3/mmwave-sidelink-slot-clock.h"
+#include "ns3/mmwave-vehicular-net-device.h"
+#include "ns3/mmwave-vehicular-helper.h"
+#include "ns3/mobility-module.h"
+#include "ns3/test.h"
+#include "ns3/applications-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/core-module.h"
+#include <sstream>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveSidelinkSlotTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * Two vehicles, the first one sends UDP packets to the second one with an
+ * interval which is not a multiple of the subframe. The scheduling decisions
+ * of the MACs, the reception times and the number of events are stored.
+ */
+class MmWaveSidelinkSlotTestScenario
+{
+public:
+  /**
+   * Run the scenario, with the configuration set through the default values
+   * of the attributes
+   */
+  MmWaveSidelinkSlotTestScenario ();
+
+  /**
+   * Callback sink fired when a MAC schedules a transport block
+   * \param params the scheduling information
+   */
+  void Scheduled (SlSchedulingCallback params);
+
+  /**
+   * Callback sink fired when the UDP server receives a packet
+   * \param p received packet
+   */
+  void Rx (Ptr<const Packet> p);
+
+  std::vector<std::pair<Time, SlSchedulingCallback> > m_scheduled; //!< the scheduling decisions, with the time at which they are taken
+  std::vector<Time> m_rxTimes; //!< the reception times of the packets
+  uint64_t m_numEvents; //!< the number of events processed by the simulator
+};
+
+MmWaveSidelinkSlotTestScenario::MmWaveSidelinkSlotTestScenario ()
+{
+  Config::SetDefault ("ns3::MmWaveSidelinkMac::UseAmc", BooleanValue (false));
+
+  NodeContainer n;
+  n.Create (2);
+
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator> ();
+  positionAlloc->Add (Vector (0.0, 0.0, 0.0));
+  positionAlloc->Add (Vector (10.0, 0.0, 0.0));
+  mobility.SetPositionAllocator (positionAlloc);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (n);
+
+  Ptr<MmWaveVehicularHelper> helper = CreateObject<MmWaveVehicularHelper> ();
+  helper->SetNumerology (3);
+  NetDeviceContainer devs = helper->InstallMmWaveVehicularNetDevices (n);
+  for (uint32_t i = 0; i < devs.GetN (); i++)
+  {
+    Ptr<MmWaveVehicularNetDevice> dev = DynamicCast<MmWaveVehicularNetDevice> (devs.Get (i));
+    dev->GetMac ()->TraceConnectWithoutContext ("SchedulingInfo", MakeCallback (&MmWaveSidelinkSlotTestScenario::Scheduled, this));
+  }
+
+  InternetStackHelper internet;
+  internet.Install (n);
+
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  ipv4.Assign (devs);
+  helper->PairDevices (devs);
+
+  Ipv4StaticRoutingHelper ipv4RoutingHelper;
+  Ptr<Ipv4StaticRouting> staticRouting = ipv4RoutingHelper.GetStaticRouting (n.Get (0)->GetObject<Ipv4> ());
+  staticRouting->SetDefaultRoute (n.Get (1)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal (), 2);
+
+  uint16_t port = 4000;
+  UdpServerHelper server (port);
+  ApplicationContainer apps = server.Install (n.Get (1));
+  apps.Start (MilliSeconds (0));
+  apps.Get (0)->TraceConnectWithoutContext ("Rx", MakeCallback (&MmWaveSidelinkSlotTestScenario::Rx, this));
+
+  UdpClientHelper client (n.Get (1)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal (), port);
+  client.SetAttribute ("MaxPackets", UintegerValue (0xFFFFFFFF));
+  client.SetAttribute ("Interval", TimeValue (MicroSeconds (2700)));
+  client.SetAttribute ("PacketSize", UintegerValue (200));
+  apps = client.Install (n.Get (0));
+  apps.Start (MilliSeconds (10));
+  apps.Stop (MilliSeconds (60));
+
+  Simulator::Stop (MilliSeconds (100));
+  Simulator::Run ();
+  m_numEvents = Simulator::GetEventCount ();
+  Simulator::Destroy ();
+}
+
+void
+MmWaveSidelinkSlotTestScenario::Scheduled (SlSchedulingCallback params)
+{
+  m_scheduled.push_back (std::make_pair (Simulator::Now (), params));
+}
+
+void
+MmWaveSidelinkSlotTestScenario::Rx (Ptr<const Packet> p)
+{
+  m_rxTimes.push_back (Simulator::Now ());
+}
+
+/**
+ * Compare the activity of two scenarios, i.e., the scheduling decisions,
+ * the time at which they are taken, and the reception times
+ * \param actual the scenario under test
+ * \param expected the baseline scenario
+ * \return the description of the first difference, or an empty string if
+ *         the activity is the same
+ */
+static std::string
+GetFirstDifference (const MmWaveSidelinkSlotTestScenario &actual, const MmWaveSidelinkSlotTestScenario &expected)
+{
+  std::ostringstream diff;
+  if (actual.m_scheduled.size () != expected.m_scheduled.size ())
+  {
+    diff << "different number of scheduled TBs, " << actual.m_scheduled.size () << " instead of " << expected.m_scheduled.size ();
+    return diff.str ();
+  }
+  for (uint32_t i = 0; i < expected.m_scheduled.size (); i++)
+  {
+    const SlSchedulingCallback &a = actual.m_scheduled.at (i).second;
+    const SlSchedulingCallback &e = expected.m_scheduled.at (i).second;
+    if (actual.m_scheduled.at (i).first != expected.m_scheduled.at (i).first
+        || a.frame != e.frame || a.subframe != e.subframe || a.slotNum != e.slotNum
+        || a.symStart != e.symStart || a.numSym != e.numSym || a.tbSize != e.tbSize
+        || a.txRnti != e.txRnti || a.rxRnti != e.rxRnti)
+    {
+      diff << "TB " << i << " scheduled by rnti " << a.txRnti << " at " << actual.m_scheduled.at (i).first
+           << " in slot " << a.frame << "/" << uint16_t (a.subframe) << "/" << uint16_t (a.slotNum)
+           << " instead of rnti " << e.txRnti << " at " << expected.m_scheduled.at (i).first
+           << " in slot " << e.frame << "/" << uint16_t (e.subframe) << "/" << uint16_t (e.slotNum);
+      return diff.str ();
+    }
+  }
+
+  if (actual.m_rxTimes.size () != expected.m_rxTimes.size ())
+  {
+    diff << "different number of received packets, " << actual.m_rxTimes.size () << " instead of " << expected.m_rxTimes.size ();
+    return diff.str ();
+  }
+  for (uint32_t i = 0; i < expected.m_rxTimes.size (); i++)
+  {
+    if (actual.m_rxTimes.at (i) != expected.m_rxTimes.at (i))
+    {
+      diff << "packet " << i << " received at " << actual.m_rxTimes.at (i) << " instead of " << expected.m_rxTimes.at (i);
+      return diff.str ();
+    }
+  }
+  return diff.str ();
+}
+
+/**
+ * In this test, the scenario runs with and without skipping the idle slots.
+ * The test checks that the devices take the same decisions at the same time
+ * and deliver the same packets at the same time, and that fewer events are
+ * processed when the idle slots are skipped.
+ */
+class MmWaveSidelinkSkipIdleSlotsTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveSidelinkSkipIdleSlotsTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveSidelinkSkipIdleSlotsTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveSidelinkSkipIdleSlotsTestCase::MmWaveSidelinkSkipIdleSlotsTestCase ()
+  : TestCase ("Skipping the idle slots does not change the activity of the devices")
+{
+}
+
+MmWaveSidelinkSkipIdleSlotsTestCase::~MmWaveSidelinkSkipIdleSlotsTestCase ()
+{
+}
+
+void
+MmWaveSidelinkSkipIdleSlotsTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::MmWaveSidelinkPhy::SkipIdleSlots", BooleanValue (false));
+  MmWaveSidelinkSlotTestScenario baseline;
+  Config::SetDefault ("ns3::MmWaveSidelinkPhy::SkipIdleSlots", BooleanValue (true));
+  MmWaveSidelinkSlotTestScenario skip;
+  Config::SetDefault ("ns3::MmWaveSidelinkPhy::SkipIdleSlots", BooleanValue (false));
+
+  NS_TEST_ASSERT_MSG_GT (baseline.m_rxTimes.size (), 0u, "No packet has been received");
+  std::string diff = GetFirstDifference (skip, baseline);
+  NS_TEST_EXPECT_MSG_EQ (diff, std::string (), "Different activity when skipping the idle slots: " << diff);
+  NS_TEST_EXPECT_MSG_LT (skip.m_numEvents, baseline.m_numEvents, "The idle slots have not been skipped");
+}
+
+/**
+ * In this test, some callbacks subscribe to a slot clock and unsubscribe,
+ * also while the clock is iterating the subscribers. The test checks that
+ * each callback is triggered at each slot boundary between its subscription
+ * and its unsubscription, as the event loop of a device would do, and that
+ * the clock stops when there are no subscribers.
+ */
+class MmWaveSidelinkSlotClockTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveSidelinkSlotClockTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveSidelinkSlotClockTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Callback of the first subscriber, which unsubscribes the second one and
+   * subscribes the third one in the slot 2, and unsubscribes in the slot 4
+   * \param timingInfo the timing information of the slot
+   */
+  void FirstTick (mmwave::SfnSf timingInfo);
+
+  /**
+   * Callback of the second subscriber, which unsubscribes in the slot 7
+   * \param timingInfo the timing information of the slot
+   */
+  void SecondTick (mmwave::SfnSf timingInfo);
+
+  /**
+   * Callback of the third subscriber, which unsubscribes in the slot 5
+   * \param timingInfo the timing information of the slot
+   */
+  void ThirdTick (mmwave::SfnSf timingInfo);
+
+  /**
+   * Subscribe the second callback
+   */
+  void SubscribeSecond ();
+
+  /**
+   * Returns the absolute index of the current slot
+   * \return the index of the slot
+   */
+  uint32_t GetSlot () const;
+
+  Ptr<MmWaveSidelinkSlotClock> m_clock; //!< the clock under test
+  uint32_t m_firstId; //!< subscription id of the first callback
+  uint32_t m_secondId; //!< subscription id of the second callback
+  uint32_t m_thirdId; //!< subscription id of the third callback
+  std::vector<std::pair<char, uint32_t> > m_ticks; //!< the callbacks triggered, with the absolute index of the slot
+  std::vector<uint16_t> m_slotNums; //!< the slot numbers passed to the callbacks
+};
+
+MmWaveSidelinkSlotClockTestCase::MmWaveSidelinkSlotClockTestCase ()
+  : TestCase ("The slot clock triggers the subscribers at the slot boundaries")
+{
+}
+
+MmWaveSidelinkSlotClockTestCase::~MmWaveSidelinkSlotClockTestCase ()
+{
+}
+
+uint32_t
+MmWaveSidelinkSlotClockTestCase::GetSlot () const
+{
+  return Simulator::Now ().GetTimeStep () / m_clock->GetSlotPeriod ().GetTimeStep ();
+}
+
+void
+MmWaveSidelinkSlotClockTestCase::FirstTick (mmwave::SfnSf timingInfo)
+{
+  m_ticks.push_back (std::make_pair ('A', GetSlot ()));
+  m_slotNums.push_back (timingInfo.m_slotNum);
+  if (GetSlot () == 2)
+  {
+    // the second subscriber comes after this one in the current tick
+    m_clock->Unsubscribe (m_secondId);
+    m_thirdId = m_clock->Subscribe (MakeCallback (&MmWaveSidelinkSlotClockTestCase::ThirdTick, this));
+  }
+  else if (GetSlot () == 4)
+  {
+    m_clock->Unsubscribe (m_firstId);
+  }
+}
+
+void
+MmWaveSidelinkSlotClockTestCase::SecondTick (mmwave::SfnSf timingInfo)
+{
+  m_ticks.push_back (std::make_pair ('B', GetSlot ()));
+  m_slotNums.push_back (timingInfo.m_slotNum);
+  if (GetSlot () == 7)
+  {
+    m_clock->Unsubscribe (m_secondId);
+  }
+}
+
+void
+MmWaveSidelinkSlotClockTestCase::ThirdTick (mmwave::SfnSf timingInfo)
+{
+  m_ticks.push_back (std::make_pair ('C', GetSlot ()));
+  m_slotNums.push_back (timingInfo.m_slotNum);
+  if (GetSlot () == 5)
+  {
+    m_clock->Unsubscribe (m_thirdId);
+  }
+}
+
+void
+MmWaveSidelinkSlotClockTestCase::SubscribeSecond ()
+{
+  m_secondId = m_clock->Subscribe (MakeCallback (&MmWaveSidelinkSlotClockTestCase::SecondTick, this));
+}
+
+void
+MmWaveSidelinkSlotClockTestCase::DoRun (void)
+{
+  Ptr<mmwave::MmWavePhyMacCommon> pmc = CreateObject<mmwave::MmWavePhyMacCommon> ();
+  m_clock = CreateObject<MmWaveSidelinkSlotClock> (pmc);
+  Time slotPeriod = m_clock->GetSlotPeriod ();
+  NS_TEST_ASSERT_MSG_GT (slotPeriod, Seconds (0), "Wrong slot period");
+
+  m_firstId = m_clock->Subscribe (MakeCallback (&MmWaveSidelinkSlotClockTestCase::FirstTick, this));
+  SubscribeSecond ();
+
+  // the clock is idle after the slot 5, the second callback subscribes again
+  // in the middle of the slot 5 and it is triggered from the slot 6
+  Simulator::Schedule (slotPeriod * int64_t (5) + slotPeriod / int64_t (2), &MmWaveSidelinkSlotClockTestCase::SubscribeSecond, this);
+
+  // the simulation ends when the clock stops, i.e., in the slot 7
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (Simulator::Now (), slotPeriod * int64_t (7), "The clock has not stopped");
+  Simulator::Destroy ();
+
+  // the subscribers would be triggered in the same order by an event per
+  // subscriber and per slot, scheduled in order of subscription
+  std::vector<std::pair<char, uint32_t> > expected = {{'A', 0}, {'B', 0}, {'A', 1}, {'B', 1}, {'A', 2},
+                                                      {'A', 3}, {'C', 3}, {'A', 4}, {'C', 4}, {'C', 5},
+                                                      {'B', 6}, {'B', 7}};
+  NS_TEST_ASSERT_MSG_EQ (m_ticks.size (), expected.size (), "Wrong number of callbacks");
+  for (uint32_t i = 0; i < expected.size (); i++)
+  {
+    NS_TEST_EXPECT_MSG_EQ (m_ticks.at (i).first, expected.at (i).first, "Wrong callback " << i);
+    NS_TEST_EXPECT_MSG_EQ (m_ticks.at (i).second, expected.at (i).second, "Wrong slot for callback " << i);
+    NS_TEST_EXPECT_MSG_EQ (m_slotNums.at (i), expected.at (i).second % pmc->GetSlotsPerSubframe (), "Wrong slot number for callback " << i);
+  }
+}
+
+/**
+ * In this test, the scenario runs with a slot event loop per device and with
+ * a slot clock shared by the devices, with and without skipping the idle
+ * slots. The test checks that the devices take the same decisions at the
+ * same time and deliver the same packets at the same time, and that fewer
+ * events are processed with the shared clock.
+ */
+class MmWaveSidelinkSharedSlotClockTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveSidelinkSharedSlotClockTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveSidelinkSharedSlotClockTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveSidelinkSharedSlotClockTestCase::MmWaveSidelinkSharedSlotClockTestCase ()
+  : TestCase ("The shared slot clock does not change the activity of the devices")
+{
+}
+
+MmWaveSidelinkSharedSlotClockTestCase::~MmWaveSidelinkSharedSlotClockTestCase ()
+{
+}
+
+void
+MmWaveSidelinkSharedSlotClockTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::MmWaveVehicularHelper::SharedSlotClock", BooleanValue (false));
+  Config::SetDefault ("ns3::MmWaveSidelinkPhy::SkipIdleSlots", BooleanValue (false));
+  MmWaveSidelinkSlotTestScenario baseline;
+  Config::SetDefault ("ns3::MmWaveVehicularHelper::SharedSlotClock", BooleanValue (true));
+  MmWaveSidelinkSlotTestScenario shared;
+  Config::SetDefault ("ns3::MmWaveSidelinkPhy::SkipIdleSlots", BooleanValue (true));
+  MmWaveSidelinkSlotTestScenario sharedSkip;
+  Config::SetDefault ("ns3::MmWaveVehicularHelper::SharedSlotClock", BooleanValue (false));
+  Config::SetDefault ("ns3::MmWaveSidelinkPhy::SkipIdleSlots", BooleanValue (false));
+
+  NS_TEST_ASSERT_MSG_GT (baseline.m_rxTimes.size (), 0u, "No packet has been received");
+  std::string diff = GetFirstDifference (shared, baseline);
+  NS_TEST_EXPECT_MSG_EQ (diff, std::string (), "Different activity with the shared clock: " << diff);
+  diff = GetFirstDifference (sharedSkip, baseline);
+  NS_TEST_EXPECT_MSG_EQ (diff, std::string (), "Different activity with the shared clock skipping the idle slots: " << diff);
+  NS_TEST_EXPECT_MSG_LT (shared.m_numEvents, baseline.m_numEvents, "The devices are not driven by a single clock");
+}
+
+/**
+ * Test suite for the slot processing of the sidelink devices
+ */
+class MmWaveSidelinkSlotTestSuite : public TestSuite
+{
+public:
+  MmWaveSidelinkSlotTestSuite ();
+};
+
+MmWaveSidelinkSlotTestSuite::MmWaveSidelinkSlotTestSuite ()
+  : TestSuite ("mmwave-sidelink-slot", UNIT)
+{
+  AddTestCase (new MmWaveSidelinkSkipIdleSlotsTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveSidelinkSlotClockTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveSidelinkSharedSlotClockTestCase, TestCase::QUICK);
+}
+
+static MmWaveSidelinkSlotTestSuite mmwaveSidelinkSlotTestSuite;
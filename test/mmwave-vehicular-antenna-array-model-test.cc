@@ -0,0 +1,535 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-antenna-array-model.h"
+#include "ns3/mmwave-vehicular-beam-codebook.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/mobility-module.h"
+#include "ns3/core-module.h"
+#include "ns3/test.h"
+#include <limits>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularAntennaArrayModelTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * Create a device on a new node placed in a given position
+ * \param position the position of the node
+ * \return the device
+ */
+static Ptr<NetDevice>
+CreateTestDevice (Vector position)
+{
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<MobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+  mobility->SetPosition (position);
+  node->AggregateObject (mobility);
+  Ptr<NetDevice> device = CreateObject<SimpleNetDevice> ();
+  node->AddDevice (device);
+  return device;
+}
+
+/**
+ * Create an antenna array with 2 sectors
+ * \param resolution the value of the attribute BeamResolution
+ * \param numElements the number of antenna elements
+ * \return the antenna
+ */
+static Ptr<MmWaveVehicularAntennaArrayModel>
+CreateTestAntenna (double resolution, uint64_t numElements = 16)
+{
+  Ptr<MmWaveVehicularAntennaArrayModel> antenna = CreateObject<MmWaveVehicularAntennaArrayModel> ();
+  antenna->SetAttribute ("AntennaElements", UintegerValue (numElements));
+  antenna->SetAttribute ("NumSectors", UintegerValue (2));
+  antenna->SetAttribute ("BeamResolution", DoubleValue (resolution));
+  return antenna;
+}
+
+/**
+ * Returns the largest difference between the elements of two beamforming
+ * vectors
+ * \param first the first vector
+ * \param second the second vector
+ * \return the largest absolute difference, or infinity if the sizes differ
+ */
+static double
+GetMaxDifference (const complexVector_t &first, const complexVector_t &second)
+{
+  if (first.size () != second.size ())
+    {
+      return std::numeric_limits<double>::infinity ();
+    }
+  double difference = 0;
+  for (uint32_t i = 0; i < first.size (); ++i)
+    {
+      difference = std::max (difference, std::abs (first[i] - second[i]));
+    }
+  return difference;
+}
+
+/**
+ * In this test, an antenna using the codebook and an antenna computing the
+ * exact beams point towards two peers, whose directions lie on the grid of
+ * the codebook. The test checks that the beams resolved from the codebook
+ * index stored for each peer are equal to the exact ones, both for the
+ * current peer and for the other one, and that the separable factors give
+ * the same vector. It then checks that changing the resolution updates the
+ * beams stored for the peers.
+ */
+class MmWaveVehicularCodebookBeamTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularCodebookBeamTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularCodebookBeamTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Check that two beamforming vectors are equal
+   * \param actual the vector under test
+   * \param expected the expected vector
+   * \param msg the message printed in case of failure
+   */
+  void CheckBeam (const complexVector_t &actual, const complexVector_t &expected, std::string msg);
+};
+
+MmWaveVehicularCodebookBeamTestCase::MmWaveVehicularCodebookBeamTestCase ()
+  : TestCase ("The beams resolved from the codebook index are equal to the exact ones")
+{
+}
+
+MmWaveVehicularCodebookBeamTestCase::~MmWaveVehicularCodebookBeamTestCase ()
+{
+}
+
+void
+MmWaveVehicularCodebookBeamTestCase::CheckBeam (const complexVector_t &actual, const complexVector_t &expected, std::string msg)
+{
+  NS_TEST_ASSERT_MSG_EQ (actual.size (), expected.size (), msg << ": wrong size");
+  for (uint32_t i = 0; i < expected.size (); ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ_TOL (actual[i].real (), expected[i].real (), 1e-9, msg << ": element " << i);
+      NS_TEST_EXPECT_MSG_EQ_TOL (actual[i].imag (), expected[i].imag (), 1e-9, msg << ": element " << i);
+    }
+}
+
+void
+MmWaveVehicularCodebookBeamTestCase::DoRun (void)
+{
+  Ptr<NetDevice> thisDevice = CreateTestDevice (Vector (0, 0, 0));
+  // boresight of the first panel and edge of the second one, both on the
+  // grid of a codebook with a resolution of 5 degrees
+  Ptr<NetDevice> front = CreateTestDevice (Vector (10, 0, 0));
+  Ptr<NetDevice> side = CreateTestDevice (Vector (0, 10, 0));
+
+  Ptr<MmWaveVehicularAntennaArrayModel> codebookAntenna = CreateTestAntenna (5);
+  Ptr<MmWaveVehicularAntennaArrayModel> exactAntenna = CreateTestAntenna (0);
+
+  codebookAntenna->SetBeamformingVectorPanelDevices (thisDevice, front);
+  exactAntenna->SetBeamformingVectorPanelDevices (thisDevice, front);
+  complexVector_t exactFront = exactAntenna->GetBeamformingVectorPanel ();
+  CheckBeam (codebookAntenna->GetBeamformingVectorPanel (), exactFront, "front, current");
+  uint64_t frontBeamId = codebookAntenna->GetBeamId ();
+  NS_TEST_EXPECT_MSG_NE (frontBeamId, 0u, "The beam has not been set");
+
+  codebookAntenna->SetBeamformingVectorPanelDevices (thisDevice, side);
+  exactAntenna->SetBeamformingVectorPanelDevices (thisDevice, side);
+  complexVector_t exactSide = exactAntenna->GetBeamformingVectorPanel ();
+  CheckBeam (codebookAntenna->GetBeamformingVectorPanel (), exactSide, "side, current");
+  CheckBeam (codebookAntenna->GetBeamformingVectorPanel (front), exactFront, "front, stored");
+  NS_TEST_EXPECT_MSG_EQ (codebookAntenna->GetPlanesId (), 1, "Wrong panel");
+
+  complexVector_t hWeights;
+  complexVector_t vWeights;
+  NS_TEST_ASSERT_MSG_EQ (codebookAntenna->GetBeamformingVectorFactors (hWeights, vWeights), true, "The codebook beam is separable");
+  CheckBeam (MmWaveVehicularAntennaArrayModel::KroneckerProduct (hWeights, vWeights), exactSide, "side, factors");
+
+  // back to the first peer, the stored codebook index is reused
+  codebookAntenna->ChangeBeamformingVectorPanel (front);
+  CheckBeam (codebookAntenna->GetBeamformingVectorPanel (), exactFront, "front, changed");
+  NS_TEST_EXPECT_MSG_EQ (codebookAntenna->GetBeamId (), frontBeamId, "The beam of the first peer changed");
+  NS_TEST_EXPECT_MSG_EQ (codebookAntenna->GetPlanesId (), 0, "Wrong panel");
+
+  // the stored beams follow a change of the resolution, to a coarser
+  // codebook whose grid still contains both directions and to the exact
+  // beams
+  codebookAntenna->SetAttribute ("BeamResolution", DoubleValue (15));
+  CheckBeam (codebookAntenna->GetBeamformingVectorPanel (side), exactSide, "side, resolution 15");
+  codebookAntenna->ChangeBeamformingVectorPanel (front);
+  CheckBeam (codebookAntenna->GetBeamformingVectorPanel (), exactFront, "front, resolution 15");
+  NS_TEST_EXPECT_MSG_NE (codebookAntenna->GetBeamId (), frontBeamId, "The beam of the new codebook needs a new identifier");
+  codebookAntenna->SetAttribute ("BeamResolution", DoubleValue (0));
+  CheckBeam (codebookAntenna->GetBeamformingVectorPanel (side), exactSide, "side, resolution 0");
+
+  // a vector set explicitly is not separable
+  codebookAntenna->SetBeamformingVectorPanel (exactSide, side);
+  codebookAntenna->ChangeBeamformingVectorPanel (side);
+  CheckBeam (codebookAntenna->GetBeamformingVectorPanel (), exactSide, "side, explicit");
+  NS_TEST_EXPECT_MSG_EQ (codebookAntenna->GetBeamformingVectorFactors (hWeights, vWeights), false, "An explicit vector is not separable");
+
+  codebookAntenna->Dispose ();
+  exactAntenna->Dispose ();
+}
+
+/**
+ * In this test, two antennas share a codebook, which is also obtained and
+ * released once more while a reference to it is kept. The test checks that
+ * the codebook is released when both antennas are disposed, and that an
+ * antenna changing its resolution stops using it.
+ */
+class MmWaveVehicularCodebookLifetimeTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularCodebookLifetimeTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularCodebookLifetimeTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularCodebookLifetimeTestCase::MmWaveVehicularCodebookLifetimeTestCase ()
+  : TestCase ("The codebooks are released with the antennas")
+{
+}
+
+MmWaveVehicularCodebookLifetimeTestCase::~MmWaveVehicularCodebookLifetimeTestCase ()
+{
+}
+
+void
+MmWaveVehicularCodebookLifetimeTestCase::DoRun (void)
+{
+  uint32_t numCodebooks = MmWaveVehicularBeamCodebook::GetNumCodebooks ();
+
+  Ptr<NetDevice> first = CreateTestDevice (Vector (0, 0, 0));
+  Ptr<NetDevice> second = CreateTestDevice (Vector (20, 5, 0));
+  // a resolution not used by the other tests
+  Ptr<MmWaveVehicularAntennaArrayModel> firstAntenna = CreateTestAntenna (7.5);
+  Ptr<MmWaveVehicularAntennaArrayModel> secondAntenna = CreateTestAntenna (7.5);
+  firstAntenna->SetBeamformingVectorPanelDevices (first, second);
+  secondAntenna->SetBeamformingVectorPanelDevices (second, first);
+  NS_TEST_EXPECT_MSG_EQ (MmWaveVehicularBeamCodebook::GetNumCodebooks (), numCodebooks + 1, "The antennas must share the codebook");
+
+  DoubleValue disH;
+  DoubleValue disV;
+  firstAntenna->GetAttribute ("AntennaHorizontalSpacing", disH);
+  firstAntenna->GetAttribute ("AntennaVerticalSpacing", disV);
+  Ptr<MmWaveVehicularBeamCodebook> codebook = MmWaveVehicularBeamCodebook::Get (16, disH.Get (), disV.Get (), 2, 7.5 * M_PI / 180);
+  Ptr<MmWaveVehicularBeamCodebook> holder = codebook;
+  MmWaveVehicularBeamCodebook::Release (codebook);
+  NS_TEST_EXPECT_MSG_EQ (MmWaveVehicularBeamCodebook::GetNumCodebooks (), numCodebooks + 1, "The antennas must share the codebook");
+
+  // a third antenna leaves the shared codebook when its resolution changes
+  Ptr<MmWaveVehicularAntennaArrayModel> thirdAntenna = CreateTestAntenna (7.5);
+  thirdAntenna->SetBeamformingVectorPanelDevices (first, second);
+  thirdAntenna->SetAttribute ("BeamResolution", DoubleValue (0));
+  thirdAntenna->Dispose ();
+
+  firstAntenna->Dispose ();
+  NS_TEST_EXPECT_MSG_EQ (MmWaveVehicularBeamCodebook::GetNumCodebooks (), numCodebooks + 1, "The codebook is still used");
+  secondAntenna->Dispose ();
+  NS_TEST_EXPECT_MSG_EQ (MmWaveVehicularBeamCodebook::GetNumCodebooks (), numCodebooks, "The codebook has not been released");
+}
+
+/**
+ * In this test, an antenna with a beam update threshold and an antenna
+ * without it point towards a peer, which then moves by a small angle and by
+ * a large one. The test checks that the first antenna keeps its beam after
+ * the small movement, while the second one computes a new beam, and that the
+ * two antennas have the same beam after the large movement.
+ */
+class MmWaveVehicularBeamHysteresisTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularBeamHysteresisTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularBeamHysteresisTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularBeamHysteresisTestCase::MmWaveVehicularBeamHysteresisTestCase ()
+  : TestCase ("The beam is kept while the angular change is below the threshold")
+{
+}
+
+MmWaveVehicularBeamHysteresisTestCase::~MmWaveVehicularBeamHysteresisTestCase ()
+{
+}
+
+void
+MmWaveVehicularBeamHysteresisTestCase::DoRun (void)
+{
+  Ptr<NetDevice> thisDevice = CreateTestDevice (Vector (0, 0, 0));
+  Ptr<NetDevice> peer = CreateTestDevice (Vector (10, 0, 0));
+  Ptr<MobilityModel> peerMobility = peer->GetNode ()->GetObject<MobilityModel> ();
+
+  Ptr<MmWaveVehicularAntennaArrayModel> hysteresisAntenna = CreateTestAntenna (0);
+  hysteresisAntenna->SetAttribute ("BeamUpdateThreshold", DoubleValue (5));
+  Ptr<MmWaveVehicularAntennaArrayModel> exactAntenna = CreateTestAntenna (0);
+
+  hysteresisAntenna->SetBeamformingVectorPanelDevices (thisDevice, peer);
+  exactAntenna->SetBeamformingVectorPanelDevices (thisDevice, peer);
+  uint64_t hysteresisBeamId = hysteresisAntenna->GetBeamId ();
+  uint64_t exactBeamId = exactAntenna->GetBeamId ();
+  complexVector_t initialBeam = exactAntenna->GetBeamformingVectorPanel ();
+  NS_TEST_EXPECT_MSG_LT (GetMaxDifference (hysteresisAntenna->GetBeamformingVectorPanel (), initialBeam), 1e-9, "Different initial beams");
+
+  // about 2 degrees, below the threshold
+  peerMobility->SetPosition (Vector (10, 0.35, 0));
+  hysteresisAntenna->SetBeamformingVectorPanelDevices (thisDevice, peer);
+  exactAntenna->SetBeamformingVectorPanelDevices (thisDevice, peer);
+  NS_TEST_EXPECT_MSG_EQ (hysteresisAntenna->GetBeamId (), hysteresisBeamId, "The beam must be kept");
+  NS_TEST_EXPECT_MSG_LT (GetMaxDifference (hysteresisAntenna->GetBeamformingVectorPanel (), initialBeam), 1e-12, "The kept beam changed");
+  NS_TEST_EXPECT_MSG_NE (exactAntenna->GetBeamId (), exactBeamId, "Without the threshold, a new beam is computed");
+  NS_TEST_EXPECT_MSG_GT (GetMaxDifference (exactAntenna->GetBeamformingVectorPanel (), initialBeam), 1e-3, "The new beam must point to the new position");
+
+  // about 11 degrees, above the threshold
+  peerMobility->SetPosition (Vector (10, 2, 0));
+  hysteresisAntenna->SetBeamformingVectorPanelDevices (thisDevice, peer);
+  exactAntenna->SetBeamformingVectorPanelDevices (thisDevice, peer);
+  NS_TEST_EXPECT_MSG_NE (hysteresisAntenna->GetBeamId (), hysteresisBeamId, "The beam must be updated");
+  NS_TEST_EXPECT_MSG_LT (GetMaxDifference (hysteresisAntenna->GetBeamformingVectorPanel (), exactAntenna->GetBeamformingVectorPanel ()), 1e-9,
+                         "The updated beam must be equal to the one computed without the threshold");
+
+  hysteresisAntenna->Dispose ();
+  exactAntenna->Dispose ();
+}
+
+/**
+ * In this test, antennas with 16, 64 and 256 elements point towards a peer
+ * which is not on the grid of any codebook. The test checks that the
+ * steering vector generated in separable form, both dense and as the
+ * Kronecker product of its factors, is equal to the one computed element by
+ * element from the location of each element.
+ */
+class MmWaveVehicularSeparableSteeringTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularSeparableSteeringTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularSeparableSteeringTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularSeparableSteeringTestCase::MmWaveVehicularSeparableSteeringTestCase ()
+  : TestCase ("The separable steering vectors are equal to the ones computed element by element")
+{
+}
+
+MmWaveVehicularSeparableSteeringTestCase::~MmWaveVehicularSeparableSteeringTestCase ()
+{
+}
+
+void
+MmWaveVehicularSeparableSteeringTestCase::DoRun (void)
+{
+  Vector thisPosition (0, 0, 0);
+  Vector peerPosition (10, 3, 2);
+  Ptr<NetDevice> thisDevice = CreateTestDevice (thisPosition);
+  Ptr<NetDevice> peer = CreateTestDevice (peerPosition);
+
+  // the peer is in front of the first panel, hence the horizontal steering
+  // angle is the azimuth of the peer
+  Angles completeAngle (peerPosition, thisPosition);
+  double hAngleRadian = atan (peerPosition.y / peerPosition.x);
+  double vAngleRadian = completeAngle.theta;
+
+  std::vector<uint64_t> numElements = {16, 64, 256};
+  for (uint64_t n : numElements)
+    {
+      Ptr<MmWaveVehicularAntennaArrayModel> antenna = CreateTestAntenna (0, n);
+      antenna->SetBeamformingVectorPanelDevices (thisDevice, peer);
+      NS_TEST_EXPECT_MSG_EQ (antenna->GetPlanesId (), 0, "Wrong panel");
+
+      // the steering vector computed element by element
+      uint16_t antennaNum [2];
+      antennaNum[0] = sqrt (n);
+      antennaNum[1] = sqrt (n);
+      complexVector_t expected;
+      for (uint64_t ind = 0; ind < n; ind++)
+        {
+          Vector loc = antenna->GetAntennaLocation (ind, antennaNum);
+          double phase = -2 * M_PI * (sin (vAngleRadian) * cos (hAngleRadian) * loc.x
+                                      + sin (vAngleRadian) * sin (hAngleRadian) * loc.y
+                                      + cos (vAngleRadian) * loc.z);
+          expected.push_back (exp (std::complex<double> (0, phase)) / sqrt (n));
+        }
+
+      NS_TEST_EXPECT_MSG_LT (GetMaxDifference (antenna->GetBeamformingVectorPanel (), expected), 1e-9, "Wrong dense vector with " << n << " elements");
+      complexVector_t hWeights;
+      complexVector_t vWeights;
+      NS_TEST_ASSERT_MSG_EQ (antenna->GetBeamformingVectorFactors (hWeights, vWeights), true, "The steering vector is separable");
+      NS_TEST_EXPECT_MSG_EQ (hWeights.size (), antennaNum[0], "Wrong size of the horizontal factor");
+      NS_TEST_EXPECT_MSG_EQ (vWeights.size (), antennaNum[1], "Wrong size of the vertical factor");
+      NS_TEST_EXPECT_MSG_LT (GetMaxDifference (MmWaveVehicularAntennaArrayModel::KroneckerProduct (hWeights, vWeights), expected), 1e-9,
+                             "Wrong factors with " << n << " elements");
+      antenna->Dispose ();
+    }
+}
+
+/**
+ * In this test, the element locations and the phase terms of an antenna are
+ * computed, then the number of elements is changed and they are computed
+ * again. The test checks that the cached locations and the phase terms are
+ * equal to the ones computed element by element with GetAntennaLocation,
+ * for both configurations.
+ */
+class MmWaveVehicularElementLocationsTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularElementLocationsTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularElementLocationsTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Check the element locations and the phase terms of an antenna
+   * \param antenna the antenna
+   */
+  void CheckElements (Ptr<MmWaveVehicularAntennaArrayModel> antenna);
+};
+
+MmWaveVehicularElementLocationsTestCase::MmWaveVehicularElementLocationsTestCase ()
+  : TestCase ("The cached element locations are equal to the ones computed element by element")
+{
+}
+
+MmWaveVehicularElementLocationsTestCase::~MmWaveVehicularElementLocationsTestCase ()
+{
+}
+
+void
+MmWaveVehicularElementLocationsTestCase::CheckElements (Ptr<MmWaveVehicularAntennaArrayModel> antenna)
+{
+  uint64_t n = antenna->GetTotNoArrayElements ();
+  uint16_t antennaNum [2];
+  antennaNum[0] = sqrt (n);
+  antennaNum[1] = sqrt (n);
+
+  const std::vector<Vector> &locations = antenna->GetElementLocations ();
+  NS_TEST_ASSERT_MSG_EQ (locations.size (), n, "Wrong number of locations");
+
+  double vAngleRadian = 1.2;
+  double hAngleRadian = 0.4;
+  complexVector_t terms;
+  antenna->GetElementPhaseTerms (vAngleRadian, hAngleRadian, terms);
+  NS_TEST_ASSERT_MSG_EQ (terms.size (), n, "Wrong number of phase terms");
+
+  for (uint64_t ind = 0; ind < n; ind++)
+    {
+      Vector loc = antenna->GetAntennaLocation (ind, antennaNum);
+      NS_TEST_EXPECT_MSG_EQ (locations[ind], loc, "Wrong location of element " << ind << " with " << n << " elements");
+
+      double phase = 2 * M_PI * (sin (vAngleRadian) * cos (hAngleRadian) * loc.x
+                                 + sin (vAngleRadian) * sin (hAngleRadian) * loc.y
+                                 + cos (vAngleRadian) * loc.z);
+      NS_TEST_EXPECT_MSG_LT (std::abs (terms[ind] - exp (std::complex<double> (0, phase))), 1e-12,
+                             "Wrong phase term of element " << ind << " with " << n << " elements");
+    }
+}
+
+void
+MmWaveVehicularElementLocationsTestCase::DoRun (void)
+{
+  Ptr<MmWaveVehicularAntennaArrayModel> antenna = CreateTestAntenna (0, 16);
+  CheckElements (antenna);
+
+  // the locations are computed again for the new configuration
+  antenna->SetAttribute ("AntennaElements", UintegerValue (64));
+  CheckElements (antenna);
+
+  antenna->Dispose ();
+}
+
+/**
+ * Test suite for the MmWaveVehicularAntennaArrayModel
+ */
+class MmWaveVehicularAntennaArrayModelTestSuite : public TestSuite
+{
+public:
+  MmWaveVehicularAntennaArrayModelTestSuite ();
+};
+
+MmWaveVehicularAntennaArrayModelTestSuite::MmWaveVehicularAntennaArrayModelTestSuite ()
+  : TestSuite ("mmwave-vehicular-antenna-array-model", UNIT)
+{
+  AddTestCase (new MmWaveVehicularCodebookBeamTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularCodebookLifetimeTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularBeamHysteresisTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularSeparableSteeringTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularElementLocationsTestCase, TestCase::QUICK);
+}
+
+static MmWaveVehicularAntennaArrayModelTestSuite mmwaveVehicularAntennaArrayModelTestSuite;
@@ -0,0 +1,154 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-channel-trace.h"
+#include "ns3/test.h"
+#include <cstdio>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularChannelTraceTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * In this test, some channel realizations are written in a channel trace
+ * and read back. The test checks that the realizations are correctly
+ * restored and that the right realization is selected for each time.
+ */
+class MmWaveVehicularChannelTraceTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularChannelTraceTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularChannelTraceTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Create a dummy channel realization
+   * \param seed value used to fill the realization
+   * \return the channel realization
+   */
+  Ptr<Params3gpp> CreateParams (double seed) const;
+};
+
+MmWaveVehicularChannelTraceTestCase::MmWaveVehicularChannelTraceTestCase ()
+  : TestCase ("Write and read back a channel trace")
+{
+}
+
+MmWaveVehicularChannelTraceTestCase::~MmWaveVehicularChannelTraceTestCase ()
+{
+}
+
+Ptr<Params3gpp>
+MmWaveVehicularChannelTraceTestCase::CreateParams (double seed) const
+{
+  Ptr<Params3gpp> params = Create<Params3gpp> ();
+  params->m_condition = 'l';
+  params->m_numCluster = 3;
+  params->m_tauDelta = seed * 1e-9;
+  params->m_dis3D = seed * 10;
+  params->m_delay = {0, seed * 1e-8, seed * 2e-8, seed * 3e-8};
+  params->m_angle.resize (4, {seed, seed + 1, seed + 2});
+  params->m_channel.resize (4, complex2DVector_t (2, complexVector_t (4)));
+  for (uint8_t u = 0; u < 4; u++)
+    {
+      for (uint8_t s = 0; s < 2; s++)
+        {
+          for (uint8_t n = 0; n < 4; n++)
+            {
+              params->m_channel.at (u).at (s).at (n) = std::complex<double> (seed + u, s - n * seed);
+            }
+        }
+    }
+  return params;
+}
+
+void
+MmWaveVehicularChannelTraceTestCase::DoRun (void)
+{
+  std::string fileName = CreateTempDirFilename ("channel-trace-test.bin");
+
+  {
+    Ptr<MmWaveVehicularChannelTraceWriter> writer = Create<MmWaveVehicularChannelTraceWriter> (fileName);
+    writer->Write (0, 1, MilliSeconds (0), *CreateParams (1));
+    writer->Write (2, 0, MilliSeconds (0), *CreateParams (2));
+    writer->Write (0, 1, MilliSeconds (10), *CreateParams (3));
+  } // the index is written here
+
+  Ptr<MmWaveVehicularChannelTraceReader> reader = Create<MmWaveVehicularChannelTraceReader> (fileName);
+
+  // the realization generated at 0 ms is used until 10 ms
+  Ptr<Params3gpp> expected = CreateParams (1);
+  bool reverse = true;
+  Ptr<Params3gpp> actual = reader->Read (0, 1, MilliSeconds (5), reverse);
+  NS_TEST_ASSERT_MSG_EQ ((actual != 0), true, "Link not found");
+  NS_TEST_EXPECT_MSG_EQ (reverse, false, "The link is in the trace");
+  NS_TEST_EXPECT_MSG_EQ (actual->m_condition, expected->m_condition, "Wrong condition");
+  NS_TEST_EXPECT_MSG_EQ (uint16_t (actual->m_numCluster), uint16_t (expected->m_numCluster), "Wrong number of clusters");
+  NS_TEST_EXPECT_MSG_EQ (actual->m_tauDelta, expected->m_tauDelta, "Wrong tau delta");
+  NS_TEST_EXPECT_MSG_EQ (actual->m_dis3D, expected->m_dis3D, "Wrong distance");
+  NS_TEST_EXPECT_MSG_EQ ((actual->m_delay == expected->m_delay), true, "Wrong delays");
+  NS_TEST_EXPECT_MSG_EQ ((actual->m_angle == expected->m_angle), true, "Wrong angles");
+  NS_TEST_EXPECT_MSG_EQ ((actual->m_channel == expected->m_channel), true, "Wrong channel matrix");
+
+  // the most recent realization is selected
+  actual = reader->Read (0, 1, MilliSeconds (15), reverse);
+  NS_TEST_EXPECT_MSG_EQ (actual->m_dis3D, CreateParams (3)->m_dis3D, "Wrong realization selected");
+
+  // the reverse link is used if the link is not in the trace
+  actual = reader->Read (0, 2, MilliSeconds (1), reverse);
+  NS_TEST_ASSERT_MSG_EQ ((actual != 0), true, "Reverse link not found");
+  NS_TEST_EXPECT_MSG_EQ (reverse, true, "The reverse link is not signaled");
+  NS_TEST_EXPECT_MSG_EQ (actual->m_dis3D, CreateParams (2)->m_dis3D, "Wrong reverse realization");
+
+  // unknown link
+  actual = reader->Read (1, 2, MilliSeconds (1), reverse);
+  NS_TEST_EXPECT_MSG_EQ ((actual == 0), true, "Unexpected realization");
+
+  std::remove (fileName.c_str ());
+}
+
+/**
+ * Test suite for the channel trace
+ */
+class MmWaveVehicularChannelTraceTestSuite : public TestSuite
+{
+public:
+  MmWaveVehicularChannelTraceTestSuite ();
+};
+
+MmWaveVehicularChannelTraceTestSuite::MmWaveVehicularChannelTraceTestSuite ()
+  : TestSuite ("mmwave-vehicular-channel-trace", UNIT)
+{
+  AddTestCase (new MmWaveVehicularChannelTraceTestCase, TestCase::QUICK);
+}
+
+static MmWaveVehicularChannelTraceTestSuite mmwaveVehicularChannelTraceTestSuite;
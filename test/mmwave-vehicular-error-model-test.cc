@@ -0,0 +1,210 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-error-model.h"
+#include "ns3/spectrum-value.h"
+#include "ns3/double.h"
+#include "ns3/test.h"
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularErrorModelTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * In this test, transport blocks are decoded with the error model based on
+ * the lookup tables and with the MIESM error model. With a flat SINR on the
+ * points of the grid and the size which represents a size class, the error
+ * rates must be the same, since the tables are filled with these values.
+ * Between the points of the grid and with a frequency selective SINR, the
+ * difference must be small.
+ */
+class MmWaveVehicularLutErrorModelTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularLutErrorModelTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularLutErrorModelTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularLutErrorModelTestCase::MmWaveVehicularLutErrorModelTestCase ()
+  : TestCase ("The error model based on the lookup tables approximates the MIESM error model")
+{
+}
+
+MmWaveVehicularLutErrorModelTestCase::~MmWaveVehicularLutErrorModelTestCase ()
+{
+}
+
+void
+MmWaveVehicularLutErrorModelTestCase::DoRun (void)
+{
+  uint32_t numRb = 32;
+  std::vector<double> frequencies;
+  std::vector<int> rbBitmap;
+  for (uint32_t rb = 0; rb < numRb; ++rb)
+    {
+      frequencies.push_back (28e9 + rb * 1.44e6);
+      rbBitmap.push_back (rb);
+    }
+  Ptr<SpectrumModel> sm = Create<SpectrumModel> (frequencies);
+
+  Ptr<MmWaveVehicularErrorModel> exact = CreateObject<MmWaveVehicularMiErrorModel> ();
+  Ptr<MmWaveVehicularLutErrorModel> lut = CreateObject<MmWaveVehicularLutErrorModel> ();
+  lut->SetAttribute ("MinSinr", DoubleValue (-10));
+  lut->SetAttribute ("MaxSinr", DoubleValue (30));
+  lut->SetAttribute ("SinrStep", DoubleValue (0.25));
+
+  // the size halfway between 2^10 and 2^11 represents its class
+  uint32_t size = 1536;
+  for (uint8_t mcs = 0; mcs <= 28; mcs += 7)
+    {
+      // flat SINR on the points of the grid
+      for (double sinrDb = -5; sinrDb <= 25; sinrDb += 2.5)
+        {
+          SpectrumValue sinr (sm);
+          sinr = std::pow (10.0, sinrDb / 10);
+          NS_TEST_EXPECT_MSG_EQ_TOL (lut->GetTbler (sinr, rbBitmap, size, mcs), exact->GetTbler (sinr, rbBitmap, size, mcs), 1e-9,
+                                     "Different TBLER for MCS " << (uint16_t) mcs << " and flat SINR " << sinrDb << " dB");
+        }
+
+      // flat SINR between the points of the grid
+      for (double sinrDb = -4.9; sinrDb <= 25; sinrDb += 2.5)
+        {
+          SpectrumValue sinr (sm);
+          sinr = std::pow (10.0, sinrDb / 10);
+          NS_TEST_EXPECT_MSG_EQ_TOL (lut->GetTbler (sinr, rbBitmap, size, mcs), exact->GetTbler (sinr, rbBitmap, size, mcs), 0.1,
+                                     "TBLER too different for MCS " << (uint16_t) mcs << " and flat SINR " << sinrDb << " dB");
+        }
+
+      // frequency selective SINR, with the same average in linear scale
+      for (double sinrDb = -5; sinrDb <= 25; sinrDb += 1)
+        {
+          SpectrumValue sinr (sm);
+          for (uint32_t rb = 0; rb < numRb; ++rb)
+            {
+              sinr[rb] = std::pow (10.0, sinrDb / 10) * (0.2 + 1.6 * (rb % 4) / 3.0);
+            }
+          NS_TEST_EXPECT_MSG_EQ_TOL (lut->GetTbler (sinr, rbBitmap, size, mcs), exact->GetTbler (sinr, rbBitmap, size, mcs), 0.1,
+                                     "TBLER too different for MCS " << (uint16_t) mcs << " and average SINR " << sinrDb << " dB");
+        }
+    }
+}
+
+/**
+ * In this test, the error rates of the AWGN overload of GetTbler, used by the
+ * scalar abstraction, are compared with the ones of transport blocks
+ * received with the same flat SINR in all the resource blocks. With the
+ * MIESM error model the error rates must be the same. With the error model
+ * based on the lookup tables they must be the same on the points of the grid.
+ */
+class MmWaveVehicularAwgnErrorModelTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularAwgnErrorModelTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularAwgnErrorModelTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularAwgnErrorModelTestCase::MmWaveVehicularAwgnErrorModelTestCase ()
+  : TestCase ("The AWGN error rate is the error rate of a flat SINR")
+{
+}
+
+MmWaveVehicularAwgnErrorModelTestCase::~MmWaveVehicularAwgnErrorModelTestCase ()
+{
+}
+
+void
+MmWaveVehicularAwgnErrorModelTestCase::DoRun (void)
+{
+  uint32_t numRb = 32;
+  std::vector<double> frequencies;
+  std::vector<int> rbBitmap;
+  for (uint32_t rb = 0; rb < numRb; ++rb)
+    {
+      frequencies.push_back (28e9 + rb * 1.44e6);
+      rbBitmap.push_back (rb);
+    }
+  Ptr<SpectrumModel> sm = Create<SpectrumModel> (frequencies);
+
+  Ptr<MmWaveVehicularErrorModel> exact = CreateObject<MmWaveVehicularMiErrorModel> ();
+  Ptr<MmWaveVehicularLutErrorModel> lut = CreateObject<MmWaveVehicularLutErrorModel> ();
+  lut->SetAttribute ("MinSinr", DoubleValue (-10));
+  lut->SetAttribute ("MaxSinr", DoubleValue (30));
+  lut->SetAttribute ("SinrStep", DoubleValue (0.25));
+
+  uint32_t size = 1536;
+  for (uint8_t mcs = 0; mcs <= 28; mcs += 7)
+    {
+      for (double sinrDb = -5; sinrDb <= 25; sinrDb += 2.5)
+        {
+          SpectrumValue sinr (sm);
+          sinr = std::pow (10.0, sinrDb / 10);
+          double expected = exact->GetTbler (sinr, rbBitmap, size, mcs);
+          NS_TEST_EXPECT_MSG_EQ_TOL (exact->GetTbler (std::pow (10.0, sinrDb / 10), size, mcs), expected, 1e-9,
+                                     "Different MIESM TBLER for MCS " << (uint16_t) mcs << " and SINR " << sinrDb << " dB");
+          NS_TEST_EXPECT_MSG_EQ_TOL (lut->GetTbler (std::pow (10.0, sinrDb / 10), size, mcs), expected, 1e-9,
+                                     "Different LUT TBLER for MCS " << (uint16_t) mcs << " and SINR " << sinrDb << " dB");
+        }
+    }
+}
+
+/**
+ * Test suite for the error models of the sidelink transport blocks
+ */
+class MmWaveVehicularErrorModelTestSuite : public TestSuite
+{
+public:
+  MmWaveVehicularErrorModelTestSuite ();
+};
+
+MmWaveVehicularErrorModelTestSuite::MmWaveVehicularErrorModelTestSuite ()
+  : TestSuite ("mmwave-vehicular-error-model", UNIT)
+{
+  AddTestCase (new MmWaveVehicularLutErrorModelTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularAwgnErrorModelTestCase, TestCase::QUICK);
+}
+
+static MmWaveVehicularErrorModelTestSuite mmwaveVehicularErrorModelTestSuite;
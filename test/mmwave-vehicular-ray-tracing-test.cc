@@ -0,0 +1,187 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-ray-tracing-spectrum-propagation-loss-model.h"
+#include "ns3/test.h"
+#include <cstdio>
+#include <fstream>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularRayTracingTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * In this test, a ray tracing file with a single link and two time steps is
+ * created. The test checks that the paths are correctly interpolated between
+ * the two steps, and that the reverse link is obtained by swapping the
+ * angles of arrival and departure.
+ */
+class MmWaveVehicularRayTracingTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularRayTracingTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularRayTracingTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Write a value in binary form
+   * \param file the output stream
+   * \param value the value
+   */
+  template <class T>
+  void WriteValue (std::ofstream &file, T value) const
+  {
+    file.write (reinterpret_cast<const char *> (&value), sizeof (T));
+  }
+
+  /**
+   * Write a path in binary form
+   * \param file the output stream
+   * \param path the path
+   */
+  void WritePath (std::ofstream &file, const MmWaveVehicularRayPath &path) const;
+};
+
+MmWaveVehicularRayTracingTestCase::MmWaveVehicularRayTracingTestCase ()
+  : TestCase ("Read and interpolate the paths of a ray tracing file")
+{
+}
+
+MmWaveVehicularRayTracingTestCase::~MmWaveVehicularRayTracingTestCase ()
+{
+}
+
+void
+MmWaveVehicularRayTracingTestCase::WritePath (std::ofstream &file, const MmWaveVehicularRayPath &path) const
+{
+  WriteValue<double> (file, path.m_delay);
+  WriteValue<double> (file, path.m_power);
+  WriteValue<double> (file, path.m_phase);
+  WriteValue<double> (file, path.m_aoa);
+  WriteValue<double> (file, path.m_zoa);
+  WriteValue<double> (file, path.m_aod);
+  WriteValue<double> (file, path.m_zod);
+}
+
+void
+MmWaveVehicularRayTracingTestCase::DoRun (void)
+{
+  std::string fileName = CreateTempDirFilename ("ray-tracing-test.bin");
+
+  // a link between node 0 and node 1 with a single path, at 0 and 10 ms
+  MmWaveVehicularRayPath first = {100e-9, -80, 1, 350, 90, 170, 90};
+  MmWaveVehicularRayPath second = {200e-9, -90, 2, 10, 80, 190, 100};
+
+  {
+    std::ofstream file (fileName.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+    uint64_t stepTableOffset = 16 + 24;
+    uint64_t pathOffset = stepTableOffset + 2 * 24;
+
+    // header
+    file.write ("MRTX", 4);
+    WriteValue<uint32_t> (file, 1);
+    WriteValue<uint32_t> (file, 1);
+    WriteValue<uint32_t> (file, 0);
+
+    // link table
+    WriteValue<uint32_t> (file, 0);
+    WriteValue<uint32_t> (file, 1);
+    WriteValue<uint32_t> (file, 2);
+    WriteValue<uint32_t> (file, 0);
+    WriteValue<uint64_t> (file, stepTableOffset);
+
+    // step table
+    WriteValue<int64_t> (file, 0);
+    WriteValue<uint32_t> (file, 1);
+    WriteValue<uint32_t> (file, 0);
+    WriteValue<uint64_t> (file, pathOffset);
+    WriteValue<int64_t> (file, MilliSeconds (10).GetNanoSeconds ());
+    WriteValue<uint32_t> (file, 1);
+    WriteValue<uint32_t> (file, 0);
+    WriteValue<uint64_t> (file, pathOffset + 7 * sizeof (double));
+
+    // paths
+    WritePath (file, first);
+    WritePath (file, second);
+  }
+
+  Ptr<MmWaveVehicularRayTracingData> data = Create<MmWaveVehicularRayTracingData> (fileName);
+  std::vector<MmWaveVehicularRayPath> paths;
+  Time stepTime;
+
+  // halfway between the two steps
+  bool found = data->GetPaths (0, 1, MilliSeconds (5), paths, stepTime);
+  NS_TEST_ASSERT_MSG_EQ (found, true, "Link not found");
+  NS_TEST_ASSERT_MSG_EQ (paths.size (), 1u, "Wrong number of paths");
+  NS_TEST_EXPECT_MSG_EQ (stepTime, MilliSeconds (0), "Wrong step time");
+  NS_TEST_EXPECT_MSG_EQ_TOL (paths.at (0).m_delay, 150e-9, 1e-15, "Wrong delay");
+  NS_TEST_EXPECT_MSG_EQ_TOL (paths.at (0).m_power, -85, 1e-9, "Wrong power");
+  NS_TEST_EXPECT_MSG_EQ_TOL (paths.at (0).m_phase, 1, 1e-9, "The phase should not be interpolated");
+  NS_TEST_EXPECT_MSG_EQ_TOL (paths.at (0).m_aoa, 360, 1e-9, "The azimuth should be interpolated along the shortest arc");
+  NS_TEST_EXPECT_MSG_EQ_TOL (paths.at (0).m_zoa, 85, 1e-9, "Wrong ZOA");
+  NS_TEST_EXPECT_MSG_EQ_TOL (paths.at (0).m_aod, 180, 1e-9, "Wrong AOD");
+  NS_TEST_EXPECT_MSG_EQ_TOL (paths.at (0).m_zod, 95, 1e-9, "Wrong ZOD");
+
+  // after the last step
+  data->GetPaths (0, 1, MilliSeconds (20), paths, stepTime);
+  NS_TEST_EXPECT_MSG_EQ (stepTime, MilliSeconds (10), "Wrong step time");
+  NS_TEST_EXPECT_MSG_EQ_TOL (paths.at (0).m_delay, second.m_delay, 1e-15, "Wrong delay");
+
+  // reverse link
+  found = data->GetPaths (1, 0, MilliSeconds (0), paths, stepTime);
+  NS_TEST_ASSERT_MSG_EQ (found, true, "Reverse link not found");
+  NS_TEST_EXPECT_MSG_EQ_TOL (paths.at (0).m_aoa, first.m_aod, 1e-9, "AOA and AOD should be swapped");
+  NS_TEST_EXPECT_MSG_EQ_TOL (paths.at (0).m_zod, first.m_zoa, 1e-9, "ZOA and ZOD should be swapped");
+
+  // unknown link
+  found = data->GetPaths (0, 2, MilliSeconds (0), paths, stepTime);
+  NS_TEST_EXPECT_MSG_EQ (found, false, "Unexpected link");
+
+  std::remove (fileName.c_str ());
+}
+
+/**
+ * Test suite for the ray tracing data
+ */
+class MmWaveVehicularRayTracingTestSuite : public TestSuite
+{
+public:
+  MmWaveVehicularRayTracingTestSuite ();
+};
+
+MmWaveVehicularRayTracingTestSuite::MmWaveVehicularRayTracingTestSuite ()
+  : TestSuite ("mmwave-vehicular-ray-tracing", UNIT)
+{
+  AddTestCase (new MmWaveVehicularRayTracingTestCase, TestCase::QUICK);
+}
+
+static MmWaveVehicularRayTracingTestSuite mmwaveVehicularRayTracingTestSuite;
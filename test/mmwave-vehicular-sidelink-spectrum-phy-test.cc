@@ -18,11 +18,14 @@
 */
 
 #include "ns3/mmwave-sidelink-spectrum-phy.h"
+#include "ns3/mmwave-sidelink-spectrum-signal-parameters.h"
 #include "ns3/mmwave-vehicular-net-device.h"
 #include "ns3/constant-position-mobility-model.h"
 #include "ns3/isotropic-antenna-model.h"
 #include "ns3/spectrum-helper.h"
 #include "ns3/mmwave-spectrum-value-helper.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
 #include "ns3/test.h"
 
 NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularSidelinkSpectrumPhyTestSuite");
@@ -198,6 +201,675 @@ MmWaveVehicularSidelinkSpectrumPhyTestCase1::DoRun (void)
 
 }
 
+/**
+ * In this test, a useful signal is received together with a strong
+ * interferer and three weak interferers, which are far from the receiver
+ * and start at the same time. The test checks that the SINR obtained when
+ * the weak interferers are aggregated is the same as the one obtained
+ * without pruning, that ignoring them changes the SINR by a negligible
+ * amount, and that only the weak interferers are pruned.
+ */
+class MmWaveVehicularInterferencePruningTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularInterferencePruningTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularInterferencePruningTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Run the simulation and store the average SINR of the reception in
+   * m_sinr and the counters of the receiver in m_numInterferenceSignals and
+   * m_numPrunedSignals
+   * \param pruning the value of the attribute InterferencePruning of the receiver
+   */
+  void RunSimulation (MmWaveSidelinkSpectrumPhy::InterferencePruning pruning);
+
+  /**
+   * Transmit an empty packet burst on all the subchannels
+   * \param ssp the tx SpectrumPhy instance
+   * \param duration the duration of the transmission
+   * \param destinationRnti the RNTI of the destination
+   */
+  void Transmit (Ptr<MmWaveSidelinkSpectrumPhy> ssp, Time duration, uint16_t destinationRnti);
+
+  /**
+   * This method is a callback sink which is fired when the rx updates the SINR
+   * estimate
+   * \param sinr the sinr value
+   */
+  void UpdateSinrPerceived (const SpectrumValue& sinr);
+
+  std::vector<int> m_subChannels; //!< all the subchannels, used by the transmissions
+  std::vector<double> m_sinr; //!< the average SINR of each run, in dB
+  std::vector<uint64_t> m_numInterferenceSignals; //!< the number of interfering signals in each run
+  std::vector<uint64_t> m_numPrunedSignals; //!< the number of pruned signals in each run
+};
+
+MmWaveVehicularInterferencePruningTestCase::MmWaveVehicularInterferencePruningTestCase ()
+  : TestCase ("The interferers below the interference floor are pruned without changing the SINR")
+{
+}
+
+MmWaveVehicularInterferencePruningTestCase::~MmWaveVehicularInterferencePruningTestCase ()
+{
+}
+
+void
+MmWaveVehicularInterferencePruningTestCase::UpdateSinrPerceived (const SpectrumValue& sinr)
+{
+  m_sinr.push_back (10 * log10 (Sum (sinr) / sinr.GetSpectrumModel ()->GetNumBands ()));
+}
+
+void
+MmWaveVehicularInterferencePruningTestCase::Transmit (Ptr<MmWaveSidelinkSpectrumPhy> ssp, Time duration, uint16_t destinationRnti)
+{
+  // the burst is empty, only the SINR is evaluated
+  Ptr<PacketBurst> pb = CreateObject<PacketBurst> ();
+  ssp->StartTxDataFrames (pb, duration, 0, 0, 0, 14, 0, destinationRnti, m_subChannels);
+}
+
+void
+MmWaveVehicularInterferencePruningTestCase::RunSimulation (MmWaveSidelinkSpectrumPhy::InterferencePruning pruning)
+{
+  SpectrumChannelHelper sh = SpectrumChannelHelper::Default ();
+  Ptr<SpectrumChannel> sc = sh.Create ();
+
+  Ptr<mmwave::MmWavePhyMacCommon> pmc = CreateObject<mmwave::MmWavePhyMacCommon> ();
+  m_subChannels.resize (pmc->GetTotalNumChunk ());
+  for (uint32_t i = 0; i < m_subChannels.size (); i++)
+  {
+    m_subChannels [i] = i;
+  }
+  Ptr<SpectrumValue> txPsd = mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (pmc, 30.0, m_subChannels);
+
+  // the receiver, the useful transmitter, the strong interferer and the weak
+  // interferers, which are at the same distance from the receiver
+  std::vector<Vector> positions = {Vector (0.0, 0.0, 0.0), Vector (10.0, 0.0, 0.0), Vector (-15.0, 0.0, 0.0),
+                                   Vector (-20000.0, 0.0, 0.0), Vector (0.0, 20000.0, 0.0), Vector (0.0, -20000.0, 0.0)};
+  std::vector<Ptr<MmWaveSidelinkSpectrumPhy> > ssps;
+  for (const Vector &position : positions)
+  {
+    Ptr<MobilityModel> mm = CreateObject<ConstantPositionMobilityModel> ();
+    mm->SetPosition (position);
+    Ptr<MmWaveSidelinkSpectrumPhy> ssp = CreateObject<MmWaveSidelinkSpectrumPhy> ();
+    ssp->SetMobility (mm);
+    ssp->SetAntenna (CreateObject<IsotropicAntennaModel> ());
+    ssp->SetChannel (sc);
+    ssp->SetTxPowerSpectralDensity (txPsd);
+    ssps.push_back (ssp);
+  }
+  Ptr<MmWaveSidelinkSpectrumPhy> rx = ssps.at (0);
+  sc->AddRx (rx);
+
+  uint16_t rxRnti = 1;
+  Ptr<MmWaveVehicularDeviceContext> context = Create<MmWaveVehicularDeviceContext> ();
+  context->m_rnti = rxRnti;
+  context->m_mobility = rx->GetMobility ();
+  rx->SetDeviceContext (context);
+  rx->SetNoisePowerSpectralDensity (mmwave::MmWaveSpectrumValueHelper::CreateNoisePowerSpectralDensity (pmc, 5.0));
+  rx->SetAttribute ("InterferencePruning", EnumValue (pruning));
+
+  Ptr<mmwave::mmWaveChunkProcessor> pData = Create<mmwave::mmWaveChunkProcessor> ();
+  pData->AddCallback (MakeCallback (&MmWaveVehicularInterferencePruningTestCase::UpdateSinrPerceived, this));
+  rx->AddDataSinrChunkProcessor (pData);
+
+  // the interferers cover the whole reception, considering the propagation
+  // delay of the weak ones
+  uint16_t otherRnti = 5;
+  for (uint32_t i = 2; i < ssps.size (); i++)
+  {
+    Simulator::Schedule (MicroSeconds (20), &MmWaveVehicularInterferencePruningTestCase::Transmit, this,
+                         ssps.at (i), MicroSeconds (300), otherRnti);
+  }
+  Simulator::Schedule (MicroSeconds (100), &MmWaveVehicularInterferencePruningTestCase::Transmit, this,
+                       ssps.at (1), MicroSeconds (100), rxRnti);
+
+  Simulator::Stop (MilliSeconds (1));
+  Simulator::Run ();
+  m_numInterferenceSignals.push_back (rx->GetNumInterferenceSignals ());
+  m_numPrunedSignals.push_back (rx->GetNumPrunedSignals ());
+  Simulator::Destroy ();
+}
+
+void
+MmWaveVehicularInterferencePruningTestCase::DoRun (void)
+{
+  RunSimulation (MmWaveSidelinkSpectrumPhy::PRUNING_DISABLED);
+  RunSimulation (MmWaveSidelinkSpectrumPhy::PRUNING_AGGREGATE);
+  RunSimulation (MmWaveSidelinkSpectrumPhy::PRUNING_IGNORE);
+
+  NS_TEST_ASSERT_MSG_EQ (m_sinr.size (), 3u, "The useful signal has not been received");
+  NS_TEST_EXPECT_MSG_LT (m_sinr.at (0), 10.0, "The strong interferer must be accounted in the SINR");
+  NS_TEST_EXPECT_MSG_EQ_TOL (m_sinr.at (1), m_sinr.at (0), 1e-6, "The aggregation must not change the SINR");
+  NS_TEST_EXPECT_MSG_EQ_TOL (m_sinr.at (2), m_sinr.at (0), 0.01, "The weak interferers must be negligible");
+  for (uint32_t i = 0; i < m_numInterferenceSignals.size (); i++)
+  {
+    NS_TEST_EXPECT_MSG_EQ (m_numInterferenceSignals.at (i), 4u, "All the interferers must be counted");
+  }
+  NS_TEST_EXPECT_MSG_EQ (m_numPrunedSignals.at (0), 0u, "No signal is pruned if the pruning is disabled");
+  NS_TEST_EXPECT_MSG_EQ (m_numPrunedSignals.at (1), 3u, "Only the weak interferers must be aggregated");
+  NS_TEST_EXPECT_MSG_EQ (m_numPrunedSignals.at (2), 3u, "Only the weak interferers must be ignored");
+}
+
+/**
+ * In this test, a transport block is received with an interferer which
+ * covers the whole reception, with and without the scalar abstraction.
+ * Both the signals follow the Friis model, therefore the SINR is almost the
+ * same in all the resource blocks. The test checks that the wideband SINR
+ * of the scalar abstraction is the same as the average of the per-RB SINR,
+ * and that the transport block is decoded in both the cases.
+ */
+class MmWaveVehicularScalarAbstractionTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularScalarAbstractionTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularScalarAbstractionTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Run the simulation and store the average SINR reported for the
+   * transport block in m_sinr and the number of received packets in
+   * m_numRxPackets
+   * \param scalar the value of the attribute ScalarAbstraction of the receiver
+   */
+  void RunSimulation (bool scalar);
+
+  /**
+   * Transmit a packet burst with a single packet on all the subchannels
+   * \param ssp the tx SpectrumPhy instance
+   * \param duration the duration of the transmission
+   * \param destinationRnti the RNTI of the destination
+   */
+  void Transmit (Ptr<MmWaveSidelinkSpectrumPhy> ssp, Time duration, uint16_t destinationRnti);
+
+  /**
+   * This method is a callback sink which is fired when the rx receives a packet
+   * \param p received packet
+   */
+  void Rx (Ptr<Packet> p);
+
+  /**
+   * This method is a callback sink which is fired when the rx reports the
+   * SINR of a transport block
+   * \param sinr the sinr value
+   * \param rnti the RNTI of the transmitter
+   * \param numSym the number of symbols of the transport block
+   * \param size the size of the transport block
+   * \param mcs the MCS of the transport block
+   */
+  void ReportSinr (const SpectrumValue& sinr, uint16_t rnti, uint8_t numSym, uint32_t size, uint8_t mcs);
+
+  std::vector<int> m_subChannels; //!< all the subchannels, used by the transmissions
+  std::vector<double> m_sinr; //!< the average SINR reported in each run, in dB
+  uint32_t m_rxPackets; //!< the number of packets received in the current run
+  std::vector<uint32_t> m_numRxPackets; //!< the number of packets received in each run
+};
+
+MmWaveVehicularScalarAbstractionTestCase::MmWaveVehicularScalarAbstractionTestCase ()
+  : TestCase ("The scalar abstraction computes the average SINR of a flat channel"),
+    m_rxPackets (0)
+{
+}
+
+MmWaveVehicularScalarAbstractionTestCase::~MmWaveVehicularScalarAbstractionTestCase ()
+{
+}
+
+void
+MmWaveVehicularScalarAbstractionTestCase::Rx (Ptr<Packet> p)
+{
+  m_rxPackets++;
+}
+
+void
+MmWaveVehicularScalarAbstractionTestCase::ReportSinr (const SpectrumValue& sinr, uint16_t rnti, uint8_t numSym, uint32_t size, uint8_t mcs)
+{
+  m_sinr.push_back (10 * log10 (Sum (sinr) / sinr.GetSpectrumModel ()->GetNumBands ()));
+}
+
+void
+MmWaveVehicularScalarAbstractionTestCase::Transmit (Ptr<MmWaveSidelinkSpectrumPhy> ssp, Time duration, uint16_t destinationRnti)
+{
+  Ptr<PacketBurst> pb = CreateObject<PacketBurst> ();
+  pb->AddPacket (Create<Packet> (20));
+  ssp->StartTxDataFrames (pb, duration, 0, 0, 20, 14, 0, destinationRnti, m_subChannels);
+}
+
+void
+MmWaveVehicularScalarAbstractionTestCase::RunSimulation (bool scalar)
+{
+  SpectrumChannelHelper sh = SpectrumChannelHelper::Default ();
+  Ptr<SpectrumChannel> sc = sh.Create ();
+
+  Ptr<mmwave::MmWavePhyMacCommon> pmc = CreateObject<mmwave::MmWavePhyMacCommon> ();
+  m_subChannels.resize (pmc->GetTotalNumChunk ());
+  for (uint32_t i = 0; i < m_subChannels.size (); i++)
+  {
+    m_subChannels [i] = i;
+  }
+  Ptr<SpectrumValue> txPsd = mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (pmc, 30.0, m_subChannels);
+
+  // the receiver, the useful transmitter and the interferer
+  std::vector<Ptr<MmWaveSidelinkSpectrumPhy> > ssps;
+  std::vector<double> positions = {0.0, 10.0, -15.0};
+  for (double x : positions)
+  {
+    Ptr<MobilityModel> mm = CreateObject<ConstantPositionMobilityModel> ();
+    mm->SetPosition (Vector (x, 0.0, 0.0));
+    Ptr<MmWaveSidelinkSpectrumPhy> ssp = CreateObject<MmWaveSidelinkSpectrumPhy> ();
+    ssp->SetMobility (mm);
+    ssp->SetAntenna (CreateObject<IsotropicAntennaModel> ());
+    ssp->SetChannel (sc);
+    ssp->SetTxPowerSpectralDensity (txPsd);
+    ssps.push_back (ssp);
+  }
+  Ptr<MmWaveSidelinkSpectrumPhy> rx = ssps.at (0);
+  sc->AddRx (rx);
+
+  uint16_t rxRnti = 1;
+  Ptr<MmWaveVehicularDeviceContext> context = Create<MmWaveVehicularDeviceContext> ();
+  context->m_rnti = rxRnti;
+  context->m_mobility = rx->GetMobility ();
+  rx->SetDeviceContext (context);
+  rx->SetNoisePowerSpectralDensity (mmwave::MmWaveSpectrumValueHelper::CreateNoisePowerSpectralDensity (pmc, 5.0));
+  rx->SetAttribute ("ScalarAbstraction", BooleanValue (scalar));
+  rx->SetPhyRxDataEndOkCallback (MakeCallback (&MmWaveVehicularScalarAbstractionTestCase::Rx, this));
+  rx->SetSidelinkSinrReportCallback (MakeCallback (&MmWaveVehicularScalarAbstractionTestCase::ReportSinr, this));
+
+  // the chunk processor is not used by the scalar abstraction
+  Ptr<mmwave::mmWaveChunkProcessor> pData = Create<mmwave::mmWaveChunkProcessor> ();
+  pData->AddCallback (MakeCallback (&MmWaveSidelinkSpectrumPhy::UpdateSinrPerceived, rx));
+  rx->AddDataSinrChunkProcessor (pData);
+
+  uint16_t otherRnti = 5;
+  Simulator::Schedule (MicroSeconds (20), &MmWaveVehicularScalarAbstractionTestCase::Transmit, this,
+                       ssps.at (2), MicroSeconds (300), otherRnti);
+  Simulator::Schedule (MicroSeconds (100), &MmWaveVehicularScalarAbstractionTestCase::Transmit, this,
+                       ssps.at (1), MicroSeconds (100), rxRnti);
+
+  m_rxPackets = 0;
+  Simulator::Stop (MilliSeconds (1));
+  Simulator::Run ();
+  m_numRxPackets.push_back (m_rxPackets);
+  Simulator::Destroy ();
+}
+
+void
+MmWaveVehicularScalarAbstractionTestCase::DoRun (void)
+{
+  RunSimulation (false);
+  RunSimulation (true);
+
+  NS_TEST_ASSERT_MSG_EQ (m_sinr.size (), 2u, "The SINR of the transport block has not been reported");
+  NS_TEST_EXPECT_MSG_LT (m_sinr.at (0), 10.0, "The interferer must be accounted in the SINR");
+  NS_TEST_EXPECT_MSG_EQ_TOL (m_sinr.at (1), m_sinr.at (0), 0.01, "The wideband SINR must be the average SINR of a flat channel");
+  NS_TEST_EXPECT_MSG_EQ (m_numRxPackets.at (0), 1u, "The transport block must be decoded without the scalar abstraction");
+  NS_TEST_EXPECT_MSG_EQ (m_numRxPackets.at (1), 1u, "The transport block must be decoded with the scalar abstraction");
+}
+
+/**
+ * In this test, a packet burst is sent three times to two receivers with
+ * the same RNTI. The first transmission creates its resource block bitmap
+ * from a vector, while the others share the same bitmap. The receivers
+ * modify the packets they receive. The test checks that the copies of the
+ * signal share the bitmap and the burst, that the receptions with the shared
+ * bitmap have the same SINR as the first one, and that each reception gets
+ * its own copy of the packets.
+ */
+class MmWaveVehicularSharedSignalTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularSharedSignalTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularSharedSignalTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Transmit the burst with a bitmap created from m_subChannels
+   * \param ssp the tx SpectrumPhy instance
+   * \param destinationRnti the RNTI of the destination
+   */
+  void TransmitVector (Ptr<MmWaveSidelinkSpectrumPhy> ssp, uint16_t destinationRnti);
+
+  /**
+   * Transmit the burst with the shared bitmap m_rbBitmap
+   * \param ssp the tx SpectrumPhy instance
+   * \param destinationRnti the RNTI of the destination
+   */
+  void TransmitShared (Ptr<MmWaveSidelinkSpectrumPhy> ssp, uint16_t destinationRnti);
+
+  /**
+   * This method is a callback sink which is fired when a rx receives a
+   * packet, which is then modified
+   * \param p received packet
+   */
+  void Rx (Ptr<Packet> p);
+
+  /**
+   * This method is a callback sink which is fired when a rx updates the SINR
+   * estimate
+   * \param sinr the sinr value
+   */
+  void UpdateSinrPerceived (const SpectrumValue& sinr);
+
+  std::vector<int> m_subChannels; //!< all the subchannels, used by the transmissions
+  Ptr<const MmWaveSidelinkRbBitmap> m_rbBitmap; //!< the bitmap shared by the transmissions
+  Ptr<PacketBurst> m_burst; //!< the burst sent in all the transmissions
+  std::vector<double> m_sinr; //!< the average SINR of each reception, in dB
+  std::vector<uint32_t> m_rxSizes; //!< the size of each received packet, before it is modified
+  std::vector<uint64_t> m_rxUids; //!< the UID of each received packet
+};
+
+MmWaveVehicularSharedSignalTestCase::MmWaveVehicularSharedSignalTestCase ()
+  : TestCase ("The copies of the signal share the bitmap and the burst, and each reception gets its own packets")
+{
+}
+
+MmWaveVehicularSharedSignalTestCase::~MmWaveVehicularSharedSignalTestCase ()
+{
+}
+
+void
+MmWaveVehicularSharedSignalTestCase::Rx (Ptr<Packet> p)
+{
+  m_rxSizes.push_back (p->GetSize ());
+  m_rxUids.push_back (p->GetUid ());
+  p->RemoveAtStart (5);
+}
+
+void
+MmWaveVehicularSharedSignalTestCase::UpdateSinrPerceived (const SpectrumValue& sinr)
+{
+  m_sinr.push_back (10 * log10 (Sum (sinr) / sinr.GetSpectrumModel ()->GetNumBands ()));
+}
+
+void
+MmWaveVehicularSharedSignalTestCase::TransmitVector (Ptr<MmWaveSidelinkSpectrumPhy> ssp, uint16_t destinationRnti)
+{
+  ssp->StartTxDataFrames (m_burst, MicroSeconds (100), 0, 0, 20, 14, 0, destinationRnti, m_subChannels);
+}
+
+void
+MmWaveVehicularSharedSignalTestCase::TransmitShared (Ptr<MmWaveSidelinkSpectrumPhy> ssp, uint16_t destinationRnti)
+{
+  ssp->StartTxDataFrames (m_burst, MicroSeconds (100), 0, 0, 20, 14, 0, destinationRnti, m_rbBitmap);
+}
+
+void
+MmWaveVehicularSharedSignalTestCase::DoRun (void)
+{
+  SpectrumChannelHelper sh = SpectrumChannelHelper::Default ();
+  Ptr<SpectrumChannel> sc = sh.Create ();
+
+  Ptr<mmwave::MmWavePhyMacCommon> pmc = CreateObject<mmwave::MmWavePhyMacCommon> ();
+  m_subChannels.resize (pmc->GetTotalNumChunk ());
+  for (uint32_t i = 0; i < m_subChannels.size (); i++)
+  {
+    m_subChannels [i] = i;
+  }
+  m_rbBitmap = Create<MmWaveSidelinkRbBitmap> (m_subChannels);
+  Ptr<SpectrumValue> txPsd = mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (pmc, 30.0, m_subChannels);
+
+  m_burst = CreateObject<PacketBurst> ();
+  Ptr<Packet> p = Create<Packet> (20);
+  m_burst->AddPacket (p);
+
+  // the copies of the parameters share the bitmap and the burst
+  Ptr<MmWaveSidelinkSpectrumSignalParameters> params = Create<MmWaveSidelinkSpectrumSignalParameters> ();
+  params->packetBurst = m_burst;
+  params->rbBitmap = m_rbBitmap;
+  Ptr<MmWaveSidelinkSpectrumSignalParameters> copy = DynamicCast<MmWaveSidelinkSpectrumSignalParameters> (params->Copy ());
+  NS_TEST_ASSERT_MSG_EQ (bool (copy), true, "The copy must be a sidelink signal");
+  NS_TEST_EXPECT_MSG_EQ (copy->packetBurst, m_burst, "The copy must share the burst");
+  NS_TEST_EXPECT_MSG_EQ (copy->rbBitmap, m_rbBitmap, "The copy must share the bitmap");
+
+  // the transmitter and the two receivers, at the same distance
+  std::vector<Ptr<MmWaveSidelinkSpectrumPhy> > ssps;
+  std::vector<double> positions = {10.0, 0.0, 20.0};
+  for (double x : positions)
+  {
+    Ptr<MobilityModel> mm = CreateObject<ConstantPositionMobilityModel> ();
+    mm->SetPosition (Vector (x, 0.0, 0.0));
+    Ptr<MmWaveSidelinkSpectrumPhy> ssp = CreateObject<MmWaveSidelinkSpectrumPhy> ();
+    ssp->SetMobility (mm);
+    ssp->SetAntenna (CreateObject<IsotropicAntennaModel> ());
+    ssp->SetChannel (sc);
+    ssp->SetTxPowerSpectralDensity (txPsd);
+    ssps.push_back (ssp);
+  }
+
+  uint16_t rxRnti = 1;
+  for (uint32_t i = 1; i < ssps.size (); i++)
+  {
+    Ptr<MmWaveSidelinkSpectrumPhy> rx = ssps.at (i);
+    sc->AddRx (rx);
+    Ptr<MmWaveVehicularDeviceContext> context = Create<MmWaveVehicularDeviceContext> ();
+    context->m_rnti = rxRnti;
+    context->m_mobility = rx->GetMobility ();
+    rx->SetDeviceContext (context);
+    rx->SetNoisePowerSpectralDensity (mmwave::MmWaveSpectrumValueHelper::CreateNoisePowerSpectralDensity (pmc, 5.0));
+    rx->SetPhyRxDataEndOkCallback (MakeCallback (&MmWaveVehicularSharedSignalTestCase::Rx, this));
+
+    Ptr<mmwave::mmWaveChunkProcessor> pData = Create<mmwave::mmWaveChunkProcessor> ();
+    pData->AddCallback (MakeCallback (&MmWaveSidelinkSpectrumPhy::UpdateSinrPerceived, rx));
+    pData->AddCallback (MakeCallback (&MmWaveVehicularSharedSignalTestCase::UpdateSinrPerceived, this));
+    rx->AddDataSinrChunkProcessor (pData);
+  }
+
+  Simulator::Schedule (MicroSeconds (100), &MmWaveVehicularSharedSignalTestCase::TransmitVector, this,
+                       ssps.at (0), rxRnti);
+  Simulator::Schedule (MicroSeconds (300), &MmWaveVehicularSharedSignalTestCase::TransmitShared, this,
+                       ssps.at (0), rxRnti);
+  Simulator::Schedule (MicroSeconds (500), &MmWaveVehicularSharedSignalTestCase::TransmitShared, this,
+                       ssps.at (0), rxRnti);
+
+  Simulator::Stop (MilliSeconds (1));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_sinr.size (), 6u, "Each receiver must receive the three transmissions");
+  for (uint32_t i = 1; i < m_sinr.size (); i++)
+  {
+    NS_TEST_EXPECT_MSG_EQ_TOL (m_sinr.at (i), m_sinr.at (0), 1e-9, "The shared bitmap must not change the SINR");
+  }
+  NS_TEST_ASSERT_MSG_EQ (m_rxSizes.size (), 6u, "Each receiver must decode the three transmissions");
+  for (uint32_t i = 0; i < m_rxSizes.size (); i++)
+  {
+    NS_TEST_EXPECT_MSG_EQ (m_rxSizes.at (i), 20u, "A reception got a packet modified by another one");
+    NS_TEST_EXPECT_MSG_EQ (m_rxUids.at (i), p->GetUid (), "A reception got a different packet");
+  }
+  NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 20u, "The receptions must not modify the transmitted packet");
+}
+
+/**
+ * In this test, an interferer starts a transmission before the receiver
+ * expects the reception of a useful signal, and the transmission lasts
+ * until the end of the reception. A shorter transmission of the interferer
+ * ends before the reception is expected. The test checks that the SINR is
+ * the same with and without the filter of the unexpected signals, and that
+ * only the short transmission is discarded by the filter.
+ */
+class MmWaveVehicularFilterUnexpectedSignalsTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularFilterUnexpectedSignalsTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularFilterUnexpectedSignalsTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Run the simulation and store the average SINR of the reception in
+   * m_sinr and the number of discarded signals in m_numFilteredSignals
+   * \param filter the value of the attribute FilterUnexpectedSignals of the receiver
+   */
+  void RunSimulation (bool filter);
+
+  /**
+   * Transmit an empty packet burst on all the subchannels
+   * \param ssp the tx SpectrumPhy instance
+   * \param duration the duration of the transmission
+   * \param destinationRnti the RNTI of the destination
+   */
+  void Transmit (Ptr<MmWaveSidelinkSpectrumPhy> ssp, Time duration, uint16_t destinationRnti);
+
+  /**
+   * This method is a callback sink which is fired when the rx updates the SINR
+   * estimate
+   * \param sinr the sinr value
+   */
+  void UpdateSinrPerceived (const SpectrumValue& sinr);
+
+  std::vector<int> m_subChannels; //!< all the subchannels, used by the transmissions
+  std::vector<double> m_sinr; //!< the average SINR of each run, in dB
+  std::vector<uint64_t> m_numFilteredSignals; //!< the number of signals discarded in each run
+};
+
+MmWaveVehicularFilterUnexpectedSignalsTestCase::MmWaveVehicularFilterUnexpectedSignalsTestCase ()
+  : TestCase ("The interferers which start before the reception is expected are accounted in the SINR")
+{
+}
+
+MmWaveVehicularFilterUnexpectedSignalsTestCase::~MmWaveVehicularFilterUnexpectedSignalsTestCase ()
+{
+}
+
+void
+MmWaveVehicularFilterUnexpectedSignalsTestCase::UpdateSinrPerceived (const SpectrumValue& sinr)
+{
+  m_sinr.push_back (10 * log10 (Sum (sinr) / sinr.GetSpectrumModel ()->GetNumBands ()));
+}
+
+void
+MmWaveVehicularFilterUnexpectedSignalsTestCase::Transmit (Ptr<MmWaveSidelinkSpectrumPhy> ssp, Time duration, uint16_t destinationRnti)
+{
+  // the burst is empty, only the SINR is evaluated
+  Ptr<PacketBurst> pb = CreateObject<PacketBurst> ();
+  ssp->StartTxDataFrames (pb, duration, 0, 0, 0, 14, 0, destinationRnti, m_subChannels);
+}
+
+void
+MmWaveVehicularFilterUnexpectedSignalsTestCase::RunSimulation (bool filter)
+{
+  SpectrumChannelHelper sh = SpectrumChannelHelper::Default ();
+  Ptr<SpectrumChannel> sc = sh.Create ();
+
+  Ptr<mmwave::MmWavePhyMacCommon> pmc = CreateObject<mmwave::MmWavePhyMacCommon> ();
+  m_subChannels.resize (pmc->GetTotalNumChunk ());
+  for (uint32_t i = 0; i < m_subChannels.size (); i++)
+  {
+    m_subChannels [i] = i;
+  }
+  Ptr<SpectrumValue> txPsd = mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (pmc, 30.0, m_subChannels);
+
+  // the receiver, the useful transmitter and the interferer
+  std::vector<Ptr<MmWaveSidelinkSpectrumPhy> > ssps;
+  std::vector<double> positions = {0.0, 10.0, -15.0};
+  for (double x : positions)
+  {
+    Ptr<MobilityModel> mm = CreateObject<ConstantPositionMobilityModel> ();
+    mm->SetPosition (Vector (x, 0.0, 0.0));
+    Ptr<MmWaveSidelinkSpectrumPhy> ssp = CreateObject<MmWaveSidelinkSpectrumPhy> ();
+    ssp->SetMobility (mm);
+    ssp->SetAntenna (CreateObject<IsotropicAntennaModel> ());
+    ssp->SetChannel (sc);
+    ssp->SetTxPowerSpectralDensity (txPsd);
+    ssps.push_back (ssp);
+  }
+  Ptr<MmWaveSidelinkSpectrumPhy> rx = ssps.at (0);
+  Ptr<MmWaveSidelinkSpectrumPhy> tx = ssps.at (1);
+  Ptr<MmWaveSidelinkSpectrumPhy> interferer = ssps.at (2);
+  sc->AddRx (rx);
+
+  uint16_t rxRnti = 1;
+  Ptr<MmWaveVehicularDeviceContext> context = Create<MmWaveVehicularDeviceContext> ();
+  context->m_rnti = rxRnti;
+  context->m_mobility = rx->GetMobility ();
+  rx->SetDeviceContext (context);
+  rx->SetNoisePowerSpectralDensity (mmwave::MmWaveSpectrumValueHelper::CreateNoisePowerSpectralDensity (pmc, 5.0));
+  rx->SetAttribute ("FilterUnexpectedSignals", BooleanValue (filter));
+
+  Ptr<mmwave::mmWaveChunkProcessor> pData = Create<mmwave::mmWaveChunkProcessor> ();
+  pData->AddCallback (MakeCallback (&MmWaveVehicularFilterUnexpectedSignalsTestCase::UpdateSinrPerceived, this));
+  rx->AddDataSinrChunkProcessor (pData);
+
+  uint16_t otherRnti = 5;
+
+  // a short transmission, which ends before the reception is expected
+  Simulator::Schedule (MicroSeconds (0), &MmWaveVehicularFilterUnexpectedSignalsTestCase::Transmit, this,
+                       interferer, MicroSeconds (10), otherRnti);
+  // a long transmission, which starts before the reception is expected
+  Simulator::Schedule (MicroSeconds (20), &MmWaveVehicularFilterUnexpectedSignalsTestCase::Transmit, this,
+                       interferer, MicroSeconds (300), otherRnti);
+  // the MAC prepares for the reception at the start of the slot
+  Simulator::Schedule (MicroSeconds (100), &MmWaveSidelinkSpectrumPhy::ExpectReception, rx, MicroSeconds (125));
+  Simulator::Schedule (MicroSeconds (100), &MmWaveVehicularFilterUnexpectedSignalsTestCase::Transmit, this,
+                       tx, MicroSeconds (100), rxRnti);
+
+  Simulator::Stop (MilliSeconds (1));
+  Simulator::Run ();
+  m_numFilteredSignals.push_back (rx->GetNumFilteredSignals ());
+  Simulator::Destroy ();
+}
+
+void
+MmWaveVehicularFilterUnexpectedSignalsTestCase::DoRun (void)
+{
+  RunSimulation (false);
+  RunSimulation (true);
+
+  NS_TEST_ASSERT_MSG_EQ (m_sinr.size (), 2u, "The useful signal has not been received");
+  NS_TEST_EXPECT_MSG_EQ_TOL (m_sinr.at (1), m_sinr.at (0), 1e-6, "The filter must not change the SINR");
+  NS_TEST_EXPECT_MSG_LT (m_sinr.at (0), 10.0, "The interferer must be accounted in the SINR");
+  NS_TEST_EXPECT_MSG_EQ (m_numFilteredSignals.at (0), 0u, "No signal is discarded without the filter");
+  NS_TEST_EXPECT_MSG_EQ (m_numFilteredSignals.at (1), 1u, "Only the short transmission must be discarded");
+}
+
 /**
  * Test suite for the class MmWaveSidelinkSpectrumPhy
  */
@@ -212,6 +884,10 @@ MmWaveVehicularSidelinkSpectrumPhyTestSuite::MmWaveVehicularSidelinkSpectrumPhyT
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new MmWaveVehicularSidelinkSpectrumPhyTestCase1, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularInterferencePruningTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularScalarAbstractionTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularSharedSignalTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularFilterUnexpectedSignalsTestCase, TestCase::QUICK);
 }
 
 static MmWaveVehicularSidelinkSpectrumPhyTestSuite MmWaveVehicularSidelinkSpectrumPhyTestSuite;
@@ -0,0 +1,598 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-spectrum-channel.h"
+#include "ns3/mmwave-vehicular-spectrum-propagation-loss-model.h"
+#include "ns3/mmwave-vehicular-propagation-loss-model.h"
+#include "ns3/mmwave-vehicular-antenna-array-model.h"
+#include "ns3/mmwave-vehicular-device-context.h"
+#include "ns3/mmwave-phy-mac-common.h"
+#include "ns3/mmwave-spectrum-value-helper.h"
+#include "ns3/spectrum-phy.h"
+#include "ns3/spectrum-signal-parameters.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/mobility-module.h"
+#include "ns3/core-module.h"
+#include "ns3/test.h"
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularSpectrumChannelTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * SpectrumPhy which records the PSDs of the received signals
+ */
+class MmWaveVehicularTestSpectrumPhy : public SpectrumPhy
+{
+public:
+  // inherited from SpectrumPhy
+  void SetDevice (Ptr<NetDevice> d);
+  Ptr<NetDevice> GetDevice () const;
+  void SetMobility (Ptr<MobilityModel> m);
+  Ptr<MobilityModel> GetMobility ();
+  void SetChannel (Ptr<SpectrumChannel> c);
+  Ptr<const SpectrumModel> GetRxSpectrumModel () const;
+  Ptr<AntennaModel> GetRxAntenna ();
+  void StartRx (Ptr<SpectrumSignalParameters> params);
+
+  /**
+   * Set the antenna
+   * \param antenna the antenna
+   */
+  void SetAntenna (Ptr<AntennaModel> antenna);
+
+  std::vector<Ptr<const SpectrumValue> > m_rxPsds; //!< the PSDs of the received signals
+  std::vector<Time> m_rxTimes; //!< the reception times of the signals
+
+private:
+  Ptr<NetDevice> m_device; //!< the device
+  Ptr<MobilityModel> m_mobility; //!< the mobility model
+  Ptr<AntennaModel> m_antenna; //!< the antenna
+};
+
+void
+MmWaveVehicularTestSpectrumPhy::SetDevice (Ptr<NetDevice> d)
+{
+  m_device = d;
+}
+
+Ptr<NetDevice>
+MmWaveVehicularTestSpectrumPhy::GetDevice () const
+{
+  return m_device;
+}
+
+void
+MmWaveVehicularTestSpectrumPhy::SetMobility (Ptr<MobilityModel> m)
+{
+  m_mobility = m;
+}
+
+Ptr<MobilityModel>
+MmWaveVehicularTestSpectrumPhy::GetMobility ()
+{
+  return m_mobility;
+}
+
+void
+MmWaveVehicularTestSpectrumPhy::SetChannel (Ptr<SpectrumChannel> c)
+{
+}
+
+Ptr<const SpectrumModel>
+MmWaveVehicularTestSpectrumPhy::GetRxSpectrumModel () const
+{
+  return 0;
+}
+
+Ptr<AntennaModel>
+MmWaveVehicularTestSpectrumPhy::GetRxAntenna ()
+{
+  return m_antenna;
+}
+
+void
+MmWaveVehicularTestSpectrumPhy::SetAntenna (Ptr<AntennaModel> antenna)
+{
+  m_antenna = antenna;
+}
+
+void
+MmWaveVehicularTestSpectrumPhy::StartRx (Ptr<SpectrumSignalParameters> params)
+{
+  m_rxPsds.push_back (params->psd->Copy ());
+  m_rxTimes.push_back (Simulator::Now ());
+}
+
+/**
+ * Vehicles attached to a MmWaveVehicularSpectrumChannel, each with its beam
+ * pointed towards the next one, either static or moving at constant
+ * velocity. The channel is deterministic: the shadowing is disabled, the
+ * channel condition is LOS and the channel realizations are never updated.
+ */
+struct MmWaveVehicularTestChannel
+{
+  /**
+   * Create the vehicles
+   * \param positions the initial positions of the vehicles
+   * \param velocities the velocities of the vehicles, empty for static vehicles
+   */
+  MmWaveVehicularTestChannel (std::vector<Vector> positions, std::vector<Vector> velocities = std::vector<Vector> ());
+
+  /**
+   * Create a tx PSD
+   * \param power the tx power in dBm
+   * \param numChunks the number of used chunks, starting from the first one
+   * \return the PSD
+   */
+  Ptr<const SpectrumValue> CreateTxPsd (double power, uint32_t numChunks) const;
+
+  /**
+   * Start a transmission
+   * \param tx the index of the transmitter
+   * \param psd the tx PSD
+   */
+  void Transmit (uint32_t tx, Ptr<const SpectrumValue> psd);
+
+  /**
+   * Compute the PSD received on a link with the propagation models, without
+   * the channel
+   * \param tx the index of the transmitter
+   * \param rx the index of the receiver
+   * \param psd the tx PSD
+   * \return the rx PSD
+   */
+  Ptr<SpectrumValue> ComputeRxPsd (uint32_t tx, uint32_t rx, Ptr<const SpectrumValue> psd) const;
+
+  NodeContainer m_nodes; //!< the vehicles
+  std::vector<Ptr<NetDevice> > m_devices; //!< the devices of the vehicles
+  std::vector<Ptr<MmWaveVehicularAntennaArrayModel> > m_antennas; //!< the antennas of the vehicles
+  std::vector<Ptr<MmWaveVehicularTestSpectrumPhy> > m_phys; //!< the spectrum phys of the vehicles
+  Ptr<MmWaveVehicularSpectrumChannel> m_channel; //!< the channel
+  Ptr<MmWaveVehicularPropagationLossModel> m_plm; //!< the propagation loss model
+  Ptr<MmWaveVehicularSpectrumPropagationLossModel> m_splm; //!< the spectrum propagation loss model
+  Ptr<mmwave::MmWavePhyMacCommon> m_conf; //!< the configuration used to create the PSDs
+};
+
+MmWaveVehicularTestChannel::MmWaveVehicularTestChannel (std::vector<Vector> positions, std::vector<Vector> velocities)
+{
+  m_plm = CreateObject<MmWaveVehicularPropagationLossModel> ();
+  m_plm->SetAttribute ("Frequency", DoubleValue (60.0e9));
+  m_plm->SetAttribute ("ChannelCondition", StringValue ("l"));
+  m_plm->SetAttribute ("Shadowing", BooleanValue (false));
+  m_splm = CreateObject<MmWaveVehicularSpectrumPropagationLossModel> ();
+  m_splm->SetAttribute ("Frequency", DoubleValue (60.0e9));
+  m_splm->SetAttribute ("UpdatePeriod", TimeValue (Seconds (0)));
+  m_splm->SetPathlossModel (m_plm);
+
+  m_channel = CreateObject<MmWaveVehicularSpectrumChannel> ();
+  m_channel->AddPropagationLossModel (m_plm);
+  m_channel->AddSpectrumPropagationLossModel (m_splm);
+  m_channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+
+  m_nodes.Create (positions.size ());
+  for (uint32_t i = 0; i < positions.size (); ++i)
+    {
+      Ptr<Node> node = m_nodes.Get (i);
+      Ptr<MobilityModel> mobility;
+      if (velocities.empty ())
+        {
+          mobility = CreateObject<ConstantPositionMobilityModel> ();
+          mobility->SetPosition (positions[i]);
+        }
+      else
+        {
+          Ptr<ConstantVelocityMobilityModel> constantVelocity = CreateObject<ConstantVelocityMobilityModel> ();
+          constantVelocity->SetPosition (positions[i]);
+          constantVelocity->SetVelocity (velocities[i]);
+          mobility = constantVelocity;
+        }
+      node->AggregateObject (mobility);
+      Ptr<NetDevice> device = CreateObject<SimpleNetDevice> ();
+      node->AddDevice (device);
+
+      Ptr<MmWaveVehicularAntennaArrayModel> antenna = CreateObject<MmWaveVehicularAntennaArrayModel> ();
+      antenna->SetAttribute ("AntennaElements", UintegerValue (16));
+
+      Ptr<MmWaveVehicularTestSpectrumPhy> phy = CreateObject<MmWaveVehicularTestSpectrumPhy> ();
+      phy->SetDevice (device);
+      phy->SetMobility (mobility);
+      phy->SetAntenna (antenna);
+      m_channel->AddRx (phy);
+
+      Ptr<MmWaveVehicularDeviceContext> context = Create<MmWaveVehicularDeviceContext> ();
+      context->m_device = device;
+      context->m_rnti = i + 1;
+      context->m_antenna = antenna;
+      context->m_mobility = mobility;
+      m_splm->AddDevice (context);
+
+      m_devices.push_back (device);
+      m_antennas.push_back (antenna);
+      m_phys.push_back (phy);
+    }
+
+  for (uint32_t i = 0; i < positions.size (); ++i)
+    {
+      m_antennas[i]->SetBeamformingVectorPanelDevices (m_devices[i], m_devices[(i + 1) % positions.size ()]);
+    }
+
+  m_conf = CreateObject<mmwave::MmWavePhyMacCommon> ();
+  m_conf->SetAttribute ("CenterFreq", DoubleValue (60.0e9));
+}
+
+Ptr<const SpectrumValue>
+MmWaveVehicularTestChannel::CreateTxPsd (double power, uint32_t numChunks) const
+{
+  std::vector<int> subChannels;
+  for (uint32_t i = 0; i < numChunks; ++i)
+    {
+      subChannels.push_back (i);
+    }
+  return mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (m_conf, power, subChannels);
+}
+
+void
+MmWaveVehicularTestChannel::Transmit (uint32_t tx, Ptr<const SpectrumValue> psd)
+{
+  Ptr<SpectrumSignalParameters> params = Create<SpectrumSignalParameters> ();
+  params->psd = psd->Copy ();
+  params->duration = MicroSeconds (100);
+  params->txPhy = m_phys[tx];
+  params->txAntenna = m_antennas[tx];
+  m_channel->StartTx (params);
+}
+
+Ptr<SpectrumValue>
+MmWaveVehicularTestChannel::ComputeRxPsd (uint32_t tx, uint32_t rx, Ptr<const SpectrumValue> psd) const
+{
+  Ptr<MobilityModel> a = m_nodes.Get (tx)->GetObject<MobilityModel> ();
+  Ptr<MobilityModel> b = m_nodes.Get (rx)->GetObject<MobilityModel> ();
+  // the antennas have no element gain, see MmWaveVehicularAntennaArrayModel::GetGainDb
+  Ptr<SpectrumValue> rxPsd = m_splm->CalcRxPowerSpectralDensity (psd, a, b);
+  *rxPsd *= std::pow (10.0, m_plm->CalcRxPower (0, a, b) / 10.0);
+  return rxPsd;
+}
+
+/**
+ * In this test, two vehicles in the same spatial cell transmit at the same
+ * time, first with the exact computation and then with the far-field
+ * approximation, to two far receivers and to each other. The test checks
+ * that each far receiver gets a single aggregate, equal to the sum of the
+ * tx PSDs scaled by the pathloss, that the signals between the two
+ * transmitters are still computed exactly, and that the reported error is
+ * the ratio between the aggregated power and the power received with the
+ * exact computation.
+ */
+class MmWaveVehicularFarFieldTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularFarFieldTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularFarFieldTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularFarFieldTestCase::MmWaveVehicularFarFieldTestCase ()
+  : TestCase ("The far-field signals are aggregated by cell and the error is reported")
+{
+}
+
+MmWaveVehicularFarFieldTestCase::~MmWaveVehicularFarFieldTestCase ()
+{
+}
+
+void
+MmWaveVehicularFarFieldTestCase::DoRun (void)
+{
+  // the two receivers, and the two transmitters in the same cell of 100 m
+  std::vector<Vector> positions;
+  positions.push_back (Vector (0, 0, 1.5));
+  positions.push_back (Vector (0, 20, 1.5));
+  positions.push_back (Vector (300, 0, 1.5));
+  positions.push_back (Vector (310, 20, 1.5));
+  MmWaveVehicularTestChannel scenario (positions);
+  Ptr<const SpectrumValue> txPsd = scenario.CreateTxPsd (30, scenario.m_conf->GetTotalNumChunk ());
+
+  // exact computation, the channel realizations do not change since the
+  // vehicles do not move
+  scenario.Transmit (2, txPsd);
+  scenario.Transmit (3, txPsd);
+  Simulator::Run ();
+  double exactPower = 0;
+  for (uint32_t rx = 0; rx < 2; ++rx)
+    {
+      NS_TEST_ASSERT_MSG_EQ (scenario.m_phys[rx]->m_rxPsds.size (), 2, "Wrong number of exact signals at receiver " << rx);
+      exactPower += Sum (*scenario.m_phys[rx]->m_rxPsds[0]) + Sum (*scenario.m_phys[rx]->m_rxPsds[1]);
+    }
+  NS_TEST_ASSERT_MSG_EQ (scenario.m_phys[2]->m_rxPsds.size (), 1, "Wrong number of exact signals at the transmitter 2");
+  Ptr<const SpectrumValue> exactNear = scenario.m_phys[2]->m_rxPsds[0];
+
+  // far-field approximation
+  scenario.m_channel->SetAttribute ("FarFieldRadius", DoubleValue (100));
+  scenario.m_channel->SetAttribute ("FarFieldValidation", BooleanValue (true));
+  Time start = Simulator::Now ();
+  scenario.Transmit (2, txPsd);
+  scenario.Transmit (3, txPsd);
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_EQ (scenario.m_channel->GetNumFarFieldSignals (), 4, "Wrong number of far-field signals");
+  NS_TEST_EXPECT_MSG_EQ (scenario.m_channel->GetNumFarFieldAggregates (), 2, "The signals of a cell must be aggregated");
+  double approxPower = 0;
+  for (uint32_t rx = 0; rx < 2; ++rx)
+    {
+      const std::vector<Ptr<const SpectrumValue> > &psds = scenario.m_phys[rx]->m_rxPsds;
+      NS_TEST_ASSERT_MSG_EQ (psds.size (), 3, "Wrong number of aggregates at receiver " << rx);
+      approxPower += Sum (*psds[2]);
+
+      // the tx PSD scaled by the pathloss of each transmitter, since the
+      // antennas have no element gain and the fixed beamforming gain is 0 dB
+      Ptr<MobilityModel> b = scenario.m_nodes.Get (rx)->GetObject<MobilityModel> ();
+      double pathGain = 0;
+      for (uint32_t tx = 2; tx < 4; ++tx)
+        {
+          Ptr<MobilityModel> a = scenario.m_nodes.Get (tx)->GetObject<MobilityModel> ();
+          pathGain += std::pow (10.0, scenario.m_plm->CalcRxPower (0, a, b) / 10.0);
+        }
+      for (uint32_t k = 0; k < txPsd->GetSpectrumModel ()->GetNumBands (); ++k)
+        {
+          NS_TEST_EXPECT_MSG_EQ_TOL ((*psds[2])[k], (*txPsd)[k] * pathGain, (*txPsd)[k] * pathGain * 1e-9, "Wrong aggregate in band " << k << " at receiver " << rx);
+        }
+
+      // the aggregate is delivered with the delay of the first signal
+      Ptr<MobilityModel> a = scenario.m_nodes.Get (2)->GetObject<MobilityModel> ();
+      Time delay = CreateObject<ConstantSpeedPropagationDelayModel> ()->GetDelay (a, b);
+      NS_TEST_EXPECT_MSG_EQ (scenario.m_phys[rx]->m_rxTimes[2], start + delay, "Wrong reception time of the aggregate at receiver " << rx);
+    }
+  NS_TEST_EXPECT_MSG_EQ_TOL (scenario.m_channel->GetFarFieldErrorDb (), 10 * std::log10 (approxPower / exactPower), 1e-6, "Wrong error of the approximation");
+
+  // the near signals are not approximated
+  const std::vector<Ptr<const SpectrumValue> > &nearPsds = scenario.m_phys[2]->m_rxPsds;
+  NS_TEST_ASSERT_MSG_EQ (nearPsds.size (), 2, "Wrong number of near signals");
+  for (uint32_t k = 0; k < exactNear->GetSpectrumModel ()->GetNumBands (); ++k)
+    {
+      NS_TEST_EXPECT_MSG_EQ_TOL ((*nearPsds[1])[k], (*exactNear)[k], (*exactNear)[k] * 1e-9, "The near signal differs in band " << k);
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * In this test, the vehicles move in and out of the range of each other, and
+ * periodically one of them transmits twice at the same time, first to all
+ * the receivers and then only within the maximum interference range. Some
+ * transmissions are between two updates of the grid. The test checks that
+ * the second signal is delivered exactly to the receivers within the range,
+ * and that it is equal to the first one.
+ */
+class MmWaveVehicularInterferenceRangeTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularInterferenceRangeTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularInterferenceRangeTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Transmit a signal to all the receivers and then within the range, and
+   * update the expected receptions
+   * \param tx the index of the transmitter
+   */
+  void Transmit (uint32_t tx);
+
+  MmWaveVehicularTestChannel *m_scenario; //!< the vehicles
+  Ptr<const SpectrumValue> m_txPsd; //!< the tx PSD
+  double m_range; //!< the maximum interference range
+  std::vector<uint32_t> m_numRx; //!< the expected number of signals received by each vehicle
+  std::vector<std::pair<uint32_t, uint32_t> > m_pairs; //!< receiver and index of the signals which must be equal to the next one
+};
+
+MmWaveVehicularInterferenceRangeTestCase::MmWaveVehicularInterferenceRangeTestCase ()
+  : TestCase ("The signals are delivered to the same receivers within the maximum interference range")
+{
+}
+
+MmWaveVehicularInterferenceRangeTestCase::~MmWaveVehicularInterferenceRangeTestCase ()
+{
+}
+
+void
+MmWaveVehicularInterferenceRangeTestCase::Transmit (uint32_t tx)
+{
+  m_scenario->m_channel->SetAttribute ("MaxInterferenceRange", DoubleValue (0));
+  m_scenario->Transmit (tx, m_txPsd);
+  m_scenario->m_channel->SetAttribute ("MaxInterferenceRange", DoubleValue (m_range));
+  m_scenario->Transmit (tx, m_txPsd);
+
+  // the signals with the same delay are received in order of transmission
+  Ptr<MobilityModel> a = m_scenario->m_nodes.Get (tx)->GetObject<MobilityModel> ();
+  for (uint32_t rx = 0; rx < m_numRx.size (); ++rx)
+    {
+      if (rx == tx)
+        {
+          continue;
+        }
+      m_numRx[rx]++;
+      if (a->GetDistanceFrom (m_scenario->m_nodes.Get (rx)->GetObject<MobilityModel> ()) <= m_range)
+        {
+          m_pairs.push_back (std::make_pair (rx, m_numRx[rx] - 1));
+          m_numRx[rx]++;
+        }
+    }
+}
+
+void
+MmWaveVehicularInterferenceRangeTestCase::DoRun (void)
+{
+  // the first vehicle leaves the range of the transmitter at the origin,
+  // the second and the third enter it, the last one is always out of range
+  std::vector<Vector> positions;
+  positions.push_back (Vector (0, 0, 1.5));
+  positions.push_back (Vector (40, 0, 1.5));
+  positions.push_back (Vector (-80, 10, 1.5));
+  positions.push_back (Vector (0, 75, 1.5));
+  positions.push_back (Vector (200, 200, 1.5));
+  std::vector<Vector> velocities;
+  velocities.push_back (Vector (0, 0, 0));
+  velocities.push_back (Vector (30, 0, 0));
+  velocities.push_back (Vector (40, 0, 0));
+  velocities.push_back (Vector (0, -35, 0));
+  velocities.push_back (Vector (0, 0, 0));
+  MmWaveVehicularTestChannel scenario (positions, velocities);
+  scenario.m_channel->SetAttribute ("GridUpdatePeriod", TimeValue (MilliSeconds (250)));
+  m_scenario = &scenario;
+  m_txPsd = scenario.CreateTxPsd (30, scenario.m_conf->GetTotalNumChunk ());
+  m_range = 50;
+  m_numRx = std::vector<uint32_t> (positions.size (), 0);
+
+  // the vehicle at the origin transmits every 100 ms, the others in turn
+  for (uint32_t i = 0; i < 10; ++i)
+    {
+      Simulator::Schedule (MilliSeconds (100 * i), &MmWaveVehicularInterferenceRangeTestCase::Transmit, this, 0);
+      Simulator::Schedule (MilliSeconds (100 * i + 50), &MmWaveVehicularInterferenceRangeTestCase::Transmit, this, 1 + i % 4);
+    }
+  Simulator::Run ();
+
+  for (uint32_t rx = 0; rx < m_numRx.size (); ++rx)
+    {
+      NS_TEST_EXPECT_MSG_EQ (scenario.m_phys[rx]->m_rxPsds.size (), m_numRx[rx], "Wrong number of signals received by vehicle " << rx);
+    }
+  for (const std::pair<uint32_t, uint32_t> &pair : m_pairs)
+    {
+      const std::vector<Ptr<const SpectrumValue> > &psds = scenario.m_phys[pair.first]->m_rxPsds;
+      NS_TEST_ASSERT_MSG_LT (pair.second + 1, psds.size (), "Missing signal at vehicle " << pair.first);
+      NS_TEST_EXPECT_MSG_EQ (scenario.m_phys[pair.first]->m_rxTimes[pair.second + 1], scenario.m_phys[pair.first]->m_rxTimes[pair.second], "Different reception time at vehicle " << pair.first);
+      for (uint32_t k = 0; k < m_txPsd->GetSpectrumModel ()->GetNumBands (); ++k)
+        {
+          NS_TEST_EXPECT_MSG_EQ_TOL ((*psds[pair.second + 1])[k], (*psds[pair.second])[k], (*psds[pair.second])[k] * 1e-9,
+                                     "Different signal in band " << k << " at vehicle " << pair.first);
+        }
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * In this test, a link is used twice in the same coherence interval: the
+ * first signal, at time 0, stores the gains of the link, and the second
+ * one, with a different power and fewer resource blocks, is computed with
+ * the cached gains. The test checks that the cached PSD is equal to the one
+ * computed with the propagation models at time 0, i.e., when the Doppler
+ * terms are equal to one, since the cache freezes the evolution of the
+ * Doppler terms within the interval.
+ */
+class MmWaveVehicularLinkGainCacheTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularLinkGainCacheTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularLinkGainCacheTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularLinkGainCacheTestCase::MmWaveVehicularLinkGainCacheTestCase ()
+  : TestCase ("The PSD computed with the cached link gains is equal to the exact one")
+{
+}
+
+MmWaveVehicularLinkGainCacheTestCase::~MmWaveVehicularLinkGainCacheTestCase ()
+{
+}
+
+void
+MmWaveVehicularLinkGainCacheTestCase::DoRun (void)
+{
+  std::vector<Vector> positions;
+  positions.push_back (Vector (0, 0, 1.5));
+  positions.push_back (Vector (3, 20, 1.5));
+  MmWaveVehicularTestChannel scenario (positions);
+  scenario.m_channel->SetAttribute ("CoherenceTime", TimeValue (MilliSeconds (10)));
+  Ptr<const SpectrumValue> firstPsd = scenario.CreateTxPsd (30, scenario.m_conf->GetTotalNumChunk ());
+  Ptr<const SpectrumValue> secondPsd = scenario.CreateTxPsd (20, scenario.m_conf->GetTotalNumChunk () / 2);
+
+  scenario.Transmit (0, firstPsd);
+  Ptr<SpectrumValue> exact = scenario.ComputeRxPsd (0, 1, secondPsd);
+  Simulator::Schedule (MilliSeconds (5), &MmWaveVehicularTestChannel::Transmit, &scenario, 0, secondPsd);
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_EQ (scenario.m_channel->GetNumCachedLinkGains (), 1, "The second signal must use the cached gains");
+  const std::vector<Ptr<const SpectrumValue> > &psds = scenario.m_phys[1]->m_rxPsds;
+  NS_TEST_ASSERT_MSG_EQ (psds.size (), 2, "Wrong number of received signals");
+  NS_TEST_EXPECT_MSG_GT (Sum (*psds[1]), 0.0, "Empty PSD");
+  for (uint32_t k = 0; k < exact->GetSpectrumModel ()->GetNumBands (); ++k)
+    {
+      NS_TEST_EXPECT_MSG_EQ_TOL ((*psds[1])[k], (*exact)[k], (*exact)[k] * 1e-9, "The cached PSD differs in band " << k);
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * Test suite for the MmWaveVehicularSpectrumChannel
+ */
+class MmWaveVehicularSpectrumChannelTestSuite : public TestSuite
+{
+public:
+  MmWaveVehicularSpectrumChannelTestSuite ();
+};
+
+MmWaveVehicularSpectrumChannelTestSuite::MmWaveVehicularSpectrumChannelTestSuite ()
+  : TestSuite ("mmwave-vehicular-spectrum-channel", UNIT)
+{
+  AddTestCase (new MmWaveVehicularFarFieldTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularInterferenceRangeTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularLinkGainCacheTestCase, TestCase::QUICK);
+}
+
+static MmWaveVehicularSpectrumChannelTestSuite mmwaveVehicularSpectrumChannelTestSuite;
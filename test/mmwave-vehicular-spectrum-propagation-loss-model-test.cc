@@ -0,0 +1,787 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+*   Copyright (c) 2020 University of Padova, Dep. of Information Engineering,
+*   SIGNET lab.
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License version 2 as
+*   published by the Free Software Foundation;
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program; if not, write to the Free Software
+*   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "ns3/mmwave-vehicular-spectrum-propagation-loss-model.h"
+#include "ns3/mmwave-vehicular-beam-sweep.h"
+#include "ns3/mmwave-vehicular-net-device.h"
+#include "ns3/mmwave-vehicular-helper.h"
+#include "ns3/mmwave-spectrum-value-helper.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/mobility-module.h"
+#include "ns3/core-module.h"
+#include "ns3/test.h"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <set>
+
+NS_LOG_COMPONENT_DEFINE ("MmWaveVehicularSpectrumPropagationLossModelTestSuite");
+
+using namespace ns3;
+using namespace millicar;
+
+/**
+ * A platoon of vehicles, each with its beam pointed towards the next one,
+ * used by the test cases of the spectrum propagation loss model
+ */
+struct MmWaveVehicularTestPlatoon
+{
+  /**
+   * Create the platoon
+   * \param numVehicles the number of vehicles
+   * \param distance the distance between two consecutive vehicles
+   */
+  MmWaveVehicularTestPlatoon (uint32_t numVehicles, double distance);
+
+  /**
+   * Returns the mobility models of all the vehicles but one
+   * \param tx the index of the excluded vehicle
+   * \return the mobility models
+   */
+  std::vector<Ptr<const MobilityModel> > GetReceivers (uint32_t tx) const;
+
+  NodeContainer m_nodes; //!< the vehicles
+  NetDeviceContainer m_devices; //!< the devices of the vehicles
+  Ptr<MmWaveVehicularSpectrumPropagationLossModel> m_splm; //!< the spectrum propagation loss model of the channel
+  Ptr<const SpectrumValue> m_txPsd; //!< a PSD using all the resource blocks
+};
+
+MmWaveVehicularTestPlatoon::MmWaveVehicularTestPlatoon (uint32_t numVehicles, double distance)
+{
+  Config::SetDefault ("ns3::MmWavePhyMacCommon::CenterFreq", DoubleValue (60.0e9));
+  Config::SetDefault ("ns3::MmWaveVehicularPropagationLossModel::Frequency", DoubleValue (60.0e9));
+  Config::SetDefault ("ns3::MmWaveVehicularSpectrumPropagationLossModel::Frequency", DoubleValue (60.0e9));
+
+  m_nodes.Create (numVehicles);
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantVelocityMobilityModel");
+  mobility.Install (m_nodes);
+  for (uint32_t i = 0; i < numVehicles; ++i)
+    {
+      m_nodes.Get (i)->GetObject<MobilityModel> ()->SetPosition (Vector (0, i * distance, 0));
+      m_nodes.Get (i)->GetObject<ConstantVelocityMobilityModel> ()->SetVelocity (Vector (0, 20, 0));
+    }
+
+  Ptr<MmWaveVehicularHelper> helper = CreateObject<MmWaveVehicularHelper> ();
+  helper->SetNumerology (3);
+  helper->SetPropagationLossModelType ("ns3::MmWaveVehicularPropagationLossModel");
+  helper->SetSpectrumPropagationLossModelType ("ns3::MmWaveVehicularSpectrumPropagationLossModel");
+  m_devices = helper->InstallMmWaveVehicularNetDevices (m_nodes);
+
+  Ptr<MmWaveSidelinkSpectrumPhy> ssp = DynamicCast<MmWaveVehicularNetDevice> (m_devices.Get (0))->GetPhy ()->GetSpectrumPhy ();
+  m_splm = DynamicCast<MmWaveVehicularSpectrumPropagationLossModel> (ssp->GetSpectrumChannel ()->GetSpectrumPropagationLossModel ());
+  NS_ABORT_MSG_IF (m_splm == 0, "Unexpected spectrum propagation loss model");
+
+  for (uint32_t i = 0; i < numVehicles; ++i)
+    {
+      Ptr<MmWaveVehicularNetDevice> dev = DynamicCast<MmWaveVehicularNetDevice> (m_devices.Get (i));
+      Ptr<MmWaveVehicularAntennaArrayModel> antenna = DynamicCast<MmWaveVehicularAntennaArrayModel> (dev->GetPhy ()->GetSpectrumPhy ()->GetRxAntenna ());
+      antenna->SetBeamformingVectorPanelDevices (m_devices.Get (i), m_devices.Get ((i + 1) % numVehicles));
+    }
+
+  Ptr<mmwave::MmWavePhyMacCommon> conf = helper->GetConfigurationParameters ();
+  std::vector<int> subChannels;
+  for (uint32_t i = 0; i < conf->GetTotalNumChunk (); ++i)
+    {
+      subChannels.push_back (i);
+    }
+  m_txPsd = mmwave::MmWaveSpectrumValueHelper::CreateTxPowerSpectralDensity (conf, 30, subChannels);
+}
+
+std::vector<Ptr<const MobilityModel> >
+MmWaveVehicularTestPlatoon::GetReceivers (uint32_t tx) const
+{
+  std::vector<Ptr<const MobilityModel> > receivers;
+  for (uint32_t j = 0; j < m_nodes.GetN (); ++j)
+    {
+      if (j != tx)
+        {
+          receivers.push_back (m_nodes.Get (j)->GetObject<MobilityModel> ());
+        }
+    }
+  return receivers;
+}
+
+/**
+ * In this test, the PSDs received by all the vehicles of a platoon are
+ * computed with a worker pool and then in the calling thread. The test
+ * checks that the two computations give the same value in every band.
+ * The test runs at time 0, when the Doppler terms are equal to one, hence
+ * the different random values drawn by the two computations do not matter.
+ */
+class MmWaveVehicularParallelFanOutTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularParallelFanOutTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularParallelFanOutTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularParallelFanOutTestCase::MmWaveVehicularParallelFanOutTestCase ()
+  : TestCase ("The parallel fan-out gives the same PSDs as the serial one")
+{
+}
+
+MmWaveVehicularParallelFanOutTestCase::~MmWaveVehicularParallelFanOutTestCase ()
+{
+}
+
+void
+MmWaveVehicularParallelFanOutTestCase::DoRun (void)
+{
+  MmWaveVehicularTestPlatoon platoon (8, 5);
+  Ptr<MmWaveVehicularWorkerPool> pool = Create<MmWaveVehicularWorkerPool> (4);
+
+  for (uint32_t i = 0; i < platoon.m_nodes.GetN (); ++i)
+    {
+      Ptr<const MobilityModel> a = platoon.m_nodes.Get (i)->GetObject<MobilityModel> ();
+      std::vector<Ptr<const MobilityModel> > receivers = platoon.GetReceivers (i);
+
+      // the channels of the links transmitted by this vehicle are generated
+      // by the first call, hence also the long term components are computed
+      // by the workers
+      std::vector<Ptr<SpectrumValue> > parallel = platoon.m_splm->CalcRxPowerSpectralDensityMulti (platoon.m_txPsd, a, receivers, pool);
+      std::vector<Ptr<SpectrumValue> > serial = platoon.m_splm->CalcRxPowerSpectralDensityMulti (platoon.m_txPsd, a, receivers);
+
+      NS_TEST_ASSERT_MSG_EQ (parallel.size (), receivers.size (), "Wrong number of PSDs");
+      NS_TEST_ASSERT_MSG_EQ (serial.size (), receivers.size (), "Wrong number of PSDs");
+      for (uint32_t j = 0; j < receivers.size (); ++j)
+        {
+          NS_TEST_ASSERT_MSG_EQ (parallel[j]->GetSpectrumModel ()->GetNumBands (), serial[j]->GetSpectrumModel ()->GetNumBands (), "Different spectrum models");
+          for (uint32_t k = 0; k < serial[j]->GetSpectrumModel ()->GetNumBands (); ++k)
+            {
+              NS_TEST_EXPECT_MSG_EQ ((*parallel[j])[k], (*serial[j])[k], "Different PSD in band " << k << " from " << i << " to receiver " << j);
+            }
+          NS_TEST_EXPECT_MSG_GT (Sum (*serial[j]), 0.0, "Empty PSD");
+        }
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * In this test, the channel between two vehicles is recorded in a trace,
+ * which only contains the realization of the link from the first to the
+ * second vehicle. The trace is then replayed computing first the PSD
+ * received by the first vehicle, so that the realization of the reverse link
+ * is used. The test checks that the PSDs received by the two vehicles are
+ * equal to the recorded ones.
+ */
+class MmWaveVehicularChannelReplayTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularChannelReplayTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularChannelReplayTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularChannelReplayTestCase::MmWaveVehicularChannelReplayTestCase ()
+  : TestCase ("The replayed channel gives the recorded PSDs when the first transmitter is swapped")
+{
+}
+
+MmWaveVehicularChannelReplayTestCase::~MmWaveVehicularChannelReplayTestCase ()
+{
+}
+
+void
+MmWaveVehicularChannelReplayTestCase::DoRun (void)
+{
+  std::string fileName = CreateTempDirFilename ("channel-replay-test.bin");
+  Config::SetDefault ("ns3::MmWaveVehicularSpectrumPropagationLossModel::ChannelTraceFile", StringValue (fileName));
+
+  // record the channel, which is generated for the link from the first to
+  // the second vehicle and shared by the reverse link
+  Config::SetDefault ("ns3::MmWaveVehicularSpectrumPropagationLossModel::ChannelTraceMode", StringValue ("Record"));
+  Ptr<SpectrumValue> recorded[2];
+  {
+    MmWaveVehicularTestPlatoon platoon (2, 10);
+    Ptr<const MobilityModel> first = platoon.m_nodes.Get (0)->GetObject<MobilityModel> ();
+    Ptr<const MobilityModel> second = platoon.m_nodes.Get (1)->GetObject<MobilityModel> ();
+    recorded[1] = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, first, second);
+    recorded[0] = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, second, first);
+    platoon.m_splm->Dispose (); // the index is written here
+  }
+
+  // the node IDs start again from 0
+  Simulator::Destroy ();
+
+  // replay the channel, starting from the reverse link
+  Config::SetDefault ("ns3::MmWaveVehicularSpectrumPropagationLossModel::ChannelTraceMode", StringValue ("Replay"));
+  Ptr<SpectrumValue> replayed[2];
+  {
+    MmWaveVehicularTestPlatoon platoon (2, 10);
+    Ptr<const MobilityModel> first = platoon.m_nodes.Get (0)->GetObject<MobilityModel> ();
+    Ptr<const MobilityModel> second = platoon.m_nodes.Get (1)->GetObject<MobilityModel> ();
+    replayed[0] = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, second, first);
+    replayed[1] = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, first, second);
+  }
+
+  for (uint32_t i = 0; i < 2; ++i)
+    {
+      NS_TEST_ASSERT_MSG_GT (Sum (*recorded[i]), 0.0, "Empty PSD");
+      for (uint32_t k = 0; k < recorded[i]->GetSpectrumModel ()->GetNumBands (); ++k)
+        {
+          NS_TEST_EXPECT_MSG_EQ_TOL ((*replayed[i])[k], (*recorded[i])[k], (*recorded[i])[k] * 1e-9,
+                                     "Different PSD at vehicle " << i << " in band " << k);
+        }
+    }
+
+  Config::SetDefault ("ns3::MmWaveVehicularSpectrumPropagationLossModel::ChannelTraceMode", StringValue ("Disabled"));
+  Config::SetDefault ("ns3::MmWaveVehicularSpectrumPropagationLossModel::ChannelTraceFile", StringValue ("channel-trace.bin"));
+  std::remove (fileName.c_str ());
+  Simulator::Destroy ();
+}
+
+/**
+ * In this test, the beam sweep between two vehicles is performed in both
+ * directions, after the channel of one direction has been generated. The
+ * sweep in the other direction uses the realization of the reverse link.
+ * The test checks that the selected pair of beams is mirrored and that the
+ * two directions have the same gain.
+ */
+class MmWaveVehicularBeamSweepReciprocityTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   * \param widebandOnly the value of the attribute WidebandOnly of the sweep
+   */
+  MmWaveVehicularBeamSweepReciprocityTestCase (bool widebandOnly);
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularBeamSweepReciprocityTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  bool m_widebandOnly; //!< the value of the attribute WidebandOnly of the sweep
+};
+
+MmWaveVehicularBeamSweepReciprocityTestCase::MmWaveVehicularBeamSweepReciprocityTestCase (bool widebandOnly)
+  : TestCase (std::string ("The beam sweep gives mirrored pairs in the two directions") + (widebandOnly ? ", wideband" : ", per band")),
+    m_widebandOnly (widebandOnly)
+{
+}
+
+MmWaveVehicularBeamSweepReciprocityTestCase::~MmWaveVehicularBeamSweepReciprocityTestCase ()
+{
+}
+
+void
+MmWaveVehicularBeamSweepReciprocityTestCase::DoRun (void)
+{
+  MmWaveVehicularTestPlatoon platoon (2, 10);
+  Ptr<NetDevice> first = platoon.m_devices.Get (0);
+  Ptr<NetDevice> second = platoon.m_devices.Get (1);
+
+  // move the second vehicle to another lane, so that the directions of the
+  // link seen by the two vehicles are not symmetric
+  platoon.m_nodes.Get (1)->GetObject<MobilityModel> ()->SetPosition (Vector (3, 10, 0));
+  platoon.m_splm->GetAntenna (first)->SetBeamformingVectorPanelDevices (first, second);
+  platoon.m_splm->GetAntenna (second)->SetBeamformingVectorPanelDevices (second, first);
+
+  // generate the channel from the first to the second vehicle
+  Ptr<SpectrumValue> rxPsd = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd,
+                                                                         platoon.m_nodes.Get (0)->GetObject<MobilityModel> (),
+                                                                         platoon.m_nodes.Get (1)->GetObject<MobilityModel> ());
+  NS_TEST_ASSERT_MSG_GT (Sum (*rxPsd), 0.0, "Empty PSD");
+
+  Ptr<MmWaveVehicularBeamSweep> sweep = CreateObject<MmWaveVehicularBeamSweep> ();
+  sweep->SetAttribute ("WidebandOnly", BooleanValue (m_widebandOnly));
+  sweep->SetPropagationLossModel (platoon.m_splm);
+
+  MmWaveVehicularBeamSweep::Result forward;
+  MmWaveVehicularBeamSweep::Result backward;
+  NS_TEST_ASSERT_MSG_EQ (sweep->Sweep (first, second, platoon.m_txPsd->GetSpectrumModel (), MicroSeconds (9), forward), true, "The channel is not available");
+  NS_TEST_ASSERT_MSG_EQ (sweep->Sweep (second, first, platoon.m_txPsd->GetSpectrumModel (), MicroSeconds (9), backward), true, "The channel is not available");
+
+  NS_TEST_EXPECT_MSG_EQ (backward.m_txBeam, forward.m_rxBeam, "The tx beam of the reverse link is not mirrored");
+  NS_TEST_EXPECT_MSG_EQ (backward.m_rxBeam, forward.m_txBeam, "The rx beam of the reverse link is not mirrored");
+  NS_TEST_EXPECT_MSG_EQ_TOL (backward.m_gain, forward.m_gain, forward.m_gain * 1e-9, "The gain of the two directions differs");
+  NS_TEST_EXPECT_MSG_EQ (backward.m_numPairs, forward.m_numPairs, "Different number of pairs");
+  NS_TEST_EXPECT_MSG_GT (forward.m_gain, 0.0, "Null gain");
+
+  sweep->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * In this test, the pool of PSD buffers is enabled and a receiver keeps the
+ * PSD of a first transmission while a second one, with a lower power, is
+ * received. The test checks that the kept PSD is not overwritten, that a
+ * buffer is reused only after it has been released, and that the PSDs are
+ * equal to the ones computed without the pool.
+ */
+class MmWaveVehicularPsdPoolTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularPsdPoolTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularPsdPoolTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularPsdPoolTestCase::MmWaveVehicularPsdPoolTestCase ()
+  : TestCase ("The pool does not reuse the PSDs kept by the receivers")
+{
+}
+
+MmWaveVehicularPsdPoolTestCase::~MmWaveVehicularPsdPoolTestCase ()
+{
+}
+
+void
+MmWaveVehicularPsdPoolTestCase::DoRun (void)
+{
+  MmWaveVehicularTestPlatoon platoon (2, 10);
+  Ptr<const MobilityModel> a = platoon.m_nodes.Get (0)->GetObject<MobilityModel> ();
+  Ptr<const MobilityModel> b = platoon.m_nodes.Get (1)->GetObject<MobilityModel> ();
+  Ptr<SpectrumValue> lowTxPsd = Copy (platoon.m_txPsd);
+  *lowTxPsd *= 0.1;
+
+  platoon.m_splm->SetAttribute ("PsdPoolSize", UintegerValue (4));
+
+  // the receiver keeps the first PSD, e.g., as an interfering signal
+  Ptr<SpectrumValue> kept = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, a, b);
+  Ptr<SpectrumValue> keptValues = Copy (kept);
+  Ptr<SpectrumValue> second = platoon.m_splm->CalcRxPowerSpectralDensity (lowTxPsd, a, b);
+  NS_TEST_ASSERT_MSG_NE (PeekPointer (second), PeekPointer (kept), "The kept PSD has been reused");
+  for (uint32_t k = 0; k < kept->GetSpectrumModel ()->GetNumBands (); ++k)
+    {
+      NS_TEST_EXPECT_MSG_EQ ((*kept)[k], (*keptValues)[k], "The kept PSD has been overwritten in band " << k);
+      NS_TEST_EXPECT_MSG_EQ_TOL ((*second)[k], (*kept)[k] * 0.1, (*kept)[k] * 1e-9, "Wrong PSD in band " << k);
+    }
+
+  // once released, the buffer of the second PSD is reused
+  SpectrumValue *secondBuffer = PeekPointer (second);
+  second = 0;
+  Ptr<SpectrumValue> third = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, a, b);
+  NS_TEST_EXPECT_MSG_EQ (PeekPointer (third), secondBuffer, "The released buffer has not been reused");
+  NS_TEST_EXPECT_MSG_NE (PeekPointer (third), PeekPointer (kept), "The kept PSD has been reused");
+
+  // same PSD without the pool
+  platoon.m_splm->SetAttribute ("PsdPoolSize", UintegerValue (0));
+  Ptr<SpectrumValue> baseline = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, a, b);
+  for (uint32_t k = 0; k < baseline->GetSpectrumModel ()->GetNumBands (); ++k)
+    {
+      NS_TEST_EXPECT_MSG_EQ ((*third)[k], (*baseline)[k], "Different PSD without the pool in band " << k);
+      NS_TEST_EXPECT_MSG_EQ ((*keptValues)[k], (*baseline)[k], "Different PSD without the pool in band " << k);
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * In this test, the PSDs received by all the vehicles of a platoon are
+ * computed with a single call to CalcRxPowerSpectralDensityMulti and then
+ * link by link with CalcRxPowerSpectralDensity. The test checks that the two
+ * computations give the same value in every band. The test runs at time 0,
+ * when the Doppler terms are equal to one.
+ */
+class MmWaveVehicularFanOutTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularFanOutTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularFanOutTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularFanOutTestCase::MmWaveVehicularFanOutTestCase ()
+  : TestCase ("The fan-out gives the same PSDs as the computation link by link")
+{
+}
+
+MmWaveVehicularFanOutTestCase::~MmWaveVehicularFanOutTestCase ()
+{
+}
+
+void
+MmWaveVehicularFanOutTestCase::DoRun (void)
+{
+  MmWaveVehicularTestPlatoon platoon (5, 5);
+
+  for (uint32_t i = 0; i < platoon.m_nodes.GetN (); ++i)
+    {
+      Ptr<const MobilityModel> a = platoon.m_nodes.Get (i)->GetObject<MobilityModel> ();
+      std::vector<Ptr<const MobilityModel> > receivers = platoon.GetReceivers (i);
+
+      std::vector<Ptr<SpectrumValue> > fanOut = platoon.m_splm->CalcRxPowerSpectralDensityMulti (platoon.m_txPsd, a, receivers);
+      NS_TEST_ASSERT_MSG_EQ (fanOut.size (), receivers.size (), "Wrong number of PSDs");
+      for (uint32_t j = 0; j < receivers.size (); ++j)
+        {
+          Ptr<SpectrumValue> single = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, a, receivers[j]);
+          NS_TEST_ASSERT_MSG_EQ (fanOut[j]->GetSpectrumModel ()->GetNumBands (), single->GetSpectrumModel ()->GetNumBands (), "Different spectrum models");
+          for (uint32_t k = 0; k < single->GetSpectrumModel ()->GetNumBands (); ++k)
+            {
+              NS_TEST_EXPECT_MSG_EQ_TOL ((*fanOut[j])[k], (*single)[k], (*single)[k] * 1e-9, "Different PSD in band " << k << " from " << i << " to receiver " << j);
+            }
+          NS_TEST_EXPECT_MSG_GT (Sum (*single), 0.0, "Empty PSD");
+        }
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * In this test, the wideband gain matrix of a platoon is computed with a
+ * worker pool and then link by link, as the average over the bands of the
+ * PSD received with CalcRxPowerSpectralDensity from a flat unit PSD. The
+ * test checks that the two computations agree, and that the strongest
+ * neighbors are the ones with the largest gains in the matrix.
+ */
+class MmWaveVehicularGainMatrixTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularGainMatrixTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularGainMatrixTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularGainMatrixTestCase::MmWaveVehicularGainMatrixTestCase ()
+  : TestCase ("The gain matrix is equal to the gains computed link by link")
+{
+}
+
+MmWaveVehicularGainMatrixTestCase::~MmWaveVehicularGainMatrixTestCase ()
+{
+}
+
+void
+MmWaveVehicularGainMatrixTestCase::DoRun (void)
+{
+  MmWaveVehicularTestPlatoon platoon (5, 5);
+  Ptr<MmWaveVehicularWorkerPool> pool = Create<MmWaveVehicularWorkerPool> (4);
+  uint32_t n = platoon.m_nodes.GetN ();
+  std::vector<Ptr<const MobilityModel> > nodes;
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      nodes.push_back (platoon.m_nodes.Get (i)->GetObject<MobilityModel> ());
+    }
+  Ptr<const SpectrumModel> sm = platoon.m_txPsd->GetSpectrumModel ();
+
+  std::vector<double> gains (n * n, -1.0);
+  platoon.m_splm->ComputeGainMatrix (sm, nodes, gains.data (), pool);
+
+  Ptr<SpectrumValue> ones = Create<SpectrumValue> (sm);
+  (*ones) = 1.0;
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (gains[i * n + i], 0.0, "The diagonal must be 0");
+      for (uint32_t j = 0; j < n; ++j)
+        {
+          if (j == i)
+            {
+              continue;
+            }
+          Ptr<SpectrumValue> rxPsd = platoon.m_splm->CalcRxPowerSpectralDensity (ones, nodes[i], nodes[j]);
+          double gain = Sum (*rxPsd) / sm->GetNumBands ();
+          NS_TEST_EXPECT_MSG_GT (gain, 0.0, "Null gain from " << i << " to " << j);
+          NS_TEST_EXPECT_MSG_EQ_TOL (gains[i * n + j], gain, gain * 1e-9, "Different gain from " << i << " to " << j);
+        }
+    }
+
+  uint32_t k = 2;
+  std::vector<uint32_t> neighbors (n * k);
+  std::vector<double> neighborGains (n * k);
+  platoon.m_splm->ComputeStrongestNeighbors (sm, nodes, k, neighbors.data (), neighborGains.data ());
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      std::vector<double> row;
+      for (uint32_t j = 0; j < n; ++j)
+        {
+          if (j != i)
+            {
+              row.push_back (gains[i * n + j]);
+            }
+        }
+      std::sort (row.begin (), row.end (), std::greater<double> ());
+      for (uint32_t m = 0; m < k; ++m)
+        {
+          uint32_t neighbor = neighbors[i * k + m];
+          NS_TEST_ASSERT_MSG_LT (neighbor, n, "Missing neighbor of " << i);
+          NS_TEST_EXPECT_MSG_NE (neighbor, i, "A device is not its own neighbor");
+          NS_TEST_EXPECT_MSG_EQ_TOL (neighborGains[i * k + m], gains[i * n + neighbor], gains[i * n + neighbor] * 1e-9, "Wrong gain of neighbor " << m << " of " << i);
+          NS_TEST_EXPECT_MSG_EQ_TOL (neighborGains[i * k + m], row[m], row[m] * 1e-9, "Neighbor " << m << " of " << i << " is not the strongest");
+        }
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * In this test, the middle vehicle of a platoon transmits to the vehicle
+ * ahead, then points its beam to the vehicle behind, which uses the other
+ * panel, and back. The test checks that the panel switches reuse the same
+ * channel realization, and that the PSD received with each panel is the same
+ * before and after the switches, i.e., the cached projections are used.
+ */
+class MmWaveVehicularPanelSwitchTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularPanelSwitchTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularPanelSwitchTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+
+  /**
+   * Check that two PSDs are equal in every band
+   * \param actual the PSD under test
+   * \param expected the expected PSD
+   * \param msg the message printed in case of failure
+   */
+  void CheckPsd (Ptr<const SpectrumValue> actual, Ptr<const SpectrumValue> expected, std::string msg);
+};
+
+MmWaveVehicularPanelSwitchTestCase::MmWaveVehicularPanelSwitchTestCase ()
+  : TestCase ("The panel switches reuse the channel realization and its projections")
+{
+}
+
+MmWaveVehicularPanelSwitchTestCase::~MmWaveVehicularPanelSwitchTestCase ()
+{
+}
+
+void
+MmWaveVehicularPanelSwitchTestCase::CheckPsd (Ptr<const SpectrumValue> actual, Ptr<const SpectrumValue> expected, std::string msg)
+{
+  NS_TEST_ASSERT_MSG_EQ (actual->GetSpectrumModel ()->GetNumBands (), expected->GetSpectrumModel ()->GetNumBands (), msg << ": different spectrum models");
+  for (uint32_t k = 0; k < expected->GetSpectrumModel ()->GetNumBands (); ++k)
+    {
+      NS_TEST_EXPECT_MSG_EQ_TOL ((*actual)[k], (*expected)[k], (*expected)[k] * 1e-9, msg << ": different PSD in band " << k);
+    }
+}
+
+void
+MmWaveVehicularPanelSwitchTestCase::DoRun (void)
+{
+  MmWaveVehicularTestPlatoon platoon (3, 10);
+  Ptr<NetDevice> behind = platoon.m_devices.Get (0);
+  Ptr<NetDevice> tx = platoon.m_devices.Get (1);
+  Ptr<NetDevice> ahead = platoon.m_devices.Get (2);
+  Ptr<const MobilityModel> a = platoon.m_nodes.Get (1)->GetObject<MobilityModel> ();
+  Ptr<const MobilityModel> b = platoon.m_nodes.Get (2)->GetObject<MobilityModel> ();
+  Ptr<MmWaveVehicularAntennaArrayModel> antenna = platoon.m_splm->GetAntenna (tx);
+
+  // the beam points to the vehicle ahead
+  double frontPanel = antenna->GetPlanesId ();
+  Ptr<SpectrumValue> front = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, a, b);
+  bool reverse = false;
+  Ptr<const Params3gpp> channel = platoon.m_splm->GetCachedChannel (tx, ahead, reverse);
+  NS_TEST_ASSERT_MSG_EQ ((channel != 0), true, "The channel has not been generated");
+
+  // the beam points to the vehicle behind, with the other panel
+  antenna->SetBeamformingVectorPanelDevices (tx, behind);
+  NS_TEST_ASSERT_MSG_NE (antenna->GetPlanesId (), frontPanel, "The panel has not changed");
+  Ptr<SpectrumValue> back = platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, a, b);
+  NS_TEST_EXPECT_MSG_EQ ((platoon.m_splm->GetCachedChannel (tx, ahead, reverse) == channel), true, "A new channel has been generated for the other panel");
+
+  // back to the first panel, and again to the second one
+  antenna->SetBeamformingVectorPanelDevices (tx, ahead);
+  CheckPsd (platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, a, b), front, "first panel");
+  antenna->SetBeamformingVectorPanelDevices (tx, behind);
+  CheckPsd (platoon.m_splm->CalcRxPowerSpectralDensity (platoon.m_txPsd, a, b), back, "second panel");
+  NS_TEST_EXPECT_MSG_EQ ((platoon.m_splm->GetCachedChannel (tx, ahead, reverse) == channel), true, "A new channel has been generated");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * In this test, some devices are added with their context, in which the
+ * caller set the same index, and one device is added without its context,
+ * which is created when it is first requested. The test checks that the
+ * indices are allocated by the model, ignoring the value set by the caller,
+ * and that they are unique and dense.
+ */
+class MmWaveVehicularDeviceIndexTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor
+   */
+  MmWaveVehicularDeviceIndexTestCase ();
+
+  /**
+   * Destructor
+   */
+  virtual ~MmWaveVehicularDeviceIndexTestCase ();
+
+private:
+  /**
+   * This method runs the test
+   */
+  virtual void DoRun (void);
+};
+
+MmWaveVehicularDeviceIndexTestCase::MmWaveVehicularDeviceIndexTestCase ()
+  : TestCase ("The indices of the device contexts are unique")
+{
+}
+
+MmWaveVehicularDeviceIndexTestCase::~MmWaveVehicularDeviceIndexTestCase ()
+{
+}
+
+void
+MmWaveVehicularDeviceIndexTestCase::DoRun (void)
+{
+  uint32_t numDevices = 4;
+  uint32_t withoutContext = 1; // the device added without its context
+
+  Ptr<MmWaveVehicularSpectrumPropagationLossModel> splm = CreateObject<MmWaveVehicularSpectrumPropagationLossModel> ();
+  NodeContainer nodes;
+  nodes.Create (numDevices);
+  std::vector<Ptr<MobilityModel> > mobilities;
+  for (uint32_t i = 0; i < numDevices; ++i)
+    {
+      Ptr<MobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (Vector (i * 10.0, 0, 0));
+      nodes.Get (i)->AggregateObject (mobility);
+      Ptr<NetDevice> device = CreateObject<SimpleNetDevice> ();
+      nodes.Get (i)->AddDevice (device);
+      Ptr<MmWaveVehicularAntennaArrayModel> antenna = CreateObject<MmWaveVehicularAntennaArrayModel> ();
+      mobilities.push_back (mobility);
+
+      if (i == withoutContext)
+        {
+          splm->AddDevice (device, antenna);
+          continue;
+        }
+
+      Ptr<MmWaveVehicularDeviceContext> context = Create<MmWaveVehicularDeviceContext> ();
+      context->m_device = device;
+      context->m_rnti = i + 1;
+      context->m_index = 7; // ignored by the model
+      context->m_antenna = antenna;
+      context->m_mobility = mobility;
+      splm->AddDevice (context);
+    }
+
+  std::set<uint32_t> indices;
+  for (uint32_t i = 0; i < numDevices; ++i)
+    {
+      Ptr<const MmWaveVehicularDeviceContext> context = splm->GetDeviceContext (mobilities[i]);
+      NS_TEST_EXPECT_MSG_LT (context->m_index, numDevices, "The index of device " << i << " is not dense");
+      NS_TEST_EXPECT_MSG_EQ (indices.insert (context->m_index).second, true, "The index of device " << i << " is not unique");
+      NS_TEST_EXPECT_MSG_EQ ((context == splm->GetDeviceContext (mobilities[i])), true, "The context of device " << i << " is not cached");
+    }
+  NS_TEST_EXPECT_MSG_EQ (splm->GetDeviceContext (mobilities[withoutContext])->m_index, numDevices - 1, "The context created on request takes the next index");
+
+  splm->Dispose ();
+}
+
+/**
+ * Test suite for the MmWaveVehicularSpectrumPropagationLossModel
+ */
+class MmWaveVehicularSpectrumPropagationLossModelTestSuite : public TestSuite
+{
+public:
+  MmWaveVehicularSpectrumPropagationLossModelTestSuite ();
+};
+
+MmWaveVehicularSpectrumPropagationLossModelTestSuite::MmWaveVehicularSpectrumPropagationLossModelTestSuite ()
+  : TestSuite ("mmwave-vehicular-spectrum-propagation-loss-model", UNIT)
+{
+  AddTestCase (new MmWaveVehicularParallelFanOutTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularChannelReplayTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularFanOutTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularGainMatrixTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularPanelSwitchTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularBeamSweepReciprocityTestCase (true), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularBeamSweepReciprocityTestCase (false), TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularPsdPoolTestCase, TestCase::QUICK);
+  AddTestCase (new MmWaveVehicularDeviceIndexTestCase, TestCase::QUICK);
+}
+
+static MmWaveVehicularSpectrumPropagationLossModelTestSuite mmwaveVehicularSpectrumPropagationLossModelTestSuite;